@@ -45,7 +45,12 @@
 #include "drsyms.h"
 #include "hashtable.h"
 #include "dr_frontend.h"
+#include <atomic>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "../../common/utils.h"
 #undef ASSERT /* we're standalone, so no client assert */
@@ -180,6 +185,13 @@ static droption_t<bool> op_include_tool(
     "coverage output.  Normally such execution is excluded and the output focuses on "
     "the application only.");
 
+static droption_t<unsigned int> op_jobs(
+    DROPTION_SCOPE_FRONTEND, "jobs", 0, 0, 1024, "Number of worker threads",
+    "Specifies the number of threads used to read and merge the input log files.  "
+    "A value of 0 uses one thread per hardware thread.  The output does not depend on "
+    "this value.  The -reduce_set and -test_pattern options depend on the order in "
+    "which the logs are read, so they always use a single thread.");
+
 static droption_t<bool> op_help(DROPTION_SCOPE_FRONTEND, "help", false,
                                 "Print this message", "Prints the usage message.");
 
@@ -282,6 +294,7 @@ struct _line_chunk_t {
         byte *exec;        /* array of the execution info on the line */
         const char **test; /* array of the test name ptr on the line */
     } info;
+    uint *count; /* array of execution counts from hit-count logs, or NULL */
     line_chunk_t *next;
 };
 
@@ -313,6 +326,11 @@ line_chunk_alloc(uint num_lines)
         chunk->info.exec = (byte *)line_info;
     }
     ASSERT(line_info != NULL, "Failed to alloc line info array\n");
+    chunk->count = NULL;
+    if (!op_test_pattern.specified()) {
+        chunk->count = (uint *)calloc(num_lines, sizeof(chunk->count[0]));
+        ASSERT(chunk->count != NULL, "Failed to alloc line count array\n");
+    }
     return chunk;
 }
 
@@ -323,6 +341,7 @@ line_chunk_free(line_chunk_t *chunk)
         free((void *)chunk->info.test); /* cast from "const char **" to "void *" */
     else
         free(chunk->info.exec);
+    free(chunk->count);
     free(chunk);
 }
 
@@ -352,9 +371,13 @@ line_chunk_print(line_chunk_t *chunk, char *start)
             }
         } else {
             if (chunk->info.exec[i] != (byte)SOURCE_LINE_STATUS_NONE) {
-                res = dr_snprintf(
-                    start, MAX_CHAR_PER_LINE, "DA:%u,%u\n", line_num,
-                    chunk->info.exec[i] == (byte)SOURCE_LINE_STATUS_SKIP ? 0 : 1);
+                /* Lines only seen in logs without hit counts have a count of 0
+                 * and are reported as executed once, as before.
+                 */
+                res = dr_snprintf(start, MAX_CHAR_PER_LINE, "DA:%u,%u\n", line_num,
+                                  chunk->info.exec[i] == (byte)SOURCE_LINE_STATUS_SKIP
+                                      ? 0
+                                      : (chunk->count[i] == 0 ? 1 : chunk->count[i]));
             }
         }
         ASSERT(res < MAX_CHAR_PER_LINE && res != -1, "Error on printing\n");
@@ -427,7 +450,8 @@ line_table_delete(void *p)
 }
 
 static inline void
-line_table_add(line_table_t *line_table, uint line, byte status, const char *test_info)
+line_table_add(line_table_t *line_table, uint line, byte status, const char *test_info,
+               uint count)
 {
     line_chunk_t *chunk = line_table->chunk;
 
@@ -484,6 +508,12 @@ line_table_add(line_table_t *line_table, uint line, byte status, const char *tes
                     chunk->info.exec[line - chunk->first_num] !=
                         (byte)SOURCE_LINE_STATUS_EXEC)
                     chunk->info.exec[line - chunk->first_num] = status;
+                /* A line may map to several addresses: we report the count of the
+                 * most-executed one, as the per-address counts of a single line
+                 * largely overlap.
+                 */
+                if (count > chunk->count[line - chunk->first_num])
+                    chunk->count[line - chunk->first_num] = count;
             }
             return;
         }
@@ -499,6 +529,10 @@ line_table_add(line_table_t *line_table, uint line, byte status, const char *tes
 #define MODULE_HASH_TABLE_BITS 6
 static hashtable_t module_htable;
 static uint num_module_htable_entries;
+/* Guards module_htable while log files are read in parallel.  Each module's
+ * table has its own lock for its contents.
+ */
+static std::mutex module_htable_lock;
 
 #define MODULE_TABLE_IGNORE ((void *)(ptr_int_t)(-1))
 #define MIN_LOG_FILE_SIZE 20
@@ -537,6 +571,12 @@ typedef struct _module_table_t {
         const char **array;  /* store test info (char *) for each app byte */
     } bb_table;              /* data structure storing which bb is seen */
     hashtable_t test_htable; /* hashtable for test functions found in the module */
+    /* Execution count for each app byte, summed over the hit-count logs read.
+     * Allocated on the first hit count seen for the module.
+     */
+    uint *counts;
+    /* Guards bb_table and counts while log files are read in parallel. */
+    std::mutex *lock;
 } module_table_t;
 
 static void
@@ -546,8 +586,10 @@ module_table_delete(void *p)
     PRINT(3, "Delete module table " PFX "\n", table);
     if (table != MODULE_TABLE_IGNORE) {
         free(table->bb_table.bitmap);
+        free(table->counts);
         if (op_test_pattern.specified())
             hashtable_delete(&table->test_htable);
+        delete table->lock;
         free(table);
     }
 }
@@ -633,6 +675,39 @@ bb_array_add(module_table_t *table, bb_entry_t *entry)
     return true;
 }
 
+/* Adds a bb's hit count to each of its bytes, saturating rather than wrapping. */
+static inline void
+module_table_count_add(module_table_t *table, bb_entry_t *entry, uint64 count)
+{
+    uint i;
+    if (table == MODULE_TABLE_IGNORE || count == 0 ||
+        table->size <= entry->start + entry->size || op_test_pattern.specified())
+        return;
+    if (table->counts == NULL) {
+        /* XXX: this is 4x the module size, but it is only allocated for modules
+         * that have hit counts.
+         */
+        table->counts = (uint *)calloc(table->size, sizeof(table->counts[0]));
+        ASSERT(table->counts != NULL, "Failed to create module count table");
+    }
+    if (count > UINT_MAX)
+        count = UINT_MAX;
+    for (i = entry->start; i < entry->start + entry->size; i++) {
+        if (table->counts[i] > UINT_MAX - (uint)count)
+            table->counts[i] = UINT_MAX;
+        else
+            table->counts[i] += (uint)count;
+    }
+}
+
+static inline uint
+module_table_count_lookup(module_table_t *table, uint addr)
+{
+    if (table->counts == NULL || table->size <= addr)
+        return 0;
+    return table->counts[addr];
+}
+
 static int
 module_table_bb_lookup(module_table_t *table, uint addr, const char **info)
 {
@@ -713,6 +788,7 @@ module_table_create(const char *module, size_t size)
     table = (module_table_t *)calloc(1, sizeof(*table));
     ASSERT(table != NULL, "Failed to allocate module table");
     table->size = (size_t)size;
+    table->lock = new std::mutex;
     PRINT(3, "module table %p, %u\n", table, (uint)size);
     if (op_test_pattern.specified()) {
         /* i#1465: add unittest case coverage information in drcov.
@@ -767,6 +843,10 @@ read_module_list(const char *buf, module_table_t ***tables, uint *num_mods)
         if (drmodtrack_offline_lookup(handle, i, &info) != DRCOVLIB_SUCCESS)
             ASSERT(false, "Failed to read module table");
         PRINT(5, "Module: %u, 0x%zx, %s\n", i, info.size, info.path);
+        /* Modules are deduplicated by path across all logs, so each one's coverage
+         * is merged into one table and it is only symbolized once.
+         */
+        std::lock_guard<std::mutex> guard(module_htable_lock);
         mod_table = (module_table_t *)hashtable_lookup(&module_htable, (void *)info.path);
         if (mod_table == NULL) {
             modpath = info.path;
@@ -813,12 +893,15 @@ read_module_list(const char *buf, module_table_t ***tables, uint *num_mods)
     return buf;
 }
 
+/* counts, if not NULL, points at num_bbs possibly-unaligned uint64 hit counts. */
 static bool
-read_bb_list(const char *buf, module_table_t **tables, uint num_mods, uint num_bbs)
+read_bb_list(const char *buf, module_table_t **tables, uint num_mods, uint num_bbs,
+             const char *counts)
 {
     uint i;
     bb_entry_t *entry;
     bool add_new_bb = false;
+    module_table_t *locked = NULL;
 
     PRINT(4, "Reading %u basic blocks\n", num_bbs);
     if (op_test_pattern.specified()) {
@@ -830,9 +913,27 @@ read_bb_list(const char *buf, module_table_t **tables, uint num_mods, uint num_b
     for (i = 0, entry = (bb_entry_t *)buf; i < num_bbs; i++, entry++) {
         PRINT(6, "BB: 0x%x, %u, %u\n", entry->start, entry->size, entry->mod_id);
         /* we could have mod id USHRT_MAX for unknown module e.g., [vdso] */
-        if (entry->mod_id < num_mods)
-            add_new_bb = module_table_bb_add(tables[entry->mod_id], entry) || add_new_bb;
+        if (entry->mod_id < num_mods) {
+            module_table_t *table = tables[entry->mod_id];
+            /* Consecutive bbs are mostly in the same module, so we hold each
+             * table's lock across a run of its bbs.
+             */
+            if (table != locked && table != MODULE_TABLE_IGNORE) {
+                if (locked != NULL)
+                    locked->lock->unlock();
+                locked = table;
+                locked->lock->lock();
+            }
+            add_new_bb = module_table_bb_add(table, entry) || add_new_bb;
+            if (counts != NULL) {
+                uint64 count;
+                memcpy(&count, counts + i * sizeof(count), sizeof(count));
+                module_table_count_add(table, entry, count);
+            }
+        }
     }
+    if (locked != NULL)
+        locked->lock->unlock();
     free(tables);
     return add_new_bb;
 }
@@ -928,7 +1029,8 @@ read_drcov_file(const char *input)
     const char *map, *ptr;
     size_t map_size;
     module_table_t **tables;
-    uint num_mods, num_bbs;
+    uint num_mods, num_bbs, num_counts;
+    const char *counts = NULL;
     bool res;
 
     PRINT(2, "Reading drcov log file: %s\n", input);
@@ -957,7 +1059,26 @@ read_drcov_file(const char *input)
         close_input_file(log, map, map_size);
         return false;
     }
-    res = read_bb_list(ptr, tables, num_mods, num_bbs);
+    /* Look for the optional hit count section (DRCOVLIB_HIT_COUNTS) after the
+     * bb table.  We find the end of its header line directly rather than with
+     * move_to_next_line(), which would skip binary counts that look like newlines.
+     */
+    if (ptr + num_bbs * sizeof(bb_entry_t) < map + map_size) {
+        const char *hdr = ptr + num_bbs * sizeof(bb_entry_t);
+        size_t left = map + map_size - hdr;
+        const char *eol = (const char *)memchr(hdr, '\n', left);
+        if (eol != NULL &&
+            dr_sscanf(hdr, "BB Hit Counts: %u bbs\n", &num_counts) == 1) {
+            counts = eol + 1;
+            if (num_counts != num_bbs ||
+                counts + num_counts * sizeof(uint64) > map + map_size) {
+                WARN(1, "Wrong number of hit counts in %s; ignoring them\n", input);
+                counts = NULL;
+            } else
+                PRINT(4, "Reading %u hit counts\n", num_counts);
+        }
+    }
+    res = read_bb_list(ptr, tables, num_mods, num_bbs, counts);
     if (res && set_log != INVALID_FILE)
         dr_fprintf(set_log, "%s\n", input);
     close_input_file(log, map, map_size);
@@ -976,6 +1097,40 @@ is_drcov_log_file(const char *fname)
     return false;
 }
 
+/* Reads the given log files using op_jobs worker threads.  Returns whether any
+ * file was read successfully.
+ */
+static bool
+read_drcov_files(const std::vector<std::string> &files)
+{
+    std::atomic<size_t> next(0);
+    std::atomic<bool> any_read(false);
+    uint num_workers = op_jobs.get_value();
+    auto worker = [&]() {
+        for (size_t i = next++; i < files.size(); i = next++) {
+            if (read_drcov_file(files[i].c_str()))
+                any_read = true;
+        }
+    };
+    if (num_workers == 0)
+        num_workers = std::thread::hardware_concurrency();
+    if (op_reduce_set.specified() || op_test_pattern.specified())
+        num_workers = 1;
+    if (num_workers > files.size())
+        num_workers = (uint)files.size();
+    if (num_workers <= 1) {
+        worker();
+    } else {
+        std::vector<std::thread> threads;
+        PRINT(2, "Reading %zu log files with %u threads\n", files.size(), num_workers);
+        for (uint i = 0; i < num_workers; i++)
+            threads.push_back(std::thread(worker));
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+    return any_read;
+}
+
 #ifdef UNIX
 static bool
 read_drcov_dir(void)
@@ -984,6 +1139,7 @@ read_drcov_dir(void)
     struct dirent *ent;
     char path[MAXIMUM_PATH];
     bool found_logs = false;
+    std::vector<std::string> files;
 
     PRINT(2, "Reading input directory %s\n", input_dir_buf);
     if ((dir = opendir(input_dir_buf)) != NULL) {
@@ -996,12 +1152,13 @@ read_drcov_dir(void)
                     WARN(1, "Fail to get full path of log file %s\n", ent->d_name);
                 } else {
                     NULL_TERMINATE_BUFFER(path);
-                    read_drcov_file(path);
+                    files.push_back(path);
                     found_logs = true;
                 }
             }
         }
         closedir(dir);
+        read_drcov_files(files);
     } else {
         /* could not open directory */
         WARN(1, "Failed to open directory %s\n", input_dir_buf);
@@ -1020,6 +1177,7 @@ read_drcov_dir(void)
     char path[MAXIMUM_PATH];
     bool has_sep;
     bool found_logs = false;
+    std::vector<std::string> files;
 
     /* append \* to the end */
     strcpy(path, input_dir_buf);
@@ -1043,10 +1201,11 @@ read_drcov_dir(void)
             if (!has_sep)
                 strcat(path, "\\");
             strcat(path, ffd.cFileName);
-            found_logs = read_drcov_file(path) || found_logs;
+            files.push_back(path);
         }
     } while (FindNextFile(hFind, &ffd) != 0);
     FindClose(hFind);
+    found_logs = read_drcov_files(files);
     if (!found_logs)
         WARN(1, "Failed to find log files in dir %s\n", input_dir_buf);
     return found_logs;
@@ -1062,6 +1221,7 @@ read_drcov_list(void)
     size_t map_size;
     uint64 file_size;
     bool found_logs = false;
+    std::vector<std::string> files;
 
     PRINT(2, "Reading list %s\n", input_list_buf);
     list = open_input_file(input_list_buf, &map, &map_size, &file_size);
@@ -1076,9 +1236,10 @@ read_drcov_list(void)
         NULL_TERMINATE_BUFFER(path);
         ptr = move_to_next_line(ptr);
         null_terminate_path(path);
-        found_logs = read_drcov_file(path) || found_logs;
+        files.push_back(path);
     }
     close_input_file(list, map, map_size);
+    found_logs = read_drcov_files(files);
     if (!found_logs)
         WARN(1, "Failed to find log files on list %s\n", input_list_buf);
     return found_logs;
@@ -1126,11 +1287,12 @@ enum_line_cb(drsym_line_info_t *info, void *data)
     if (status == BB_TABLE_ENTRY_SET) {
         PRINT(5, "exec: ");
         line_table_add(line_table, (uint)info->line, (byte)SOURCE_LINE_STATUS_EXEC,
-                       test_info);
+                       test_info,
+                       module_table_count_lookup(table, (uint)info->line_addr));
     } else if (status == BB_TABLE_ENTRY_CLEAR) {
         PRINT(5, "skip: ");
         line_table_add(line_table, (uint)info->line, (byte)SOURCE_LINE_STATUS_SKIP,
-                       test_info);
+                       test_info, 0);
     } else {
         WARN(2, "Invalid bb lookup, Table: " PFX ", Addr: " PIFX "\n", table,
              IF_NOT_X64((uint)) info->line);
@@ -44,15 +44,6 @@ string(REGEX REPLACE "@@" " " cmd "${cmd}")
 string(REGEX REPLACE "@" ";" cmd "${cmd}")
 string(REGEX REPLACE "!" "\\\;" cmd "${cmd}")
 
-# run the cmd
-execute_process(COMMAND ${cmd}
-  RESULT_VARIABLE cmd_result
-  ERROR_VARIABLE cmd_err
-  OUTPUT_VARIABLE cmd_out)
-if (cmd_result)
-  message(FATAL_ERROR "*** ${cmd} failed (${cmd_result}): ${cmd_err}***\n")
-endif (cmd_result)
-
 # get the real test name:
 # CMake uses the first '.' to identify the longest extension, so we cannot use
 # get_filename_component to get the real test name directly.
@@ -62,8 +53,30 @@ string(REGEX REPLACE "\\.[^.]+$" "" test_name ${test_name})
 # tool.drcov.fib => fib
 string(REGEX REPLACE "^.+\\.([^.]+)$" "\\1" test_name ${test_name})
 
-FILE(GLOB drcov_logs "drcov.*${test_name}*.log")
-set(cov_file "coverage.${test_name}")
+# A variant of a test, such as fib_counts, runs the same app with different
+# drcov options (which must include "-logdir <variant>") and keeps its logs in
+# a subdirectory named after the variant so they are not mixed with the base
+# test's logs.
+if ("${test_name}" MATCHES "^([^_]+)_.+$")
+  set(log_dir "${test_name}")
+  set(test_name "${CMAKE_MATCH_1}")
+  file(REMOVE_RECURSE "${log_dir}")
+  file(MAKE_DIRECTORY "${log_dir}")
+else ()
+  set(log_dir ".")
+endif ()
+
+# run the cmd
+execute_process(COMMAND ${cmd}
+  RESULT_VARIABLE cmd_result
+  ERROR_VARIABLE cmd_err
+  OUTPUT_VARIABLE cmd_out)
+if (cmd_result)
+  message(FATAL_ERROR "*** ${cmd} failed (${cmd_result}): ${cmd_err}***\n")
+endif (cmd_result)
+
+FILE(GLOB drcov_logs "${log_dir}/drcov.*${test_name}*.log")
+set(cov_file "${log_dir}/coverage.${test_name}")
 
 file(READ ${cmp} expect)
 if (WIN32)
@@ -72,7 +85,7 @@ if (WIN32)
 endif (WIN32)
 
 execute_process(COMMAND ${postcmd}
-  -dir        ./
+  -dir        ${log_dir}
   -mod_filter ${test_name}
   -src_filter ${test_name}
   -output     ${cov_file}
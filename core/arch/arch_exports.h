@@ -2409,6 +2409,16 @@ mangle_syscall_code(dcontext_t *dcontext, fragment_t *f, byte *pc, bool skip);
 #endif
 void
 finalize_selfmod_sandbox(dcontext_t *dcontext, fragment_t *f);
+#ifdef X86
+/* Upper bound on the code inserted by insert_frag_profile_counter(): a TLS spill
+ * and restore (11 bytes each as segment moffs) around a load and store (10 bytes
+ * each as moffs) and a 4-byte lea.
+ */
+#    define FRAG_PROFILE_COUNTER_MAX_SIZE 46
+void
+insert_frag_profile_counter(dcontext_t *dcontext, instrlist_t *ilist, app_pc tag,
+                            ptr_uint_t *counter);
+#endif
 
 bool
 instr_check_xsp_mangling(dcontext_t *dcontext, instr_t *inst, int *xsp_adjust);
@@ -2439,6 +2449,11 @@ is_observed_call_site(dcontext_t *dcontext, app_pc retaddr);
 /* in optimize.c */
 void
 optimize_trace(dcontext_t *dcontext, app_pc tag, instrlist_t *trace);
+#if defined(X86) && defined(CLIENT_INTERFACE)
+uint
+optimize_trace_spills(dcontext_t *dcontext, app_pc tag, instrlist_t *trace,
+                      bool recreating);
+#endif
 #ifdef DEBUG
 void
 print_optimization_stats(void);
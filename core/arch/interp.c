@@ -65,6 +65,8 @@
 #include "../perscache.h"
 #include "../native_exec.h"
 #include "../jit_opt.h"
+#include "../fragprof.h"
+#include "../bbprebuild.h"
 
 #ifdef CHECK_RETURNS_SSE2
 #    include <setjmp.h> /* for warning when see libc setjmp */
@@ -4510,6 +4512,17 @@ mangle_bb_ilist(dcontext_t *dcontext, build_bb_t *bb)
         instrlist_disassemble(dcontext, bb->start_pc, bb->ilist, THREAD);
     });
     d_r_mangle(dcontext, bb->ilist, &bb->flags, true, bb->record_translation);
+#if defined(X86) && defined(CLIENT_INTERFACE)
+    /* A trace's blocks are counted by the trace's own counter.  Only a bb for the
+     * cache creates a counter: one being recreated uses the one it was built with.
+     */
+    if (fragprof_should_count(bb->flags) && !bb->for_trace) {
+        ptr_uint_t *counter =
+            fragprof_counter(dcontext, bb->start_pc, false /*bb*/, bb->for_cache);
+        if (counter != NULL)
+            insert_frag_profile_counter(dcontext, bb->ilist, bb->start_pc, counter);
+    }
+#endif
     DOLOG(4, LOG_INTERP, {
         LOG(THREAD, LOG_INTERP, 4, "bb ilist after mangling:\n");
         instrlist_disassemble(dcontext, bb->start_pc, bb->ilist, THREAD);
@@ -5162,11 +5175,27 @@ build_basic_block_fragment(dcontext_t *dcontext, app_pc start, uint initial_flag
         jitopt_add_dgc_bb(bb.start_pc, bb.end_pc, TEST(FRAG_IS_TRACE_HEAD, bb.flags));
     }
 
+    /* A trace head from -trace_seed_file is marked before anything can link to it.
+     * Coarse-grain trace heads are tracked per unit, so we leave those alone.
+     */
+    if (!TESTANY(FRAG_IS_TRACE_HEAD | FRAG_CANNOT_BE_TRACE | FRAG_COARSE_GRAIN |
+                     FRAG_TEMP_PRIVATE,
+                 bb.flags) &&
+        fragprof_is_trace_seed(start)) {
+        bb.flags |= FRAG_IS_TRACE_HEAD;
+        RSTATS_INC(num_trace_seeds_marked);
+    }
+
     /* emit fragment into fcache */
     KSTART(bb_emit);
     f = emit_fragment_ex(dcontext, start, bb.ilist, bb.flags, bb.vmlist, link, visible);
     KSTOP(bb_emit);
 
+#ifdef CLIENT_SIDELINE
+    if (DYNAMO_OPTION(bb_prebuild_threads) > 0 && link && visible)
+        bbprebuild_successors(dcontext, f, bb.end_pc);
+#endif
+
 #ifdef CUSTOM_TRACES_RET_REMOVAL
     f->num_calls = dcontext->num_calls;
     f->num_rets = dcontext->num_rets;
@@ -5370,7 +5399,8 @@ recreate_fragment_ilist(dcontext_t *dcontext, byte *pc,
         /* easy case: just a bb */
         ilist = recreate_bb_ilist(
             dcontext, (byte *)f->tag, (byte *)f->tag, NULL /*default stop*/,
-            0 /*no pre flags*/, &flags, NULL, true /*check vm area*/, mangle,
+            /* a trace's private copy has no -profile_frags counter */
+            f->flags & FRAG_TEMP_PRIVATE, &flags, NULL, true /*check vm area*/, mangle,
             NULL _IF_CLIENT(call_client) _IF_CLIENT(false /*not for_trace*/));
         ASSERT(ilist != NULL);
         if (ilist == NULL) /* a race */
@@ -5492,6 +5522,12 @@ recreate_fragment_ilist(dcontext_t *dcontext, byte *pc,
                 }
             } /* else we mangled one bb at a time up above */
 
+#if defined(X86) && defined(CLIENT_INTERFACE)
+            /* Must match end_and_emit_trace(). */
+            if (DYNAMO_OPTION(opt_trace_spills))
+                optimize_trace_spills(dcontext, f->tag, ilist, true /*recreating*/);
+#endif
+
 #ifdef INTERNAL
             /* we only optimize traces */
             if (dynamo_options.optimize) {
@@ -5512,6 +5548,16 @@ recreate_fragment_ilist(dcontext_t *dcontext, byte *pc,
             }
 #endif
 
+#if defined(X86) && defined(CLIENT_INTERFACE)
+            /* Must match end_and_emit_trace(). */
+            if (fragprof_should_count(f->flags)) {
+                ptr_uint_t *counter =
+                    fragprof_counter(dcontext, f->tag, true /*trace*/, false /*!create*/);
+                if (counter != NULL)
+                    insert_frag_profile_counter(dcontext, ilist, f->tag, counter);
+            }
+#endif
+
             /* FIXME: case 4718 append_trace_speculate_last_ibl(true)
              * should be called as well
              */
@@ -2267,6 +2267,50 @@ mangle_single_step(dcontext_t *dcontext, instrlist_t *ilist, uint flags, instr_t
     }
 }
 
+/***************************************************************************
+ * FRAGMENT ENTRY COUNTERS
+ */
+
+/* Inserts an increment of *counter at the top of ilist for -profile_frags.  We use
+ * only a load, a lea, and a store so the arithmetic flags are untouched.  The
+ * sequence is our mangling translating to the first app instr, so an interruption
+ * inside it restores xax from its TLS slot and re-executes the increment.
+ * XXX: Keep this consistent with instr_is_frag_profile_counter() in translate.c.
+ */
+void
+insert_frag_profile_counter(dcontext_t *dcontext, instrlist_t *ilist, app_pc tag,
+                            ptr_uint_t *counter)
+{
+    instr_t *where = instrlist_first(ilist);
+    instr_t *seq[5];
+    app_pc xl8 = tag;
+    instr_t *instr;
+    uint i;
+    /* Skip client instrumentation, if any, as insert_selfmod_sandbox() does. */
+    for (instr = where; instr != NULL; instr = instr_get_next(instr)) {
+        if (!instr_is_meta(instr) && instr_get_translation(instr) != NULL) {
+            xl8 = instr_get_translation(instr);
+            break;
+        }
+    }
+    seq[0] = instr_create_save_to_tls(dcontext, REG_XAX, TLS_XAX_SLOT);
+    seq[1] = INSTR_CREATE_mov_ld(dcontext, opnd_create_reg(REG_XAX),
+                                 opnd_create_abs_addr(counter, OPSZ_PTR));
+    seq[2] = INSTR_CREATE_lea(dcontext, opnd_create_reg(REG_XAX),
+                              opnd_create_base_disp(REG_XAX, REG_NULL, 0, 1, OPSZ_lea));
+    seq[3] = INSTR_CREATE_mov_st(dcontext, opnd_create_abs_addr(counter, OPSZ_PTR),
+                                 opnd_create_reg(REG_XAX));
+    seq[4] = instr_create_restore_from_tls(dcontext, REG_XAX, TLS_XAX_SLOT);
+    for (i = 0; i < BUFFER_SIZE_ELEMENTS(seq); i++) {
+        instr_set_translation(seq[i], xl8);
+        instr_set_our_mangling(seq[i], true);
+        if (where == NULL)
+            instrlist_meta_append(ilist, seq[i]);
+        else
+            PRE(ilist, where, seq[i]);
+    }
+}
+
 /***************************************************************************
  * FLOATING POINT PC
  */
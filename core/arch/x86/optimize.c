@@ -40,22 +40,20 @@
  * (old offline optimization stuff is in mangle.c)
  */
 
-#include "../globals.h" /* just to disable warning C4206 about an empty file */
-
-#ifdef INTERNAL /* around whole file */
-
-#    include "../globals.h"
-#    include "arch.h"
-#    include "instr.h"
-#    include "instr_create.h"
-#    include "instrlist.h"
-#    include "decode.h"
-#    include "decode_fast.h"
+#include "../globals.h"
+#include "arch.h"
+#include "instr.h"
+#include "instr_create.h"
+#include "instrlist.h"
+#include "decode.h"
+#include "decode_fast.h"
 /* XXX i#1551: eliminate PREFIX_{DATA,ADDR} refs and then remove this include */
-#    include "x86/decode_private.h"
-#    include "../fragment.h"
-#    include "disassemble.h"
-#    include "proc.h"
+#include "x86/decode_private.h"
+#include "../fragment.h"
+#include "disassemble.h"
+#include "proc.h"
+
+#ifdef INTERNAL /* around the old optimizations */
 
 /* IMPORTANT INSTRUCTIONS FOR WRITING OPTIMIZATIONS:
  *
@@ -4655,4 +4653,364 @@ is_nop(instr_t *inst)
     return false;
 }
 
-#endif /* INTERNAL around whole file */
+#endif /* INTERNAL around the old optimizations */
+
+#ifdef CLIENT_INTERFACE
+/****************************************************************************/
+/* -opt_trace_spills: unlike the optimizations above, this one is meant for release
+ * builds.  Clients like drreg restore their scratch registers and the arithmetic
+ * flags at the end of each block and save them again at the start of the next, so a
+ * trace stitched from instrumented blocks has a restore/save pair at every seam that
+ * control cannot leave through.  We remove such a pair when the app value it
+ * reloads is dead until the next save would have been overwritten anyway.
+ *
+ * Like the rest of the trace this must be deterministic: recreate_fragment_ilist()
+ * re-runs it for state translation.  Removing a whole pair keeps the earlier save in
+ * effect, so walkers like drreg's restore-state handler, which decode the cache
+ * code and track the client's spill slots, see the value as still saved at every
+ * point in between and restore it from the slot, which still holds it.
+ */
+
+/* Bounds the search from a restore to the save that matches it. */
+#    define SEAM_SCAN_MAX 32
+
+/* Returns whether instr was inserted by a client rather than by the app or by our
+ * own mangling.
+ */
+static bool
+is_client_meta(instr_t *instr)
+{
+    return instr_is_meta(instr) && !instr_is_label(instr) &&
+        !instr_is_our_mangling(instr);
+}
+
+/* Returns whether instr is a client's move of a whole gpr to or from a TLS slot:
+ * that is how drreg and dr_save_reg() spill and restore.
+ */
+static bool
+is_client_tls_spill_or_restore(dcontext_t *dcontext, instr_t *instr, bool *spill,
+                               reg_id_t *reg, uint *offs)
+{
+    bool tls;
+    if (!is_client_meta(instr) ||
+        !instr_is_reg_spill_or_restore(dcontext, instr, &tls, spill, reg, offs) ||
+        !tls)
+        return false;
+    /* Rule out the xchg form, which both restores and spills. */
+    return instr_get_opcode(instr) == (*spill ? OP_mov_st : OP_mov_ld) &&
+        reg_is_pointer_sized(*reg);
+}
+
+static bool
+opnd_overlaps_tls_slot(opnd_t opnd, uint offs)
+{
+    int disp, size;
+    if (!opnd_is_far_base_disp(opnd) || opnd_get_segment(opnd) != SEG_TLS)
+        return false;
+    if (!opnd_is_abs_base_disp(opnd))
+        return true;
+    disp = opnd_get_disp(opnd);
+    size = opnd_size_in_bytes(opnd_get_size(opnd));
+    return size == 0 || (disp < (int)(offs + sizeof(reg_t)) && disp + size > (int)offs);
+}
+
+static bool
+instr_touches_tls_slot(instr_t *instr, uint offs)
+{
+    int i;
+    for (i = 0; i < instr_num_srcs(instr); i++) {
+        if (opnd_overlaps_tls_slot(instr_get_src(instr, i), offs))
+            return true;
+    }
+    for (i = 0; i < instr_num_dsts(instr); i++) {
+        if (opnd_overlaps_tls_slot(instr_get_dst(instr, i), offs))
+            return true;
+    }
+    return false;
+}
+
+/* Returns whether the full app state must be in place at instr because control can
+ * leave the trace there or DR can intercept it.
+ */
+static bool
+is_seam_barrier(instr_t *instr)
+{
+    return instr_is_cti(instr) || instr_is_syscall(instr) || instr_is_interrupt(instr);
+}
+
+static bool
+instr_writes_whole_reg(instr_t *instr, reg_id_t reg)
+{
+    return instr_writes_to_exact_reg(instr, reg, DR_QUERY_DEFAULT)
+        /* A 32-bit write zero-extends. */
+        IF_X64(|| instr_writes_to_exact_reg(instr, reg_64_to_32(reg), DR_QUERY_DEFAULT));
+}
+
+/* Returns whether the most recent write to the slot before where spilled reg there,
+ * so that a walker tracking the slot considers reg spilled at where.
+ */
+static bool
+slot_holds_spill(dcontext_t *dcontext, instr_t *where, reg_id_t reg, uint offs)
+{
+    instr_t *in;
+    bool spill;
+    reg_id_t spill_reg;
+    uint spill_offs;
+    for (in = instr_get_prev(where); in != NULL; in = instr_get_prev(in)) {
+        if (instr_is_label(in))
+            continue;
+        if (is_client_tls_spill_or_restore(dcontext, in, &spill, &spill_reg,
+                                           &spill_offs) &&
+            spill_offs == offs && !spill)
+            continue; /* a restore leaves the slot alone */
+        if (instr_touches_tls_slot(in, offs)) {
+            return is_client_tls_spill_or_restore(dcontext, in, &spill, &spill_reg,
+                                                  &spill_offs) &&
+                spill && spill_reg == reg && spill_offs == offs;
+        }
+    }
+    return false;
+}
+
+/* Returns whether reg is written before it is read once past after. */
+static bool
+reg_dead_after(instr_t *after, reg_id_t reg)
+{
+    instr_t *in;
+    for (in = instr_get_next(after); in != NULL; in = instr_get_next(in)) {
+        if (instr_is_label(in))
+            continue;
+        if (is_seam_barrier(in) || instr_reads_from_reg(in, reg, DR_QUERY_INCLUDE_ALL))
+            return false;
+        if (instr_writes_whole_reg(in, reg))
+            return true;
+    }
+    return false;
+}
+
+/* Returns whether the arithmetic flags in live (EFLAGS_READ_* bits) are written
+ * before they are read once past after.
+ */
+static bool
+aflags_dead_after(instr_t *after, uint live)
+{
+    instr_t *in;
+    for (in = instr_get_next(after); in != NULL; in = instr_get_next(in)) {
+        if (instr_is_label(in))
+            continue;
+        if (is_seam_barrier(in) ||
+            TESTANY(live, instr_get_eflags(in, DR_QUERY_INCLUDE_ALL)))
+            return false;
+        live &= ~EFLAGS_WRITE_TO_READ(instr_get_eflags(in, DR_QUERY_DEFAULT) &
+                                      EFLAGS_WRITE_ARITH);
+        if (live == 0)
+            return true;
+    }
+    return false;
+}
+
+static instr_t *
+next_non_label(instr_t *instr)
+{
+    do {
+        instr = instr_get_next(instr);
+    } while (instr != NULL && instr_is_label(instr));
+    return instr;
+}
+
+static instr_t *
+prev_non_label(instr_t *instr)
+{
+    do {
+        instr = instr_get_prev(instr);
+    } while (instr != NULL && instr_is_label(instr));
+    return instr;
+}
+
+static void
+remove_seam_instr(dcontext_t *dcontext, instrlist_t *trace, instr_t *instr)
+{
+    d_r_loginst(dcontext, 3, instr, "removing seam instr");
+    instrlist_remove(trace, instr);
+    instr_destroy(dcontext, instr);
+}
+
+/* Looks for "restore reg from slot" at restore followed by "spill reg to slot"
+ * with nothing in between that uses either one, and removes both when the spill
+ * leaves reg dead.  Returns the number of instrs removed.
+ */
+static uint
+remove_spill_pair(dcontext_t *dcontext, instrlist_t *trace, instr_t *restore)
+{
+    instr_t *in, *spill_instr = NULL;
+    bool spill;
+    reg_id_t reg, in_reg;
+    uint offs, in_offs, count;
+    if (!is_client_tls_spill_or_restore(dcontext, restore, &spill, &reg, &offs) ||
+        spill)
+        return 0;
+    for (in = next_non_label(restore), count = 0; in != NULL && count < SEAM_SCAN_MAX;
+         in = next_non_label(in), count++) {
+        if (is_client_tls_spill_or_restore(dcontext, in, &spill, &in_reg, &in_offs) &&
+            spill && in_reg == reg && in_offs == offs) {
+            spill_instr = in;
+            break;
+        }
+        if (is_seam_barrier(in) || instr_uses_reg(in, reg) ||
+            instr_touches_tls_slot(in, offs))
+            return 0;
+    }
+    if (spill_instr == NULL || !slot_holds_spill(dcontext, restore, reg, offs) ||
+        !reg_dead_after(spill_instr, reg))
+        return 0;
+    remove_seam_instr(dcontext, trace, restore);
+    remove_seam_instr(dcontext, trace, spill_instr);
+    return 2;
+}
+
+/* Looks for a client's "[cmp al,-127 | add al,0x7f] sahf" flags restore followed by
+ * its "lahf [seto al]" save, optionally with xax restored from and spilled back to
+ * one slot in between, and removes the lot when the restored flags are dead after
+ * the save.  lahf and seto rebuild the same ah and al that sahf and the OF restore
+ * consumed, as long as those came from an earlier lahf and seto, so xax ends up the
+ * same.  Returns the number of instrs removed.
+ */
+static uint
+remove_aflags_pair(dcontext_t *dcontext, instrlist_t *trace, instr_t *sahf)
+{
+    instr_t *in, *of_restore, *xax_restore = NULL, *xax_spill = NULL, *lahf = NULL;
+    instr_t *seto;
+    bool spill, is_add = false;
+    reg_id_t reg;
+    uint offs, xax_offs = 0, count, live = EFLAGS_READ_ARITH;
+    if (!is_client_meta(sahf) || instr_get_opcode(sahf) != OP_sahf)
+        return 0;
+    of_restore = prev_non_label(sahf);
+    if (of_restore != NULL && is_client_meta(of_restore)) {
+        opnd_t al = opnd_create_null(), imm = opnd_create_null();
+        if (instr_get_opcode(of_restore) == OP_cmp) {
+            al = instr_get_src(of_restore, 0);
+            imm = instr_get_src(of_restore, 1);
+        } else if (instr_get_opcode(of_restore) == OP_add) {
+            al = instr_get_dst(of_restore, 0);
+            imm = instr_get_src(of_restore, 0);
+            is_add = true;
+        }
+        if (!opnd_same(al, opnd_create_reg(DR_REG_AL)) || !opnd_is_immed_int(imm) ||
+            opnd_get_immed_int(imm) != (is_add ? 0x7f : -127))
+            of_restore = NULL;
+    } else
+        of_restore = NULL;
+    if (of_restore == NULL) {
+        is_add = false;
+        live &= ~EFLAGS_READ_OF;
+    }
+    /* The flags must be in ah and al as lahf and seto left them. */
+    for (in = prev_non_label(of_restore != NULL ? of_restore : sahf); in != NULL;
+         in = prev_non_label(in)) {
+        if (instr_writes_to_reg(in, DR_REG_XAX, DR_QUERY_INCLUDE_ALL))
+            break;
+    }
+    if (in != NULL && is_client_meta(in) && instr_get_opcode(in) == OP_seto)
+        in = prev_non_label(in);
+    if (in == NULL || !is_client_meta(in) || instr_get_opcode(in) != OP_lahf)
+        return 0;
+    for (in = next_non_label(sahf), count = 0; in != NULL && count < SEAM_SCAN_MAX;
+         in = next_non_label(in), count++) {
+        if (is_client_meta(in) && instr_get_opcode(in) == OP_lahf) {
+            lahf = in;
+            break;
+        }
+        if (is_client_tls_spill_or_restore(dcontext, in, &spill, &reg, &offs) &&
+            reg == DR_REG_XAX) {
+            if (!spill && xax_restore == NULL) {
+                xax_restore = in;
+                xax_offs = offs;
+                continue;
+            }
+            if (spill && xax_restore != NULL && xax_spill == NULL && offs == xax_offs) {
+                xax_spill = in;
+                continue;
+            }
+            return 0;
+        }
+        if (is_seam_barrier(in) || instr_uses_reg(in, DR_REG_XAX) ||
+            TESTANY(EFLAGS_READ_ARITH | EFLAGS_WRITE_ARITH,
+                    instr_get_eflags(in, DR_QUERY_INCLUDE_ALL)) ||
+            (xax_restore != NULL && instr_touches_tls_slot(in, xax_offs)))
+            return 0;
+    }
+    if (lahf == NULL || (xax_restore != NULL && xax_spill == NULL))
+        return 0;
+    seto = next_non_label(lahf);
+    if (seto != NULL &&
+        (!is_client_meta(seto) || instr_get_opcode(seto) != OP_seto ||
+         !opnd_is_reg(instr_get_dst(seto, 0)) ||
+         opnd_get_reg(instr_get_dst(seto, 0)) != DR_REG_AL))
+        seto = NULL;
+    /* seto must recreate what the OF restore consumed; without seto only cmp
+     * leaves al alone.
+     */
+    if (seto != NULL ? of_restore == NULL : is_add)
+        return 0;
+    if (xax_restore != NULL &&
+        !slot_holds_spill(dcontext, xax_restore, DR_REG_XAX, xax_offs))
+        return 0;
+    if (!aflags_dead_after(seto != NULL ? seto : lahf, live))
+        return 0;
+    count = 2;
+    if (of_restore != NULL) {
+        remove_seam_instr(dcontext, trace, of_restore);
+        count++;
+    }
+    remove_seam_instr(dcontext, trace, sahf);
+    if (xax_restore != NULL) {
+        remove_seam_instr(dcontext, trace, xax_restore);
+        remove_seam_instr(dcontext, trace, xax_spill);
+        count += 2;
+    }
+    remove_seam_instr(dcontext, trace, lahf);
+    if (seto != NULL) {
+        remove_seam_instr(dcontext, trace, seto);
+        count++;
+    }
+    return count;
+}
+
+/* Removes the redundant client restore/save pairs in trace and returns the number
+ * of instrs removed.  Pass recreating=true from recreate_fragment_ilist().
+ */
+uint
+optimize_trace_spills(dcontext_t *dcontext, app_pc tag, instrlist_t *trace,
+                      bool recreating)
+{
+    instr_t *in, *next, *prev;
+    uint removed, total = 0;
+    LOG(THREAD, LOG_OPTS, 3, "optimize_trace_spills " PFX "\n", tag);
+    for (in = instrlist_first(trace); in != NULL; in = next) {
+        /* The only instr before in that a removal can take out is the OF restore
+         * just before a sahf.
+         */
+        prev = prev_non_label(in);
+        if (prev != NULL)
+            prev = instr_get_prev(prev);
+        removed = remove_aflags_pair(dcontext, trace, in);
+        if (removed > 0) {
+            if (!recreating)
+                STATS_INC(num_trace_aflags_pairs_removed);
+        } else {
+            removed = remove_spill_pair(dcontext, trace, in);
+            if (removed > 0 && !recreating)
+                STATS_INC(num_trace_spill_pairs_removed);
+        }
+        if (removed == 0) {
+            next = instr_get_next(in);
+            continue;
+        }
+        total += removed;
+        /* Rescan from just before the pair: removing it can expose another. */
+        next = (prev == NULL) ? instrlist_first(trace) : instr_get_next(prev);
+    }
+    return total;
+}
+#endif /* CLIENT_INTERFACE */
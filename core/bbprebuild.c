@@ -0,0 +1,268 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/*
+ * bbprebuild.c - background building of predicted successor blocks for
+ * -bb_prebuild_threads
+ *
+ * When an app thread builds a shared bb, we queue the targets of its direct exits
+ * that are not yet linked, plus its post-call fall-through.  Worker threads,
+ * which are DR-created client threads, build them into the shared bb table just
+ * as d_r_dispatch() would, so the app finds them there and the new bb's exits
+ * get linked to them.  Only the app's own blocks are followed: what a worker
+ * builds queues nothing further.
+ *
+ * A worker is an ordinary thread from the point of view of flushing: it enters
+ * the could-be-linking state around each build.  While idle it is marked as
+ * being at a syscall, so a flush does its shared deletion work on its behalf and
+ * a synch can suspend it.
+ */
+
+#include "globals.h"
+#include "link.h"
+#include "fragment.h"
+#include "vmareas.h"
+#include "dispatch.h"
+#include "module_shared.h"
+#include "native_exec.h"
+#include "instr.h"
+#include "decode.h"
+#include "instrument.h"
+#include "bbprebuild.h"
+
+#ifdef CLIENT_SIDELINE
+
+/* Requests beyond this many are dropped: the app will build those itself. */
+#    define BBPREBUILD_QUEUE_SIZE 256
+#    define MAX_BBPREBUILD_THREADS 64
+
+typedef struct _bbprebuild_info_t {
+    /* Guards the queue. */
+    mutex_t lock;
+    app_pc queue[BBPREBUILD_QUEUE_SIZE];
+    uint head; /* index of the oldest request */
+    uint count;
+    /* Signaled when requests are added. */
+    event_t work;
+} bbprebuild_info_t;
+
+static bbprebuild_info_t *bbprebuild;
+
+static void
+bbprebuild_thread(void *arg);
+
+static void
+bbprebuild_create_threads(void)
+{
+    uint i;
+    uint num = MIN(DYNAMO_OPTION(bb_prebuild_threads), MAX_BBPREBUILD_THREADS);
+    for (i = 0; i < num; i++) {
+        if (!dr_create_client_thread(bbprebuild_thread, NULL)) {
+            SYSLOG_INTERNAL_WARNING("failed to create bb prebuild thread");
+            break;
+        }
+    }
+}
+
+void
+bbprebuild_init(void)
+{
+    if (DYNAMO_OPTION(bb_prebuild_threads) == 0 || RUNNING_WITHOUT_CODE_CACHE())
+        return;
+    bbprebuild =
+        HEAP_TYPE_ALLOC(GLOBAL_DCONTEXT, bbprebuild_info_t, ACCT_OTHER, UNPROTECTED);
+    memset(bbprebuild, 0, sizeof(*bbprebuild));
+    ASSIGN_INIT_LOCK_FREE(bbprebuild->lock, bbprebuild_lock);
+    bbprebuild->work = create_event();
+    bbprebuild_create_threads();
+}
+
+void
+bbprebuild_exit(void)
+{
+    if (bbprebuild == NULL)
+        return;
+    /* The workers were terminated along with the other client threads. */
+    destroy_event(bbprebuild->work);
+    DELETE_LOCK(bbprebuild->lock);
+    HEAP_TYPE_FREE(GLOBAL_DCONTEXT, bbprebuild, bbprebuild_info_t, ACCT_OTHER,
+                   UNPROTECTED);
+    bbprebuild = NULL;
+}
+
+void
+bbprebuild_fork_init(dcontext_t *dcontext)
+{
+    if (bbprebuild == NULL)
+        return;
+    /* The parent's requests are still valid in the child, but there is no one left
+     * to build them.
+     */
+    bbprebuild_create_threads();
+}
+
+/* Returns whether a request was added. */
+static bool
+bbprebuild_enqueue(app_pc tag)
+{
+    ASSERT_OWN_MUTEX(true, &bbprebuild->lock);
+    if (bbprebuild->count == BBPREBUILD_QUEUE_SIZE) {
+        STATS_INC(num_bb_prebuild_dropped);
+        return false;
+    }
+    bbprebuild->queue[(bbprebuild->head + bbprebuild->count) % BBPREBUILD_QUEUE_SIZE] =
+        tag;
+    bbprebuild->count++;
+    RSTATS_INC(num_bb_prebuild_requests);
+    return true;
+}
+
+static app_pc
+bbprebuild_dequeue(void)
+{
+    app_pc tag = NULL;
+    d_r_mutex_lock(&bbprebuild->lock);
+    if (bbprebuild->count > 0) {
+        tag = bbprebuild->queue[bbprebuild->head];
+        bbprebuild->head = (bbprebuild->head + 1) % BBPREBUILD_QUEUE_SIZE;
+        bbprebuild->count--;
+    }
+    d_r_mutex_unlock(&bbprebuild->lock);
+    return tag;
+}
+
+void
+bbprebuild_successors(dcontext_t *dcontext, fragment_t *f, app_pc fall_through)
+{
+    linkstub_t *l;
+    bool added = false;
+    if (bbprebuild == NULL || IS_CLIENT_THREAD(dcontext) ||
+        !TEST(FRAG_SHARED, f->flags) ||
+        TESTANY(FRAG_COARSE_GRAIN | FRAG_TEMP_PRIVATE, f->flags))
+        return;
+    /* Whether we go native depends on how a bb is reached, which we cannot know
+     * ahead of time.
+     */
+    if (DYNAMO_OPTION(native_exec) && !vmvector_empty(native_exec_areas))
+        return;
+    /* Client threads get no thread init event, so a bb event that uses per-thread
+     * state must run on the app thread.
+     */
+    if (dr_bb_hook_exists() && !DYNAMO_OPTION(bb_prebuild_client_safe)) {
+        STATS_INC(num_bb_prebuild_client_unsafe);
+        return;
+    }
+    d_r_mutex_lock(&bbprebuild->lock);
+    for (l = FRAGMENT_EXIT_STUBS(f); l != NULL; l = LINKSTUB_NEXT_EXIT(l)) {
+        if (LINKSTUB_DIRECT(l->flags) && !LINKSTUB_FAKE(l) &&
+            !TESTANY(LINK_LINKED | LINK_SPECIAL_EXIT, l->flags))
+            added = bbprebuild_enqueue(EXIT_TARGET_TAG(dcontext, f, l)) || added;
+        if (EXIT_IS_CALL(l->flags) && fall_through != NULL)
+            added = bbprebuild_enqueue(fall_through) || added;
+    }
+    d_r_mutex_unlock(&bbprebuild->lock);
+    if (added)
+        signal_event(bbprebuild->work);
+}
+
+/* Returns whether building a bb at tag can do nothing an app thread would not
+ * also do on reaching it.  Must be called while could-be-linking, so that the
+ * code cannot be flushed before we build it.
+ */
+static bool
+bbprebuild_target_ok(dcontext_t *dcontext, app_pc tag)
+{
+    byte copy[MAX_INSTR_LENGTH];
+    instr_t instr;
+    bool valid;
+    if (is_dynamo_address(tag) || is_stopping_point(dcontext, tag) ||
+        tag == get_image_entry())
+        return false;
+    /* Code that has already run has had its module load event delivered and passed
+     * our security checks.
+     */
+    if (!executable_vm_area_executed_from(tag, tag + 1))
+        return false;
+    /* A bb starting with an invalid instr raises a fault on the building thread. */
+    if (!d_r_safe_read(tag, sizeof(copy), copy))
+        return false;
+    instr_init(dcontext, &instr);
+    valid = decode_from_copy(dcontext, copy, tag, &instr) != NULL;
+    instr_free(dcontext, &instr);
+    return valid;
+}
+
+static void
+bbprebuild_build(dcontext_t *dcontext, app_pc tag)
+{
+    fragment_t coarse_f;
+    fragment_t *f = NULL;
+    enter_couldbelinking(dcontext, NULL, false);
+    SHARED_BB_LOCK();
+    if (fragment_lookup_fine_and_coarse(dcontext, tag, &coarse_f, NULL) == NULL &&
+        bbprebuild_target_ok(dcontext, tag)) {
+        SELF_PROTECT_LOCAL(dcontext, WRITABLE);
+        f = build_basic_block_fragment(dcontext, tag, 0, true /*link*/,
+                                       true /*visible*/
+                                       _IF_CLIENT(false /*!for_trace*/) _IF_CLIENT(NULL));
+        SELF_PROTECT_LOCAL(dcontext, READONLY);
+    }
+    SHARED_BB_UNLOCK();
+    enter_nolinking(dcontext, NULL, false);
+    if (f != NULL) {
+        LOG(THREAD, LOG_INTERP, 2, "prebuilt bb " PFX "\n", tag);
+        RSTATS_INC(num_bb_prebuilt);
+    } else
+        STATS_INC(num_bb_prebuild_skipped);
+}
+
+static void
+bbprebuild_thread(void *arg)
+{
+    dcontext_t *dcontext = get_thread_private_dcontext();
+    app_pc tag;
+    /* We never come from the cache, so there is no real last exit. */
+    dcontext->last_exit = (linkstub_t *)get_starting_linkstub();
+    LOG(THREAD, LOG_INTERP, 1, "bb prebuild thread " TIDFMT " started\n",
+        d_r_get_thread_id());
+    while (true) {
+        set_at_syscall(dcontext, true);
+        dcontext->client_data->client_thread_safe_for_synch = true;
+        wait_for_event(bbprebuild->work, 0);
+        dcontext->client_data->client_thread_safe_for_synch = false;
+        set_at_syscall(dcontext, false);
+        while ((tag = bbprebuild_dequeue()) != NULL)
+            bbprebuild_build(dcontext, tag);
+    }
+}
+
+#endif /* CLIENT_SIDELINE */
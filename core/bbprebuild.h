@@ -0,0 +1,63 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/*
+ * bbprebuild.h - background building of predicted successor blocks for
+ * -bb_prebuild_threads
+ */
+
+#ifndef _BBPREBUILD_H_
+#define _BBPREBUILD_H_ 1
+
+#ifdef CLIENT_SIDELINE
+
+/* Must be called after instrument_init(), as it creates client threads. */
+void
+bbprebuild_init(void);
+
+void
+bbprebuild_exit(void);
+
+/* Re-creates the worker threads, which do not survive a fork. */
+void
+bbprebuild_fork_init(dcontext_t *dcontext);
+
+/* Queues the direct targets of the new bb f, plus fall_through if f ends in a
+ * call, to be built by the worker threads.  Called while holding the
+ * bb_building_lock.
+ */
+void
+bbprebuild_successors(dcontext_t *dcontext, fragment_t *f, app_pc fall_through);
+
+#endif /* CLIENT_SIDELINE */
+
+#endif /* _BBPREBUILD_H_ */
@@ -390,6 +390,11 @@ dispatch_enter_fcache(dcontext_t *dcontext, fragment_t *targetf)
 
     dispatch_enter_fcache_stats(dcontext, targetf);
 
+    if (DYNAMO_OPTION(cache_shared_clock_sample) > 0 &&
+        (DYNAMO_OPTION(finite_shared_bb_cache) ||
+         DYNAMO_OPTION(finite_shared_trace_cache)))
+        fcache_sample_entry(dcontext, targetf);
+
     /* FIXME: for now we do this before the synch point to avoid complexity of
      * missing a KSTART(fcache_* for cases like NtSetContextThread where a thread
      * appears back at d_r_dispatch() from the synch point w/o ever entering the cache.
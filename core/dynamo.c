@@ -64,6 +64,8 @@
 #include "synch.h"
 #include "native_exec.h"
 #include "jit_opt.h"
+#include "fragprof.h"
+#include "bbprebuild.h"
 
 #ifdef ANNOTATIONS
 #    include "annotations.h"
@@ -660,6 +662,7 @@ dynamorio_app_init(void)
         annotation_init();
 #endif
         jitopt_init();
+        fragprof_init();
 
         dr_attach_finished = create_broadcast_event();
 
@@ -678,6 +681,10 @@ dynamorio_app_init(void)
          *       DllMain.
          */
         instrument_init();
+#    ifdef CLIENT_SIDELINE
+        /* Creates client threads, so must follow instrument_init(). */
+        bbprebuild_init();
+#    endif
         /* To give clients a chance to process pcaches as we load them, we
          * delay the loading until we've initialized the clients.
          */
@@ -846,6 +853,9 @@ dynamorio_fork_init(dcontext_t *dcontext)
     fragment_fork_init(dcontext);
     /* this must be called after dynamo_other_thread_exit() above */
     signal_fork_init(dcontext);
+#    ifdef CLIENT_SIDELINE
+    bbprebuild_fork_init(dcontext);
+#    endif
 
 #    ifdef CLIENT_INTERFACE
     if (CLIENTS_EXIST()) {
@@ -987,6 +997,10 @@ void
 dynamo_process_exit_with_thread_info(void)
 {
     perscache_fast_exit(); /* "fast" b/c called in release as well */
+    /* Written now rather than in fragprof_exit() as the release exit path skips
+     * the full cleanup.
+     */
+    fragprof_dump();
 }
 
 /* shared between app_exit and detach */
@@ -1036,6 +1050,10 @@ dynamo_shared_exit(thread_record_t *toexit /* must ==cur thread for Linux */
     annotation_exit();
 #endif
     jitopt_exit();
+    fragprof_exit();
+#ifdef CLIENT_SIDELINE
+    bbprebuild_exit();
+#endif
 #ifdef CLIENT_INTERFACE
     /* We tell the client as soon as possible in case it wants to use services from other
      * components.  Must be after fragment_exit() so that the client gets all the
@@ -1908,6 +1926,7 @@ create_callback_dcontext(dcontext_t *old_dcontext)
     new_dcontext->private_code = old_dcontext->private_code;
 #    ifdef CLIENT_INTERFACE
     new_dcontext->client_data = old_dcontext->client_data;
+    new_dcontext->ir_arena = old_dcontext->ir_arena;
 #    endif
 #    ifdef DEBUG
     new_dcontext->logfile = old_dcontext->logfile;
@@ -2632,6 +2651,12 @@ dynamo_thread_exit_common(dcontext_t *dcontext, thread_id_t id,
     kstat_thread_exit(dcontext);
 #endif
     DOSTATS({ stats_thread_exit(dcontext); });
+#ifdef CLIENT_INTERFACE
+    /* After everything that can free an instr, such as monitor_thread_exit()
+     * destroying a trace still being built.
+     */
+    instr_arena_thread_exit(dcontext);
+#endif
     heap_thread_exit(dcontext);
 #ifdef DEADLOCK_AVOIDANCE
     locks_thread_exit(dcontext);
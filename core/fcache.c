@@ -321,11 +321,21 @@ static const uint FREE_LIST_SIZES[] = {
      * the final sizes.
      * FIXME: these #s are for inlined stubs, should re-tune w/ separate stubs
      * (case 7163)
+     *
+     * The classes above 172 keep large entries (mostly traces and heavily
+     * instrumented bbs) segregated so a small request does not carve up the one
+     * big slot that a later large request needs, which used to force a new unit.
      */
-    0, 44, 52, 56, 64, 72, 80, 112, 172
+    0, 44, 52, 56, 64, 72, 80, 112, 172, 256, 384, 512, 1024, 2048
 };
 #define FREE_LIST_SIZES_NUM (BUFFER_SIZE_ELEMENTS(FREE_LIST_SIZES))
 
+/* Once a fitting free entry is found in the first candidate bucket we look at
+ * this many more fitting entries and take the tightest one, to reduce the
+ * small unusable remainders that first-fit splitting leaves behind.
+ */
+#define FREE_LIST_BEST_FIT_CANDIDATES 8
+
 /* To support physical cache contiguity walking we store both a
  * next-free and prev-free pointer and a size at the top of the empty slot, and
  * don't waste memory with an empty_slot_t data structure.
@@ -423,10 +433,14 @@ typedef struct _fcache_unit_t {
     bool was_shared;
     profile_t *profile;
 #endif
-    bool pending_free; /* was entire unit flushed and slated for free? */
-#ifdef DEBUG
+    bool pending_free;  /* was entire unit flushed and slated for free? */
     bool pending_flush; /* indicates in-limbo unit pre-flush is still live */
-#endif
+    uint free_list_bytes; /* bytes of this unit currently on the cache's free lists */
+    /* CLOCK reference bit for finite shared caches: set when a sampled cache
+     * entry targets a fragment in this unit, cleared as the eviction hand passes.
+     * Racy writes are fine as it is only a hint.
+     */
+    bool referenced;
     uint flushtime;                     /* free this unit when this flushtime is freed --
                                          * used only for units_to_free list, else 0 */
     struct _fcache_unit_t *next_global; /* used to link all units */
@@ -509,6 +523,7 @@ typedef struct _fcache {
     bool record_wset;
 
     free_list_header_t *free_list[FREE_LIST_SIZES_NUM];
+    size_t free_list_bytes; /* sum of all free list entry sizes */
 #ifdef DEBUG
     uint free_stats_freed[FREE_LIST_SIZES_NUM];     /* occurrences */
     uint free_stats_reused[FREE_LIST_SIZES_NUM];    /* occurrences */
@@ -532,6 +547,8 @@ typedef struct _fcache_thread_units_t {
     size_t pending_unmap_size;
     /* are there units waiting to be flushed at a safe spot? */
     bool pending_flush;
+    /* cache entries left until the next -cache_shared_clock_sample sample */
+    uint clock_sample_countdown;
 } fcache_thread_units_t;
 
 #define ALLOC_DC(dc, cache) ((cache)->is_shared ? GLOBAL_DCONTEXT : (dc))
@@ -642,6 +659,24 @@ DECLARE_FREQPROT_VAR(uint reset_every_nth_unit[CACHE_NUM_TYPES],
 #define STATS_FCACHE_SUB(cache, stat, val) \
     STATS_FCACHE_ADD(cache, stat, -(stats_int_t)(val))
 
+/* Free lists are only used by shared caches, and we want the fragmentation
+ * numbers in release builds as well.
+ */
+#define STATS_FREE_LIST_ADD(cache, val)                         \
+    do {                                                        \
+        if ((cache)->is_trace)                                  \
+            RSTATS_ADD_PEAK(fcache_shared_trace_free_list, val); \
+        else                                                    \
+            RSTATS_ADD_PEAK(fcache_shared_bb_free_list, val);    \
+    } while (0)
+#define STATS_FREE_LIST_SUB(cache, val)                      \
+    do {                                                     \
+        if ((cache)->is_trace)                               \
+            RSTATS_SUB(fcache_shared_trace_free_list, val); \
+        else                                                 \
+            RSTATS_SUB(fcache_shared_bb_free_list, val);    \
+    } while (0)
+
 #define STATS_FCACHE_MAX(cache, stat1, stat2)                                        \
     DOSTATS({                                                                        \
         if (cache->is_shared) {                                                      \
@@ -1418,7 +1453,10 @@ fcache_create_unit(dcontext_t *dcontext, fcache_t *cache, cache_pc pc, size_t si
 #endif
     u->writable = true;
     u->pending_free = false;
-    DODEBUG({ u->pending_flush = false; });
+    u->pending_flush = false;
+    u->free_list_bytes = 0;
+    /* a new unit has not had a chance to be sampled yet */
+    u->referenced = true;
     u->flushtime = 0;
 
     RSTATS_ADD_PEAK(fcache_num_live, 1);
@@ -1600,6 +1638,7 @@ fcache_cache_init(dcontext_t *dcontext, uint flags, bool initial_unit)
     cache->record_wset = false;
     if (cache->is_shared) { /* else won't use free list */
         memset(cache->free_list, 0, sizeof(cache->free_list));
+        cache->free_list_bytes = 0;
         DODEBUG({
             memset(cache->free_stats_freed, 0, sizeof(cache->free_stats_freed));
             memset(cache->free_stats_reused, 0, sizeof(cache->free_stats_reused));
@@ -1642,6 +1681,11 @@ fcache_cache_free(dcontext_t *dcontext, fcache_t *cache, bool free_units)
         cache->fifo = NULL;
     }
     ASSERT(cache->fifo == NULL);
+    if (USE_FREE_LIST_FOR_CACHE(cache) && cache->free_list_bytes > 0) {
+        /* the entries go away with their units */
+        STATS_FREE_LIST_SUB(cache, cache->free_list_bytes);
+        cache->free_list_bytes = 0;
+    }
 
     u = cache->units;
     while (u != NULL) {
@@ -2133,6 +2177,7 @@ fcache_thread_init(dcontext_t *dcontext)
     tu->bb = NULL;
     tu->pending_unmap_pc = NULL;
     tu->pending_flush = false;
+    tu->clock_sample_countdown = DYNAMO_OPTION(cache_shared_clock_sample);
 
     fcache_thread_reset_init(dcontext);
 }
@@ -2510,6 +2555,73 @@ extend_unit_end(dcontext_t *dcontext, fcache_t *cache, fcache_unit_t *unit, size
     return extra;
 }
 
+/* Picks the unit of a finite shared cache to flush when the working set
+ * algorithm says the cache should not grow.  We use CLOCK with the hand starting
+ * at the oldest unit: an old unit that was executed since the hand last passed
+ * it gets a second chance and has its reference bit cleared.  If every unit has
+ * been referenced we fall back to the oldest one, which is also what
+ * -cache_shared_clock_sample 0 always does.
+ * Returns the victim and sets *prev_out to its predecessor in cache->units.
+ */
+static fcache_unit_t *
+choose_unit_to_evict(dcontext_t *dcontext, fcache_t *cache, fcache_unit_t **prev_out)
+{
+    fcache_unit_t *u, *prev = NULL;
+    fcache_unit_t *oldest = NULL, *oldest_prev = NULL;
+    fcache_unit_t *victim = NULL, *victim_prev = NULL;
+    ASSERT(CACHE_PROTECTED(cache));
+    ASSERT(cache->units != NULL);
+    /* The list is newest-first, so the last unreferenced unit we see is the one
+     * the hand reaches first and everything after it is passed over.
+     * (Another place where a prev_local would be nice.)
+     */
+    for (u = cache->units; u != NULL; prev = u, u = u->next_local) {
+        if (DYNAMO_OPTION(cache_shared_clock_sample) > 0 && !u->referenced &&
+            /* the unit we are filling is never cold */
+            u != cache->units) {
+            victim = u;
+            victim_prev = prev;
+        }
+        oldest = u;
+        oldest_prev = prev;
+    }
+    u = (victim == NULL) ? cache->units : victim->next_local;
+    for (; u != NULL; u = u->next_local) {
+        if (u->referenced) {
+            u->referenced = false;
+            STATS_INC(cache_units_wset_spared);
+        }
+    }
+    if (victim == NULL) {
+        victim = oldest;
+        victim_prev = oldest_prev;
+    }
+    LOG(THREAD, LOG_CACHE, 2, "choose_unit_to_evict: %s unit " PFX "-" PFX "%s\n",
+        cache->name, victim->start_pc, victim->end_pc,
+        victim == oldest ? " (oldest)" : "");
+    *prev_out = victim_prev;
+    return victim;
+}
+
+void
+fcache_sample_entry(dcontext_t *dcontext, fragment_t *f)
+{
+    fcache_thread_units_t *tu = (fcache_thread_units_t *)dcontext->fcache_field;
+    fcache_unit_t *unit;
+    ASSERT(DYNAMO_OPTION(cache_shared_clock_sample) > 0);
+    if (--tu->clock_sample_countdown > 0)
+        return;
+    tu->clock_sample_countdown = DYNAMO_OPTION(cache_shared_clock_sample);
+    if (!USE_FREE_LIST(f) || TEST(FRAG_FAKE, f->flags))
+        return;
+    /* The caller is about to enter f, so f and its unit cannot be freed
+     * underneath us.
+     */
+    unit = fcache_lookup_unit(f->start_pc);
+    if (unit != NULL && !unit->referenced)
+        unit->referenced = true;
+}
+
 /* Returns whether was able to either resize unit or create a new unit.
  * For non-FIFO caches this routine cannot fail and must suspend the world
  * and reset if necessary.
@@ -2573,22 +2685,17 @@ try_for_more_space(dcontext_t *dcontext, fcache_t *cache, fcache_unit_t *unit,
                  */
                 if (!check_regen_replace_ratio(dcontext, cache,
                                                0 /*not adding a fragment*/)) {
-                    /* flush the oldest unit, at the end of the list */
+                    /* flush the coldest old unit */
                     fcache_thread_units_t *tu =
                         (fcache_thread_units_t *)dcontext->fcache_field;
-                    fcache_unit_t *oldest = cache->units, *prev = NULL;
-                    ASSERT(oldest != NULL);
-
-                    /* another place where a prev_local would be nice */
-                    for (; oldest->next_local != NULL;
-                         prev = oldest, oldest = oldest->next_local)
-                        ; /* nothing */
+                    fcache_unit_t *prev;
+                    fcache_unit_t *oldest = choose_unit_to_evict(dcontext, cache, &prev);
 
                     /* Indicate unit is still live even though off live list.
                      * Flag will be cleared once really flushed in
                      * fcache_flush_pending_units()
                      */
-                    DODEBUG({ oldest->pending_flush = true; });
+                    oldest->pending_flush = true;
 
                     LOG(THREAD, LOG_CACHE, 2,
                         "marking unit " PFX "-" PFX " for flushing\n", oldest->start_pc,
@@ -2722,6 +2829,10 @@ place_fragment(dcontext_t *dcontext, fragment_t *f, fcache_unit_t *unit,
         if (fut != NULL) {
             cache->num_regenerated++;
             STATS_INC(num_fragments_regenerated);
+            if (cache->is_trace)
+                RSTATS_INC(fcache_shared_trace_evict_rebuilt);
+            else
+                RSTATS_INC(fcache_shared_bb_evict_rebuilt);
             SHARED_FLAGS_RECURSIVE_LOCK(fut->flags, acquire, change_linking_lock);
             fut->flags &= ~FRAG_WAS_DELETED;
             SHARED_FLAGS_RECURSIVE_LOCK(fut->flags, release, change_linking_lock);
@@ -2892,6 +3003,10 @@ replace_fragments(dcontext_t *dcontext, fcache_t *cache, fcache_unit_t *unit,
         if (fut != NULL) {
             cache->num_regenerated++;
             STATS_INC(num_fragments_regenerated);
+            if (cache->is_trace)
+                RSTATS_INC(fcache_shared_trace_evict_rebuilt);
+            else
+                RSTATS_INC(fcache_shared_bb_evict_rebuilt);
             SHARED_FLAGS_RECURSIVE_LOCK(fut->flags, acquire, change_linking_lock);
             fut->flags &= ~FRAG_WAS_DELETED;
             SHARED_FLAGS_RECURSIVE_LOCK(fut->flags, release, change_linking_lock);
@@ -2949,7 +3064,7 @@ free_list_header_from_footer(free_list_footer_t *h)
 }
 
 static inline void
-remove_from_free_list(fcache_t *cache, uint bucket,
+remove_from_free_list(fcache_t *cache, fcache_unit_t *unit, uint bucket,
                       free_list_header_t *header _IF_DEBUG(bool coalesce))
 {
     ASSERT(CACHE_PROTECTED(cache));
@@ -2971,6 +3086,10 @@ remove_from_free_list(fcache_t *cache, uint bucket,
      * follows header.
      * no reason to remove FRAG_FCACHE_FREE_LIST flag here.
      */
+    ASSERT(unit->free_list_bytes >= header->size);
+    unit->free_list_bytes -= header->size;
+    cache->free_list_bytes -= header->size;
+    STATS_FREE_LIST_SUB(cache, header->size);
     DOSTATS({
         if (coalesce)
             cache->free_stats_coalesced[bucket]++;
@@ -3024,7 +3143,7 @@ add_to_free_list(dcontext_t *dcontext, fcache_t *cache, fcache_unit_t *unit,
                     cache->name, next_bucket, next_header->size, next_header);
                 size += next_header->size;
                 /* OPTIMIZATION: if still in same bucket can eliminate some work */
-                remove_from_free_list(cache, next_bucket,
+                remove_from_free_list(cache, unit, next_bucket,
                                       next_header _IF_DEBUG(true /*coalesce*/));
                 /* fall-through and add to free list anew
                  * (potentially coalesce with prev as well)
@@ -3076,7 +3195,7 @@ add_to_free_list(dcontext_t *dcontext, fcache_t *cache, fcache_unit_t *unit,
             header = prev_header;
             start_pc = (cache_pc)header;
             /* OPTIMIZATION: if still in same bucket can eliminate some work */
-            remove_from_free_list(cache, prev_bucket,
+            remove_from_free_list(cache, unit, prev_bucket,
                                   prev_header _IF_DEBUG(true /*coalesce*/));
             /* fall-through and add to free list anew */
             STATS_FCACHE_ADD(cache, free_coalesce_prev, 1);
@@ -3133,6 +3252,12 @@ add_to_free_list(dcontext_t *dcontext, fcache_t *cache, fcache_unit_t *unit,
     }
     cache->free_list[bucket] = header;
     /* FIXME: case 7318 we should keep sorted */
+    unit->free_list_bytes += size;
+    cache->free_list_bytes += size;
+    STATS_FREE_LIST_ADD(cache, size);
+    /* fragmentation: share of committed capacity sitting in free slots */
+    STATS_TRACK_MAX(fcache_shared_peak_fragmentation,
+                    cache->size == 0 ? 0 : (cache->free_list_bytes * 100 / cache->size));
 
     DOSTATS({
         /* FIXME: we could split freed into pure-freed, split-freed, and coalesce-freed */
@@ -3178,19 +3303,26 @@ find_free_list_slot(dcontext_t *dcontext, fcache_t *cache, fragment_t *f, uint s
         if (cache->free_list[bucket] == NULL)
             continue;
 
-        /* search for first entry larger than size in current bucket */
-        /* note that for a bucket of only one size, this search should
-         * finish immediately */
-        header = cache->free_list[bucket];
-
-        while (header != NULL && header->size < size) {
-            /* FIXME: if we keep the list sorted, we'd not waste too
-             * much space by picking the first large enough slot */
+        /* Search for the tightest of the first few entries large enough for
+         * size in the current bucket.  Every entry in a higher bucket is large
+         * enough, so there we simply take the first one.
+         * Note that for a bucket of only one size, this search should
+         * finish immediately.
+         */
+        free_list_header_t *best = NULL;
+        uint fits = 0;
+        for (header = cache->free_list[bucket]; header != NULL; header = header->next) {
             /* FIXME: if we want to coalesce here we can act on any
              * fragment while walking list and make sure that it is
              * coalesced */
-            header = header->next;
+            if (header->size < size)
+                continue;
+            if (best == NULL || header->size < best->size)
+                best = header;
+            if (best->size == size || ++fits >= FREE_LIST_BEST_FIT_CANDIDATES)
+                break;
         }
+        header = best;
         if (header != NULL)
             break;
     }
@@ -3202,9 +3334,6 @@ find_free_list_slot(dcontext_t *dcontext, fcache_t *cache, fragment_t *f, uint s
             STATS_FCACHE_ADD(cache, free_use_larger, 1);
     });
     ASSERT(header != NULL);
-    /* found big enough free slot, extract from free list */
-    remove_from_free_list(cache, bucket, header _IF_DEBUG(false /*!coalesce*/));
-
     start_pc = (cache_pc)header;
     free_size = header->size;
     ASSERT(free_size >= size);
@@ -3214,6 +3343,9 @@ find_free_list_slot(dcontext_t *dcontext, fcache_t *cache, fragment_t *f, uint s
      * unit ptr/tag in the free header.*/
     unit = fcache_lookup_unit(start_pc);
     ASSERT(unit != NULL);
+
+    /* found big enough free slot, extract from free list */
+    remove_from_free_list(cache, unit, bucket, header _IF_DEBUG(false /*!coalesce*/));
     DOCHECK(CHKLVL_DEFAULT, { /* expensive */
                               ASSERT(fcache_pc_in_live_unit(cache, start_pc));
     });
@@ -3688,6 +3820,56 @@ fcache_add_fragment(dcontext_t *dcontext, fragment_t *f)
     PROTECT_CACHE(cache, unlock);
 }
 
+/* Returns a shared cache unit to the dead list once everything in it has been
+ * freed.  Without this a long-running process with code churn keeps every unit
+ * it ever filled, each holding only free list entries, until the cache limit
+ * forces a reset of everything.  Caller must hold the cache lock and must not
+ * touch unit afterward.
+ */
+static void
+release_unit_if_empty(dcontext_t *dcontext, fcache_t *cache, fcache_unit_t *unit)
+{
+    fcache_unit_t *u, *prev_u;
+    cache_pc pc;
+    ASSERT(CACHE_PROTECTED(cache));
+    ASSERT(USE_FREE_LIST_FOR_CACHE(cache));
+    /* Free space at the end of the current unit is simply returned to it.  A unit
+     * queued for flushing is no longer on cache->units and will be freed by
+     * fcache_flush_pending_units().
+     */
+    if (unit == cache->units || unit->pending_free || dynamo_exited || dynamo_resetting)
+        return;
+    if (unit->free_list_bytes < (uint)(unit->cur_pc - unit->start_pc))
+        return;
+    if (unit->pending_flush) {
+        STATS_INC(fcache_shared_units_release_pending);
+        return;
+    }
+    ASSERT(unit->free_list_bytes == (uint)(unit->cur_pc - unit->start_pc));
+    LOG(THREAD, LOG_CACHE, 2, "release_unit_if_empty: %s unit " PFX "-" PFX " is empty\n",
+        cache->name, unit->start_pc, unit->end_pc);
+    for (prev_u = NULL, u = cache->units; u != NULL && u != unit;
+         prev_u = u, u = u->next_local)
+        ; /* no body */
+    if (u != unit || prev_u == NULL) {
+        ASSERT_NOT_REACHED();
+        return;
+    }
+    /* coalescing is capped at MAX_FREE_ENTRY_SIZE so there may be several entries */
+    pc = unit->start_pc;
+    while (pc < unit->cur_pc) {
+        free_list_header_t *cur_free = (free_list_header_t *)pc;
+        ASSERT(FRAG_IS_FREE_LIST(*((fragment_t **)pc)));
+        pc += cur_free->size;
+        remove_from_free_list(cache, unit, find_free_list_bucket(cur_free->size),
+                              cur_free _IF_DEBUG(false /*!coalesce*/));
+    }
+    ASSERT(unit->free_list_bytes == 0);
+    prev_u->next_local = unit->next_local;
+    RSTATS_INC(fcache_shared_units_released);
+    fcache_free_unit(dcontext, unit, true);
+}
+
 void
 fcache_remove_fragment(dcontext_t *dcontext, fragment_t *f)
 {
@@ -3725,6 +3907,10 @@ fcache_remove_fragment(dcontext_t *dcontext, fragment_t *f)
         if (USE_FIFO(f)) {
             fifo_remove(dcontext, cache, f);
             DOLOG(3, LOG_CACHE, { verify_fifo(dcontext, cache); });
+        } else if (USE_FREE_LIST_FOR_CACHE(cache) &&
+                   DYNAMO_OPTION(cache_shared_free_list) &&
+                   DYNAMO_OPTION(cache_shared_release_empty_units)) {
+            release_unit_if_empty(dcontext, cache, unit);
         }
     }
     PROTECT_CACHE(cache, unlock);
@@ -3834,7 +4020,7 @@ chain_fragments_for_flush(dcontext_t *dcontext, fcache_unit_t *unit, fragment_t
                  * entire routine b/c it has lower rank than the lazy_delete lock.
                  */
                 PROTECT_CACHE(unit->cache, lock);
-                remove_from_free_list(unit->cache, bucket,
+                remove_from_free_list(unit->cache, unit, bucket,
                                       cur_free _IF_DEBUG(false /*!coalesce*/));
                 PROTECT_CACHE(unit->cache, unlock);
                 pc += cur_free->size;
@@ -3966,11 +4152,6 @@ fcache_flush_pending_units(dcontext_t *dcontext, fragment_t *was_I_flushed)
         /* not implemented for private units, since no reason to use flush there */
         ASSERT(u->cache->is_shared);
 
-        /* unit is no longer to be considered live -- no other thread should
-         * use it as a live unit from this point on
-         */
-        DODEBUG({ u->pending_flush = false; });
-
         /* Indicate that individual fragments in this unit must not be put
          * on free lists/FIFO empty slots.
          * FIXME: would be nice to set this earlier when move to
@@ -3979,6 +4160,11 @@ fcache_flush_pending_units(dcontext_t *dcontext, fragment_t *was_I_flushed)
          * inefficiently put on free list and then take off in the walk.
          */
         u->pending_free = true;
+        /* unit is no longer to be considered live -- no other thread should
+         * use it as a live unit from this point on.  Cleared only after
+         * pending_free is set so release_unit_if_empty() never sees neither.
+         */
+        u->pending_flush = false;
 
         if (u == unit_flushed)
             not_flushed = false;
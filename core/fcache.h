@@ -123,6 +123,9 @@ void
 fcache_return_extra_space(dcontext_t *dcontext, fragment_t *f, size_t space);
 void
 fcache_remove_fragment(dcontext_t *dcontext, fragment_t *f);
+/* Called on cache entry to f when -cache_shared_clock_sample is on */
+void
+fcache_sample_entry(dcontext_t *dcontext, fragment_t *f);
 
 bool
 fcache_is_flush_pending(dcontext_t *dcontext);
@@ -97,6 +97,20 @@ DECLARE_FREQPROT_VAR(static dcontext_t *allsynch_flusher, NULL);
 DECLARE_FREQPROT_VAR(static app_pc flush_base, NULL);
 DECLARE_FREQPROT_VAR(static size_t flush_size, 0);
 
+/* For -flush_epoch: the number of threads that are could_be_linking, and whether
+ * a flush is in progress.  A thread only becomes could_be_linking while no flush
+ * is in progress, so a flusher need only wait for the count to drain rather than
+ * handshaking with each thread.  Written on every linking transition, so unprotected.
+ */
+DECLARE_NEVERPROT_VAR(static volatile int flush_epoch_linkers, 0);
+DECLARE_NEVERPROT_VAR(static volatile int flush_epoch_pending, 0);
+/* Threads left at a syscall by the current flush, protected by thread_initexit_lock. */
+DECLARE_NEVERPROT_VAR(static int flush_epoch_at_syscall, 0);
+/* Signaled when the last linking thread leaves while a flush is pending. */
+static event_t flush_epoch_drained;
+/* Broadcast to threads held at the epoch gate when a flush completes. */
+static event_t flush_epoch_done;
+
 /* These global tables are kept on the heap for selfprot (case 7957) */
 
 /* synchronization to these tables is accomplished via read-write locks,
@@ -1420,6 +1434,13 @@ fragment_init()
     /* ensure we can read this w/o a lock: no cache line crossing, please */
     ASSERT(ALIGNED(&flushtime_global, 4));
 
+    translation_cache_init();
+
+    if (DYNAMO_OPTION(flush_epoch)) {
+        flush_epoch_drained = create_event();
+        flush_epoch_done = create_broadcast_event();
+    }
+
     if (SHARED_FRAGMENTS_ENABLED()) {
         /* tables are persistent across resets, only on heap for selfprot (case 7957) */
         if (DYNAMO_OPTION(shared_bbs)) {
@@ -1705,7 +1726,12 @@ fragment_exit()
         DELETE_LOCK(shared_traces_lock);
     }
 #endif
+    if (DYNAMO_OPTION(flush_epoch)) {
+        destroy_event(flush_epoch_drained);
+        destroy_event(flush_epoch_done);
+    }
 cleanup:
+    translation_cache_exit();
     /* FIXME: we shouldn't need these locks anyway for hotp_only & thin_client */
 #if defined(INTERNAL) || defined(CLIENT_INTERFACE)
     DELETE_LOCK(tracedump_mutex);
@@ -2582,6 +2608,7 @@ fragment_free(dcontext_t *dcontext, fragment_t *f)
         translation_info_free(dcontext, FRAGMENT_TRANSLATION_INFO(f));
     } else
         ASSERT(FRAGMENT_TRANSLATION_INFO(f) == NULL);
+    translation_cache_remove(f);
 
     /* N.B.: monitor_remove_fragment() was called in fragment_delete,
      * which is assumed to have been called prior to fragment_free
@@ -5609,6 +5636,36 @@ wait_for_flusher_linking(dcontext_t *dcontext)
     }
 }
 
+/* For -flush_epoch: leaves the set of could_be_linking threads, waking a flusher
+ * waiting for that set to drain.
+ */
+static void
+flush_epoch_exit_linking(void)
+{
+    if (atomic_dec_becomes_zero(&flush_epoch_linkers) && flush_epoch_pending)
+        signal_event(flush_epoch_drained);
+}
+
+/* For -flush_epoch: joins the set of could_be_linking threads, first waiting out
+ * any flush in progress.  Must be called prior to acquiring pt->linking_lock.
+ */
+static void
+flush_epoch_enter_linking(dcontext_t *dcontext)
+{
+    while (true) {
+        ATOMIC_INC(int, flush_epoch_linkers);
+        /* The flusher must not wait on its own flush. */
+        if (!flush_epoch_pending || dcontext == flusher)
+            return;
+        flush_epoch_exit_linking();
+        LOG(THREAD, LOG_DISPATCH | LOG_THREADS, 2,
+            "Thread " TIDFMT " waiting for flush epoch (flushtime %d)\n",
+            dcontext->owning_thread, flushtime_global);
+        STATS_INC(num_wait_flush);
+        wait_for_event(flush_epoch_done, 0);
+    }
+}
+
 #ifdef DEBUG
 static void
 check_safe_for_flush_synch(dcontext_t *dcontext)
@@ -5701,6 +5758,8 @@ enter_nolinking(dcontext_t *dcontext, fragment_t *was_I_flushed, bool cache_tran
     not_flushed = not_flushed && check_flush_queue(dcontext, was_I_flushed);
     pt->could_be_linking = false;
     d_r_mutex_unlock(&pt->linking_lock);
+    if (DYNAMO_OPTION(flush_epoch))
+        flush_epoch_exit_linking();
 
     if (!cache_transition)
         return not_flushed;
@@ -5801,6 +5860,8 @@ enter_couldbelinking(dcontext_t *dcontext, fragment_t *was_I_flushed,
 
     DOCHECK(1, { check_safe_for_flush_synch(dcontext); });
 
+    if (DYNAMO_OPTION(flush_epoch))
+        flush_epoch_enter_linking(dcontext);
     d_r_mutex_lock(&pt->linking_lock);
     ASSERT(!pt->could_be_linking);
     /* ensure not still marked at_syscall */
@@ -5836,6 +5897,7 @@ void
 enter_threadexit(dcontext_t *dcontext)
 {
     per_thread_t *pt = (per_thread_t *)dcontext->fragment_field;
+    bool was_linking;
 
     /*case 7966: has no pt, no flushing either */
     if (RUNNING_WITHOUT_CODE_CACHE() || pt == NULL /*PR 536058: no pt*/)
@@ -5844,6 +5906,7 @@ enter_threadexit(dcontext_t *dcontext)
     d_r_mutex_lock(&pt->linking_lock);
     /* must dec ref count on shared regions before we die */
     check_flush_queue(dcontext, NULL);
+    was_linking = pt->could_be_linking;
     pt->could_be_linking = false;
     if (pt->wait_for_unlink) {
         /* make sure don't get into deadlock w/ flusher */
@@ -5851,6 +5914,8 @@ enter_threadexit(dcontext_t *dcontext)
         signal_event(pt->waiting_for_unlink); /* wake flusher up */
     }
     d_r_mutex_unlock(&pt->linking_lock);
+    if (DYNAMO_OPTION(flush_epoch) && was_linking)
+        flush_epoch_exit_linking();
 }
 
 /* caller must hold shared_cache_flush_lock */
@@ -6364,6 +6429,24 @@ flush_fragments_synch_priv(dcontext_t *dcontext, app_pc base, size_t size,
     if (!special_ibl_xfer_is_thread_private())
         unlink_special_ibl_xfer(GLOBAL_DCONTEXT);
 
+    if (DYNAMO_OPTION(flush_epoch)) {
+        /* Close the gate on becoming could_be_linking and wait for every thread
+         * already past it to leave, all at once.  Threads arriving at a cache exit
+         * now wait at the gate for flush_fragments_end_synch(), which obviates the
+         * per-thread wait_for_unlink handshakes below.
+         */
+        reset_event(flush_epoch_drained);
+        reset_event(flush_epoch_done);
+        atomic_exchange_int(&flush_epoch_pending, 1);
+        while (flush_epoch_linkers > 0) {
+            LOG(THREAD, LOG_FRAGMENT, 2, "  waiting for %d linking threads\n",
+                flush_epoch_linkers);
+            STATS_INC(num_flush_epoch_drain_waits);
+            wait_for_event(flush_epoch_drained, 0);
+        }
+        flush_epoch_at_syscall = 0;
+    }
+
     for (i = 0; i < flush_num_threads; i++) {
         tgt_dcontext = flush_threads[i]->dcontext;
         tgt_pt = (per_thread_t *)tgt_dcontext->fragment_field;
@@ -6376,6 +6459,8 @@ flush_fragments_synch_priv(dcontext_t *dcontext, app_pc base, size_t size,
          * vm areas or linking state
          */
         d_r_mutex_lock(&tgt_pt->linking_lock);
+        ASSERT(!DYNAMO_OPTION(flush_epoch) || tgt_dcontext == dcontext ||
+               !tgt_pt->could_be_linking);
         /* Must explicitly check for self and avoid synch then, o/w will lock up
          * if ever called from a could_be_linking location (currently only
          * happens w/ app syscalls)
@@ -6427,6 +6512,8 @@ flush_fragments_synch_priv(dcontext_t *dcontext, app_pc base, size_t size,
 
             if (thread_synch_callback(dcontext, i, tgt_dcontext))
                 flush_fragments_relink_thread_syscalls(dcontext, tgt_dcontext, tgt_pt);
+            if (DYNAMO_OPTION(flush_epoch) && tgt_pt->at_syscall_at_flush)
+                flush_epoch_at_syscall++;
         }
 
         /* for thread-shared, we CANNOT let any thread become could_be_linking, for normal
@@ -6442,7 +6529,8 @@ flush_fragments_synch_priv(dcontext_t *dcontext, app_pc base, size_t size,
          * synch to stop threads at cache exit, since we need them all
          * out of DR for duration of shared flush.
          */
-        if (tgt_dcontext != dcontext && !tgt_pt->could_be_linking)
+        if (tgt_dcontext != dcontext && !tgt_pt->could_be_linking &&
+            !DYNAMO_OPTION(flush_epoch))
             tgt_pt->wait_for_unlink = true; /* stop at cache exit */
         d_r_mutex_unlock(&tgt_pt->linking_lock);
     }
@@ -6721,9 +6809,14 @@ flush_fragments_end_synch(dcontext_t *dcontext, bool keep_initexit_lock)
         /*case 7966: has no pt, no flushing either */
         if (RUNNING_WITHOUT_CODE_CACHE())
             continue;
+        /* With -flush_epoch only threads left at a syscall need a visit. */
+        if (DYNAMO_OPTION(flush_epoch) && flush_epoch_at_syscall == 0)
+            break;
 
         tgt_dcontext = flush_threads[i]->dcontext;
         tgt_pt = (per_thread_t *)tgt_dcontext->fragment_field;
+        if (DYNAMO_OPTION(flush_epoch) && !tgt_pt->at_syscall_at_flush)
+            continue;
         /* re-acquire lock */
         d_r_mutex_lock(&tgt_pt->linking_lock);
 
@@ -6755,6 +6848,8 @@ flush_fragments_end_synch(dcontext_t *dcontext, bool keep_initexit_lock)
              */
             ASSERT(tgt_pt->flushtime_last_update >= pre_flushtime);
             tgt_pt->at_syscall_at_flush = false;
+            if (DYNAMO_OPTION(flush_epoch))
+                flush_epoch_at_syscall--;
         }
 
         if (tgt_dcontext != dcontext) {
@@ -6775,6 +6870,13 @@ flush_fragments_end_synch(dcontext_t *dcontext, bool keep_initexit_lock)
         d_r_mutex_unlock(&tgt_pt->linking_lock);
     }
 
+    if (DYNAMO_OPTION(flush_epoch) && !RUNNING_WITHOUT_CODE_CACHE()) {
+        /* Open the gate and wake everyone waiting at it. */
+        ASSERT(flush_epoch_at_syscall == 0);
+        atomic_exchange_int(&flush_epoch_pending, 0);
+        signal_event(flush_epoch_done);
+    }
+
     /* thread init/exit can proceed now */
     flusher = NULL;
     global_heap_free(flush_threads,
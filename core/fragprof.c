@@ -0,0 +1,606 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/*
+ * fragprof.c - per-fragment entry counts for -profile_frags, and trace head
+ * seeding from a prior run's counts for -trace_seed_file
+ *
+ * Every counted bb and trace starts with an inline increment of a counter kept
+ * here, keyed by tag.  The counters are never freed before exit so that code in
+ * the cache, including code pending deletion, can always reach them, and so that
+ * counts accumulate across flushes and resets.  At exit and on a frag_profile
+ * nudge we write the counts sorted by hotness and mapped to module offsets.
+ *
+ * A report read back in through -trace_seed_file names the module offsets that
+ * were trace heads.  We match them by module path, so they survive a different
+ * load address.
+ */
+
+#include "globals.h"
+#include "fragment.h"
+#include "hashtable.h"
+#include "module_shared.h"
+#include "fragprof.h"
+
+/* Entry counts for one tag. */
+typedef struct _fragprof_rec_t {
+    /* Incremented inline from the code cache. */
+    ptr_uint_t bb_count;
+    ptr_uint_t trace_count;
+    app_pc tag;
+    uint module; /* index into fragprof->modules, or FRAGPROF_NO_MODULE */
+    /* The record this one replaced when a new module was loaded at tag. */
+    struct _fragprof_rec_t *prev;
+} fragprof_rec_t;
+
+typedef struct _fragprof_module_t {
+    app_pc start;
+    app_pc end;
+    const char *path;
+} fragprof_module_t;
+
+typedef struct _fragprof_info_t {
+    /* Maps tags to fragprof_rec_t.  The table lock also guards the module list. */
+    generic_table_t *table;
+    fragprof_module_t *modules;
+    uint num_modules;
+    uint modules_capacity;
+    uint last_module; /* hint for the next lookup */
+    volatile int num_dumps;
+} fragprof_info_t;
+
+/* The trace heads from one module path in a -trace_seed_file report. */
+typedef struct _fragprof_seed_module_t {
+    const char *path;
+    /* Keyed by module offset plus one, as 0 is not a valid key.  Read-only once
+     * loaded.
+     */
+    generic_table_t *offsets;
+} fragprof_seed_module_t;
+
+typedef struct _fragprof_seeds_t {
+    fragprof_seed_module_t *modules;
+    uint num_modules;
+    uint modules_capacity;
+} fragprof_seeds_t;
+
+#define FRAGPROF_NO_MODULE UINT_MAX
+#define INIT_HTABLE_SIZE_FRAGPROF 12
+#define INIT_HTABLE_SIZE_FRAGPROF_SEEDS 8
+#define INIT_MODULES_FRAGPROF 32
+/* Sanity limit for a -trace_seed_file header. */
+#define MAX_MODULES_FRAGPROF_SEEDS 65536
+/* Entries read from a -trace_seed_file at a time. */
+#define FRAGPROF_SEED_BATCH 64
+
+static fragprof_info_t *fragprof;
+static fragprof_seeds_t *fragprof_seeds;
+/* For the last_trace_millis stat. */
+static uint64 fragprof_start_millis;
+
+static void
+fragprof_load_seeds(const char *path);
+
+void
+fragprof_init(void)
+{
+    char seed_file[MAXIMUM_PATH];
+    string_option_read_lock();
+    strncpy(seed_file, DYNAMO_OPTION(trace_seed_file), BUFFER_SIZE_ELEMENTS(seed_file));
+    string_option_read_unlock();
+    NULL_TERMINATE_BUFFER(seed_file);
+    if (seed_file[0] != '\0' && !DYNAMO_OPTION(disable_traces))
+        fragprof_load_seeds(seed_file);
+    if (DYNAMO_OPTION(profile_frags)) {
+        fragprof =
+            HEAP_TYPE_ALLOC(GLOBAL_DCONTEXT, fragprof_info_t, ACCT_OTHER, UNPROTECTED);
+        memset(fragprof, 0, sizeof(*fragprof));
+        /* Records are freed in fragprof_exit(), not by the table, as we replace
+         * them.
+         */
+        fragprof->table =
+            generic_hash_create(GLOBAL_DCONTEXT, INIT_HTABLE_SIZE_FRAGPROF,
+                                80 /* load factor: not perf-critical */,
+                                HASHTABLE_SHARED | HASHTABLE_PERSISTENT,
+                                NULL _IF_DEBUG("fragprof table"));
+        fragprof->modules_capacity = INIT_MODULES_FRAGPROF;
+        fragprof->modules = global_heap_alloc(
+            fragprof->modules_capacity * sizeof(fragprof_module_t) HEAPACCT(ACCT_OTHER));
+        fragprof->last_module = FRAGPROF_NO_MODULE;
+    }
+    if (fragprof != NULL || fragprof_seeds != NULL)
+        fragprof_start_millis = query_time_millis();
+}
+
+static void
+fragprof_seeds_exit(void)
+{
+    uint i;
+    for (i = 0; i < fragprof_seeds->num_modules; i++) {
+        generic_hash_destroy(GLOBAL_DCONTEXT, fragprof_seeds->modules[i].offsets);
+        dr_strfree(fragprof_seeds->modules[i].path HEAPACCT(ACCT_OTHER));
+    }
+    if (fragprof_seeds->modules != NULL) {
+        global_heap_free(fragprof_seeds->modules,
+                         fragprof_seeds->modules_capacity *
+                             sizeof(fragprof_seed_module_t) HEAPACCT(ACCT_OTHER));
+    }
+    HEAP_TYPE_FREE(GLOBAL_DCONTEXT, fragprof_seeds, fragprof_seeds_t, ACCT_OTHER,
+                   PROTECTED);
+    fragprof_seeds = NULL;
+}
+
+void
+fragprof_exit(void)
+{
+    fragprof_rec_t *rec, *prev;
+    void *payload;
+    uint i;
+    int iter = 0;
+    if (fragprof_seeds != NULL)
+        fragprof_seeds_exit();
+    if (fragprof == NULL)
+        return;
+    do {
+        iter = generic_hash_iterate_next(GLOBAL_DCONTEXT, fragprof->table, iter, NULL,
+                                         &payload);
+        if (iter < 0)
+            break;
+        for (rec = (fragprof_rec_t *)payload; rec != NULL; rec = prev) {
+            prev = rec->prev;
+            HEAP_TYPE_FREE(GLOBAL_DCONTEXT, rec, fragprof_rec_t, ACCT_OTHER, UNPROTECTED);
+        }
+    } while (true);
+    generic_hash_destroy(GLOBAL_DCONTEXT, fragprof->table);
+    for (i = 0; i < fragprof->num_modules; i++)
+        dr_strfree(fragprof->modules[i].path HEAPACCT(ACCT_OTHER));
+    global_heap_free(fragprof->modules,
+                     fragprof->modules_capacity *
+                         sizeof(fragprof_module_t) HEAPACCT(ACCT_OTHER));
+    HEAP_TYPE_FREE(GLOBAL_DCONTEXT, fragprof, fragprof_info_t, ACCT_OTHER, UNPROTECTED);
+    fragprof = NULL;
+}
+
+bool
+fragprof_should_count(uint flags)
+{
+    /* Sandboxing checks must come first in a selfmod bb and coarse-grain code can
+     * be persisted, so we leave both uncounted.  A trace's temporary private
+     * copies of its blocks are not entries into the bb.  We only emit a 64-bit
+     * increment.
+     */
+    return (DYNAMO_OPTION(profile_frags) &&
+            !TESTANY(FRAG_SELFMOD_SANDBOXED | FRAG_COARSE_GRAIN | FRAG_TEMP_PRIVATE,
+                     flags)
+                IF_X64(&&!FRAG_IS_32(flags)));
+}
+
+static bool
+fragprof_module_matches(uint index, module_area_t *ma)
+{
+    if (index == FRAGPROF_NO_MODULE)
+        return ma == NULL;
+    return (ma != NULL && fragprof->modules[index].start == ma->start &&
+            fragprof->modules[index].end == ma->end);
+}
+
+static const char *
+fragprof_module_path(module_area_t *ma)
+{
+    const char *path = ma->full_path;
+    if (path == NULL)
+        path = GET_MODULE_NAME(&ma->names);
+    return path == NULL ? "" : path;
+}
+
+/* Returns the module list index for ma, adding it if it's new. */
+static uint
+fragprof_module_index(module_area_t *ma)
+{
+    uint i;
+    ASSERT_TABLE_SYNCHRONIZED(fragprof->table, WRITE);
+    if (ma == NULL)
+        return FRAGPROF_NO_MODULE;
+    if (fragprof->last_module != FRAGPROF_NO_MODULE &&
+        fragprof_module_matches(fragprof->last_module, ma))
+        return fragprof->last_module;
+    for (i = 0; i < fragprof->num_modules; i++) {
+        if (fragprof_module_matches(i, ma)) {
+            fragprof->last_module = i;
+            return i;
+        }
+    }
+    if (fragprof->num_modules == fragprof->modules_capacity) {
+        fragprof->modules =
+            global_heap_realloc(fragprof->modules, fragprof->modules_capacity,
+                                fragprof->modules_capacity * 2,
+                                sizeof(fragprof_module_t) HEAPACCT(ACCT_OTHER));
+        fragprof->modules_capacity *= 2;
+    }
+    fragprof->modules[i].start = ma->start;
+    fragprof->modules[i].end = ma->end;
+    fragprof->modules[i].path = dr_strdup(fragprof_module_path(ma) HEAPACCT(ACCT_OTHER));
+    fragprof->num_modules++;
+    fragprof->last_module = i;
+    return i;
+}
+
+ptr_uint_t *
+fragprof_counter(dcontext_t *dcontext, app_pc tag, bool is_trace, bool create)
+{
+    fragprof_rec_t *rec;
+    module_area_t *ma;
+    ASSERT(fragprof != NULL);
+    if (!create) {
+        /* The record stays put once we've seen it, so no lock is needed past here. */
+        TABLE_RWLOCK(fragprof->table, read, lock);
+        rec = generic_hash_lookup(GLOBAL_DCONTEXT, fragprof->table, (ptr_uint_t)tag);
+        TABLE_RWLOCK(fragprof->table, read, unlock);
+    } else {
+        os_get_module_info_lock();
+        ma = module_pc_lookup(tag);
+        TABLE_RWLOCK(fragprof->table, write, lock);
+        rec = generic_hash_lookup(GLOBAL_DCONTEXT, fragprof->table, (ptr_uint_t)tag);
+        if (rec == NULL || !fragprof_module_matches(rec->module, ma)) {
+            fragprof_rec_t *prev = rec;
+            rec = HEAP_TYPE_ALLOC(GLOBAL_DCONTEXT, fragprof_rec_t, ACCT_OTHER,
+                                  UNPROTECTED);
+            memset(rec, 0, sizeof(*rec));
+            rec->tag = tag;
+            rec->module = fragprof_module_index(ma);
+            rec->prev = prev;
+            if (prev != NULL)
+                generic_hash_remove(GLOBAL_DCONTEXT, fragprof->table, (ptr_uint_t)tag);
+            generic_hash_add(GLOBAL_DCONTEXT, fragprof->table, (ptr_uint_t)tag, rec);
+            STATS_INC(num_frag_profile_records);
+        }
+        TABLE_RWLOCK(fragprof->table, write, unlock);
+        os_get_module_info_unlock();
+    }
+    if (rec == NULL)
+        return NULL;
+    return is_trace ? &rec->trace_count : &rec->bb_count;
+}
+
+/* Returns whether a should be listed before b: hottest first, then by location. */
+static inline bool
+fragprof_entry_before(dr_frag_profile_entry_t *a, dr_frag_profile_entry_t *b)
+{
+    uint64 a_total = a->bb_count + a->trace_count;
+    uint64 b_total = b->bb_count + b->trace_count;
+    if (a_total != b_total)
+        return a_total > b_total;
+    if (a->module != b->module)
+        return a->module < b->module;
+    return a->offset < b->offset;
+}
+
+/* Restores the heap property below root in a heap whose root is the entry that
+ * belongs last.
+ */
+static void
+fragprof_sift_down(dr_frag_profile_entry_t *entries, size_t root, size_t num)
+{
+    dr_frag_profile_entry_t tmp;
+    size_t child;
+    while (2 * root + 1 < num) {
+        child = 2 * root + 1;
+        if (child + 1 < num &&
+            fragprof_entry_before(&entries[child], &entries[child + 1]))
+            child++;
+        if (!fragprof_entry_before(&entries[root], &entries[child]))
+            return;
+        tmp = entries[root];
+        entries[root] = entries[child];
+        entries[child] = tmp;
+        root = child;
+    }
+}
+
+/* A heapsort, as we have no qsort in the core on every platform. */
+static void
+fragprof_sort(dr_frag_profile_entry_t *entries, size_t num)
+{
+    dr_frag_profile_entry_t tmp;
+    size_t i;
+    for (i = num / 2; i > 0; i--)
+        fragprof_sift_down(entries, i - 1, num);
+    for (i = num; i > 1; i--) {
+        tmp = entries[0];
+        entries[0] = entries[i - 1];
+        entries[i - 1] = tmp;
+        fragprof_sift_down(entries, 0, i - 1);
+    }
+}
+
+static bool
+fragprof_get_dir(char *dir, uint dir_len)
+{
+    uint len = dir_len;
+    string_option_read_lock();
+    if (!IS_STRING_OPTION_EMPTY(profile_frags_dir)) {
+        strncpy(dir, DYNAMO_OPTION(profile_frags_dir), dir_len);
+        dir[dir_len - 1] = '\0';
+        string_option_read_unlock();
+        return true;
+    }
+    string_option_read_unlock();
+    create_log_dir(PROCESS_DIR);
+    if (!get_log_dir(PROCESS_DIR, dir, &len) || len > dir_len)
+        return false;
+    dir[dir_len - 1] = '\0';
+    return dir[0] != '\0';
+}
+
+static bool
+fragprof_write(file_t f, const void *buf, size_t size)
+{
+    return os_write(f, buf, size) == (ssize_t)size;
+}
+
+void
+fragprof_dump(void)
+{
+    char dir[MAXIMUM_PATH];
+    char path[MAXIMUM_PATH];
+    dr_frag_profile_header_t header;
+    dr_frag_profile_module_t module;
+    dr_frag_profile_entry_t *entries;
+    fragprof_rec_t *rec;
+    void *payload;
+    size_t num = 0, i;
+    bool ok;
+    file_t f;
+    int iter;
+    if (fragprof == NULL)
+        return;
+    if (!fragprof_get_dir(dir, BUFFER_SIZE_ELEMENTS(dir))) {
+        SYSLOG_INTERNAL_WARNING("No directory for -profile_frags report");
+        return;
+    }
+    do {
+        snprintf(path, BUFFER_SIZE_ELEMENTS(path), "%s%cfragprof.%d.%d.dat", dir, DIRSEP,
+                 get_process_id(),
+                 atomic_add_exchange_int(&fragprof->num_dumps, 1) - 1);
+        NULL_TERMINATE_BUFFER(path);
+        f = os_open(path, OS_OPEN_WRITE | OS_OPEN_REQUIRE_NEW);
+        /* An existing file is from before an execve: try the next number. */
+    } while (f == INVALID_FILE && os_file_exists(path, false /*!is_dir*/));
+    if (f == INVALID_FILE) {
+        SYSLOG_INTERNAL_WARNING("Unable to create -profile_frags report %s", path);
+        return;
+    }
+
+    TABLE_RWLOCK(fragprof->table, read, lock);
+    for (iter = 0;;) {
+        iter = generic_hash_iterate_next(GLOBAL_DCONTEXT, fragprof->table, iter, NULL,
+                                         &payload);
+        if (iter < 0)
+            break;
+        for (rec = (fragprof_rec_t *)payload; rec != NULL; rec = rec->prev)
+            num++;
+    }
+    entries = num == 0 ? NULL
+                       : global_heap_alloc(num * sizeof(*entries) HEAPACCT(ACCT_OTHER));
+    i = 0;
+    for (iter = 0;;) {
+        iter = generic_hash_iterate_next(GLOBAL_DCONTEXT, fragprof->table, iter, NULL,
+                                         &payload);
+        if (iter < 0)
+            break;
+        for (rec = (fragprof_rec_t *)payload; rec != NULL; rec = rec->prev) {
+            if (rec->module == FRAGPROF_NO_MODULE) {
+                entries[i].module = DR_FRAG_PROFILE_NO_MODULE;
+                entries[i].offset = (uint64)(ptr_uint_t)rec->tag;
+            } else {
+                entries[i].module = rec->module;
+                entries[i].offset = rec->tag - fragprof->modules[rec->module].start;
+            }
+            /* Racy reads: other threads may still be running. */
+            entries[i].bb_count = rec->bb_count;
+            entries[i].trace_count = rec->trace_count;
+            i++;
+        }
+    }
+    ASSERT(i == num);
+    fragprof_sort(entries, num);
+
+    header.magic = DR_FRAG_PROFILE_MAGIC;
+    header.version = DR_FRAG_PROFILE_VERSION;
+    header.num_modules = fragprof->num_modules;
+    header.num_entries = num;
+    ok = fragprof_write(f, &header, sizeof(header));
+    for (i = 0; ok && i < fragprof->num_modules; i++) {
+        module.start = (uint64)(ptr_uint_t)fragprof->modules[i].start;
+        module.end = (uint64)(ptr_uint_t)fragprof->modules[i].end;
+        module.path_len = strlen(fragprof->modules[i].path) + 1;
+        ok = fragprof_write(f, &module, sizeof(module)) &&
+            fragprof_write(f, fragprof->modules[i].path, (size_t)module.path_len);
+    }
+    TABLE_RWLOCK(fragprof->table, read, unlock);
+    if (entries != NULL) {
+        ok = ok && fragprof_write(f, entries, num * sizeof(*entries));
+        global_heap_free(entries, num * sizeof(*entries) HEAPACCT(ACCT_OTHER));
+    }
+    os_close(f);
+    if (!ok) {
+        SYSLOG_INTERNAL_WARNING("Failed to write -profile_frags report %s", path);
+        return;
+    }
+    STATS_INC(num_frag_profile_dumps);
+    LOG(GLOBAL, LOG_MONITOR, 1, "Wrote " SZFMT " fragment profile entries to %s\n", num,
+        path);
+}
+
+/***************************************************************************
+ * TRACE SEEDS
+ */
+
+static bool
+fragprof_read(file_t f, void *buf, size_t size)
+{
+    return os_read(f, buf, size) == (ssize_t)size;
+}
+
+/* Returns the seed module for path, adding it if it's new. */
+static fragprof_seed_module_t *
+fragprof_seed_module(const char *path)
+{
+    fragprof_seed_module_t *sm;
+    uint i;
+    for (i = 0; i < fragprof_seeds->num_modules; i++) {
+        if (strcmp(fragprof_seeds->modules[i].path, path) == 0)
+            return &fragprof_seeds->modules[i];
+    }
+    /* The array is sized for every module in the report. */
+    ASSERT(i < fragprof_seeds->modules_capacity);
+    sm = &fragprof_seeds->modules[i];
+    sm->path = dr_strdup(path HEAPACCT(ACCT_OTHER));
+    sm->offsets = generic_hash_create(GLOBAL_DCONTEXT, INIT_HTABLE_SIZE_FRAGPROF_SEEDS,
+                                      80 /* load factor: not perf-critical */,
+                                      HASHTABLE_SHARED | HASHTABLE_PERSISTENT,
+                                      NULL _IF_DEBUG("trace seed table"));
+    fragprof_seeds->num_modules++;
+    return sm;
+}
+
+/* Loads every trace in the report at path as a seed.  A malformed report is
+ * used up to the point where it goes bad.
+ */
+static void
+fragprof_load_seeds(const char *path)
+{
+    dr_frag_profile_header_t header;
+    dr_frag_profile_module_t module;
+    dr_frag_profile_entry_t entries[FRAGPROF_SEED_BATCH];
+    fragprof_seed_module_t **by_index = NULL;
+    char module_path[MAXIMUM_PATH];
+    uint64 i, num, j;
+    bool ok;
+    file_t f = os_open(path, OS_OPEN_READ);
+    if (f == INVALID_FILE) {
+        /* Not an error: a first run has no profile to seed from yet. */
+        LOG(GLOBAL, LOG_MONITOR, 1, "No -trace_seed_file %s\n", path);
+        return;
+    }
+    ok = fragprof_read(f, &header, sizeof(header)) &&
+        header.magic == DR_FRAG_PROFILE_MAGIC &&
+        header.version == DR_FRAG_PROFILE_VERSION &&
+        header.num_modules <= MAX_MODULES_FRAGPROF_SEEDS;
+    if (ok) {
+        fragprof_seeds =
+            HEAP_TYPE_ALLOC(GLOBAL_DCONTEXT, fragprof_seeds_t, ACCT_OTHER, PROTECTED);
+        memset(fragprof_seeds, 0, sizeof(*fragprof_seeds));
+        if (header.num_modules > 0) {
+            fragprof_seeds->modules_capacity = (uint)header.num_modules;
+            fragprof_seeds->modules = global_heap_alloc(
+                fragprof_seeds->modules_capacity *
+                sizeof(fragprof_seed_module_t) HEAPACCT(ACCT_OTHER));
+            by_index = global_heap_alloc(fragprof_seeds->modules_capacity *
+                                         sizeof(*by_index) HEAPACCT(ACCT_OTHER));
+        }
+    }
+    for (i = 0; ok && i < header.num_modules; i++) {
+        ok = fragprof_read(f, &module, sizeof(module)) && module.path_len > 0 &&
+            module.path_len <= sizeof(module_path) &&
+            fragprof_read(f, module_path, (size_t)module.path_len) &&
+            module_path[module.path_len - 1] == '\0';
+        if (ok)
+            by_index[i] = fragprof_seed_module(module_path);
+    }
+    for (i = 0; ok && i < header.num_entries; i += num) {
+        num = MIN(header.num_entries - i, FRAGPROF_SEED_BATCH);
+        ok = fragprof_read(f, entries, (size_t)num * sizeof(entries[0]));
+        for (j = 0; ok && j < num; j++) {
+            fragprof_seed_module_t *sm;
+            ptr_uint_t key;
+            /* Tags outside any module have no stable name to match. */
+            if (entries[j].trace_count == 0 || entries[j].module >= header.num_modules ||
+                entries[j].offset >= POINTER_MAX)
+                continue;
+            sm = by_index[entries[j].module];
+            key = (ptr_uint_t)entries[j].offset + 1;
+            TABLE_RWLOCK(sm->offsets, write, lock);
+            if (generic_hash_lookup(GLOBAL_DCONTEXT, sm->offsets, key) == NULL) {
+                generic_hash_add(GLOBAL_DCONTEXT, sm->offsets, key, sm);
+                RSTATS_INC(num_trace_seeds);
+            }
+            TABLE_RWLOCK(sm->offsets, write, unlock);
+        }
+    }
+    os_close(f);
+    if (by_index != NULL) {
+        global_heap_free(by_index,
+                         fragprof_seeds->modules_capacity *
+                             sizeof(*by_index) HEAPACCT(ACCT_OTHER));
+    }
+    if (!ok)
+        SYSLOG_INTERNAL_WARNING("Malformed -trace_seed_file %s", path);
+    LOG(GLOBAL, LOG_MONITOR, 1, "Loaded " SZFMT " trace seeds from %s\n",
+        (size_t)GLOBAL_STAT(num_trace_seeds), path);
+}
+
+bool
+fragprof_is_trace_seed(app_pc tag)
+{
+    module_area_t *ma;
+    const char *path;
+    bool res = false;
+    uint i;
+    if (fragprof_seeds == NULL)
+        return false;
+    os_get_module_info_lock();
+    ma = module_pc_lookup(tag);
+    path = ma == NULL ? NULL : fragprof_module_path(ma);
+    for (i = 0; path != NULL && i < fragprof_seeds->num_modules; i++) {
+        fragprof_seed_module_t *sm = &fragprof_seeds->modules[i];
+        if (strcmp(sm->path, path) != 0)
+            continue;
+        TABLE_RWLOCK(sm->offsets, read, lock);
+        res = generic_hash_lookup(GLOBAL_DCONTEXT, sm->offsets,
+                                  (ptr_uint_t)(tag - ma->start) + 1) != NULL;
+        TABLE_RWLOCK(sm->offsets, read, unlock);
+        break;
+    }
+    os_get_module_info_unlock();
+    return res;
+}
+
+void
+fragprof_trace_built(app_pc tag)
+{
+    if (fragprof == NULL && fragprof_seeds == NULL)
+        return;
+    RSTATS_TRACK_MAX(last_trace_millis, query_time_millis() - fragprof_start_millis);
+    if (fragprof_is_trace_seed(tag))
+        RSTATS_INC(num_trace_seeds_built);
+}
@@ -0,0 +1,72 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/*
+ * fragprof.h - per-fragment entry counts for -profile_frags, and trace head
+ * seeding for -trace_seed_file
+ */
+
+#ifndef _FRAGPROF_H_
+#define _FRAGPROF_H_ 1
+
+void
+fragprof_init(void);
+
+void
+fragprof_exit(void);
+
+/* Returns whether a fragment with these flags gets an entry counter. */
+bool
+fragprof_should_count(uint flags);
+
+/* Returns the counter to increment on entry to the bb or trace at tag.  The
+ * counter lives until process exit, and the same tag always maps to the same
+ * counter unless its module is unloaded and something else is loaded there.  If
+ * !create, returns NULL for a tag that has never been counted: recreating a
+ * fragment should pass false.
+ */
+ptr_uint_t *
+fragprof_counter(dcontext_t *dcontext, app_pc tag, bool is_trace, bool create);
+
+/* Writes the current counts as a hotness report: see dr_frag_profile_header_t. */
+void
+fragprof_dump(void);
+
+/* Returns whether -trace_seed_file names tag as a trace head. */
+bool
+fragprof_is_trace_seed(app_pc tag);
+
+/* Updates the trace seed and timing stats for a new trace at tag. */
+void
+fragprof_trace_built(app_pc tag);
+
+#endif /* _FRAGPROF_H_ */
@@ -306,6 +306,19 @@ typedef struct _dr_stats_t {
      * an un-translatable spot.
      */
     uint64 synchs_not_at_safe_spot;
+    /** The number of trace heads loaded from the -trace_seed_file runtime option. */
+    uint64 trace_seeds;
+    /**
+     * The number of traces built from trace heads in -trace_seed_file.  This
+     * includes traces rebuilt after deletion.
+     */
+    uint64 trace_seeds_built;
+    /**
+     * Milliseconds from initialization to when the most recent new trace was built:
+     * a measure of how long it took to reach a steady state.  Only tracked with the
+     * -trace_seed_file or -profile_frags runtime options.
+     */
+    uint64 last_trace_millis;
 } dr_stats_t;
 
 /**
@@ -723,6 +736,102 @@ typedef enum {
 #endif
     DR_WHERE_LAST /**< Equals the count of DR_WHERE_xxx locations. */
 } dr_where_am_i_t;
+
+/**
+ * Identifies the event that drives a sampler installed by dr_set_perf_sampler().
+ */
+typedef enum {
+    DR_PERF_SAMPLE_CYCLES,        /**< Hardware CPU cycles. */
+    DR_PERF_SAMPLE_CACHE_MISSES,  /**< Hardware last-level cache misses. */
+    DR_PERF_SAMPLE_BRANCH_MISSES, /**< Hardware mispredicted branches. */
+    /**
+     * The kernel's per-thread CPU clock, in nanoseconds.  This is a software
+     * event, so it is available where the hardware counters are not, such as
+     * in many virtual machines.
+     */
+    DR_PERF_SAMPLE_TASK_CLOCK,
+    DR_PERF_SAMPLE_LAST /**< Equals the count of DR_PERF_SAMPLE_xxx events. */
+} dr_perf_event_t;
+
+/**
+ * A sample delivered to the callback passed to dr_set_perf_sampler().
+ */
+typedef struct _dr_perf_sample_t {
+    /** The size of this structure.  Used for backward compatibility. */
+    size_t size;
+    /** The event whose counter overflowed. */
+    dr_perf_event_t event;
+    /**
+     * Where the thread was when it was interrupted.  Samples of DR or client
+     * code have a value other than #DR_WHERE_FCACHE or #DR_WHERE_APP and never
+     * have an application pc, so they can be kept apart from application samples.
+     */
+    dr_where_am_i_t where;
+    /** The interrupted pc, which may be a code cache or DR address. */
+    byte *raw_pc;
+    /**
+     * The application pc corresponding to \p raw_pc, or NULL if \p raw_pc is not
+     * in application code or in a code cache fragment or could not be translated
+     * without blocking.
+     */
+    app_pc pc;
+    /** The tag of the code cache fragment containing \p raw_pc, or NULL. */
+    void *tag;
+} dr_perf_sample_t;
+
+/**
+ * The value of dr_frag_profile_header_t.magic: "FRAGPROF" in little-endian order.
+ */
+#define DR_FRAG_PROFILE_MAGIC 0x464f525047415246ULL
+/** The current value of dr_frag_profile_header_t.version. */
+#define DR_FRAG_PROFILE_VERSION 1
+/** The dr_frag_profile_entry_t.module value for code outside of any module. */
+#define DR_FRAG_PROFILE_NO_MODULE (~0ULL)
+
+/**
+ * The header of a hotness report written by the -profile_frags runtime option.
+ * All fields in a report are in the byte order of the profiled process.  The
+ * header is followed by \p num_modules module records and then by
+ * \p num_entries dr_frag_profile_entry_t records.
+ */
+typedef struct _dr_frag_profile_header_t {
+    uint64 magic;       /**< Always #DR_FRAG_PROFILE_MAGIC. */
+    uint64 version;     /**< The format version: #DR_FRAG_PROFILE_VERSION. */
+    uint64 num_modules; /**< The number of module records. */
+    uint64 num_entries; /**< The number of fragment entry records. */
+} dr_frag_profile_header_t;
+
+/**
+ * A module record in a -profile_frags hotness report.  Each record is followed
+ * by \p path_len bytes holding the module's null-terminated path.  A record's
+ * position in the module list is its index for dr_frag_profile_entry_t.module.
+ */
+typedef struct _dr_frag_profile_module_t {
+    uint64 start;    /**< The base address of the module. */
+    uint64 end;      /**< The end address of the module. */
+    uint64 path_len; /**< The size of the path that follows, including the null. */
+} dr_frag_profile_module_t;
+
+/**
+ * A fragment record in a -profile_frags hotness report.  Records are sorted by
+ * the sum of \p bb_count and \p trace_count, hottest first.  Counts are
+ * incremented without synchronization and so are approximate when several
+ * threads execute the same fragment.
+ */
+typedef struct _dr_frag_profile_entry_t {
+    /**
+     * The index of the module containing the fragment's tag, or
+     * #DR_FRAG_PROFILE_NO_MODULE.
+     */
+    uint64 module;
+    /**
+     * The offset of the fragment's tag from the start of its module, or the tag
+     * itself for #DR_FRAG_PROFILE_NO_MODULE.
+     */
+    uint64 offset;
+    uint64 bb_count;    /**< The number of entries into basic blocks at the tag. */
+    uint64 trace_count; /**< The number of entries into traces at the tag. */
+} dr_frag_profile_entry_t;
 /* DR_API EXPORT END */
 
 /* make args easier to read for protection change calls
@@ -1053,6 +1162,11 @@ struct _dcontext_t {
     /* i#2237: on exit we delete client_data before some IS_CLIENT_THREAD asserts. */
     bool is_client_thread_exiting;
 #    endif
+    /* Bump arena for IR objects under DR_IR_ALLOC_ARENA; lazily created.  Not part
+     * of client_data, which debug builds free before monitor_thread_exit() destroys
+     * a trace still being built.
+     */
+    struct _ir_arena_t *ir_arena;
 #endif
 
     /* FIXME trace_sysenter_exit is used to capture an exit from a trace that
@@ -348,6 +348,23 @@ DECLARE_CXTSWPROT_VAR(static recursive_lock_t low_on_memory_pending_lock,
 DECLARE_FREQPROT_VAR(bool low_on_memory_pending, false);
 #endif
 
+/* Stacks freed by exiting threads are kept on this list for reuse by new threads
+ * (-stack_pool_size), saving the map, guard page protection, and DR areas
+ * update on both thread creation and thread exit.  Each entry is stored at the
+ * top of the freed stack itself.
+ */
+typedef struct _pooled_stack_t {
+    size_t size;
+    struct _pooled_stack_t *next;
+} pooled_stack_t;
+
+DECLARE_CXTSWPROT_VAR(static mutex_t stack_pool_lock, INIT_LOCK_FREE(stack_pool_lock));
+DECLARE_CXTSWPROT_VAR(static pooled_stack_t *stack_pool, NULL);
+DECLARE_CXTSWPROT_VAR(static uint stack_pool_count, 0);
+
+static void
+stack_pool_exit(void);
+
 #if defined(DEBUG) && defined(HEAP_ACCOUNTING) && defined(HOT_PATCHING_INTERFACE)
 static int
 get_special_heap_header_size(void);
@@ -2307,6 +2324,7 @@ d_r_heap_exit()
     heap_management_t *temp;
 
     heap_exiting = true;
+    stack_pool_exit();
     /* FIXME: we shouldn't need either lock if executed last */
     dynamo_vm_areas_lock();
     acquire_recursive_lock(&heap_unit_lock);
@@ -2377,6 +2395,7 @@ d_r_heap_exit()
 #ifdef X64
     DELETE_LOCK(request_region_be_heap_reachable_lock);
 #endif
+    DELETE_LOCK(stack_pool_lock);
 
     if (doing_detach) {
         heapmgt = &temp_heapmgt;
@@ -3142,6 +3161,73 @@ heap_munmap(void *p, size_t size, which_vmm_t which)
     heap_munmap_ex(p, size, true /*guarded*/, which);
 }
 
+/* Returns the TOS of a pooled stack of the given size that lies entirely above
+ * min_addr, or NULL if there is none.
+ */
+static byte *
+stack_pool_take(size_t size, byte *min_addr)
+{
+    pooled_stack_t *ps, *prev = NULL;
+    if (stack_pool == NULL)
+        return NULL;
+    d_r_mutex_lock(&stack_pool_lock);
+    for (ps = stack_pool; ps != NULL; prev = ps, ps = ps->next) {
+        byte *tos = (byte *)ps + sizeof(*ps);
+        if (ps->size == size && tos - size >= min_addr) {
+            if (prev == NULL)
+                stack_pool = ps->next;
+            else
+                prev->next = ps->next;
+            stack_pool_count--;
+            break;
+        }
+    }
+    d_r_mutex_unlock(&stack_pool_lock);
+    if (ps == NULL)
+        return NULL;
+    STATS_INC(stacks_reused);
+    return (byte *)ps + sizeof(*ps);
+}
+
+/* Returns whether the stack with top p was added to the pool. */
+static bool
+stack_pool_add(byte *p, size_t size)
+{
+    pooled_stack_t *ps = (pooled_stack_t *)(p - sizeof(*ps));
+    bool added = false;
+    if (heap_exiting || DYNAMO_OPTION(stack_pool_size) == 0)
+        return false;
+    d_r_mutex_lock(&stack_pool_lock);
+    if (stack_pool_count < DYNAMO_OPTION(stack_pool_size)) {
+        ps->size = size;
+        ps->next = stack_pool;
+        stack_pool = ps;
+        stack_pool_count++;
+        added = true;
+    }
+    d_r_mutex_unlock(&stack_pool_lock);
+    return added;
+}
+
+static void
+stack_release(void *p, size_t size);
+
+/* Frees all pooled stacks.  Called at exit prior to releasing the vmm heap. */
+static void
+stack_pool_exit(void)
+{
+    pooled_stack_t *ps, *next;
+    d_r_mutex_lock(&stack_pool_lock);
+    ps = stack_pool;
+    stack_pool = NULL;
+    stack_pool_count = 0;
+    d_r_mutex_unlock(&stack_pool_lock);
+    for (; ps != NULL; ps = next) {
+        next = ps->next;
+        stack_release((byte *)ps + sizeof(*ps), ps->size);
+    }
+}
+
 /* use stack_alloc to build a stack -- it returns TOS
  * For -stack_guard_pages, also allocates an extra page
  * on the bottom and uses it to detect overflows when accessed.
@@ -3149,7 +3235,13 @@ heap_munmap(void *p, size_t size, which_vmm_t which)
 void *
 stack_alloc(size_t size, byte *min_addr)
 {
-    void *p;
+    void *p = stack_pool_take(size, min_addr);
+    if (p != NULL) {
+#ifdef DEBUG_MEMORY
+        memset((byte *)p - size, HEAP_ALLOCATED_BYTE, size);
+#endif
+        return p;
+    }
     /* we reserve and commit at once for now
      * FIXME case 2330: commit-on-demand could allow larger max sizes w/o
      * hurting us in the common case
@@ -3201,10 +3293,16 @@ stack_alloc(size_t size, byte *min_addr)
 void
 stack_free(void *p, size_t size)
 {
-    size_t alloc_size;
     if (size == 0)
         size = DYNAMORIO_STACK_SIZE;
-    alloc_size = size;
+    if (!stack_pool_add((byte *)p, size))
+        stack_release(p, size);
+}
+
+static void
+stack_release(void *p, size_t size)
+{
+    size_t alloc_size = size;
     p = (void *)((vm_addr_t)p - size);
     if (!DYNAMO_OPTION(guard_pages) && DYNAMO_OPTION(stack_guard_pages)) {
         alloc_size += PAGE_SIZE;
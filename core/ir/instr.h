@@ -545,8 +545,47 @@ typedef struct instr_noalloc_t {
  * @brief Functions to create and manipulate instructions.
  */
 
+/**
+ * Allocation strategies for #instr_t objects and their operand arrays, for use with
+ * dr_set_ir_allocation_mode().
+ */
+typedef enum {
+    /** Each object is allocated individually from the thread-local heap (default). */
+    DR_IR_ALLOC_HEAP,
+    /**
+     * Objects created with a thread's drcontext are carved out of a per-thread bump
+     * arena, which is reset in bulk once every instruction allocated from it has been
+     * destroyed: normally right after each basic block or trace is emitted.  When the
+     * arena is full, allocation falls back to the heap.
+     */
+    DR_IR_ALLOC_ARENA,
+} dr_ir_alloc_mode_t;
+
 /* DR_API EXPORT END */
 
+DR_API
+/**
+ * Selects how subsequent instr_create(), instr_clone(), and operand array
+ * allocations obtain their memory.  Under #DR_IR_ALLOC_ARENA, freeing an
+ * instruction is nearly free and block building avoids most heap traffic.  The
+ * arena imposes the same requirement as the thread-local heap: an instruction must be
+ * destroyed with the same drcontext that created it.  Instructions created with
+ * GLOBAL_DCONTEXT always use the heap.  Switching modes at any time is safe, as
+ * instructions are freed according to where they were allocated.  Debug builds of
+ * DR poison arena memory on each reset and assert when a stale instruction is
+ * freed or cloned.  Returns whether the mode is supported.
+ */
+bool
+dr_set_ir_allocation_mode(dr_ir_alloc_mode_t mode);
+
+#ifdef CLIENT_INTERFACE
+/* Releases the thread's IR arena.  Must follow everything that can still free
+ * the thread's instrs.
+ */
+void
+instr_arena_thread_exit(dcontext_t *dcontext);
+#endif
+
 DR_API
 /**
  * Returns an initialized instr_t allocated on the thread-local heap.
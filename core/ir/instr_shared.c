@@ -80,11 +80,196 @@
 #    define ASSERT_NOT_REACHED DO_NOT_USE_ASSERT_USE_CLIENT_ASSERT_INSTEAD
 #endif
 
+/****************************************************************************
+ * IR allocation
+ *
+ * Under DR_IR_ALLOC_ARENA, instr_t structs and their operand arrays are carved
+ * out of a per-thread bump arena.  Arena objects are recognized purely by
+ * address, so no instr_t flag is needed and heap-allocated instrs (created
+ * before the mode switch, with GLOBAL_DCONTEXT, or after the arena filled up)
+ * are freed exactly as before.  The bump pointer only moves back once every
+ * arena instr has been destroyed, which keeps the operand arrays of live instrs
+ * intact and in practice happens each time a block's ilist is freed after emit.
+ */
+
+static dr_ir_alloc_mode_t ir_alloc_mode = DR_IR_ALLOC_HEAP;
+
+#if defined(CLIENT_INTERFACE) && !defined(STANDALONE_DECODER)
+#    define IR_ARENA_SUPPORTED 1
+
+/* Lives at the start of its own mapping. */
+typedef struct _ir_arena_t {
+    byte *start; /* first allocatable byte */
+    byte *cur;   /* bump pointer */
+    byte *end;
+    uint live_instrs;
+#    ifdef DEBUG_MEMORY
+    byte *poison_start; /* start of the current generation */
+#    endif
+} ir_arena_t;
+
+static inline ir_arena_t *
+ir_arena_get(dcontext_t *dcontext, bool create)
+{
+    ir_arena_t *arena;
+    size_t map_size;
+    if (dcontext == NULL || dcontext == GLOBAL_DCONTEXT)
+        return NULL;
+    arena = dcontext->ir_arena;
+    if (arena != NULL || !create)
+        return arena;
+    map_size = ALIGN_FORWARD(DYNAMO_OPTION(ir_arena_size), PAGE_SIZE);
+    arena = (ir_arena_t *)heap_mmap(map_size, MEMPROT_READ | MEMPROT_WRITE,
+                                    VMM_SPECIAL_MMAP);
+    arena->start = (byte *)arena + ALIGN_FORWARD(sizeof(*arena), HEAP_ALIGNMENT);
+    arena->cur = arena->start;
+    arena->end = (byte *)arena + map_size;
+    arena->live_instrs = 0;
+#    ifdef DEBUG_MEMORY
+    arena->poison_start = arena->start;
+#    endif
+    dcontext->ir_arena = arena;
+    return arena;
+}
+
+static inline bool
+ir_arena_owns(ir_arena_t *arena, void *p)
+{
+    return arena != NULL && (byte *)p >= arena->start && (byte *)p < arena->end;
+}
+
+/* Returns NULL when the arena is full: callers fall back to the heap. */
+static inline void *
+ir_arena_alloc(ir_arena_t *arena, size_t size)
+{
+    byte *p = arena->cur;
+    size = ALIGN_FORWARD(size, HEAP_ALIGNMENT);
+    if ((size_t)(arena->end - p) < size) {
+        STATS_INC(ir_arena_fallbacks);
+        return NULL;
+    }
+    arena->cur = p + size;
+    return p;
+}
+
+static void
+ir_arena_reset(ir_arena_t *arena)
+{
+#    ifdef DEBUG_MEMORY
+    /* Poison the generation just freed so that stale pointers trip the checks in
+     * instr_free() and instr_clone().  The space is only recycled once half the
+     * arena is used, so a dangling instr stays poisoned across several blocks.
+     */
+    memset(arena->poison_start, HEAP_UNALLOCATED_BYTE, arena->cur - arena->poison_start);
+    if (arena->cur - arena->start < (arena->end - arena->start) / 2) {
+        arena->poison_start = arena->cur;
+        return;
+    }
+    arena->poison_start = arena->start;
+#    endif
+    arena->cur = arena->start;
+    STATS_INC(ir_arena_resets);
+}
+
+static inline void
+ir_arena_check_live(ir_arena_t *arena, instr_t *instr)
+{
+#    ifdef DEBUG_MEMORY
+    CLIENT_ASSERT(!ir_arena_owns(arena, instr) || instr->flags != HEAP_UNALLOCATED_UINT,
+                  "instr used after its IR arena was reset");
+#    endif
+}
+
+void
+instr_arena_thread_exit(dcontext_t *dcontext)
+{
+    ir_arena_t *arena = ir_arena_get(dcontext, false);
+    if (arena == NULL)
+        return;
+    dcontext->ir_arena = NULL;
+    heap_munmap(arena, arena->end - (byte *)arena, VMM_SPECIAL_MMAP);
+}
+#endif /* CLIENT_INTERFACE && !STANDALONE_DECODER */
+
+bool
+dr_set_ir_allocation_mode(dr_ir_alloc_mode_t mode)
+{
+    switch (mode) {
+    case DR_IR_ALLOC_HEAP: break;
+#ifdef IR_ARENA_SUPPORTED
+    case DR_IR_ALLOC_ARENA:
+        if (DYNAMO_OPTION(ir_arena_size) == 0)
+            return false;
+        break;
+#endif
+    default: return false;
+    }
+    ir_alloc_mode = mode;
+    return true;
+}
+
+static instr_t *
+instr_alloc_struct(dcontext_t *dcontext)
+{
+#ifdef IR_ARENA_SUPPORTED
+    if (ir_alloc_mode == DR_IR_ALLOC_ARENA) {
+        ir_arena_t *arena = ir_arena_get(dcontext, true);
+        instr_t *instr = arena == NULL ? NULL : ir_arena_alloc(arena, sizeof(instr_t));
+        if (instr != NULL) {
+            arena->live_instrs++;
+            STATS_INC(ir_arena_instrs);
+            return instr;
+        }
+    }
+#endif
+    return (instr_t *)heap_alloc(dcontext, sizeof(instr_t) HEAPACCT(ACCT_IR));
+}
+
+static void
+instr_free_struct(dcontext_t *dcontext, instr_t *instr)
+{
+#ifdef IR_ARENA_SUPPORTED
+    ir_arena_t *arena = ir_arena_get(dcontext, false);
+    if (ir_arena_owns(arena, instr)) {
+        CLIENT_ASSERT(arena->live_instrs > 0, "IR arena instr count underflow");
+        if (--arena->live_instrs == 0)
+            ir_arena_reset(arena);
+        return;
+    }
+#endif
+    heap_free(dcontext, instr, sizeof(instr_t) HEAPACCT(ACCT_IR));
+}
+
+/* Operand arrays follow their instr: arena instrs get arena arrays when possible. */
+static opnd_t *
+instr_alloc_opnds(dcontext_t *dcontext, instr_t *instr, uint num)
+{
+#ifdef IR_ARENA_SUPPORTED
+    ir_arena_t *arena = ir_arena_get(dcontext, false);
+    if (ir_arena_owns(arena, instr)) {
+        opnd_t *opnds = (opnd_t *)ir_arena_alloc(arena, num * sizeof(opnd_t));
+        if (opnds != NULL)
+            return opnds;
+    }
+#endif
+    return (opnd_t *)heap_alloc(dcontext, num * sizeof(opnd_t) HEAPACCT(ACCT_IR));
+}
+
+static void
+instr_free_opnds(dcontext_t *dcontext, opnd_t *opnds, uint num)
+{
+#ifdef IR_ARENA_SUPPORTED
+    if (ir_arena_owns(ir_arena_get(dcontext, false), opnds))
+        return;
+#endif
+    heap_free(dcontext, opnds, num * sizeof(opnd_t) HEAPACCT(ACCT_IR));
+}
+
 /* returns an empty instr_t object */
 instr_t *
 instr_create(dcontext_t *dcontext)
 {
-    instr_t *instr = (instr_t *)heap_alloc(dcontext, sizeof(instr_t) HEAPACCT(ACCT_IR));
+    instr_t *instr = instr_alloc_struct(dcontext);
     /* everything initializes to 0, even flags, to indicate
      * an uninitialized instruction */
     memset((void *)instr, 0, sizeof(instr_t));
@@ -103,7 +288,7 @@ instr_destroy(dcontext_t *dcontext, instr_t *instr)
     instr_free(dcontext, instr);
 
     /* CAUTION: assumes that instr is not part of any instrlist */
-    heap_free(dcontext, instr, sizeof(instr_t) HEAPACCT(ACCT_IR));
+    instr_free_struct(dcontext, instr);
 }
 
 /* returns a clone of orig, but with next and prev fields set to NULL */
@@ -115,8 +300,11 @@ instr_clone(dcontext_t *dcontext, instr_t *orig)
      */
     CLIENT_ASSERT(!TEST(INSTR_IS_NOALLOC_STRUCT, orig->flags),
                   "Cloning an instr_noalloc_t is not supported.");
+#ifdef IR_ARENA_SUPPORTED
+    ir_arena_check_live(ir_arena_get(dcontext, false), orig);
+#endif
 
-    instr_t *instr = (instr_t *)heap_alloc(dcontext, sizeof(instr_t) HEAPACCT(ACCT_IR));
+    instr_t *instr = instr_alloc_struct(dcontext);
     memcpy((void *)instr, (void *)orig, sizeof(instr_t));
     instr->next = NULL;
     instr->prev = NULL;
@@ -139,13 +327,11 @@ instr_clone(dcontext_t *dcontext, instr_t *orig)
         instr_set_label_callback(instr, NULL);
     }
     if (orig->num_dsts > 0) { /* checking num_dsts, not dsts, b/c of label data */
-        instr->dsts = (opnd_t *)heap_alloc(
-            dcontext, instr->num_dsts * sizeof(opnd_t) HEAPACCT(ACCT_IR));
+        instr->dsts = instr_alloc_opnds(dcontext, instr, instr->num_dsts);
         memcpy((void *)instr->dsts, (void *)orig->dsts, instr->num_dsts * sizeof(opnd_t));
     }
     if (orig->num_srcs > 1) { /* checking num_src, not srcs, b/c of label data */
-        instr->srcs = (opnd_t *)heap_alloc(
-            dcontext, (instr->num_srcs - 1) * sizeof(opnd_t) HEAPACCT(ACCT_IR));
+        instr->srcs = instr_alloc_opnds(dcontext, instr, instr->num_srcs - 1);
         memcpy((void *)instr->srcs, (void *)orig->srcs,
                (instr->num_srcs - 1) * sizeof(opnd_t));
     }
@@ -183,19 +369,20 @@ instr_free(dcontext_t *dcontext, instr_t *instr)
         (*instr->label_cb)(dcontext, instr);
     if (TEST(INSTR_IS_NOALLOC_STRUCT, instr->flags))
         return;
+#ifdef IR_ARENA_SUPPORTED
+    ir_arena_check_live(ir_arena_get(dcontext, false), instr);
+#endif
     if (TEST(INSTR_RAW_BITS_ALLOCATED, instr->flags)) {
         instr_free_raw_bits(dcontext, instr);
     }
     if (instr->num_dsts > 0) { /* checking num_dsts, not dsts, b/c of label data */
-        heap_free(dcontext, instr->dsts,
-                  instr->num_dsts * sizeof(opnd_t) HEAPACCT(ACCT_IR));
+        instr_free_opnds(dcontext, instr->dsts, instr->num_dsts);
         instr->dsts = NULL;
         instr->num_dsts = 0;
     }
     if (instr->num_srcs > 1) { /* checking num_src, not src, b/c of label data */
         /* remember one src is static, rest are dynamic */
-        heap_free(dcontext, instr->srcs,
-                  (instr->num_srcs - 1) * sizeof(opnd_t) HEAPACCT(ACCT_IR));
+        instr_free_opnds(dcontext, instr->srcs, instr->num_srcs - 1);
         instr->srcs = NULL;
         instr->num_srcs = 0;
     }
@@ -545,8 +732,7 @@ instr_set_num_opnds(dcontext_t *dcontext, instr_t *instr, int instr_num_dsts,
             instr_noalloc_t *noalloc = (instr_noalloc_t *)instr;
             noalloc->instr.dsts = noalloc->dsts;
         } else {
-            instr->dsts = (opnd_t *)heap_alloc(
-                dcontext, instr_num_dsts * sizeof(opnd_t) HEAPACCT(ACCT_IR));
+            instr->dsts = instr_alloc_opnds(dcontext, instr, instr_num_dsts);
         }
     }
     if (instr_num_srcs > 0) {
@@ -558,8 +744,7 @@ instr_set_num_opnds(dcontext_t *dcontext, instr_t *instr, int instr_num_dsts,
                 instr_noalloc_t *noalloc = (instr_noalloc_t *)instr;
                 noalloc->instr.srcs = noalloc->srcs;
             } else {
-                instr->srcs = (opnd_t *)heap_alloc(
-                    dcontext, (instr_num_srcs - 1) * sizeof(opnd_t) HEAPACCT(ACCT_IR));
+                instr->srcs = instr_alloc_opnds(dcontext, instr, instr_num_srcs - 1);
             }
         }
         CLIENT_ASSERT_TRUNCATE(instr->num_srcs, byte, instr_num_srcs,
@@ -610,9 +795,8 @@ instr_remove_srcs(dcontext_t *dcontext, instr_t *instr, uint start, uint end)
     CLIENT_ASSERT(start >= 0 && end <= instr->num_srcs && start < end,
                   "instr_remove_srcs: ordinals invalid");
     if (instr->num_srcs - 1 > (byte)(end - start)) {
-        new_srcs = (opnd_t *)heap_alloc(dcontext,
-                                        (instr->num_srcs - 1 - (end - start)) *
-                                            sizeof(opnd_t) HEAPACCT(ACCT_IR));
+        new_srcs =
+            instr_alloc_opnds(dcontext, instr, instr->num_srcs - 1 - (end - start));
         if (start > 1)
             memcpy(new_srcs, instr->srcs, (start - 1) * sizeof(opnd_t));
         if ((byte)end < instr->num_srcs - 1) {
@@ -623,8 +807,7 @@ instr_remove_srcs(dcontext_t *dcontext, instr_t *instr, uint start, uint end)
         new_srcs = NULL;
     if (start == 0 && end < instr->num_srcs)
         instr->src0 = instr->srcs[end - 1];
-    heap_free(dcontext, instr->srcs,
-              (instr->num_srcs - 1) * sizeof(opnd_t) HEAPACCT(ACCT_IR));
+    instr_free_opnds(dcontext, instr->srcs, instr->num_srcs - 1);
     instr->num_srcs -= (byte)(end - start);
     instr->srcs = new_srcs;
     instr_being_modified(instr, false /*raw bits invalid*/);
@@ -642,9 +825,7 @@ instr_remove_dsts(dcontext_t *dcontext, instr_t *instr, uint start, uint end)
     CLIENT_ASSERT(start >= 0 && end <= instr->num_dsts && start < end,
                   "instr_remove_dsts: ordinals invalid");
     if (instr->num_dsts > (byte)(end - start)) {
-        new_dsts = (opnd_t *)heap_alloc(dcontext,
-                                        (instr->num_dsts - (end - start)) *
-                                            sizeof(opnd_t) HEAPACCT(ACCT_IR));
+        new_dsts = instr_alloc_opnds(dcontext, instr, instr->num_dsts - (end - start));
         if (start > 0)
             memcpy(new_dsts, instr->dsts, start * sizeof(opnd_t));
         if (end < instr->num_dsts) {
@@ -653,7 +834,7 @@ instr_remove_dsts(dcontext_t *dcontext, instr_t *instr, uint start, uint end)
         }
     } else
         new_dsts = NULL;
-    heap_free(dcontext, instr->dsts, instr->num_dsts * sizeof(opnd_t) HEAPACCT(ACCT_IR));
+    instr_free_opnds(dcontext, instr->dsts, instr->num_dsts);
     instr->num_dsts -= (byte)(end - start);
     instr->dsts = new_dsts;
     instr_being_modified(instr, false /*raw bits invalid*/);
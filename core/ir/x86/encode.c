@@ -2736,6 +2736,186 @@ copy_and_re_relativize_raw_instr(dcontext_t *dcontext, instr_t *instr, byte *dst
     return orig_dst_pc + instr->length;
 }
 
+/***************************************************************************
+ * Template cache
+ *
+ * Selecting a template walks the opcode's template list calling
+ * encoding_possible() on each until one matches.  The outcome, including the
+ * prefixes accumulated along the way, depends only on the opcode, x86 mode,
+ * prefixes, hints, and the "shape" of each operand, so for instrs whose operands
+ * do not depend on the encode location we remember the result keyed by that
+ * shape.  The table is shared by all threads; each entry is guarded by a sequence
+ * number that is odd while the entry is being written.
+ */
+
+#define ENCODE_CACHE_BITS 8
+#define ENCODE_CACHE_SIZE (1 << ENCODE_CACHE_BITS)
+#define ENCODE_CACHE_MAX_DSTS 2
+#define ENCODE_CACHE_MAX_SRCS 3
+
+/* Immediate classes matching the checks in opnd_type_ok() and immed_size_ok() */
+enum {
+    ENCODE_IMMED_ONE = 1,
+    ENCODE_IMMED_INT8,
+    ENCODE_IMMED_INT16,
+    ENCODE_IMMED_INT32,
+    ENCODE_IMMED_LARGE,
+};
+
+/* Displacements outside this range are never compared to template constants */
+#define ENCODE_DISP_LARGE INT_MAX
+
+typedef struct _encode_opnd_sig_t {
+    byte kind;
+    byte size;
+    byte scale;
+    byte flags;   /* disp encoding flags for memory operands */
+    byte same_as; /* 1-based index of the first earlier identical operand */
+    byte unused;
+    reg_id_t reg; /* register or memory base */
+    reg_id_t index;
+    reg_id_t seg;
+    int value; /* ENCODE_IMMED_ class, or the displacement */
+} encode_opnd_sig_t;
+
+typedef struct _encode_sig_t {
+    uint opcode;
+    uint prefixes;
+    uint hints;
+    ushort num_dsts;
+    ushort num_srcs;
+    uint x86_mode;
+    encode_opnd_sig_t opnd[ENCODE_CACHE_MAX_DSTS + ENCODE_CACHE_MAX_SRCS];
+} encode_sig_t;
+
+#define ENCODE_SIG_WORDS (sizeof(encode_sig_t) / sizeof(uint))
+
+typedef struct _encode_cache_entry_t {
+    uint seq;
+    uint prefixes; /* di->prefixes after template selection */
+    const instr_info_t *info;
+    uint sig[ENCODE_SIG_WORDS];
+} encode_cache_entry_t;
+
+static encode_cache_entry_t encode_cache[ENCODE_CACHE_SIZE];
+
+/* Fills in the sig for instr and returns its table index, or returns -1 if instr
+ * has an operand whose template choice depends on where it is encoded.
+ */
+static int
+encode_cache_sig(decode_info_t *di, instr_t *instr, encode_sig_t *sig)
+{
+    int i, j, num;
+    uint hash = 0;
+    opnd_t opnds[ENCODE_CACHE_MAX_DSTS + ENCODE_CACHE_MAX_SRCS];
+    if (instr->num_dsts > ENCODE_CACHE_MAX_DSTS ||
+        instr->num_srcs > ENCODE_CACHE_MAX_SRCS)
+        return -1;
+    memset(sig, 0, sizeof(*sig));
+    sig->opcode = (uint)di->opcode;
+    sig->prefixes = di->prefixes;
+    sig->hints = instr->encoding_hints;
+    sig->num_dsts = (ushort)instr->num_dsts;
+    sig->num_srcs = (ushort)instr->num_srcs;
+    sig->x86_mode = IF_X64_ELSE((uint)di->x86_mode, 0);
+    num = 0;
+    for (i = 0; i < instr->num_dsts; i++)
+        opnds[num++] = instr_get_dst(instr, i);
+    for (i = 0; i < instr->num_srcs; i++)
+        opnds[num++] = instr_get_src(instr, i);
+    for (i = 0; i < num; i++) {
+        opnd_t opnd = opnds[i];
+        encode_opnd_sig_t *os = &sig->opnd[i];
+        os->kind = opnd.kind;
+        if (opnd_is_null(opnd)) {
+            /* nothing else to record */
+        } else if (opnd_is_reg(opnd)) {
+            os->size = opnd_get_size(opnd);
+            os->reg = opnd_get_reg(opnd);
+        } else if (opnd_is_immed_int(opnd)) {
+            ptr_int_t val = opnd_get_immed_int(opnd);
+            os->size = opnd_get_size(opnd);
+            if (val == 1)
+                os->value = ENCODE_IMMED_ONE;
+            else if (val >= INT8_MIN && val <= INT8_MAX)
+                os->value = ENCODE_IMMED_INT8;
+            else if (val >= INT16_MIN && val <= INT16_MAX)
+                os->value = ENCODE_IMMED_INT16;
+            else if (val >= INT32_MIN && val <= INT32_MAX)
+                os->value = ENCODE_IMMED_INT32;
+            else
+                os->value = ENCODE_IMMED_LARGE;
+        } else if (opnd_is_immed_float(opnd)) {
+            os->size = opnd_get_size(opnd);
+        } else if (opnd_is_base_disp(opnd)) {
+            int disp = opnd_get_disp(opnd);
+            os->size = opnd_get_size(opnd);
+            os->reg = opnd_get_base(opnd);
+            os->index = opnd_get_index(opnd);
+            os->seg = opnd_get_segment(opnd);
+            os->scale = (byte)opnd_get_scale(opnd);
+            os->flags = (opnd_is_disp_encode_zero(opnd) ? 1 : 0) |
+                (opnd_is_disp_force_full(opnd) ? 2 : 0) |
+                (opnd_is_disp_short_addr(opnd) ? 4 : 0);
+            os->value = (disp >= INT8_MIN && disp <= INT8_MAX) ? disp : ENCODE_DISP_LARGE;
+        } else {
+            /* pc, instr, and rip-relative or absolute addresses */
+            return -1;
+        }
+        /* Templates can require two operands to be identical */
+        for (j = 0; j < i; j++) {
+            if (opnd_same(opnds[j], opnd)) {
+                os->same_as = (byte)(j + 1);
+                break;
+            }
+        }
+    }
+    for (i = 0; i < ENCODE_SIG_WORDS; i++)
+        hash = (hash ^ ((uint *)sig)[i]) * 0x01000193; /* FNV prime */
+    return (int)((hash ^ (hash >> 16)) & (ENCODE_CACHE_SIZE - 1));
+}
+
+static const instr_info_t *
+encode_cache_lookup(encode_sig_t *sig, int idx, uint *prefixes OUT)
+{
+    volatile encode_cache_entry_t *entry = &encode_cache[idx];
+    const instr_info_t *info;
+    uint seq = entry->seq;
+    uint i;
+    if (TEST(1, seq) || entry->info == NULL)
+        return NULL;
+    for (i = 0; i < ENCODE_SIG_WORDS; i++) {
+        if (entry->sig[i] != ((uint *)sig)[i])
+            return NULL;
+    }
+    info = entry->info;
+    *prefixes = entry->prefixes;
+    /* x86 does not reorder loads with other loads, and the volatile accesses
+     * keep the compiler from doing so.
+     */
+    if (entry->seq != seq)
+        return NULL;
+    return info;
+}
+
+static void
+encode_cache_record(encode_sig_t *sig, int idx, const instr_info_t *info, uint prefixes)
+{
+    volatile encode_cache_entry_t *entry = &encode_cache[idx];
+    uint seq = entry->seq;
+    uint i;
+    /* If another thread is writing this entry we just skip caching */
+    if (TEST(1, seq) ||
+        !atomic_compare_exchange_int((volatile int *)&entry->seq, (int)seq,
+                                     (int)(seq + 1)))
+        return;
+    for (i = 0; i < ENCODE_SIG_WORDS; i++)
+        entry->sig[i] = ((uint *)sig)[i];
+    entry->info = info;
+    entry->prefixes = prefixes;
+    entry->seq = seq + 2;
+}
+
 /* Encodes instruction instr.  The parameter copy_pc points
  * to the address of this instruction in the fragment cache.
  * Checks for and fixes pc-relative instructions.
@@ -2763,6 +2943,10 @@ instr_encode_arch(dcontext_t *dcontext, instr_t *instr, byte *copy_pc, byte *fin
     byte *disp_relativize_at = NULL;
     uint opc;
     bool output_initial_opcode = false;
+    encode_sig_t cache_sig;
+    int cache_idx = -1;
+    const instr_info_t *cached = NULL;
+    uint cached_prefixes = 0;
     if (has_instr_opnds != NULL)
         *has_instr_opnds = false;
 
@@ -2830,23 +3014,47 @@ instr_encode_arch(dcontext_t *dcontext, instr_t *instr, byte *copy_pc, byte *fin
     di.start_pc = cache_pc;
     di.final_pc = final_pc;
 
-    while (!encoding_possible(&di, instr, info)) {
-        LOG(THREAD, LOG_EMIT, ENC_LEVEL, "\tencoding for 0x%x no good...\n",
-            info->opcode);
-        info = get_next_instr_info(info);
-        /* stop when hit end of list or when hit extra operand tables (OP_CONTD) */
-        if (info == NULL || info->type == OP_CONTD) {
-            DOLOG(1, LOG_EMIT, {
-                LOG(THREAD, LOG_EMIT, 1, "ERROR: Could not find encoding for: ");
-                instr_disassemble(dcontext, instr, THREAD);
-                LOG(THREAD, LOG_EMIT, 1, "\n");
-            });
-            CLIENT_ASSERT(false, "instr_encode error: no encoding found (see log)");
-            /* FIXME: since labels (case 4468) have a legal length 0
-             * we may want to return a separate status code for failure.
-             */
-            return NULL;
+    if (DYNAMO_OPTION(encode_template_cache))
+        cache_idx = encode_cache_sig(&di, instr, &cache_sig);
+    if (cache_idx >= 0)
+        cached = encode_cache_lookup(&cache_sig, cache_idx, &cached_prefixes);
+    if (cached != NULL) {
+        STATS_INC(encode_template_cache_hit);
+        DOCHECK(1, {
+            /* Ensure the walk below would have made the same choice */
+            decode_info_t check_di = di;
+            const instr_info_t *check_info = info;
+            while (check_info != NULL && check_info->type != OP_CONTD &&
+                   !encoding_possible(&check_di, instr, check_info))
+                check_info = get_next_instr_info(check_info);
+            CLIENT_ASSERT(check_info == cached && check_di.prefixes == cached_prefixes,
+                          "instr_encode error: template cache mismatch");
+        });
+        info = cached;
+        di.prefixes = cached_prefixes;
+    } else {
+        if (cache_idx >= 0)
+            STATS_INC(encode_template_cache_miss);
+        while (!encoding_possible(&di, instr, info)) {
+            LOG(THREAD, LOG_EMIT, ENC_LEVEL, "\tencoding for 0x%x no good...\n",
+                info->opcode);
+            info = get_next_instr_info(info);
+            /* stop when hit end of list or when hit extra operand tables (OP_CONTD) */
+            if (info == NULL || info->type == OP_CONTD) {
+                DOLOG(1, LOG_EMIT, {
+                    LOG(THREAD, LOG_EMIT, 1, "ERROR: Could not find encoding for: ");
+                    instr_disassemble(dcontext, instr, THREAD);
+                    LOG(THREAD, LOG_EMIT, 1, "\n");
+                });
+                CLIENT_ASSERT(false, "instr_encode error: no encoding found (see log)");
+                /* FIXME: since labels (case 4468) have a legal length 0
+                 * we may want to return a separate status code for failure.
+                 */
+                return NULL;
+            }
         }
+        if (cache_idx >= 0)
+            encode_cache_record(&cache_sig, cache_idx, info, di.prefixes);
     }
 
     /* fill out the other fields of di */
@@ -1472,6 +1472,8 @@ enum {
     NUDGE_DEF(client, "Client nudge")                                          \
     /* security testing */                                                     \
     NUDGE_DEF(violation, "Simulate a security violation")                      \
+    /* -profile_frags */                                                       \
+    NUDGE_DEF(frag_profile, "Write a fragment hotness report")                 \
     /* ADD NEW NUDGE_DEFs only immediately above this line  */                 \
     /* Since these are used as a bitmask only 32 types can be supported:       \
      * but on Linux only 28.  If we want more we can simply use the client_arg \
@@ -330,6 +330,10 @@ static client_lib_t client_libs[MAX_CLIENT_LIBS] = { {
 static size_t num_client_libs = 0;
 
 static void *persist_user_data[MAX_CLIENT_LIBS];
+/* Combined instrumentation versions from dr_set_persist_version(), recorded in
+ * and required to match for persisted cache files.
+ */
+static uint64 persist_client_version;
 
 #    ifdef WINDOWS
 /* private kernel32 lib, used to print to console */
@@ -5325,6 +5329,20 @@ dr_get_itimer(int which)
 }
 #    endif /* UNIX */
 
+#    ifdef LINUX
+DR_API
+bool
+dr_set_perf_sampler(dr_perf_event_t event, uint64 period,
+                    void (*func)(void *drcontext, dr_perf_sample_t *sample))
+{
+    dcontext_t *dcontext = get_thread_private_dcontext();
+    CLIENT_ASSERT(!standalone_library, "API not supported in standalone mode");
+    if (func == NULL && period != 0)
+        return false;
+    return set_perf_sampler(dcontext, event, period, func);
+}
+#    endif /* LINUX */
+
 DR_API
 void
 dr_track_where_am_i(void)
@@ -8249,4 +8267,24 @@ dr_unregister_persist_patch(bool (*func_patch)(void *drcontext, void *perscxt,
     return remove_callback(&persist_patch_callbacks, (void (*)(void))func_patch, true);
 }
 
+DR_API
+bool
+dr_set_persist_version(uint64 version)
+{
+    CLIENT_ASSERT(!dynamo_initialized,
+                  "dr_set_persist_version must be called at client init time");
+    if (dynamo_initialized)
+        return false;
+    /* Rotate so that two clients passing the same value do not cancel out */
+    persist_client_version =
+        ((persist_client_version << 13) | (persist_client_version >> 51)) ^ version;
+    return true;
+}
+
+uint64
+instrument_persist_version(void)
+{
+    return persist_client_version;
+}
+
 #endif /* CLIENT_INTERFACE */
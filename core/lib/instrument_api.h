@@ -5011,6 +5011,47 @@ DR_API
 dr_where_am_i_t
 dr_where_am_i(void *drcontext, app_pc pc, OUT void **tag);
 
+#    ifdef LINUX
+DR_API
+/**
+ * Samples the calling thread on the hardware or kernel event \p event, using
+ * Linux's perf_event_open system call.  Every \p period occurrences of the
+ * event, \p func is called with a #dr_perf_sample_t describing where the
+ * thread was.  Unlike dr_set_itimer(), the interrupted code cache pc is already
+ * translated: when the thread was in a code cache fragment the sample carries
+ * the fragment's tag and the corresponding application pc.  Samples of DR and
+ * client code have no application pc and a \p where value other than
+ * #DR_WHERE_FCACHE or #DR_WHERE_APP, so that DR's own time can be kept apart.
+ * Call dr_track_where_am_i() during process initialization to separate
+ * clean call time from other DR time.
+ *
+ * Each event type has at most one sampler per thread: calling this again for
+ * the same \p event replaces the prior sampler, and passing 0 for \p period
+ * removes it.  A sampler is not inherited by threads the calling thread
+ * creates, nor across fork; a client wanting samples from every thread should
+ * call this from its thread initialization event.
+ *
+ * The function is called from a signal handler that may have interrupted a
+ * lock holder or other critical code, so it must be careful in its
+ * operations: keep it as simple as possible, and avoid any non-reentrant
+ * actions such as lock usage or calling this routine.
+ *
+ * The overflow notifications arrive as SIGPROF, which continues to work for
+ * an application's ITIMER_PROF.
+ *
+ * The return value indicates whether the sampler was successfully installed
+ * (or removed if 0 was passed for \p period).  Installation fails if the
+ * kernel or the hardware does not support the event, as is common for the
+ * hardware events inside virtual machines: #DR_PERF_SAMPLE_TASK_CLOCK is
+ * usually available regardless.
+ *
+ * \note Linux-only.
+ */
+bool
+dr_set_perf_sampler(dr_perf_event_t event, uint64 period,
+                    void (*func)(void *drcontext, dr_perf_sample_t *sample));
+#    endif
+
 /* DR_API EXPORT TOFILE dr_ir_utils.h */
 /* DR_API EXPORT BEGIN */
 #    ifdef API_EXPORT_ONLY
@@ -6886,4 +6927,19 @@ dr_unregister_persist_patch(bool (*func_patch)(void *drcontext, void *perscxt,
                                                byte *bb_start, size_t bb_size,
                                                void *user_data));
 
+DR_API
+/**
+ * Sets a version identifier for the instrumentation this client adds to
+ * persisted code.  The value is recorded in each persisted cache file and
+ * is part of the file's name, and a file is only loaded when its recorded
+ * value matches the current one.  A client whose instrumentation depends on
+ * its own build or on its options should pass a hash of those here so that
+ * persisted code from an incompatible configuration is never used.  When
+ * multiple clients call this routine their values are combined.
+ * Must be called from dr_client_main().
+ * \return whether successful.
+ */
+bool
+dr_set_persist_version(uint64 version);
+
 #endif /* _INSTRUMENT_API_H_ */
@@ -100,6 +100,9 @@ STATS_DEF("Re-takeovers after native", num_retakeover_after_native)
 RSTATS_DEF("Total signals delivered", num_signals)
 RSTATS_DEF("Signals dropped", num_signals_dropped)
 RSTATS_DEF("Signals in coarse units delayed", num_signals_coarse_delayed)
+STATS_DEF("Delayable signals delivered from the cache", num_signals_from_cache)
+STATS_DEF("Perf samples of application code", num_perf_samples_app)
+STATS_DEF("Perf samples of DR or client code", num_perf_samples_dr)
 #endif
 STATS_DEF("Exceptions in decoding app memory", num_exceptions_decode)
 RSTATS_DEF("System calls, pre", pre_syscall)
@@ -166,6 +169,11 @@ STATS_DEF("Interpreted far indirect jmps", num_far_ind_jmps)
 STATS_DEF("Interpreted far rets", num_far_rets)
 STATS_DEF("Interpreted irets", num_irets)
 STATS_DEF("Decoded jcc branch hints", num_branch_hints)
+STATS_DEF("Encode template cache hits", encode_template_cache_hit)
+STATS_DEF("Encode template cache misses", encode_template_cache_miss)
+STATS_DEF("IR arena instrs allocated", ir_arena_instrs)
+STATS_DEF("IR arena bulk resets", ir_arena_resets)
+STATS_DEF("IR arena full, heap fallbacks", ir_arena_fallbacks)
 
 STATS_DEF("Dynamic option synchronizations", option_synchronizations)
 STATS_DEF("Dynamic option synchronizations, no change", option_synchronizations_nop)
@@ -261,6 +269,10 @@ STATS_DEF("Fcache units on to-free list", cache_units_tofree)
 STATS_DEF("Peak fcache units on to-free list", peak_cache_units_tofree)
 STATS_DEF("Fcache units flushed for wset", cache_units_wset_flushed)
 STATS_DEF("Fcache units allowed w/o a flush for wset", cache_units_wset_allowed)
+STATS_DEF("Fcache units spared for wset by reference bit", cache_units_wset_spared)
+RSTATS_DEF("Shared bb fragments rebuilt after eviction", fcache_shared_bb_evict_rebuilt)
+RSTATS_DEF("Shared trace fragments rebuilt after eviction",
+           fcache_shared_trace_evict_rebuilt)
 STATS_DEF("Fcache units flushed w/ no live fragments", cache_units_flushed_nolive)
 STATS_DEF("Flushes of vmvector areas", num_flush_vmvector)
 STATS_DEF("Shared deletion regions unlinked", num_shared_flush_regions)
@@ -396,6 +408,21 @@ STATS_DEF("32-bit basic block fragments generated", num_32bit_bbs)
 STATS_DEF("32-bit trace fragments generated", num_32bit_traces)
 STATS_DEF("32-bit instructions translated to 64-bit", num_32bit_instrs_translated)
 #endif
+RSTATS_DEF("Predicted successor blocks queued for prebuilding",
+           num_bb_prebuild_requests)
+RSTATS_DEF("Basic blocks prebuilt by worker threads", num_bb_prebuilt)
+STATS_DEF("Prebuild requests already built or not eligible", num_bb_prebuild_skipped)
+STATS_DEF("Prebuild requests dropped on a full queue", num_bb_prebuild_dropped)
+STATS_DEF("Prebuilding skipped for a client bb event", num_bb_prebuild_client_unsafe)
+STATS_DEF("Fragment profile records", num_frag_profile_records)
+STATS_DEF("Fragment profile reports written", num_frag_profile_dumps)
+RSTATS_DEF("Trace heads loaded from -trace_seed_file", num_trace_seeds)
+RSTATS_DEF("Seeded trace heads marked when built", num_trace_seeds_marked)
+RSTATS_DEF("Traces built from seeded trace heads", num_trace_seeds_built)
+RSTATS_DEF("Milliseconds from init to the last new trace", last_trace_millis)
+STATS_DEF("Trace client spill/restore pairs removed", num_trace_spill_pairs_removed)
+STATS_DEF("Trace client aflags restore/save pairs removed",
+          num_trace_aflags_pairs_removed)
 STATS_DEF("Trace fragments aborted for any reason", num_aborted_traces)
 STATS_DEF("Trace fragments aborted: shared race", num_aborted_traces_race)
 STATS_DEF("Trace fragments aborted: client bad mod", num_aborted_traces_client)
@@ -562,6 +589,9 @@ STATS_DEF("Recreated fragments, total", num_recreated_fragments)
 STATS_DEF("Recreated fragments, traces", num_recreated_traces)
 STATS_DEF("Recreations via app re-decode", recreate_via_app_ilist)
 STATS_DEF("Recreations via stored info", recreate_via_stored_info)
+STATS_DEF("Recreations via translation cache", recreate_via_translation_cache)
+STATS_DEF("Translation cache entries added", translation_cache_entries)
+STATS_DEF("Translation cache evictions", translation_cache_evictions)
 STATS_DEF("Recreation spill value restores", recreate_spill_restores)
 STATS_DEF("IBL stubs updated on table resize", num_ibl_stub_resize_updates)
 
@@ -655,6 +685,8 @@ STATS_DEF("Persisted cache load error: modinfo mismatch", perscache_modinfo_mism
 STATS_DEF("Persisted cache load error: modbase mismatch", perscache_base_mismatch)
 STATS_DEF("Persisted cache load error: region mismatch", perscache_region_mismatch)
 STATS_DEF("Persisted cache load error: tls offs mismatch", perscache_tls_mismatch)
+STATS_DEF("Persisted cache load error: client version mismatch",
+          perscache_instrument_mismatch)
 STATS_DEF("Persisted cache load error: no trace support", perscache_trace_mismatch)
 STATS_DEF("Persisted cache load error: no RAC/RCT support", perscache_rct_mismatch)
 STATS_DEF("Persisted cache load error: option mismatch", perscache_options_mismatch)
@@ -674,6 +706,7 @@ STATS_DEF("Persisted cache stub pages touched", pcache_stub_touched)
 STATS_DEF("Waits due to sideline", num_wait_sideline)
 #endif
 STATS_DEF("Waits due to flushing", num_wait_flush)
+STATS_DEF("Flush epoch waits for linking threads", num_flush_epoch_drain_waits)
 STATS_DEF("Waits due to shared cache barrier", num_wait_shared_barrier)
 
 STATS_DEF("Entrance hooks to DR", num_entering_DR)
@@ -875,6 +908,16 @@ RSTATS_DEF("Current fcache units on live list", fcache_num_live)
 RSTATS_DEF("Peak fcache units on live list", peak_fcache_num_live)
 RSTATS_DEF("Current fcache units on free list", fcache_num_free)
 RSTATS_DEF("Peak fcache units on free list", peak_fcache_num_free)
+RSTATS_DEF("Current fcache shared bb free list (bytes)", fcache_shared_bb_free_list)
+RSTATS_DEF("Peak fcache shared bb free list (bytes)", peak_fcache_shared_bb_free_list)
+RSTATS_DEF("Current fcache shared trace free list (bytes)", fcache_shared_trace_free_list)
+RSTATS_DEF("Peak fcache shared trace free list (bytes)",
+           peak_fcache_shared_trace_free_list)
+RSTATS_DEF("Fcache shared empty units released", fcache_shared_units_released)
+STATS_DEF("Fcache shared empty units left to their pending flush",
+          fcache_shared_units_release_pending)
+STATS_DEF("Peak fcache shared fragmentation (% capacity free)",
+          fcache_shared_peak_fragmentation)
 STATS_DEF("Fcache unit lookups", fcache_unit_lookups)
 
 STATS_DEF("Separate shared trace direct exit stubs (bytes)",
@@ -912,6 +955,7 @@ RSTATS_DEF("Peak client raw mmap size", peak_client_raw_mmap_size)
 #endif
 RSTATS_DEF("Current stack capacity (bytes)", stack_capacity)
 RSTATS_DEF("Peak stack capacity (bytes)", peak_stack_capacity)
+STATS_DEF("Thread stacks reused from the stack pool", stacks_reused)
 STATS_DEF("Mmaps sharing stack alloc region", mmap_share_stack_region)
 STATS_DEF("Mmaps unable to share stack alloc region", mmap_no_share_stack_region)
 STATS_DEF("Mmap capacity (bytes)", mmap_capacity)
@@ -1122,6 +1166,7 @@ STATS_DEF("Num bytes nops removed for tracing", num_nop_bytes_removed)
 STATS_DEF("Num synch yields for exiting threads", synch_yields_for_exiting_thread)
 STATS_DEF("Num synch yields for uninit threads", synch_yields_for_uninit_thread)
 STATS_DEF("Num synch yields", synch_yields)
+STATS_DEF("Synchall suspend signals sent in parallel", synch_all_parallel_suspends)
 STATS_DEF("Num synch loops in wait_at_safe_spot", synch_loops_wait_safe)
 STATS_DEF("Multiple setcontexts while in wait_at_safe_spot", wait_multiple_setcxt)
 
@@ -51,6 +51,7 @@
 #include "instr.h"
 #include "perscache.h"
 #include "disassemble.h"
+#include "fragprof.h"
 
 #ifdef CLIENT_INTERFACE
 /* in interp.c.  not declared in arch_exports.h to avoid having to go
@@ -333,21 +334,13 @@ monitor_thread_init(dcontext_t *dcontext)
     memset(md, 0, sizeof(monitor_data_t));
     reset_trace_state(dcontext, false /* link lock not needed */);
 
-    /* case 7966: don't initialize un-needed things for hotp_only & thin_client
-     * FIXME: could set initial sizes to 0 for all configurations, instead
+    /* The trace head table is created lazily by thcounter_add(), like the
+     * thread-private caches in fcache_thread_init(): that skips it for
+     * hotp_only, thin_client, and -disable_traces (case 7966) and for the many
+     * short-lived threads that never reach a trace head.
      * FIXME: we can optimize even more to not allocate md at all, but would need
      * to have hotp_only checks in monitor_cache_exit(), etc.
      */
-    if (RUNNING_WITHOUT_CODE_CACHE() || DYNAMO_OPTION(disable_traces))
-        return;
-
-    md->thead_table = generic_hash_create(
-        dcontext, INIT_COUNTER_TABLE_SIZE, COUNTER_TABLE_LOAD,
-        /* persist the trace head counts for improved
-         * traces and trace-building efficiency
-         */
-        HASHTABLE_PERSISTENT, thcounter_free _IF_DEBUG("trace heads"));
-    md->thead_table->hash_func = HASH_FUNCTION_MULTIPLY_PHI;
 }
 
 /* atexit cleanup */
@@ -382,6 +375,8 @@ static trace_head_counter_t *
 thcounter_lookup(dcontext_t *dcontext, app_pc tag)
 {
     monitor_data_t *md = (monitor_data_t *)dcontext->monitor_field;
+    if (md->thead_table == NULL)
+        return NULL;
     return (trace_head_counter_t *)generic_hash_lookup(dcontext, md->thead_table,
                                                        (ptr_uint_t)tag);
 }
@@ -391,6 +386,16 @@ thcounter_add(dcontext_t *dcontext, app_pc tag)
 {
     monitor_data_t *md = (monitor_data_t *)dcontext->monitor_field;
     trace_head_counter_t *e = thcounter_lookup(dcontext, tag);
+    if (md->thead_table == NULL) {
+        ASSERT(!RUNNING_WITHOUT_CODE_CACHE() && !DYNAMO_OPTION(disable_traces));
+        md->thead_table = generic_hash_create(
+            dcontext, INIT_COUNTER_TABLE_SIZE, COUNTER_TABLE_LOAD,
+            /* persist the trace head counts for improved
+             * traces and trace-building efficiency
+             */
+            HASHTABLE_PERSISTENT, thcounter_free _IF_DEBUG("trace heads"));
+        md->thead_table->hash_func = HASH_FUNCTION_MULTIPLY_PHI;
+    }
     if (e == NULL) {
         e = COUNTER_ALLOC(dcontext,
                           sizeof(trace_head_counter_t) HEAPACCT(ACCT_THCOUNTER));
@@ -1215,6 +1220,13 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
     }
 #endif
 
+#if defined(X86) && defined(CLIENT_INTERFACE)
+    /* recreate_fragment_ilist() must do the same after mangling. */
+    if (DYNAMO_OPTION(opt_trace_spills) &&
+        optimize_trace_spills(dcontext, tag, trace, false /*!recreating*/) > 0)
+        externally_mangled = true;
+#endif
+
     if (INTERNAL_OPTION(cbr_single_stub) &&
         final_exit_shares_prev_stub(dcontext, trace, md->trace_flags)) {
         /* while building, we re-add shared stub since not sure if
@@ -1312,6 +1324,17 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
     }
 #endif /* INTERNAL */
 
+#if defined(X86) && defined(CLIENT_INTERFACE)
+    /* Space was already reserved in md->emitted_size.  recreate_fragment_ilist()
+     * must insert the counter at the same point.
+     */
+    if (fragprof_should_count(md->trace_flags)) {
+        ptr_uint_t *counter = fragprof_counter(dcontext, tag, true /*trace*/, true);
+        if (counter != NULL)
+            insert_frag_profile_counter(dcontext, trace, tag, counter);
+    }
+#endif
+
 #ifdef PROFILE_RDTSC
     if (dynamo_options.profile_times) {
         /* space was already reserved in buffer and in md->emitted_size */
@@ -1488,7 +1511,9 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
     /* with -pad_jmps not exact anymore, we should be able to figure out
      * by how much though FIXME */
     ASSERT_CURIOSITY(trace_f->size == md->emitted_size || externally_mangled ||
-                     PAD_FRAGMENT_JMPS(trace_f->flags));
+                     PAD_FRAGMENT_JMPS(trace_f->flags) ||
+                     /* the counter's reservation is its largest encoding */
+                     DYNAMO_OPTION(profile_frags));
     trace_tr = TRACE_FIELDS(trace_f);
     trace_tr->num_bbs = md->num_blks;
     trace_tr->bbs = (trace_bb_info_t *)nonpersistent_heap_alloc(
@@ -1505,6 +1530,7 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
         { IF_X86_64(if (FRAG_IS_32(trace_f->flags)) { STATS_INC(num_32bit_traces); }) });
     STATS_ADD(num_bbs_in_all_traces, md->num_blks);
     STATS_TRACK_MAX(max_bbs_in_a_trace, md->num_blks);
+    fragprof_trace_built(tag);
     DOLOG(2, LOG_MONITOR, {
         LOG(THREAD, LOG_MONITOR, 1, "Generated trace fragment #%d for tag " PFX "\n",
             GLOBAL_STAT(num_traces), tag);
@@ -2142,8 +2168,12 @@ monitor_cache_enter(dcontext_t *dcontext, fragment_t *f)
     /* Found a trace head, increment its counter */
     ctr = thcounter_lookup(dcontext, f->tag);
     /* May not have been added for this thread yet */
-    if (ctr == NULL)
+    if (ctr == NULL) {
         ctr = thcounter_add(dcontext, f->tag);
+        /* A seeded trace head was hot last run: build its trace on this entry. */
+        if (fragprof_is_trace_seed(f->tag))
+            ctr->counter = INTERNAL_OPTION(trace_threshold) - 1;
+    }
     ASSERT(ctr != NULL);
 
     if (ctr->counter == TH_COUNTER_CREATED_TRACE_VALUE()) {
@@ -2262,6 +2292,11 @@ monitor_cache_enter(dcontext_t *dcontext, fragment_t *f)
 #ifdef PROFILE_RDTSC
         if (dynamo_options.profile_times)
             md->emitted_size += profile_call_size();
+#endif
+#if defined(X86) && defined(CLIENT_INTERFACE)
+        /* The flags can still change, so reserve for any trace. */
+        if (DYNAMO_OPTION(profile_frags))
+            md->emitted_size += FRAG_PROFILE_COUNTER_MAX_SIZE;
 #endif
         LOG(THREAD, LOG_MONITOR, 2, "Found hot trace head F%d (tag " PFX ")\n", f->id,
             f->tag);
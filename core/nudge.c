@@ -54,7 +54,8 @@
 #ifdef CLIENT_INTERFACE
 #    include "instrument.h" /* for instrement_nudge() */
 #endif
-#include "fcache.h" /* for reset routines */
+#include "fcache.h"   /* for reset routines */
+#include "fragprof.h" /* for fragprof_dump() */
 
 #ifdef WINDOWS
 static void
@@ -378,6 +379,10 @@ handle_nudge(dcontext_t *dcontext, nudge_arg_t *arg)
         nudge_action_mask &= ~NUDGE_GENERIC(persist);
         coarse_units_freeze_all(false /*!in-place==persist*/);
     }
+    if (TEST(NUDGE_GENERIC(frag_profile), nudge_action_mask)) {
+        nudge_action_mask &= ~NUDGE_GENERIC(frag_profile);
+        fragprof_dump();
+    }
 #ifdef CLIENT_INTERFACE
     if (TEST(NUDGE_GENERIC(client), nudge_action_mask)) {
         nudge_action_mask &= ~NUDGE_GENERIC(client);
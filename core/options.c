@@ -1218,6 +1218,27 @@ check_option_compatibility_helper(int recurse_count)
     }
 #    endif
 
+#    if !defined(LINUX) || !defined(CLIENT_SIDELINE)
+    if (DYNAMO_OPTION(bb_prebuild_threads) > 0) {
+        USAGE_ERROR("-bb_prebuild_threads not supported in this build");
+        dynamo_options.bb_prebuild_threads = 0;
+        changed_options = true;
+    }
+#    endif
+    if (DYNAMO_OPTION(bb_prebuild_threads) > 0 && !DYNAMO_OPTION(shared_bbs)) {
+        USAGE_ERROR("-bb_prebuild_threads requires -shared_bbs");
+        dynamo_options.bb_prebuild_threads = 0;
+        changed_options = true;
+    }
+
+#    if !defined(X86) || !defined(CLIENT_INTERFACE)
+    if (DYNAMO_OPTION(profile_frags)) {
+        USAGE_ERROR("-profile_frags not supported in this build");
+        dynamo_options.profile_frags = false;
+        changed_options = true;
+    }
+#    endif
+
     /****************************************************************************
      * warn of unfinished and untested self-protection options
      * FIXME: update once these features are complete
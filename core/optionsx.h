@@ -230,6 +230,12 @@ OPTION(bool, syntax_att, "use AT&T disassembly syntax")
 OPTION(bool, syntax_arm, "use ARM disassembly syntax")
 /* whether to mark gray-area instrs as invalid when we know the length (i#1118) */
 OPTION(bool, decode_strict, "mark all known-invalid instructions as invalid")
+/* cache the x86 template chosen for each instruction shape */
+OPTION_DEFAULT(bool, encode_template_cache, true,
+               "cache encoding templates by opcode and operand shape")
+/* upper bound on each thread's IR arena under DR_IR_ALLOC_ARENA */
+OPTION_DEFAULT(uint_size, ir_arena_size, 256 * 1024,
+               "per-thread arena size for instr_t and operand allocation")
 OPTION(uint, disasm_mask, "disassembly style as a dr_disasm_flags_t bitmask")
 OPTION_INTERNAL(bool, bbdump_tags, "dump tags, sizes, and sharedness of all bbs")
 OPTION_INTERNAL(bool, gendump, "dump generated code")
@@ -334,6 +340,28 @@ OPTION_NAME(bool, profile_pcs, "prof_pcs", "pc-sampling profiling")
 /* XXX i#1114: enable by default when the implementation is complete */
 OPTION_DEFAULT(bool, opt_jit, false, "optimize translation of dynamically generated code")
 
+/* Each bb and trace increments an inline counter on entry.  The counts are written
+ * out sorted by hotness, keyed by module and offset, at exit and on a frag_profile
+ * nudge.  Only supported on x86.
+ */
+OPTION_DEFAULT(bool, profile_frags, false, "count fragment entries for a hotness report")
+/* The per-process log directory is used if this is empty. */
+OPTION_DEFAULT(pathstring_t, profile_frags_dir, EMPTY_STRING,
+               "directory for -profile_frags hotness reports")
+/* A -profile_frags report from a prior run: each of its traces marks the bb at
+ * the same module offset as a trace head with a hot counter, so the trace is
+ * built the first time the bb executes.  Pair with -profile_frags to write the
+ * profile for the next run.
+ */
+OPTION_DEFAULT(pathstring_t, trace_seed_file, EMPTY_STRING,
+               "seed trace heads from a -profile_frags report")
+/* After the client's trace event, removes client restore/save pairs of scratch
+ * registers and arithmetic flags at the seams between a trace's blocks when the
+ * restored values are dead.  Only supported on x86.
+ */
+OPTION_DEFAULT(bool, opt_trace_spills, false,
+               "remove redundant client spills and restores across trace blocks")
+
 #ifdef EXPOSE_INTERNAL_OPTIONS
 #    ifdef PROFILE_RDTSC
 OPTION_NAME_INTERNAL(bool, profile_times, "prof_times", "profiling via measuring time")
@@ -733,6 +761,14 @@ OPTION_DEFAULT(bool, avoid_dlclose, true, "Avoid calling dlclose from DynamoRIO.
 OPTION_DEFAULT(bool, intercept_all_signals, true, "intercept all signals")
 OPTION_DEFAULT(uint, max_pending_signals, 8,
                "maximum count of pending signals per thread")
+/* Delivers delayable signals that interrupt a fine-grained fragment right away
+ * when the interrupted state can be translated, instead of unlinking the fragment
+ * and delivering once the thread reaches d_r_dispatch.  This bounds the delivery
+ * latency for long traces and self-loops, but it requires that clients restore
+ * any state they changed in their restore state events (drreg does so).
+ */
+OPTION_DEFAULT(bool, signal_delivery_from_cache, false,
+               "deliver asynchronous signals at their interruption point in the cache")
 
 /* i#2080: we have had some problems using sigreturn to set a thread's
  * context to a given state.  Turning this off will instead use a direct
@@ -800,6 +836,8 @@ OPTION_DEFAULT(uint_size, stack_size,
                 */
                IF_CLIENT_INTERFACE_ELSE(24 * 1024, IF_X64_ELSE(20 * 1024, 12 * 1024)),
                "size of thread-private stacks, in KB")
+OPTION_DEFAULT(uint, stack_pool_size, 16,
+               "number of freed thread stacks kept for reuse by new threads")
 #ifdef UNIX
 /* signal_stack_size may be adjusted by adjust_defaults_for_page_size(). */
 OPTION_DEFAULT(uint_size, signal_stack_size,
@@ -894,6 +932,17 @@ OPTION_DEFAULT_INTERNAL(
 /* PR 361894: if no TLS available, we fall back to thread-private */
 PC_OPTION_DEFAULT(bool, shared_bbs, IF_HAVE_TLS_ELSE(true, false),
                   "use thread-shared basic blocks")
+/* Worker threads build the unlinked direct targets and the post-call fall-through
+ * of each new shared bb ahead of the app.  Requires -shared_bbs.  Only supported on
+ * Linux.
+ */
+OPTION_DEFAULT(uint, bb_prebuild_threads, 0,
+               "number of threads building predicted successor blocks")
+/* The workers get no thread init event, so with a client bb event present nothing
+ * is prebuilt unless the client says its bb event is safe to run on them.
+ */
+OPTION_DEFAULT(bool, bb_prebuild_client_safe, false,
+               "client bb events may run on -bb_prebuild_threads threads")
 /* Note that if we want traces off by default we would have to turn
  * off -shared_traces to avoid tripping over un-initialized ibl tables
  * PR 361894: if no TLS available, we fall back to thread-private
@@ -953,6 +1002,13 @@ OPTION_DEFAULT(bool, remove_trace_components, false, "remove bb components of ne
 OPTION_DEFAULT(bool, shared_deletion, true, "enable shared fragment deletion")
 OPTION_DEFAULT(bool, syscalls_synch_flush, true,
                "syscalls are flush synch points (currently for shared_deletion only)")
+/* The flusher waits for all could-be-linking threads at once and the final
+ * flush stage releases waiting threads with a single broadcast, in place of a
+ * handshake with each thread in turn.  The cost is an atomic update of a shared
+ * counter on every could-be-linking transition.
+ */
+OPTION_DEFAULT(bool, flush_epoch, false,
+               "synch flushes with a global linking epoch rather than per-thread")
 OPTION_DEFAULT(uint, lazy_deletion_max_pending, 128,
                "maximum size of lazy shared deletion list before moving to normal list")
 
@@ -1395,6 +1451,10 @@ OPTION_DEFAULT(bool, finite_shared_trace_cache, false,
                "adaptive working set shared trace cache management")
 OPTION_DEFAULT(bool, finite_coarse_bb_cache, false,
                "adaptive working set shared bb cache management")
+OPTION_DEFAULT(uint, cache_shared_clock_sample, 64,
+               "with -finite_shared_{bb,trace}_cache, sample every nth cache entry to "
+               "mark shared units as recently executed so eviction skips them "
+               "(0 always evicts the oldest unit)")
 OPTION_DEFAULT(uint_size, cache_bb_unit_upgrade, (64 * 1024),
                "bb cache units are always upgraded to this size, in KB or MB")
 /* default size is in Kilobytes, Examples: 4, 4k, 4m, or 0 for unlimited */
@@ -1470,6 +1530,8 @@ OPTION_COMMAND(bool, sandbox_non_text, false, "sandbox_non_text",
 /* FIXME: separate for bb and trace shared caches? */
 OPTION_DEFAULT(bool, cache_shared_free_list, true,
                "use size-separated free lists to manage empty shared cache slots")
+OPTION_DEFAULT(bool, cache_shared_release_empty_units, true,
+               "return shared cache units holding only free slots to the dead unit list")
 
 /* FIXME i#1674: enable on ARM once bugs are fixed, along with all the
  * reset_* trigger options as well.
@@ -1753,6 +1815,10 @@ OPTION_DEFAULT(bool, synch_thread_sleep_MP, true,
 OPTION_DEFAULT(uint_time, synch_with_sleep_time, 5,
                "time in ms to sleep for each "
                "wait loop in synch_with_* routines")
+#ifdef UNIX
+OPTION_DEFAULT(bool, synch_all_parallel_suspend, true,
+               "in synch_with_all_threads, signal all threads before waiting for any")
+#endif
 #ifdef WINDOWS
 /* FIXME - only an option since late in the release cycle - should always be on */
 OPTION_DEFAULT(
@@ -2317,6 +2383,11 @@ OPTION_DEFAULT_INTERNAL(bool, safe_translate_flushed, false,
                         "store info at flush time for safe post-flush translation")
 PC_OPTION_INTERNAL(bool, store_translations,
                    "store info at emit time for fragment translation")
+/* Bounds the tables kept for fragments translated more than once, such as those
+ * with app faults.  0 disables the cache.
+ */
+OPTION_DEFAULT(uint_size, translation_cache_size, 128 * 1024,
+               "bytes of fault translation tables to cache for reuse")
 /* i#698: our fpu state xl8 is a perf hit for some apps */
 PC_OPTION(bool, translate_fpu_pc,
           "translate the saved last floating-point pc when FPU state is saved")
@@ -2315,6 +2315,17 @@ get_persist_filename(char *filename /*OUT*/, uint filename_max /* max #chars */,
     /* should we go to a 64-bit hash? */
     IF_X64(ASSERT(CHECK_TRUNCATE_TYPE_uint(size)));
     hash = checksum ^ timestamp ^ (uint)size;
+    /* On Linux file_version holds the build-id hash.  Including it and the client
+     * instrumentation version lets files for different builds or different
+     * instrumentation coexist rather than clobbering each other.
+     */
+    hash ^= (uint)file_version ^ (uint)(file_version >> 32);
+#ifdef CLIENT_INTERFACE
+    {
+        uint64 client_version = instrument_persist_version();
+        hash ^= (uint)client_version ^ (uint)(client_version >> 32);
+    }
+#endif
     /* case 9799: make options part of namespace */
     if (option_string != NULL) {
         uint i;
@@ -2962,6 +2973,7 @@ coarse_unit_set_persist_data(dcontext_t *dcontext, coarse_info_t *info,
     pers->start_offs = info->base_pc - modbase;
     pers->end_offs = info->end_pc - modbase;
     pers->tls_offs_base = os_tls_offset(0);
+    pers->instrument_version = IF_CLIENT_INTERFACE_ELSE(instrument_persist_version(), 0);
 
     /* We need to go in forward order so we can tell the client the current offset */
     x_offs += pers->header_len;
@@ -3585,6 +3597,17 @@ persist_check_option_compat(dcontext_t *dcontext, coarse_persisted_info_t *pers,
         return false;
     }
 
+    if (IF_CLIENT_INTERFACE_ELSE(instrument_persist_version(), 0) !=
+        pers->instrument_version) {
+        LOG(THREAD, LOG_CACHE, 1,
+            "  client version mismatch " UINT64_FORMAT_STRING
+            " vs persisted " UINT64_FORMAT_STRING "\n",
+            IF_CLIENT_INTERFACE_ELSE(instrument_persist_version(), 0),
+            pers->instrument_version);
+        STATS_INC(perscache_instrument_mismatch);
+        return false;
+    }
+
     if (!TEST(PERSCACHE_SUPPORT_TRACES, pers->flags) && !DYNAMO_OPTION(disable_traces)) {
         /* We bail out; the consequences of continuing are huge performance
          * problems akin to -no_link_ibl.
@@ -316,7 +316,7 @@ coarse_unit_merge(dcontext_t *dcontext, coarse_info_t *info1, coarse_info_t *inf
 
 enum {
     PERSISTENT_CACHE_MAGIC = 0x244f4952, /* RIO$ */
-    PERSISTENT_CACHE_VERSION = 10,
+    PERSISTENT_CACHE_VERSION = 11,
 };
 
 /* Global flags we need to process if present in a persisted cache */
@@ -466,6 +466,11 @@ typedef struct _coarse_persisted_info_t {
     /* We require a match here; alternative is to put all uses in relocs */
     uint tls_offs_base; /* could be ushort */
 
+    /* Combined client instrumentation version (dr_set_persist_version()):
+     * we require a match so stale instrumentation is never reused.
+     */
+    uint64 instrument_version;
+
     /* Now we store the lengths of each data section, in reverse
      * order, to allow for expansion */
 
@@ -934,11 +934,14 @@ synch_with_thread(thread_id_t id, bool block, bool hold_initexit_lock,
     thread_synch_result_t res = THREAD_SYNCH_RESULT_NOT_SAFE;
     bool first_loop = true;
     IF_UNIX(bool actually_suspended = true;)
+    IF_UNIX(bool suspend_started = TEST(THREAD_SYNCH_SUSPEND_STARTED, flags);)
     const uint max_loops = TEST(THREAD_SYNCH_SMALL_LOOP_MAX, flags)
         ? (SYNCH_MAXIMUM_LOOPS / 10)
         : SYNCH_MAXIMUM_LOOPS;
 
     ASSERT(id != my_id);
+    /* The pre-sent signal can only be consumed once. */
+    IF_UNIX(ASSERT(!block || !suspend_started));
     /* Must set ABORT or IGNORE.  Only caller can RETRY as need a new
      * set of threads for that, hoping problematic one is short-lived.
      */
@@ -1009,7 +1012,12 @@ synch_with_thread(thread_id_t id, bool block, bool hold_initexit_lock,
                 adjust_wait_at_safe_spot(trec->dcontext, 1);
                 first_loop = false;
             }
-            if (!os_thread_suspend(trec)) {
+#ifdef UNIX
+            /* synch_with_all_threads() may have already sent the signal. */
+            if (suspend_started)
+                os_thread_suspend_finish(trec);
+#endif
+            if (!(IF_UNIX(suspend_started ||) os_thread_suspend(trec))) {
                 /* FIXME : eventually should be a real assert once we figure out
                  * how to handle threads with low privilege handles */
                 /* For dr_api_exit, we may have missed a thread exit. */
@@ -1151,6 +1159,59 @@ exit_synch_with_thread:
     return res;
 }
 
+/* synch_with_all_threads() keeps one of these for each thread */
+enum {
+    SYNCH_WITH_ALL_NEW = 0,
+    SYNCH_WITH_ALL_NOTIFIED = 1,
+    SYNCH_WITH_ALL_SYNCHED = 2,
+    /* Notified, and the suspend signal was sent in this pass but not yet waited
+     * for.  Only used with -synch_all_parallel_suspend.
+     */
+    SYNCH_WITH_ALL_SIGNALED = 3,
+};
+
+/* Records the result of synch_with_thread() for one target of
+ * synch_with_all_threads() in *synch_state.  Returns false if the caller
+ * should abort.
+ */
+static bool
+synch_with_all_record_result(dcontext_t *dcontext, thread_record_t *tr,
+                             thread_synch_result_t synch_res,
+                             thread_synch_state_t desired_synch_state, uint flags,
+                             uint *synch_state INOUT, bool *all_synched INOUT)
+{
+    if (synch_res == THREAD_SYNCH_RESULT_SUCCESS) {
+        LOG(THREAD, LOG_SYNCH, 2, "Synch succeeded!\n");
+        /* successful synch */
+        *synch_state = SYNCH_WITH_ALL_SYNCHED;
+        /* tr is freed if cleaned */
+        if (!THREAD_SYNCH_IS_CLEANED(desired_synch_state))
+            adjust_wait_at_safe_spot(tr->dcontext, -1);
+    } else {
+        LOG(THREAD, LOG_SYNCH, 2, "Synch failed!\n");
+        *all_synched = false;
+        if (synch_res == THREAD_SYNCH_RESULT_SUSPEND_FAILURE) {
+            if (TEST(THREAD_SYNCH_SUSPEND_FAILURE_ABORT, flags))
+                return false;
+        } else
+            ASSERT(synch_res == THREAD_SYNCH_RESULT_NOT_SAFE);
+    }
+    return true;
+}
+
+#ifdef UNIX
+/* Whether synch_with_all_threads() suspends tr in its parallel phase.  Client
+ * threads must wait until all others are synched, and vfork threads that
+ * called execve are not signaled, so both stay with the serial loop.
+ */
+static bool
+synch_with_all_in_parallel(thread_record_t *tr)
+{
+    return DYNAMO_OPTION(synch_all_parallel_suspend) &&
+        !tr->execve IF_CLIENT_INTERFACE(&& !IS_CLIENT_THREAD(tr->dcontext));
+}
+#endif
+
 /* desired_synch_state - a requested state define from above that describes
  *                        the synchronization required
  * threads, num_threads - must not be NULL, if !THREAD_SYNCH_IS_CLEANED(desired
@@ -1190,11 +1251,6 @@ synch_with_all_threads(thread_synch_state_t desired_synch_state,
     int num_threads_temp = 0, i, j, expect_self_exiting = 0;
     /* synch array contains a SYNCH_WITH_ALL_ value for each thread */
     uint *synch_array = NULL, *synch_array_temp = NULL;
-    enum {
-        SYNCH_WITH_ALL_NEW = 0,
-        SYNCH_WITH_ALL_NOTIFIED = 1,
-        SYNCH_WITH_ALL_SYNCHED = 2,
-    };
     bool all_synched = false;
     thread_id_t my_id = d_r_get_thread_id();
     uint loop_count = 0;
@@ -1383,9 +1439,69 @@ synch_with_all_threads(thread_synch_state_t desired_synch_state,
         num_threads_temp = num_threads;
         synch_array_temp = synch_array;
 
+#ifdef UNIX
+        if (DYNAMO_OPTION(synch_all_parallel_suspend)) {
+            /* Send every suspend signal before waiting for any target, so that
+             * the targets' round trips overlap rather than add up.  We then
+             * examine targets in the order they reach the suspend point: a
+             * target can be held up on a lock owned by one suspended at an
+             * unsafe spot, which synch_with_thread() resumes.
+             */
+            uint num_signaled = 0;
+            for (i = 0; i < num_threads; i++) {
+                if (synch_array[i] == SYNCH_WITH_ALL_SYNCHED || threads[i]->id == my_id ||
+                    !synch_with_all_in_parallel(threads[i]))
+                    continue;
+                if (synch_array[i] == SYNCH_WITH_ALL_NEW)
+                    adjust_wait_at_safe_spot(threads[i]->dcontext, 1);
+                if (os_thread_suspend_start(threads[i])) {
+                    synch_array[i] = SYNCH_WITH_ALL_SIGNALED;
+                    num_signaled++;
+                } else {
+                    /* synch_with_thread() retries and reports the failure */
+                    synch_array[i] = SYNCH_WITH_ALL_NOTIFIED;
+                    synch_res =
+                        synch_with_thread(threads[i]->id, false, true, THREAD_SYNCH_NONE,
+                                          desired_synch_state, flags_one);
+                    if (!synch_with_all_record_result(dcontext, threads[i], synch_res,
+                                                      desired_synch_state, flags,
+                                                      &synch_array[i], &all_synched))
+                        goto synch_with_all_abort;
+                }
+            }
+            STATS_ADD(synch_all_parallel_suspends, num_signaled);
+            while (num_signaled > 0) {
+                bool progress = false;
+                for (i = 0; i < num_threads; i++) {
+                    if (synch_array[i] != SYNCH_WITH_ALL_SIGNALED ||
+                        !os_thread_suspend_ready(threads[i]))
+                        continue;
+                    progress = true;
+                    num_signaled--;
+                    synch_array[i] = SYNCH_WITH_ALL_NOTIFIED;
+                    LOG(THREAD, LOG_SYNCH, 2,
+                        "About to try synch with signaled thread #%d/%d " TIDFMT "\n", i,
+                        num_threads, threads[i]->id);
+                    synch_res = synch_with_thread(
+                        threads[i]->id, false, true, THREAD_SYNCH_NONE,
+                        desired_synch_state, flags_one | THREAD_SYNCH_SUSPEND_STARTED);
+                    if (!synch_with_all_record_result(dcontext, threads[i], synch_res,
+                                                      desired_synch_state, flags,
+                                                      &synch_array[i], &all_synched))
+                        goto synch_with_all_abort;
+                }
+                if (!progress)
+                    os_thread_yield();
+            }
+        }
+#endif
         for (i = 0; i < num_threads; i++) {
             /* do not de-ref threads[i] after synching if it was cleaned up! */
             if (synch_array[i] != SYNCH_WITH_ALL_SYNCHED && threads[i]->id != my_id) {
+#ifdef UNIX
+                if (synch_with_all_in_parallel(threads[i]))
+                    continue; /* already tried in this pass */
+#endif
 #ifdef CLIENT_INTERFACE
                 if (!finished_non_client_threads &&
                     IS_CLIENT_THREAD(threads[i]->dcontext)) {
@@ -1425,21 +1541,10 @@ synch_with_all_threads(thread_synch_state_t desired_synch_state,
                 synch_res =
                     synch_with_thread(threads[i]->id, false, true, THREAD_SYNCH_NONE,
                                       desired_synch_state, flags_one);
-                if (synch_res == THREAD_SYNCH_RESULT_SUCCESS) {
-                    LOG(THREAD, LOG_SYNCH, 2, "Synch succeeded!\n");
-                    /* successful synch */
-                    synch_array[i] = SYNCH_WITH_ALL_SYNCHED;
-                    if (!THREAD_SYNCH_IS_CLEANED(desired_synch_state))
-                        adjust_wait_at_safe_spot(threads[i]->dcontext, -1);
-                } else {
-                    LOG(THREAD, LOG_SYNCH, 2, "Synch failed!\n");
-                    all_synched = false;
-                    if (synch_res == THREAD_SYNCH_RESULT_SUSPEND_FAILURE) {
-                        if (TEST(THREAD_SYNCH_SUSPEND_FAILURE_ABORT, flags))
-                            goto synch_with_all_abort;
-                    } else
-                        ASSERT(synch_res == THREAD_SYNCH_RESULT_NOT_SAFE);
-                }
+                if (!synch_with_all_record_result(dcontext, threads[i], synch_res,
+                                                  desired_synch_state, flags,
+                                                  &synch_array[i], &all_synched))
+                    goto synch_with_all_abort;
             } else {
                 LOG(THREAD, LOG_SYNCH, 2, "Skipping synch with thread " TIDFMT "\n",
                     thread_ids_temp[i]);
@@ -1574,6 +1679,16 @@ synch_with_all_abort:
             } else if (synch_array[i] == SYNCH_WITH_ALL_NOTIFIED) {
                 adjust_wait_at_safe_spot(threads[i]->dcontext, -1);
             }
+#ifdef UNIX
+            else if (synch_array[i] == SYNCH_WITH_ALL_SIGNALED) {
+                os_thread_suspend_finish(threads[i]);
+                DEBUG_DECLARE(ok =)
+                os_thread_resume(threads[i]);
+                ASSERT(ok);
+                adjust_wait_at_safe_spot(threads[i]->dcontext, -1);
+                synch_array[i] = SYNCH_WITH_ALL_NEW;
+            }
+#endif
         }
     }
     d_r_mutex_unlock(&thread_initexit_lock);
@@ -117,6 +117,11 @@ enum {
 
     /* specifies whether we should terminate client threads */
     THREAD_SYNCH_SKIP_CLIENT_THREAD = 0x00000010,
+
+    /* For synch_with_all_threads() internal use: the caller already called
+     * os_thread_suspend_start() on the target and it has reached the suspend point.
+     */
+    THREAD_SYNCH_SUSPEND_STARTED = 0x00000020,
 };
 
 /* convenience macros */
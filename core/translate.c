@@ -197,6 +197,31 @@ instr_is_mov_PC_immed(dcontext_t *dcontext, instr_t *inst)
 #endif
 
 #ifdef X86
+static bool
+instr_is_frag_profile_counter(dcontext_t *dcontext, instr_t *inst)
+{
+    /* This won't fault but we don't want it marked as unsupported. */
+    opnd_t reg, mem;
+    if (!instr_is_our_mangling(inst))
+        return false;
+    /* XXX: Keep this consistent with insert_frag_profile_counter() in mangle.c. */
+    if (instr_get_opcode(inst) == OP_lea) {
+        mem = instr_get_src(inst, 0);
+        return (opnd_get_reg(instr_get_dst(inst, 0)) == REG_XAX &&
+                opnd_get_base(mem) == REG_XAX && opnd_get_index(mem) == REG_NULL &&
+                opnd_get_disp(mem) == 1);
+    }
+    if (instr_get_opcode(inst) == OP_mov_ld) {
+        reg = instr_get_dst(inst, 0);
+        mem = instr_get_src(inst, 0);
+    } else if (instr_get_opcode(inst) == OP_mov_st) {
+        reg = instr_get_src(inst, 0);
+        mem = instr_get_dst(inst, 0);
+    } else
+        return false;
+    return (opnd_is_reg(reg) && opnd_get_reg(reg) == REG_XAX &&
+            (opnd_is_abs_addr(mem) IF_X64(|| opnd_is_rel_addr(mem))));
+}
 
 /* FIXME i#3329: add support for ARM/AArch64. */
 
@@ -423,6 +448,11 @@ translate_walk_track(dcontext_t *tdcontext, instr_t *inst, translate_walk_t *wal
             /* nothing to do */
         }
 #endif
+#ifdef X86
+        else if (instr_is_frag_profile_counter(tdcontext, inst)) {
+            /* nothing to do */
+        }
+#endif
 #ifdef ARM
         else if (instr_is_mov_PC_immed(tdcontext, inst)) {
             /* nothing to do */
@@ -1052,6 +1082,378 @@ recreate_selfmod_ilist(dcontext_t *dcontext, fragment_t *f)
     return ilist;
 }
 
+/***************************************************************************
+ * TRANSLATION CACHE
+ *
+ * Re-building a fragment's ilist costs a full decode, client instrumentation
+ * pass, and mangling of the source block, which apps that use faults for
+ * control flow (null checks, guard pages, GC barriers) pay on every fault.
+ * Rather than storing a table for every fragment at emit time, which would
+ * cost memory and emit time for the vast majority of fragments that never
+ * fault, we record a compact table for a fragment the first time it is
+ * translated and reuse it for later translations.  The cache is bounded by
+ * -translation_cache_size bytes and evicts in LRU order.
+ *
+ * Each table is a sequence of delta-encoded translation entries: an unsigned
+ * LEB128 value holding the cache offset delta shifted left by 3, the
+ * TRANSLATE_ flags in the low 2 bits, and XL8_CACHE_NULL_APP in bit 2;
+ * followed, for a non-NULL app pc, by a signed (zigzag) LEB128 delta from the
+ * previous non-NULL app pc, which starts at the fragment tag.  A typical bb
+ * takes around 5 bytes versus 40 for a translation_info_t.
+ *
+ * Entries are keyed by fragment_t and removed in fragment_free(), before the
+ * fragment_t can be reused.
+ */
+
+/* Larger tables (long traces) are not cached, so we can decode into a
+ * fixed-size buffer on the stack, which can be the signal stack.
+ */
+#define XL8_CACHE_MAX_ENTRIES 64
+/* Worst case: a 3-byte offset/flags value plus a 10-byte app delta. */
+#define XL8_CACHE_MAX_ENCODED (XL8_CACHE_MAX_ENTRIES * 13)
+#define XL8_CACHE_NULL_APP 0x4
+#define XL8_CACHE_FLAGS_MASK (TRANSLATE_IDENTICAL | TRANSLATE_OUR_MANGLING)
+#define XL8_CACHE_HASH_BITS 10
+#define XL8_CACHE_HASH_SIZE (1U << XL8_CACHE_HASH_BITS)
+
+typedef struct _xl8_cache_entry_t {
+    fragment_t *f;
+    /* Sanity checks against a stale entry. */
+    app_pc tag;
+    ushort frag_size;
+    ushort num_entries;
+    uint encoded_size;
+    struct _xl8_cache_entry_t *hash_next;
+    struct _xl8_cache_entry_t *lru_prev; /* toward most-recently-used */
+    struct _xl8_cache_entry_t *lru_next; /* toward least-recently-used */
+    byte encoded[1];                     /* variable-sized */
+} xl8_cache_entry_t;
+
+/* Layout-compatible with translation_info_t. */
+typedef struct _xl8_cache_info_t {
+    uint num_entries;
+    translation_entry_t translation[XL8_CACHE_MAX_ENTRIES];
+} xl8_cache_info_t;
+
+/* All fields are protected by xl8_cache_lock, except that xl8_cache_count is
+ * read without it as a fast-path check in translation_cache_remove().
+ */
+DECLARE_CXTSWPROT_VAR(static mutex_t xl8_cache_lock, INIT_LOCK_FREE(xl8_cache_lock));
+DECLARE_CXTSWPROT_VAR(static xl8_cache_entry_t **xl8_cache_table, NULL);
+DECLARE_CXTSWPROT_VAR(static xl8_cache_entry_t *xl8_cache_mru, NULL);
+DECLARE_CXTSWPROT_VAR(static xl8_cache_entry_t *xl8_cache_lru, NULL);
+DECLARE_CXTSWPROT_VAR(static size_t xl8_cache_bytes, 0);
+DECLARE_CXTSWPROT_VAR(static volatile uint xl8_cache_count, 0);
+
+static inline size_t
+xl8_cache_entry_size(uint encoded_size)
+{
+    return sizeof(xl8_cache_entry_t) - 1 + encoded_size;
+}
+
+static inline uint
+xl8_cache_hash(fragment_t *f)
+{
+    ptr_uint_t key = (ptr_uint_t)f >> 4;
+    return (uint)((key ^ (key >> XL8_CACHE_HASH_BITS)) & (XL8_CACHE_HASH_SIZE - 1));
+}
+
+static byte *
+xl8_cache_encode_uleb(byte *pc, ptr_uint_t val)
+{
+    do {
+        byte b = (byte)(val & 0x7f);
+        val >>= 7;
+        if (val != 0)
+            b |= 0x80;
+        *pc++ = b;
+    } while (val != 0);
+    return pc;
+}
+
+static const byte *
+xl8_cache_decode_uleb(const byte *pc, ptr_uint_t *val OUT)
+{
+    ptr_uint_t res = 0;
+    uint shift = 0;
+    byte b;
+    do {
+        b = *pc++;
+        res |= ((ptr_uint_t)(b & 0x7f)) << shift;
+        shift += 7;
+    } while (TEST(0x80, b));
+    *val = res;
+    return pc;
+}
+
+/* Returns the encoded size, or 0 if info is too large to cache. */
+static uint
+xl8_cache_encode(const translation_info_t *info, app_pc tag, byte *buf)
+{
+    byte *pc = buf;
+    uint i;
+    ushort prev_offs = 0;
+    app_pc prev_app = tag;
+    if (info->num_entries > XL8_CACHE_MAX_ENTRIES)
+        return 0;
+    for (i = 0; i < info->num_entries; i++) {
+        const translation_entry_t *e = &info->translation[i];
+        ptr_uint_t head;
+        ASSERT(e->cache_offs >= prev_offs);
+        head = ((ptr_uint_t)(e->cache_offs - prev_offs) << 3) |
+            (e->flags & XL8_CACHE_FLAGS_MASK) | (e->app == NULL ? XL8_CACHE_NULL_APP : 0);
+        pc = xl8_cache_encode_uleb(pc, head);
+        if (e->app != NULL) {
+            ptr_int_t delta = e->app - prev_app;
+            /* zigzag so small negative deltas stay small */
+            ptr_uint_t zz = ((ptr_uint_t)delta << 1) ^
+                (ptr_uint_t)(delta >> (8 * sizeof(delta) - 1));
+            pc = xl8_cache_encode_uleb(pc, zz);
+            prev_app = e->app;
+        }
+        prev_offs = e->cache_offs;
+    }
+    ASSERT(pc - buf <= XL8_CACHE_MAX_ENCODED);
+    return (uint)(pc - buf);
+}
+
+static void
+xl8_cache_decode(const xl8_cache_entry_t *entry, xl8_cache_info_t *info OUT)
+{
+    const byte *pc = entry->encoded;
+    uint i;
+    ushort offs = 0;
+    app_pc app = entry->tag;
+    ASSERT(entry->num_entries <= XL8_CACHE_MAX_ENTRIES);
+    for (i = 0; i < entry->num_entries; i++) {
+        ptr_uint_t head, zz;
+        pc = xl8_cache_decode_uleb(pc, &head);
+        offs += (ushort)(head >> 3);
+        info->translation[i].cache_offs = offs;
+        info->translation[i].flags = (ushort)(head & XL8_CACHE_FLAGS_MASK);
+        if (TEST(XL8_CACHE_NULL_APP, head))
+            info->translation[i].app = NULL;
+        else {
+            pc = xl8_cache_decode_uleb(pc, &zz);
+            app += (ptr_int_t)(zz >> 1) ^ -(ptr_int_t)(zz & 1);
+            info->translation[i].app = app;
+        }
+    }
+    ASSERT(pc == entry->encoded + entry->encoded_size);
+    info->num_entries = entry->num_entries;
+}
+
+/* Caller must hold xl8_cache_lock. */
+static void
+xl8_cache_lru_unlink(xl8_cache_entry_t *entry)
+{
+    ASSERT_OWN_MUTEX(true, &xl8_cache_lock);
+    if (entry->lru_prev != NULL)
+        entry->lru_prev->lru_next = entry->lru_next;
+    else
+        xl8_cache_mru = entry->lru_next;
+    if (entry->lru_next != NULL)
+        entry->lru_next->lru_prev = entry->lru_prev;
+    else
+        xl8_cache_lru = entry->lru_prev;
+}
+
+/* Caller must hold xl8_cache_lock. */
+static void
+xl8_cache_lru_push(xl8_cache_entry_t *entry)
+{
+    ASSERT_OWN_MUTEX(true, &xl8_cache_lock);
+    entry->lru_prev = NULL;
+    entry->lru_next = xl8_cache_mru;
+    if (xl8_cache_mru != NULL)
+        xl8_cache_mru->lru_prev = entry;
+    xl8_cache_mru = entry;
+    if (xl8_cache_lru == NULL)
+        xl8_cache_lru = entry;
+}
+
+/* Unlinks entry from the hashtable and the LRU list, but does not free it, so
+ * that callers can free outside of the lock.  Caller must hold xl8_cache_lock.
+ */
+static void
+xl8_cache_unlink(xl8_cache_entry_t *entry)
+{
+    xl8_cache_entry_t **prev_next = &xl8_cache_table[xl8_cache_hash(entry->f)];
+    ASSERT_OWN_MUTEX(true, &xl8_cache_lock);
+    while (*prev_next != entry) {
+        ASSERT(*prev_next != NULL);
+        prev_next = &(*prev_next)->hash_next;
+    }
+    *prev_next = entry->hash_next;
+    xl8_cache_lru_unlink(entry);
+    xl8_cache_bytes -= xl8_cache_entry_size(entry->encoded_size);
+    xl8_cache_count--;
+}
+
+static void
+xl8_cache_entry_free(xl8_cache_entry_t *entry)
+{
+    global_heap_free(entry,
+                     xl8_cache_entry_size(entry->encoded_size) HEAPACCT(ACCT_OTHER));
+}
+
+void
+translation_cache_init(void)
+{
+    if (DYNAMO_OPTION(translation_cache_size) == 0)
+        return;
+    xl8_cache_table = HEAP_ARRAY_ALLOC(GLOBAL_DCONTEXT, xl8_cache_entry_t *,
+                                       XL8_CACHE_HASH_SIZE, ACCT_OTHER, PROTECTED);
+    memset(xl8_cache_table, 0, XL8_CACHE_HASH_SIZE * sizeof(xl8_cache_entry_t *));
+}
+
+void
+translation_cache_exit(void)
+{
+    if (xl8_cache_table != NULL) {
+        while (xl8_cache_mru != NULL) {
+            xl8_cache_entry_t *entry = xl8_cache_mru;
+            d_r_mutex_lock(&xl8_cache_lock);
+            xl8_cache_unlink(entry);
+            d_r_mutex_unlock(&xl8_cache_lock);
+            xl8_cache_entry_free(entry);
+        }
+        ASSERT(xl8_cache_count == 0 && xl8_cache_bytes == 0);
+        HEAP_ARRAY_FREE(GLOBAL_DCONTEXT, xl8_cache_table, xl8_cache_entry_t *,
+                        XL8_CACHE_HASH_SIZE, ACCT_OTHER, PROTECTED);
+        xl8_cache_table = NULL;
+    }
+    DELETE_LOCK(xl8_cache_lock);
+}
+
+static inline bool
+xl8_cache_applies(fragment_t *f)
+{
+    /* Self-modifying fragments are translated from a copy of the app code with
+     * special rep-string handling, and coarse-grain fragments are not kept in
+     * individual fragment_t structs, so we leave both to the ilist path.
+     */
+    return xl8_cache_table != NULL && FRAGMENT_TRANSLATION_INFO(f) == NULL &&
+        !TESTANY(FRAG_SELFMOD_SANDBOXED | FRAG_COARSE_GRAIN | FRAG_FAKE, f->flags);
+}
+
+/* Fills in info with f's cached table and returns true, if there is one. */
+static bool
+translation_cache_lookup(fragment_t *f, xl8_cache_info_t *info OUT)
+{
+    xl8_cache_entry_t *entry;
+    bool found = false;
+    if (!xl8_cache_applies(f))
+        return false;
+    d_r_mutex_lock(&xl8_cache_lock);
+    for (entry = xl8_cache_table[xl8_cache_hash(f)]; entry != NULL;
+         entry = entry->hash_next) {
+        if (entry->f == f) {
+            ASSERT(entry->tag == f->tag && entry->frag_size == f->size);
+            if (entry->tag == f->tag && entry->frag_size == f->size) {
+                xl8_cache_decode(entry, info);
+                if (entry != xl8_cache_mru) {
+                    xl8_cache_lru_unlink(entry);
+                    xl8_cache_lru_push(entry);
+                }
+                found = true;
+            }
+            break;
+        }
+    }
+    d_r_mutex_unlock(&xl8_cache_lock);
+    return found;
+}
+
+/* Records a table for f from its just-recreated ilist. */
+static void
+translation_cache_add(dcontext_t *tdcontext, fragment_t *f, instrlist_t *ilist)
+{
+    byte buf[XL8_CACHE_MAX_ENCODED];
+    translation_info_t *info;
+    xl8_cache_entry_t *entry, *e, *evicted = NULL;
+    uint encoded_size, num_entries;
+    size_t alloc_size;
+    /* Fragments whose app code may already be gone get a table at flush time
+     * when that is needed, so we do not record from a possibly-stale ilist.
+     */
+    if (!xl8_cache_applies(f) || TEST(FRAG_WAS_DELETED, f->flags))
+        return;
+    info = record_translation_info(tdcontext, f, ilist);
+    num_entries = info->num_entries;
+    encoded_size = xl8_cache_encode(info, f->tag, buf);
+    translation_info_free(tdcontext, info);
+    alloc_size = xl8_cache_entry_size(encoded_size);
+    if (encoded_size == 0 || alloc_size > DYNAMO_OPTION(translation_cache_size))
+        return;
+    entry = global_heap_alloc(alloc_size HEAPACCT(ACCT_OTHER));
+    entry->f = f;
+    entry->tag = f->tag;
+    entry->frag_size = f->size;
+    entry->num_entries = (ushort)num_entries;
+    entry->encoded_size = encoded_size;
+    memcpy(entry->encoded, buf, encoded_size);
+
+    d_r_mutex_lock(&xl8_cache_lock);
+    for (e = xl8_cache_table[xl8_cache_hash(f)]; e != NULL; e = e->hash_next) {
+        if (e->f == f)
+            break;
+    }
+    if (e != NULL) {
+        /* Another thread translating the same fragment beat us to it. */
+        d_r_mutex_unlock(&xl8_cache_lock);
+        xl8_cache_entry_free(entry);
+        return;
+    }
+    while (xl8_cache_bytes + alloc_size > DYNAMO_OPTION(translation_cache_size)) {
+        e = xl8_cache_lru;
+        ASSERT(e != NULL);
+        xl8_cache_unlink(e);
+        /* Chain through hash_next to free once we drop the lock. */
+        e->hash_next = evicted;
+        evicted = e;
+        STATS_INC(translation_cache_evictions);
+    }
+    entry->hash_next = xl8_cache_table[xl8_cache_hash(f)];
+    xl8_cache_table[xl8_cache_hash(f)] = entry;
+    xl8_cache_lru_push(entry);
+    xl8_cache_bytes += alloc_size;
+    xl8_cache_count++;
+    d_r_mutex_unlock(&xl8_cache_lock);
+    STATS_INC(translation_cache_entries);
+
+    while (evicted != NULL) {
+        e = evicted;
+        evicted = e->hash_next;
+        xl8_cache_entry_free(e);
+    }
+}
+
+/* Called when f is freed, so that a later fragment_t at the same address does
+ * not pick up f's table.
+ */
+void
+translation_cache_remove(fragment_t *f)
+{
+    xl8_cache_entry_t *entry;
+    /* An entry for f is only added while f is live and being translated, which
+     * cannot race with f being freed, so an empty cache needs no lock.
+     */
+    if (xl8_cache_count == 0 || TEST(FRAG_FAKE, f->flags))
+        return;
+    d_r_mutex_lock(&xl8_cache_lock);
+    for (entry = xl8_cache_table[xl8_cache_hash(f)]; entry != NULL;
+         entry = entry->hash_next) {
+        if (entry->f == f) {
+            xl8_cache_unlink(entry);
+            break;
+        }
+    }
+    d_r_mutex_unlock(&xl8_cache_lock);
+    if (entry != NULL)
+        xl8_cache_entry_free(entry);
+}
+
 /* The esp in mcontext must either be valid or NULL (if null will be unable to
  * recreate on XP and 03 at vsyscall_after_syscall and on sygate 2k at after syscall).
  * Returns true if successful.  Whether successful or not, attempts to modify
@@ -1229,6 +1631,8 @@ recreate_app_state_internal(dcontext_t *tdcontext, priv_mcontext_t *mcontext,
         linkstub_t *l;
         cache_pc cti_pc;
         instrlist_t *ilist = NULL;
+        translation_info_t *info = NULL;
+        xl8_cache_info_t cached_info;
         fragment_t *f = owning_f;
         bool alloc = false, ok;
         dr_isa_mode_t old_mode;
@@ -1254,7 +1658,8 @@ recreate_app_state_internal(dcontext_t *tdcontext, priv_mcontext_t *mcontext,
          * containing the code cache pc whenever we can.  For pending-deletion
          * fragments we can't do that and have to store the info, due to our
          * weak consistency flushing where the app code may have changed
-         * before we get here (case 3559).
+         * before we get here (case 3559).  Fragments translated more than once
+         * (typically fault-heavy code) get a table in the translation cache.
          */
 
         /* Check whether we have a fragment w/ stored translations before
@@ -1275,7 +1680,10 @@ recreate_app_state_internal(dcontext_t *tdcontext, priv_mcontext_t *mcontext,
             ilist = recreate_fragment_ilist(tdcontext, mcontext->pc, &f, &alloc,
                                             true /*mangle*/ _IF_CLIENT(true /*client*/));
         } else if (FRAGMENT_TRANSLATION_INFO(f) == NULL) {
-            if (TEST(FRAG_SELFMOD_SANDBOXED, f->flags)) {
+            if (!alloc && translation_cache_lookup(f, &cached_info)) {
+                info = (translation_info_t *)&cached_info;
+                STATS_INC(recreate_via_translation_cache);
+            } else if (TEST(FRAG_SELFMOD_SANDBOXED, f->flags)) {
                 ilist = recreate_selfmod_ilist(tdcontext, f);
             } else {
                 /* NULL for pc indicates that f is valid */
@@ -1289,7 +1697,9 @@ recreate_app_state_internal(dcontext_t *tdcontext, priv_mcontext_t *mcontext,
                 ASSERT(!new_alloc);
             }
         }
-        if (ilist == NULL && (f == NULL || FRAGMENT_TRANSLATION_INFO(f) == NULL)) {
+        if (f != NULL && info == NULL)
+            info = FRAGMENT_TRANSLATION_INFO(f);
+        if (ilist == NULL && info == NULL) {
             /* It is problematic if this routine fails.  Many places assume that
              * recreate_app_pc() will work.
              */
@@ -1354,18 +1764,21 @@ recreate_app_state_internal(dcontext_t *tdcontext, priv_mcontext_t *mcontext,
         client_info.raw_mcontext_valid = true;
 #endif
         if (ilist == NULL) {
-            ASSERT(f != NULL && FRAGMENT_TRANSLATION_INFO(f) != NULL);
+            ASSERT(f != NULL && info != NULL);
             ASSERT(!TEST(FRAG_WAS_DELETED, f->flags) ||
-                   INTERNAL_OPTION(safe_translate_flushed));
+                   INTERNAL_OPTION(safe_translate_flushed) ||
+                   info == (translation_info_t *)&cached_info);
             res = recreate_app_state_from_info(
-                tdcontext, FRAGMENT_TRANSLATION_INFO(f), (byte *)f->start_pc,
-                (byte *)f->start_pc + f->size, mcontext, just_pc _IF_DEBUG(f->flags));
+                tdcontext, info, (byte *)f->start_pc, (byte *)f->start_pc + f->size,
+                mcontext, just_pc _IF_DEBUG(f->flags));
             STATS_INC(recreate_via_stored_info);
         } else {
             res = recreate_app_state_from_ilist(
                 tdcontext, ilist, (byte *)f->tag, (byte *)FCACHE_ENTRY_PC(f),
                 (byte *)f->start_pc + f->size, mcontext, just_pc, f->flags);
             STATS_INC(recreate_via_app_ilist);
+            if (res != RECREATE_FAILURE && !alloc)
+                translation_cache_add(tdcontext, f, ilist);
         }
         ok = dr_set_isa_mode(tdcontext, old_mode, NULL);
         ASSERT(ok);
@@ -103,6 +103,12 @@ translation_info_free(dcontext_t *tdcontext, translation_info_t *info);
 translation_info_t *
 record_translation_info(dcontext_t *dcontext, fragment_t *f, instrlist_t *ilist);
 void
+translation_cache_init(void);
+void
+translation_cache_exit(void);
+void
+translation_cache_remove(fragment_t *f);
+void
 translation_info_print(const translation_info_t *info, cache_pc start, file_t file);
 #ifdef INTERNAL
 void
@@ -432,8 +432,10 @@ os_get_module_info(const app_pc pc, uint *checksum, uint *timestamp, size_t *siz
             *code_size = rx_sz;
         }
         if (file_version != NULL) {
-            /* FIXME: NYI: make windows-only everywhere if no good linux source */
-            *file_version = 0;
+            /* There is no version resource on Linux: the build-id is the closest
+             * thing, and it identifies the exact file contents.
+             */
+            *file_version = IF_LINUX_ELSE(ma->os_data.build_id_hash, 0);
         }
     }
 
@@ -65,6 +65,8 @@ typedef struct _os_module_data_t {
     /* Fields for pcaches (PR 295534) */
     size_t checksum;
     size_t timestamp;
+    /* Fold of the NT_GNU_BUILD_ID note, or 0 if absent (Linux only) */
+    uint64 build_id_hash;
 
 #ifdef LINUX
     /* i#112: Dynamic section info for exported symbol lookup.  Not
@@ -331,6 +331,57 @@ module_fill_os_data(ELF_PROGRAM_HEADER_TYPE *prog_hdr, /* PT_DYNAMIC entry */
     return res;
 }
 
+#ifdef LINUX
+#    ifndef NT_GNU_BUILD_ID
+#        define NT_GNU_BUILD_ID 3
+#    endif
+
+/* Returns a 64-bit fold of the NT_GNU_BUILD_ID note in the PT_NOTE segment
+ * prog_hdr, or 0 if it has none.  The build-id is already a digest of the
+ * file's contents, so folding it keeps it a good key for pcaches.
+ */
+static uint64
+module_read_build_id_hash(ELF_PROGRAM_HEADER_TYPE *prog_hdr, /* PT_NOTE entry */
+                          app_pc base, size_t view_size, bool at_map,
+                          ptr_int_t load_delta)
+{
+    uint64 hash = 0;
+    app_pc note = at_map ? base + prog_hdr->p_offset
+                         : (app_pc)prog_hdr->p_vaddr + load_delta;
+    app_pc end = note + prog_hdr->p_filesz;
+    dcontext_t *dcontext = get_thread_private_dcontext();
+    ASSERT(prog_hdr->p_type == PT_NOTE);
+    if (note < base || end > base + view_size || end < note)
+        return 0;
+    TRY_EXCEPT_ALLOW_NO_DCONTEXT(
+        dcontext,
+        {
+            while ((size_t)(end - note) >= sizeof(ELF_NOTE_HEADER_TYPE)) {
+                ELF_NOTE_HEADER_TYPE *nhdr = (ELF_NOTE_HEADER_TYPE *)note;
+                const char *name = (const char *)(nhdr + 1);
+                byte *desc = (byte *)name + ALIGN_FORWARD(nhdr->n_namesz, 4);
+                size_t len = sizeof(*nhdr) + ALIGN_FORWARD(nhdr->n_namesz, 4) +
+                    ALIGN_FORWARD(nhdr->n_descsz, 4);
+                if (len > (size_t)(end - note))
+                    break;
+                if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4 &&
+                    strcmp(name, "GNU") == 0) {
+                    uint i;
+                    for (i = 0; i < nhdr->n_descsz; i++)
+                        hash = ((hash << 8) | (hash >> 56)) ^ desc[i];
+                    break;
+                }
+                note += len;
+            }
+        },
+        { /* EXCEPT */
+          ASSERT_CURIOSITY(false && "crashed while walking note segment");
+          hash = 0;
+        });
+    return hash;
+}
+#endif
+
 /* Identifies the bounds of each segment in the ELF at base.
  * Returned addresses out_base and out_end are relative to the actual
  * loaded module base, so the "base" param should be added to produce
@@ -392,6 +443,13 @@ module_walk_program_headers(app_pc base, size_t view_size, bool at_map, bool dyn
                 }
                 found_load = true;
             }
+#ifdef LINUX
+            if (out_data != NULL && prog_hdr->p_type == PT_NOTE &&
+                out_data->build_id_hash == 0) {
+                out_data->build_id_hash = module_read_build_id_hash(
+                    prog_hdr, base, view_size, at_map, load_delta);
+            }
+#endif
             if ((out_soname != NULL || out_data != NULL) &&
                 prog_hdr->p_type == PT_DYNAMIC) {
                 module_fill_os_data(prog_hdr, mod_base, max_end, base, view_size, at_map,
@@ -58,6 +58,7 @@
 #    define ELF_REL_TYPE Elf64_Rel
 #    define ELF_RELA_TYPE Elf64_Rela
 #    define ELF_AUXV_TYPE Elf64_auxv_t
+#    define ELF_NOTE_HEADER_TYPE Elf64_Nhdr
 /* system like android has ELF_ST_TYPE and ELF_ST_BIND */
 #    ifndef ELF_ST_TYPE
 #        define ELF_ST_TYPE ELF64_ST_TYPE
@@ -79,6 +80,7 @@
 #    define ELF_REL_TYPE Elf32_Rel
 #    define ELF_RELA_TYPE Elf32_Rela
 #    define ELF_AUXV_TYPE Elf32_auxv_t
+#    define ELF_NOTE_HEADER_TYPE Elf32_Nhdr
 /* system like android has ELF_ST_TYPE and ELF_ST_BIND */
 #    ifndef ELF_ST_TYPE
 #        define ELF_ST_TYPE ELF32_ST_TYPE
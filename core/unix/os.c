@@ -2762,11 +2762,17 @@ os_thread_under_dynamo(dcontext_t *dcontext)
     os_swap_context(dcontext, false /*to dr*/, DR_STATE_GO_NATIVE);
     signal_swap_mask(dcontext, false /*to dr*/);
     start_itimer(dcontext);
+#if defined(LINUX) && defined(CLIENT_INTERFACE)
+    start_perf_samplers(dcontext);
+#endif
 }
 
 void
 os_thread_not_under_dynamo(dcontext_t *dcontext)
 {
+#if defined(LINUX) && defined(CLIENT_INTERFACE)
+    stop_perf_samplers(dcontext);
+#endif
     stop_itimer(dcontext);
     signal_swap_mask(dcontext, true /*to app*/);
     os_swap_context(dcontext, true /*to app*/, DR_STATE_GO_NATIVE);
@@ -3560,8 +3566,14 @@ os_thread_sleep(uint64 milliseconds)
 #endif
 }
 
+/* Sends the suspend signal, if needed, without waiting for the target to
+ * reach the suspend point.  Each successful call must be followed by
+ * os_thread_suspend_finish() before the target can be examined or resumed.
+ * This lets synch_with_all_threads() overlap the signal round trips of
+ * many threads.
+ */
 bool
-os_thread_suspend(thread_record_t *tr)
+os_thread_suspend_start(thread_record_t *tr)
 {
     os_thread_data_t *ostd = (os_thread_data_t *)tr->dcontext->os_field;
     ASSERT(ostd != NULL);
@@ -3577,9 +3589,9 @@ os_thread_suspend(thread_record_t *tr)
      */
     if (ostd->suspend_count == 1) {
         /* PR 212090: we use a custom signal handler to suspend.  We wait
-         * here until the target reaches the suspend point, and leave it
-         * up to the caller to check whether it is a safe suspend point,
-         * to match Windows behavior.
+         * in os_thread_suspend_finish() until the target reaches the suspend
+         * point, and leave it up to the caller to check whether it is a safe
+         * suspend point, to match Windows behavior.
          */
         ASSERT(ksynch_get_value(&ostd->suspended) == 0);
         if (!known_thread_signal(tr, SUSPEND_SIGNAL)) {
@@ -3594,6 +3606,17 @@ os_thread_suspend(thread_record_t *tr)
      * suspending thread gets scheduled again.
      */
     d_r_mutex_unlock(&ostd->suspend_lock);
+    return true;
+}
+
+/* Waits for a target passed to os_thread_suspend_start() to reach the
+ * suspend point.
+ */
+void
+os_thread_suspend_finish(thread_record_t *tr)
+{
+    os_thread_data_t *ostd = (os_thread_data_t *)tr->dcontext->os_field;
+    ASSERT(ostd != NULL);
     while (ksynch_get_value(&ostd->suspended) == 0) {
         /* For Linux, waits only if the suspended flag is not set as 1. Return value
          * doesn't matter because the flag will be re-checked.
@@ -3612,6 +3635,25 @@ os_thread_suspend(thread_record_t *tr)
             os_thread_yield();
         }
     }
+}
+
+/* Returns whether a target passed to os_thread_suspend_start() has reached the
+ * suspend point, so that os_thread_suspend_finish() will not block.
+ */
+bool
+os_thread_suspend_ready(thread_record_t *tr)
+{
+    os_thread_data_t *ostd = (os_thread_data_t *)tr->dcontext->os_field;
+    ASSERT(ostd != NULL);
+    return ksynch_get_value(&ostd->suspended) != 0;
+}
+
+bool
+os_thread_suspend(thread_record_t *tr)
+{
+    if (!os_thread_suspend_start(tr))
+        return false;
+    os_thread_suspend_finish(tr);
     return true;
 }
 
@@ -181,6 +181,12 @@ void
 os_fork_init(dcontext_t *dcontext);
 void
 os_thread_stack_store(dcontext_t *dcontext);
+bool
+os_thread_suspend_start(thread_record_t *tr);
+void
+os_thread_suspend_finish(thread_record_t *tr);
+bool
+os_thread_suspend_ready(thread_record_t *tr);
 app_pc
 get_dynamorio_dll_end(void);
 thread_id_t
@@ -511,6 +517,14 @@ set_itimer_callback(dcontext_t *dcontext, int which, uint millisec,
 uint
 get_itimer_frequency(dcontext_t *dcontext, int which);
 
+#if defined(LINUX) && defined(CLIENT_INTERFACE)
+/* Declared ahead of dr_perf_sample_t in globals.h, which includes us first. */
+struct _dr_perf_sample_t;
+bool
+set_perf_sampler(dcontext_t *dcontext, int event, uint64 period,
+                 void (*func)(void *, struct _dr_perf_sample_t *));
+#endif
+
 bool
 sysnum_is_not_restartable(int sysnum);
 
@@ -392,6 +392,12 @@ void
 start_itimer(dcontext_t *dcontext);
 void
 stop_itimer(dcontext_t *dcontext);
+#if defined(LINUX) && defined(CLIENT_INTERFACE)
+void
+start_perf_samplers(dcontext_t *dcontext);
+void
+stop_perf_samplers(dcontext_t *dcontext);
+#endif
 
 /* handle app itimer syscalls */
 void
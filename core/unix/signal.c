@@ -1069,6 +1069,10 @@ signal_thread_inherit(dcontext_t *dcontext, void *clone_record)
             }
 #ifdef CLIENT_INTERFACE
             info->we_intercept[SIGALRM] = true;
+#    ifdef LINUX
+            /* for dr_set_perf_sampler() */
+            info->we_intercept[PERF_SAMPLE_SIGNAL] = true;
+#    endif
 #endif
 #ifdef SIDELINE
             info->we_intercept[SIGCHLD] = true;
@@ -1182,6 +1186,10 @@ signal_fork_init(dcontext_t *dcontext)
         info->shared_itimer_underDR = NULL;
         init_itimer(dcontext, true /*first*/);
     }
+#if defined(LINUX) && defined(CLIENT_INTERFACE)
+    /* Perf samplers count the parent thread and are not inherited across fork. */
+    perf_sampler_thread_exit(dcontext, info);
+#endif
     info->num_unstarted_children = 0;
     for (i = 1; i <= MAX_SIGNUM; i++) {
         /* "A child created via fork(2) initially has an empty pending signal set" */
@@ -1270,6 +1278,10 @@ signal_thread_exit(dcontext_t *dcontext, bool other_thread)
      * from dynamo_thread_exit_common().  We need to leave the app itimers in place
      * in case we're detaching.
      */
+#if defined(LINUX) && defined(CLIENT_INTERFACE)
+    /* Close any perf samplers before we restore the app's SIGPROF handling. */
+    perf_sampler_thread_exit(dcontext, info);
+#endif
 
 #if defined(X86) && defined(LINUX)
     if (info->xstate_alloc != NULL) {
@@ -1376,9 +1388,10 @@ signal_thread_exit(dcontext_t *dcontext, bool other_thread)
     IF_LINUX(signalfd_thread_exit(dcontext, info));
     special_heap_exit(info->sigheap);
     DELETE_LOCK(info->child_lock);
-#ifdef DEBUG
-    /* for non-debug we do fast exit path and don't free local heap */
-#    ifdef HAVE_SIGALTSTACK
+#ifdef HAVE_SIGALTSTACK
+    /* Unlike the local heap, the stack is freed in release builds too, as it lives
+     * past the thread's heap and it returns to the stack pool for the next thread.
+     */
     if (info->sigstack.ss_sp != NULL) {
         /* i#552: to raise client exit event, we may call dynamo_process_exit
          * on sigstack in signal handler.
@@ -1386,7 +1399,9 @@ signal_thread_exit(dcontext_t *dcontext, bool other_thread)
          */
         stack_free(info->sigstack.ss_sp + info->sigstack.ss_size, info->sigstack.ss_size);
     }
-#    endif
+#endif
+#ifdef DEBUG
+    /* for non-debug we do fast exit path and don't free local heap */
     HEAP_TYPE_FREE(dcontext, info, thread_sig_info_t, ACCT_OTHER, PROTECTED);
 #endif
 #ifdef PAPI
@@ -3945,6 +3960,31 @@ adjust_syscall_for_restart(dcontext_t *dcontext, thread_sig_info_t *info, int si
 /* XXX: Better to get this code inside arch/ but we'd have to convert to an mcontext
  * which seems overkill.
  */
+/* Unlinks f, which the delayable signal interrupted at pc, so the signal can be
+ * delivered once the thread exits the cache.
+ */
+static void
+delay_signal_until_fragment_exit(dcontext_t *dcontext, thread_sig_info_t *info,
+                                 fragment_t *f, byte *pc)
+{
+    LOG(THREAD, LOG_ASYNCH, 2, "\tdelaying until exit F%d\n", f->id);
+    /* could get another signal but should be in same fragment */
+    ASSERT(info->interrupted == NULL || info->interrupted == f);
+    if (info->interrupted != f) {
+        /* Just in case there's a prior, avoid leaving it unlinked. */
+        relink_interrupted_fragment(dcontext, info);
+        if (unlink_fragment_for_signal(dcontext, f, pc)) {
+            info->interrupted = f;
+            info->interrupted_pc = pc;
+        } else {
+            /* either was unlinked for trace creation, or we got another
+             * signal before exiting cache to handle 1st
+             */
+            ASSERT(info->interrupted == NULL || info->interrupted == f);
+        }
+    }
+}
+
 static fragment_t *
 find_next_fragment_from_gencode(dcontext_t *dcontext, sigcontext_t *sc)
 {
@@ -4166,7 +4206,6 @@ record_pending_signal(dcontext_t *dcontext, int sig, kernel_ucontext_t *ucxt,
                 f = fragment_pclookup(dcontext, pc, &wrapper);
                 ASSERT(f != NULL);
                 ASSERT(!TEST(FRAG_COARSE_GRAIN, f->flags)); /* checked above */
-                LOG(THREAD, LOG_ASYNCH, 2, "\tdelaying until exit F%d\n", f->id);
                 if (interrupted_inlined_syscall(dcontext, f, pc)) {
                     /* PR 596147: if delayable signal arrives after syscall-skipping
                      * jmp, either at syscall or post-syscall, we deliver
@@ -4180,23 +4219,17 @@ record_pending_signal(dcontext_t *dcontext, int sig, kernel_ucontext_t *ucxt,
                      * post-syscall handler to worry about we have no need to
                      * change anything.
                      */
-                } else {
-                    /* could get another signal but should be in same fragment */
-                    ASSERT(info->interrupted == NULL || info->interrupted == f);
-                    if (info->interrupted != f) {
-                        /* Just in case there's a prior, avoid leaving it unlinked. */
-                        relink_interrupted_fragment(dcontext, info);
-                        if (unlink_fragment_for_signal(dcontext, f, pc)) {
-                            info->interrupted = f;
-                            info->interrupted_pc = pc;
-                        } else {
-                            /* either was unlinked for trace creation, or we got another
-                             * signal before exiting cache to handle 1st
-                             */
-                            ASSERT(info->interrupted == NULL || info->interrupted == f);
-                        }
-                    }
-                }
+                } else if (DYNAMO_OPTION(signal_delivery_from_cache) && !forged) {
+                    /* Rather than waiting for the fragment to exit, which can take
+                     * arbitrarily long for a long trace or a self-loop, deliver at
+                     * the interruption point.  If the point cannot be translated we
+                     * fall back to delaying, below.
+                     */
+                    receive_now = true;
+                    LOG(THREAD, LOG_ASYNCH, 2,
+                        "signal interrupted F%d so trying to deliver now\n", f->id);
+                } else
+                    delay_signal_until_fragment_exit(dcontext, info, f, pc);
             }
         } else {
             /* the signal interrupted code cache => run handler now! */
@@ -4335,9 +4368,15 @@ record_pending_signal(dcontext_t *dcontext, int sig, kernel_ucontext_t *ucxt,
              * in middle of ind branch region or sthg (PR 213040)
              */
             LOG(THREAD, LOG_ASYNCH, 2,
-                "signal is in un-translatable spot in coarse fragment: delaying\n");
+                "signal is in un-translatable spot in fragment: delaying\n");
             receive_now = false;
-        }
+            /* For -signal_delivery_from_cache, bound the delay as for a fine
+             * fragment we never tried to translate.
+             */
+            if (f != NULL && !TEST(FRAG_COARSE_GRAIN, f->flags))
+                delay_signal_until_fragment_exit(dcontext, info, f, pc);
+        } else if (can_always_delay[sig] && f != NULL)
+            STATS_INC(num_signals_from_cache);
     }
 
     if (receive_now) {
@@ -5313,6 +5352,12 @@ master_signal_handler_C(byte *xsp)
     case SIGALRM:
     case SIGVTALRM:
     case SIGPROF:
+#if defined(LINUX) && defined(CLIENT_INTERFACE)
+        if (sig == PERF_SAMPLE_SIGNAL &&
+            handle_perf_sample(dcontext, (thread_sig_info_t *)dcontext->signal_field,
+                               siginfo, ucxt))
+            break;
+#endif
         if (handle_alarm(dcontext, sig, ucxt))
             record_pending_signal(dcontext, sig, ucxt, frame, false _IF_CLIENT(NULL));
         /* else, don't deliver to app */
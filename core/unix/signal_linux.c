@@ -48,6 +48,12 @@
 #include "arch.h"
 #include "../hashtable.h"
 #include "include/syscall.h"
+#ifdef CLIENT_INTERFACE
+#    include "../fragment.h"
+#    include "../fcache.h"
+#    include "../translate.h"
+#    include <linux/perf_event.h>
+#endif
 
 #include <errno.h>
 #undef errno
@@ -558,3 +564,269 @@ signal_handle_close(dcontext_t *dcontext, file_t fd)
     }
     TABLE_RWLOCK(sigfd_table, write, unlock);
 }
+
+/***************************************************************************
+ * PERF EVENT SAMPLING
+ *
+ * Each dr_set_perf_sampler() sampler is a perf_event_open counter on its thread
+ * that sends PERF_SAMPLE_SIGNAL to that thread every period events.  We re-arm a
+ * one-shot overflow from the handler rather than mapping a sample ring buffer so
+ * that each sample arrives with the interrupted context in hand.
+ */
+#ifdef CLIENT_INTERFACE
+
+/* From fcntl.h and signal.h, which only provide some of these with _GNU_SOURCE. */
+#    ifndef F_SETSIG
+#        define F_SETSIG 10
+#    endif
+#    ifndef F_SETOWN_EX
+#        define F_SETOWN_EX 15
+#    endif
+#    ifndef F_OWNER_TID
+#        define F_OWNER_TID 0
+#    endif
+#    ifndef O_ASYNC
+#        define O_ASYNC 020000
+#    endif
+#    ifndef POLL_HUP
+#        define POLL_HUP 6
+#    endif
+
+typedef struct _kernel_f_owner_ex_t {
+    int type;
+    int pid;
+} kernel_f_owner_ex_t;
+
+static void
+perf_sampler_close(dcontext_t *dcontext, perf_sampler_t *sampler)
+{
+    ASSERT(sampler->open);
+    /* Clear first so a signal arriving mid-close is not matched to the fd. */
+    sampler->open = false;
+    sampler->armed = false;
+    os_close_protected(sampler->fd);
+    LOG(THREAD, LOG_ASYNCH, 2, "closed perf sampler fd %d\n", sampler->fd);
+}
+
+static bool
+perf_sampler_open(dcontext_t *dcontext, dr_perf_event_t event, perf_sampler_t *sampler)
+{
+    struct perf_event_attr attr;
+    kernel_f_owner_ex_t owner;
+    file_t fd, priv_fd;
+    ptr_int_t flags;
+    ASSERT(!sampler->open);
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    switch (event) {
+    case DR_PERF_SAMPLE_CYCLES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case DR_PERF_SAMPLE_CACHE_MISSES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+    case DR_PERF_SAMPLE_BRANCH_MISSES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    case DR_PERF_SAMPLE_TASK_CLOCK:
+        attr.type = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_TASK_CLOCK;
+        break;
+    default: ASSERT_NOT_REACHED(); return false;
+    }
+    attr.sample_period = sampler->period;
+    attr.disabled = 1;
+    /* Everything we want to attribute runs in user mode. */
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = (file_t)dynamorio_syscall(SYS_perf_event_open, 5, &attr, 0 /*this thread*/,
+                                   -1 /*any cpu*/, -1 /*no group*/, 0);
+    if (fd < 0) {
+        LOG(THREAD, LOG_ASYNCH, 1, "perf_event_open for event %d failed: %d\n", event,
+            fd);
+        return false;
+    }
+    /* Keep the fd in the private fd space, as for our other long-lived fds. */
+    priv_fd = fd_priv_dup(fd);
+    if (priv_fd >= 0) {
+        close_syscall(fd);
+        fd = priv_fd;
+    }
+    fd_mark_close_on_exec(fd);
+    fd_table_add(fd, 0);
+    /* Direct the overflow signal at this thread rather than the process. */
+    owner.type = F_OWNER_TID;
+    owner.pid = get_sys_thread_id();
+    flags = dynamorio_syscall(SYS_fcntl, 2, fd, F_GETFL);
+    if (flags < 0 ||
+        dynamorio_syscall(SYS_fcntl, 3, fd, F_SETFL, flags | O_ASYNC) != 0 ||
+        dynamorio_syscall(SYS_fcntl, 3, fd, F_SETSIG, PERF_SAMPLE_SIGNAL) != 0 ||
+        dynamorio_syscall(SYS_fcntl, 3, fd, F_SETOWN_EX, &owner) != 0) {
+        LOG(THREAD, LOG_ASYNCH, 1, "failed to direct perf event %d signals\n", event);
+        os_close_protected(fd);
+        return false;
+    }
+    sampler->fd = fd;
+    sampler->armed = false;
+    sampler->open = true;
+    LOG(THREAD, LOG_ASYNCH, 2, "opened perf sampler fd %d for event %d period %d\n", fd,
+        event, sampler->period);
+    return true;
+}
+
+static void
+perf_sampler_arm(dcontext_t *dcontext, perf_sampler_t *sampler)
+{
+    ASSERT(sampler->open);
+    /* Enables the event until its next overflow. */
+    if (dynamorio_syscall(SYS_ioctl, 3, sampler->fd, PERF_EVENT_IOC_REFRESH, 1) == 0)
+        sampler->armed = true;
+}
+
+bool
+set_perf_sampler(dcontext_t *dcontext, int event, uint64 period,
+                 void (*func)(void *, dr_perf_sample_t *))
+{
+    thread_sig_info_t *info = (thread_sig_info_t *)dcontext->signal_field;
+    perf_sampler_t *sampler;
+    if (event < 0 || event >= DR_PERF_SAMPLE_LAST) {
+        CLIENT_ASSERT(false, "invalid perf sampler event");
+        return false;
+    }
+    if (func == NULL && period != 0) {
+        CLIENT_ASSERT(false, "invalid function");
+        return false;
+    }
+    sampler = &info->perf_sampler[event];
+    if (sampler->open)
+        perf_sampler_close(dcontext, sampler);
+    sampler->cb = NULL;
+    if (period == 0)
+        return true;
+    sampler->period = period;
+    if (!perf_sampler_open(dcontext, (dr_perf_event_t)event, sampler))
+        return false;
+    sampler->cb = func;
+    if (!dynamo_initialized) {
+        /* As for itimers (i#2907), we have no signal handler until we start the
+         * app.  start_perf_samplers() will arm it.
+         */
+        LOG(THREAD, LOG_ASYNCH, 2, "delaying perf sampler until attach\n");
+    } else
+        perf_sampler_arm(dcontext, sampler);
+    return true;
+}
+
+void
+start_perf_samplers(dcontext_t *dcontext)
+{
+    thread_sig_info_t *info = (thread_sig_info_t *)dcontext->signal_field;
+    int event;
+    for (event = 0; event < DR_PERF_SAMPLE_LAST; event++) {
+        perf_sampler_t *sampler = &info->perf_sampler[event];
+        if (sampler->cb == NULL)
+            continue;
+        if (!sampler->open &&
+            !perf_sampler_open(dcontext, (dr_perf_event_t)event, sampler)) {
+            sampler->cb = NULL;
+            continue;
+        }
+        if (!sampler->armed)
+            perf_sampler_arm(dcontext, sampler);
+    }
+}
+
+/* We close rather than disable the events while the thread is native so that
+ * re-arming on return starts from a known state.
+ */
+void
+stop_perf_samplers(dcontext_t *dcontext)
+{
+    thread_sig_info_t *info = (thread_sig_info_t *)dcontext->signal_field;
+    int event;
+    for (event = 0; event < DR_PERF_SAMPLE_LAST; event++) {
+        if (info->perf_sampler[event].open)
+            perf_sampler_close(dcontext, &info->perf_sampler[event]);
+    }
+}
+
+void
+perf_sampler_thread_exit(dcontext_t *dcontext, thread_sig_info_t *info)
+{
+    int event;
+    for (event = 0; event < DR_PERF_SAMPLE_LAST; event++) {
+        if (info->perf_sampler[event].open)
+            perf_sampler_close(dcontext, &info->perf_sampler[event]);
+        info->perf_sampler[event].cb = NULL;
+    }
+}
+
+/* Returns whether the signal was a perf sampler overflow, in which case it has been
+ * consumed.  Called from our signal handler, so it must not block on locks.
+ */
+bool
+handle_perf_sample(dcontext_t *dcontext, thread_sig_info_t *info,
+                   kernel_siginfo_t *siginfo, kernel_ucontext_t *ucxt)
+{
+    sigcontext_t *sc = SIGCXT_FROM_UCXT(ucxt);
+    perf_sampler_t *sampler = NULL;
+    dr_perf_sample_t sample;
+    fragment_t wrapper, *f;
+    int event;
+    /* An itimer's SIGPROF never has this code. */
+    if (siginfo->si_code != POLL_HUP)
+        return false;
+    for (event = 0; event < DR_PERF_SAMPLE_LAST; event++) {
+        if (info->perf_sampler[event].open &&
+            info->perf_sampler[event].fd == siginfo->si_fd) {
+            sampler = &info->perf_sampler[event];
+            break;
+        }
+    }
+    if (sampler == NULL)
+        return false;
+    /* i#471: as for alarms, suppress samples coming in after exit. */
+    if (dynamo_exited)
+        return true;
+
+    sample.size = sizeof(sample);
+    sample.event = (dr_perf_event_t)event;
+    sample.where = dcontext->whereami;
+    sample.raw_pc = (byte *)sc->SC_XIP;
+    sample.pc = NULL;
+    sample.tag = NULL;
+    if (sample.where == DR_WHERE_FCACHE) {
+        f = fragment_pclookup(dcontext, sample.raw_pc, &wrapper);
+        if (f == NULL) {
+            sample.where =
+                fcache_refine_whereami(dcontext, sample.where, sample.raw_pc, NULL);
+        } else {
+            sample.tag = f->tag;
+            /* As in translate_sigcontext(), the initexit lock keeps f from being
+             * flushed; but we give up rather than wait, as its holder may be
+             * waiting on us.
+             */
+            if (d_r_mutex_trylock(&thread_initexit_lock)) {
+                sample.pc = recreate_app_pc(dcontext, sample.raw_pc, f);
+                d_r_mutex_unlock(&thread_initexit_lock);
+            }
+        }
+    } else if (sample.where == DR_WHERE_APP)
+        sample.pc = sample.raw_pc;
+    if (sample.where == DR_WHERE_FCACHE || sample.where == DR_WHERE_APP)
+        STATS_INC(num_perf_samples_app);
+    else
+        STATS_INC(num_perf_samples_dr);
+    LOG(THREAD, LOG_ASYNCH, 3, "perf sample event %d where %d @" PFX " => " PFX "\n",
+        event, sample.where, sample.raw_pc, sample.pc);
+
+    sampler->cb(dcontext, &sample);
+    /* The event disabled itself on overflow. */
+    if (sampler->open)
+        perf_sampler_arm(dcontext, sampler);
+    return true;
+}
+#endif /* CLIENT_INTERFACE */
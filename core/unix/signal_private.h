@@ -380,6 +380,26 @@ typedef struct _thread_itimer_info_t {
 struct _sigfd_pipe_t;
 typedef struct _sigfd_pipe_t sigfd_pipe_t;
 
+#if defined(LINUX) && defined(CLIENT_INTERFACE)
+/* The signal the kernel sends on a dr_set_perf_sampler() counter overflow.  We
+ * tell these apart from ITIMER_PROF alarms by the si_fd of the perf event.
+ */
+#    define PERF_SAMPLE_SIGNAL SIGPROF
+
+/* A dr_set_perf_sampler() sampler on one thread.  Not inherited by new threads.
+ * The perf event is open only while the thread is under DR control.
+ */
+typedef struct _perf_sampler_t {
+    /* NULL when not sampling. */
+    void (*cb)(void *, dr_perf_sample_t *);
+    uint64 period;
+    bool open;
+    /* Whether the one-shot overflow has been enabled since opening. */
+    bool armed;
+    file_t fd;
+} perf_sampler_t;
+#endif
+
 typedef struct _thread_sig_info_t {
     /* we use kernel_sigaction_t so we don't have to translate back and forth
      * between it and libc version.
@@ -456,6 +476,9 @@ typedef struct _thread_sig_info_t {
     uint skip_alarm_xl8;
     /* signalfd array (lazily initialized) */
     sigfd_pipe_t *signalfd[SIGARRAY_SIZE];
+#if defined(LINUX) && defined(CLIENT_INTERFACE)
+    perf_sampler_t perf_sampler[DR_PERF_SAMPLE_LAST];
+#endif
 
     /* to handle sigsuspend we have to save blocked set */
     bool in_sigsuspend;
@@ -634,6 +657,15 @@ notify_signalfd(dcontext_t *dcontext, thread_sig_info_t *info, int sig,
 
 void
 check_signals_pending(dcontext_t *dcontext, thread_sig_info_t *info);
+
+#    ifdef CLIENT_INTERFACE
+bool
+handle_perf_sample(dcontext_t *dcontext, thread_sig_info_t *info,
+                   kernel_siginfo_t *siginfo, kernel_ucontext_t *ucxt);
+
+void
+perf_sampler_thread_exit(dcontext_t *dcontext, thread_sig_info_t *info);
+#    endif
 #endif
 
 #endif /* _SIGNAL_PRIVATE_H_ */
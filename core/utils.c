@@ -4609,5 +4609,10 @@ stats_get_snapshot(dr_stats_t *drstats)
     if (drstats->size > offsetof(dr_stats_t, synchs_not_at_safe_spot)) {
         drstats->synchs_not_at_safe_spot = GLOBAL_STAT(synchs_not_at_safe_spot);
     }
+    if (drstats->size > offsetof(dr_stats_t, last_trace_millis)) {
+        drstats->trace_seeds = GLOBAL_STAT(num_trace_seeds);
+        drstats->trace_seeds_built = GLOBAL_STAT(num_trace_seeds_built);
+        drstats->last_trace_millis = GLOBAL_STAT(last_trace_millis);
+    }
     return true;
 }
@@ -593,6 +593,9 @@ enum {
     LOCK_RANK(request_region_be_heap_reachable_lock), /* > heap_unit_lock, vmh_lock
                                                        * < report_buf_lock (for assert) */
 #    endif
+    LOCK_RANK(stack_pool_lock), /* leaf: the pool is only a free list */
+    LOCK_RANK(bbprebuild_lock), /* leaf: only guards the request queue */
+    LOCK_RANK(xl8_cache_lock),  /* leaf: no allocation while held */
     LOCK_RANK(report_buf_lock),
 /* FIXME: if we crash while holding the all_threads_lock, snapshot_lock
  * (for loglevel 1+, logmask LOG_MEMSTATS), or any lock below this
@@ -1695,6 +1698,7 @@ enum { LONGJMP_EXCEPTION = 1 };
 #define RSTATS_ADD XSTATS_ADD
 #define RSTATS_SUB XSTATS_SUB
 #define RSTATS_ADD_PEAK XSTATS_ADD_PEAK
+#define RSTATS_TRACK_MAX XSTATS_TRACK_MAX
 
 #if defined(DEBUG) && defined(INTERNAL)
 #    define DODEBUGINT DODEBUG
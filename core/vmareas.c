@@ -8855,6 +8855,14 @@ vm_list_overlaps(dcontext_t *dcontext, void *vmlist, app_pc start, app_pc end)
     if (v == NULL)
         return false;
     SHARED_VECTOR_RWLOCK(v, read, lock);
+    /* A flusher may have deleted a shared fragment since we checked its flags
+     * above, after which its also field holds a flushtime rather than a chain.
+     * Deletion happens under the write lock, so re-checking here suffices.
+     */
+    if (TEST(FRAG_WAS_DELETED, ((fragment_t *)vmlist)->flags)) {
+        SHARED_VECTOR_RWLOCK(v, read, unlock);
+        return false;
+    }
     for (entry = vmlist; entry != NULL; entry = FRAG_ALSO(entry)) {
         ok = lookup_addr(v, FRAG_PC(entry), &area);
         if (!ok)
@@ -10849,7 +10857,11 @@ handle_modified_code(dcontext_t *dcontext, cache_pc instr_cache_pc, app_pc instr
                 flush_start + flush_size);
         }
     } else {
-        ASSERT(!info.overlap || (f != NULL && TEST(FRAG_IS_TRACE, f->flags)));
+        /* For a deleted f, info.overlap only says that f contains the instr: see
+         * the slow lookup above.
+         */
+        ASSERT(!info.overlap ||
+               (f != NULL && TESTANY(FRAG_IS_TRACE | FRAG_WAS_DELETED, f->flags)));
         /* instr not in region, so move entire region off the executable list */
         flush_start = base_pc;
         flush_size = size;
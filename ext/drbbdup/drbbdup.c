@@ -36,7 +36,9 @@
 #include "drreg.h"
 #include "hashtable.h"
 #include "drbbdup.h"
+#include <limits.h>
 #include <string.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "../ext_utils.h"
 
@@ -77,7 +79,8 @@ typedef enum {
     DRBBDUP_XAX_REG_SLOT = 1,
     DRBBDUP_FLAG_REG_SLOT = 2,
     DRBBDUP_HIT_TABLE_SLOT = 3,
-    DRBBDUP_SLOT_COUNT = 4, /* Need to update if more slots are added. */
+    DRBBDUP_STATS_SLOT = 4, /* Points to the thread's statistics. */
+    DRBBDUP_SLOT_COUNT = 5, /* Need to update if more slots are added. */
 } drbbdup_thread_slots_t;
 
 /* A scratch register used by drbbdup's dispatcher. */
@@ -87,6 +90,13 @@ typedef enum {
 #define DRBBDUP_DEFAULT_INDEX -1
 #define DRBBDUP_IGNORE_INDEX -2
 
+/* Dispatch switches from a compare chain to an indexed jump table once a bb has at
+ * least this many cases and they cover at least half of their encoding range.
+ */
+#define DRBBDUP_JUMP_TABLE_MIN_CASES 4
+/* Each jump table entry is a rel32 jmp. */
+#define DRBBDUP_JUMP_TABLE_ENTRY_SIZE 5
+
 /* Contains information of a case that maps to a copy of a bb. */
 typedef struct {
     uintptr_t encoding; /* The encoding specific to the case. */
@@ -110,7 +120,7 @@ typedef enum {
     DRBBDUP_LABEL_EXIT = 79,  /* Denotes the end of all bb copies. */
 } drbbdup_label_t;
 
-typedef struct {
+typedef struct _drbbdup_per_thread {
     int case_index; /* Used to keep track of the current case during insertion. */
     void *orig_analysis_data;        /* Analysis data accessible for all cases. */
     void *default_analysis_data;     /* Analysis data specific to default case. */
@@ -119,6 +129,12 @@ typedef struct {
     instr_t *first_instr;          /* The first instr of the bb copy being considered. */
     instr_t *first_nonlabel_instr; /* The first non label instr of the bb copy. */
     instr_t *last_instr;           /* The last instr of the bb copy being considered. */
+    bool use_jump_table;           /* Whether this bb dispatches via a jump table. */
+    instr_t **case_labels;         /* Jump table targets, indexed like cases. */
+    drbbdup_stats_t stats;         /* This thread's share of the statistics. */
+    /* Chains the live threads for drbbdup_get_stats(). */
+    struct _drbbdup_per_thread *stat_next;
+    struct _drbbdup_per_thread *stat_prev;
 } drbbdup_per_thread;
 
 static uint ref_count = 0;        /* Instance count of drbbdup. */
@@ -126,9 +142,13 @@ static hashtable_t manager_table; /* Maps bbs with book-keeping data. */
 static drbbdup_options_t opts;
 static void *rw_lock = NULL;
 
-/* For tracking statistics. */
+/* For tracking statistics. Each thread counts into its own drbbdup_per_thread, so
+ * stat_mutex is only taken at thread init and exit and by drbbdup_get_stats(), which
+ * sums the live threads' counters with the totals of exited threads kept in stats.
+ */
 static void *stat_mutex = NULL;
 static drbbdup_stats_t stats;
+static drbbdup_per_thread *stat_threads = NULL;
 
 /* An outlined code cache (storing a clean call) for dynamically generating a case. */
 static app_pc new_case_cache_pc = NULL;
@@ -405,12 +425,12 @@ drbbdup_duplicate_phase(void *drcontext, void *tag, instrlist_t *bb, bool for_tr
         ASSERT(manager != NULL, "created manager cannot be NULL");
         hashtable_add(&manager_table, pc, manager);
         if (opts.is_stat_enabled) {
-            dr_mutex_lock(stat_mutex);
+            drbbdup_per_thread *pt =
+                (drbbdup_per_thread *)drmgr_get_tls_field(drcontext, tls_idx);
             if (!manager->enable_dup)
-                stats.no_dup_count++;
+                pt->stats.no_dup_count++;
             if (!manager->enable_dynamic_handling)
-                stats.no_dynamic_handling_count++;
-            dr_mutex_unlock(stat_mutex);
+                pt->stats.no_dynamic_handling_count++;
         }
     }
 
@@ -795,6 +815,108 @@ drbbdup_insert_dispatch(void *drcontext, instrlist_t *bb, instr_t *where,
     drbbdup_insert_landing_restoration(drcontext, bb, where, manager);
 }
 
+/* Returns whether the cases of manager are dense enough to be dispatched via a jump
+ * table, in which case the smallest encoding and the table length are also returned.
+ */
+static bool
+drbbdup_use_jump_table(drbbdup_manager_t *manager, OUT uintptr_t *min_encoding,
+                       OUT uint *table_len)
+{
+    uintptr_t min = UINTPTR_MAX;
+    uintptr_t max = 0;
+    uint count = 0;
+    int i;
+
+    /* The miss path reloads the encoding, which the scratch reg cannot be part of. */
+    if (opnd_uses_reg(opts.runtime_case_opnd, DRBBDUP_SCRATCH_REG))
+        return false;
+    for (i = 0; i < opts.non_default_case_limit; i++) {
+        if (!manager->cases[i].is_defined)
+            continue;
+        count++;
+        if (manager->cases[i].encoding < min)
+            min = manager->cases[i].encoding;
+        if (manager->cases[i].encoding > max)
+            max = manager->cases[i].encoding;
+    }
+    /* The rebasing subtraction takes a sign-extended 32-bit immediate. */
+    if (count < DRBBDUP_JUMP_TABLE_MIN_CASES || max - min >= 2 * count ||
+        min > INT_MAX)
+        return false;
+    *min_encoding = min;
+    *table_len = (uint)(max - min + 1);
+    return true;
+}
+
+/* Inserts an indexed dispatch replacing the compare chain: the runtime encoding in
+ * the scratch register is rebased and bounds-checked, then used to index a table of
+ * rel32 jmps to the landing of each case.  Holes and out-of-range encodings reload
+ * the encoding and go to the default case, exactly as a failed chain would.
+ */
+static void
+drbbdup_insert_jump_table(void *drcontext, instrlist_t *bb, instr_t *where,
+                          drbbdup_manager_t *manager, drbbdup_per_thread *pt,
+                          instr_t *default_label, uintptr_t min_encoding,
+                          uint table_len)
+{
+    opnd_t scratch_opnd = opnd_create_reg(DRBBDUP_SCRATCH_REG);
+    opnd_t slot_opnd = drbbdup_get_tls_raw_slot_opnd(DRBBDUP_ENCODING_SLOT);
+    instr_t *table_label = INSTR_CREATE_label(drcontext);
+    instr_t *miss_label = INSTR_CREATE_label(drcontext);
+    uint idx;
+    int i;
+
+    if (min_encoding != 0) {
+        instrlist_meta_preinsert(bb, where,
+                                 XINST_CREATE_sub(drcontext, scratch_opnd,
+                                                  OPND_CREATE_INT32((int)min_encoding)));
+    }
+    instrlist_meta_preinsert(
+        bb, where,
+        XINST_CREATE_cmp(drcontext, scratch_opnd, OPND_CREATE_INT32(table_len - 1)));
+    instrlist_meta_preinsert(
+        bb, where, INSTR_CREATE_jcc(drcontext, OP_ja, opnd_create_instr(miss_label)));
+
+    /* Target is table_label + index * DRBBDUP_JUMP_TABLE_ENTRY_SIZE.  The encoding
+     * slot is free to hold the offset as the miss path is the only one needing the
+     * encoding again and it reloads it.
+     */
+    instrlist_meta_preinsert(
+        bb, where,
+        INSTR_CREATE_lea(drcontext, scratch_opnd,
+                         opnd_create_base_disp(DRBBDUP_SCRATCH_REG, DRBBDUP_SCRATCH_REG,
+                                               DRBBDUP_JUMP_TABLE_ENTRY_SIZE - 1, 0,
+                                               OPSZ_lea)));
+    instrlist_meta_preinsert(bb, where,
+                             XINST_CREATE_store(drcontext, slot_opnd, scratch_opnd));
+    instrlist_insert_mov_instr_addr(drcontext, table_label, NULL /*in cache*/,
+                                    scratch_opnd, bb, where, NULL, NULL);
+    instrlist_meta_preinsert(bb, where,
+                             INSTR_CREATE_add(drcontext, scratch_opnd, slot_opnd));
+    instrlist_meta_preinsert(bb, where, INSTR_CREATE_jmp_ind(drcontext, scratch_opnd));
+
+    instrlist_meta_preinsert(bb, where, table_label);
+    for (idx = 0; idx < table_len; idx++) {
+        instr_t *target = miss_label;
+        for (i = 0; i < opts.non_default_case_limit; i++) {
+            if (manager->cases[i].is_defined &&
+                manager->cases[i].encoding == min_encoding + idx) {
+                target = pt->case_labels[i];
+                break;
+            }
+        }
+        /* OP_jmp is never shortened, keeping every entry the same size. */
+        instrlist_meta_preinsert(bb, where,
+                                 INSTR_CREATE_jmp(drcontext, opnd_create_instr(target)));
+    }
+
+    instrlist_meta_preinsert(bb, where, miss_label);
+    instrlist_meta_preinsert(
+        bb, where, XINST_CREATE_load(drcontext, scratch_opnd, opts.runtime_case_opnd));
+    instrlist_meta_preinsert(
+        bb, where, XINST_CREATE_jump(drcontext, opnd_create_instr(default_label)));
+}
+
 /* Returns whether or not additional cases should be handled by checking if the
  * copy limit, defined by the user, has been reached.
  */
@@ -813,13 +935,21 @@ drbbdup_do_dynamic_handling(drbbdup_manager_t *manager)
     return false;
 }
 
-/* Increments the execution count of bails to default case. */
+/* Inserts an increment of the thread's count of bails to the default case. The
+ * scratch register and flags have both been saved by the dispatcher at this point.
+ */
 static void
-drbbdup_inc_bail_count()
+drbbdup_insert_inc_bail_count(void *drcontext, instrlist_t *bb, instr_t *where)
 {
-    dr_mutex_lock(stat_mutex);
-    stats.bail_count++;
-    dr_mutex_unlock(stat_mutex);
+    opnd_t stats_opnd = drbbdup_get_tls_raw_slot_opnd(DRBBDUP_STATS_SLOT);
+    opnd_t count_opnd = opnd_create_base_disp(
+        DRBBDUP_SCRATCH_REG, DR_REG_NULL, 0, offsetof(drbbdup_stats_t, bail_count),
+        opnd_size_from_bytes(sizeof(((drbbdup_stats_t *)0)->bail_count)));
+
+    instrlist_meta_preinsert(
+        bb, where,
+        XINST_CREATE_load(drcontext, opnd_create_reg(DRBBDUP_SCRATCH_REG), stats_opnd));
+    instrlist_meta_preinsert(bb, where, INSTR_CREATE_inc(drcontext, count_opnd));
 }
 
 /* Insert trigger for dynamic case handling. */
@@ -891,14 +1021,8 @@ drbbdup_insert_dynamic_handling(void *drcontext, app_pc translation_pc, void *ta
         }
     }
 
-    /* XXX i#4215: Use atomic counter when 64-bit sized integers can be used
-     * on 32-bit platforms.
-     */
-    if (opts.is_stat_enabled) {
-        /* Insert clean call so that we can lock stat_mutex. */
-        dr_insert_clean_call(drcontext, bb, where, (void *)drbbdup_inc_bail_count, false,
-                             0);
-    }
+    if (opts.is_stat_enabled)
+        drbbdup_insert_inc_bail_count(drcontext, bb, where);
 
     instrlist_meta_preinsert(bb, where, done_label);
 }
@@ -1010,6 +1134,27 @@ drbbdup_instrument_dups(void *drcontext, app_pc pc, void *tag, instrlist_t *bb,
             /* We have reached the start of a new bb version (not the last one). */
             bool found = false;
             int i;
+            if (pt->case_index == -1) {
+                /* This is the first copy: decide how to dispatch. */
+                uintptr_t min_encoding;
+                uint table_len;
+                pt->use_jump_table =
+                    drbbdup_use_jump_table(manager, &min_encoding, &table_len);
+                if (pt->use_jump_table) {
+                    instr_t *default_label = next_bb_label;
+                    instr_t *next_start;
+                    while ((next_start = drbbdup_next_start(drbbdup_next_end(
+                                instr_get_next(default_label)))) != NULL)
+                        default_label = next_start;
+                    for (i = 0; i < opts.non_default_case_limit; i++) {
+                        pt->case_labels[i] = manager->cases[i].is_defined
+                            ? INSTR_CREATE_label(drcontext)
+                            : NULL;
+                    }
+                    drbbdup_insert_jump_table(drcontext, bb, next_instr, manager, pt,
+                                              default_label, min_encoding, table_len);
+                }
+            }
             for (i = pt->case_index + 1; i < opts.non_default_case_limit; i++) {
                 drbbdup_case = &manager->cases[i];
                 if (drbbdup_case->is_defined) {
@@ -1022,9 +1167,15 @@ drbbdup_instrument_dups(void *drcontext, app_pc pc, void *tag, instrlist_t *bb,
             ASSERT(pt->case_index + 1 == i,
                    "the next case considered should be the next increment");
             pt->case_index = i; /* Move on to the next case. */
-            drbbdup_insert_dispatch(drcontext, bb,
-                                    next_instr /* insert after START label. */, manager,
-                                    next_bb_label, drbbdup_case);
+            if (pt->use_jump_table) {
+                /* The table jumps straight here, skipping the compare. */
+                instrlist_meta_preinsert(bb, next_instr, pt->case_labels[i]);
+                drbbdup_insert_landing_restoration(drcontext, bb, next_instr, manager);
+            } else {
+                drbbdup_insert_dispatch(drcontext, bb,
+                                        next_instr /* insert after START label. */,
+                                        manager, next_bb_label, drbbdup_case);
+            }
         }
 
         /* XXX i#4134: statistics -- insert code that tracks the number of times the
@@ -1260,12 +1411,10 @@ drbbdup_handle_new_case()
                 manager->is_gen = true;
 
             if (opts.is_stat_enabled) {
-                dr_mutex_lock(stat_mutex);
                 if (do_gen)
-                    stats.gen_count++;
+                    pt->stats.gen_count++;
                 if (!manager->enable_dynamic_handling)
-                    stats.no_dynamic_handling_count++;
-                dr_mutex_unlock(stat_mutex);
+                    pt->stats.no_dynamic_handling_count++;
             }
         }
     }
@@ -1406,6 +1555,15 @@ drbbdup_is_last_instr(void *drcontext, instr_t *instr, bool *is_last)
     return DRBBDUP_SUCCESS;
 }
 
+static void
+drbbdup_add_stats(drbbdup_stats_t *sum, const drbbdup_stats_t *add)
+{
+    sum->no_dup_count += add->no_dup_count;
+    sum->no_dynamic_handling_count += add->no_dynamic_handling_count;
+    sum->gen_count += add->gen_count;
+    sum->bail_count += add->bail_count;
+}
+
 drbbdup_status_t
 drbbdup_get_stats(OUT drbbdup_stats_t *stats_in)
 {
@@ -1415,9 +1573,13 @@ drbbdup_get_stats(OUT drbbdup_stats_t *stats_in)
         stats_in->struct_size > stats.struct_size)
         return DRBBDUP_ERROR_INVALID_PARAMETER;
 
+    drbbdup_stats_t sum;
     dr_mutex_lock(stat_mutex);
-    memcpy(stats_in, &stats, stats_in->struct_size);
+    memcpy(&sum, &stats, sizeof(sum));
+    for (drbbdup_per_thread *pt = stat_threads; pt != NULL; pt = pt->stat_next)
+        drbbdup_add_stats(&sum, &pt->stats);
     dr_mutex_unlock(stat_mutex);
+    memcpy(stats_in, &sum, stats_in->struct_size);
     return DRBBDUP_SUCCESS;
 }
 
@@ -1451,12 +1613,30 @@ drbbdup_thread_init(void *drcontext)
     pt->case_analysis_data =
         dr_thread_alloc(drcontext, sizeof(void *) * opts.non_default_case_limit);
     memset(pt->case_analysis_data, 0, sizeof(void *) * opts.non_default_case_limit);
+    pt->use_jump_table = false;
+    pt->case_labels =
+        dr_thread_alloc(drcontext, sizeof(instr_t *) * opts.non_default_case_limit);
+    memset(pt->case_labels, 0, sizeof(instr_t *) * opts.non_default_case_limit);
 
     /* Init hit table. */
     for (int i = 0; i < TABLE_SIZE; i++)
         pt->hit_counts[i] = opts.hit_threshold;
     drbbdup_set_tls_raw_slot_val(DRBBDUP_HIT_TABLE_SLOT, (uintptr_t)pt->hit_counts);
 
+    memset(&pt->stats, 0, sizeof(pt->stats));
+    pt->stats.struct_size = sizeof(pt->stats);
+    pt->stat_prev = NULL;
+    pt->stat_next = NULL;
+    drbbdup_set_tls_raw_slot_val(DRBBDUP_STATS_SLOT, (uintptr_t)&pt->stats);
+    if (opts.is_stat_enabled) {
+        dr_mutex_lock(stat_mutex);
+        pt->stat_next = stat_threads;
+        if (stat_threads != NULL)
+            stat_threads->stat_prev = pt;
+        stat_threads = pt;
+        dr_mutex_unlock(stat_mutex);
+    }
+
     drmgr_set_tls_field(drcontext, tls_idx, (void *)pt);
 }
 
@@ -1468,6 +1648,21 @@ drbbdup_thread_exit(void *drcontext)
     ASSERT(pt != NULL, "thread-local storage should not be NULL");
     ASSERT(opts.non_default_case_limit > 0, "dup limit should be greater than zero");
 
+    if (opts.is_stat_enabled) {
+        /* Fold this thread's counts into the totals. */
+        dr_mutex_lock(stat_mutex);
+        drbbdup_add_stats(&stats, &pt->stats);
+        if (pt->stat_prev != NULL)
+            pt->stat_prev->stat_next = pt->stat_next;
+        else
+            stat_threads = pt->stat_next;
+        if (pt->stat_next != NULL)
+            pt->stat_next->stat_prev = pt->stat_prev;
+        dr_mutex_unlock(stat_mutex);
+    }
+
+    dr_thread_free(drcontext, pt->case_labels,
+                   sizeof(instr_t *) * opts.non_default_case_limit);
     dr_thread_free(drcontext, pt->case_analysis_data,
                    sizeof(void *) * opts.non_default_case_limit);
     dr_thread_free(drcontext, pt, sizeof(drbbdup_per_thread));
@@ -1552,6 +1747,7 @@ drbbdup_init(drbbdup_options_t *ops_in)
     if (opts.is_stat_enabled) {
         memset(&stats, 0, sizeof(drbbdup_stats_t));
         stats.struct_size = sizeof(drbbdup_stats_t);
+        stat_threads = NULL;
         stat_mutex = dr_mutex_create();
         if (stat_mutex == NULL)
             return DRBBDUP_ERROR;
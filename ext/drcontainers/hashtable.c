@@ -152,9 +152,117 @@ hash_free(void *ptr, size_t size)
 #define HASH_FUNC_BITS(val, num_bits) ((val) & (HASH_MASK(num_bits)))
 #define HASH_FUNC(val, mask) ((val) & (mask))
 
+/* Read-mostly tables (hashtable_config_t.read_mostly) are traversed by lookups
+ * without the lock, so writers publish bucket heads, next pointers, and the
+ * bucket array with these, and lookups read them with these.  DR's atomic
+ * accessors include the barriers needed on weakly-ordered architectures.
+ */
+static inline void *
+load_ptr(void *volatile *src)
+{
+#ifdef X64
+    return (void *)(ptr_int_t)dr_atomic_load64((volatile int64 *)src);
+#else
+    return (void *)(ptr_int_t)dr_atomic_load32((volatile int *)src);
+#endif
+}
+
+static inline void
+store_ptr(void *volatile *dst, void *val)
+{
+#ifdef X64
+    dr_atomic_store64((volatile int64 *)dst, (int64)(ptr_int_t)val);
+#else
+    dr_atomic_store32((volatile int *)dst, (int)(ptr_int_t)val);
+#endif
+}
+
+/* Memory from a read-mostly table that a concurrent lookup may still be reading. */
+typedef struct _retired_t {
+    void *ptr;
+    size_t size;   /* For a bucket array; 0 for a hash_entry_t. */
+    bool free_key; /* For a hash_entry_t: whether its key is ours to free. */
+    struct _retired_t *next;
+} retired_t;
+
+/* caller must hold lock */
+static void
+retire(hashtable_t *table, void *ptr, size_t size, bool free_key)
+{
+    retired_t *r = (retired_t *)hash_alloc(sizeof(*r));
+    r->ptr = ptr;
+    r->size = size;
+    r->free_key = free_key;
+    r->next = (retired_t *)table->retired;
+    table->retired = r;
+}
+
+static void
+hash_free_key(hashtable_t *table, void *key)
+{
+    if (table->str_dup)
+        hash_free(key, strlen((const char *)key) + 1);
+    else if (table->config.free_key_func != NULL)
+        (table->config.free_key_func)(key);
+}
+
 /* caller must hold lock */
+static void
+free_retired_internal(hashtable_t *table)
+{
+    retired_t *r, *next;
+    for (r = (retired_t *)table->retired; r != NULL; r = next) {
+        next = r->next;
+        if (r->size > 0)
+            hash_free(r->ptr, r->size);
+        else {
+            hash_entry_t *e = (hash_entry_t *)r->ptr;
+            if (r->free_key)
+                hash_free_key(table, e->key);
+            hash_free(e, sizeof(*e));
+        }
+        hash_free(r, sizeof(*r));
+    }
+    table->retired = NULL;
+}
+
+/* Unlinks e, whose predecessor is prev_e or NULL if e is at the head of its
+ * bucket.  For a read-mostly table, a concurrent lookup may be at e, so e's own
+ * next pointer is left intact.
+ * caller must hold lock
+ */
+static inline void
+unlink_entry(hashtable_t *table, uint hindex, hash_entry_t *prev_e, hash_entry_t *e,
+             hash_entry_t *replacement)
+{
+    hash_entry_t **link = prev_e == NULL ? &table->table[hindex] : &prev_e->next;
+    hash_entry_t *target = replacement == NULL ? e->next : replacement;
+    if (table->config.read_mostly)
+        store_ptr((void *volatile *)link, target);
+    else
+        *link = target;
+}
+
+/* Frees a removed entry, or for a read-mostly table defers that until no lookup
+ * can be using it.  The payload is the caller's responsibility.
+ * caller must hold lock
+ */
+static inline void
+free_entry(hashtable_t *table, hash_entry_t *e)
+{
+    if (table->config.read_mostly)
+        retire(table, e, 0, true);
+    else {
+        hash_free_key(table, e->key);
+        hash_free(e, sizeof(*e));
+    }
+}
+
+/* caller must hold lock, or for a read-mostly table pass a consistent snapshot
+ * of table_bits
+ */
 static uint
-hash_key(hashtable_t *table, void *key)
+hash_key_bits(hashtable_t *table, void *key, uint table_bits)
 {
     uint hash = 0;
     if (table->hash_key_func != NULL) {
@@ -163,7 +271,7 @@ hash_key(hashtable_t *table, void *key)
         const char *s = (const char *)key;
         char c;
         uint i, shift;
-        uint max_shift = ALIGN_FORWARD(table->table_bits, 8);
+        uint max_shift = ALIGN_FORWARD(table_bits, 8);
         /* XXX: share w/ core's hash_value() function */
         for (i = 0; s[i] != '\0'; i++) {
             c = s[i];
@@ -180,7 +288,14 @@ hash_key(hashtable_t *table, void *key)
                "hashtable.c hash_key internal error: invalid hash type");
         hash = (uint)(ptr_uint_t)key;
     }
-    return HASH_FUNC_BITS(hash, table->table_bits);
+    return HASH_FUNC_BITS(hash, table_bits);
+}
+
+/* caller must hold lock */
+static uint
+hash_key(hashtable_t *table, void *key)
+{
+    return hash_key_bits(table, key, table->table_bits);
 }
 
 static bool
@@ -227,6 +342,9 @@ hashtable_init_ex(hashtable_t *table, uint num_bits, hash_type_t hashtype, bool
     table->config.resizable = true;
     table->config.resize_threshold = 75;
     table->config.free_key_func = NULL;
+    table->config.read_mostly = false;
+    table->resize_seq = 0;
+    table->retired = NULL;
 }
 
 void
@@ -246,6 +364,8 @@ hashtable_configure(hashtable_t *table, hashtable_config_t *config)
         table->config.resize_threshold = config->resize_threshold;
     if (config->size > offsetof(hashtable_config_t, free_key_func))
         table->config.free_key_func = config->free_key_func;
+    if (config->size > offsetof(hashtable_config_t, read_mostly))
+        table->config.read_mostly = config->read_mostly;
 }
 
 void
@@ -266,6 +386,32 @@ hashtable_lock_self_owns(hashtable_t *table)
     return dr_mutex_self_owns(table->lock);
 }
 
+/* Lock-free lookup for a read-mostly table.  Writers never modify an entry that
+ * is reachable from the table, other than its next pointer, and never free one
+ * until hashtable_free_retired(), so we only need a consistent view of the bucket
+ * array and its size, which resize_seq provides.
+ */
+static void *
+hashtable_lookup_read_mostly(hashtable_t *table, void *key)
+{
+    hash_entry_t **buckets;
+    hash_entry_t *e;
+    uint seq, bits;
+    do {
+        seq = (uint)dr_atomic_load32((volatile int *)&table->resize_seq);
+        buckets = (hash_entry_t **)load_ptr((void *volatile *)&table->table);
+        bits = (uint)dr_atomic_load32((volatile int *)&table->table_bits);
+    } while (TEST(1, seq) ||
+             (uint)dr_atomic_load32((volatile int *)&table->resize_seq) != seq);
+    for (e = (hash_entry_t *)load_ptr((void *volatile *)&buckets[hash_key_bits(
+             table, key, bits)]);
+         e != NULL; e = (hash_entry_t *)load_ptr((void *volatile *)&e->next)) {
+        if (keys_equal(table, e->key, key))
+            return e->payload;
+    }
+    return NULL;
+}
+
 /* Lookup an entry by key and return a pointer to the corresponding entry
  * Returns NULL if no such entry exists */
 void *
@@ -273,6 +419,8 @@ hashtable_lookup(hashtable_t *table, void *key)
 {
     void *res = NULL;
     hash_entry_t *e;
+    if (table->config.read_mostly)
+        return hashtable_lookup_read_mostly(table, key);
     if (table->synch) {
         dr_mutex_lock(table->lock);
     }
@@ -301,10 +449,39 @@ hashtable_check_for_resize(hashtable_t *table)
         uint i, old_bits;
         /* double the size */
         old_bits = table->table_bits;
-        table->table_bits++;
-        new_sz = (size_t)HASHTABLE_SIZE(table->table_bits) * sizeof(hash_entry_t *);
+        new_sz = (size_t)HASHTABLE_SIZE(old_bits + 1) * sizeof(hash_entry_t *);
         new_table = (hash_entry_t **)hash_alloc(new_sz);
         memset(new_table, 0, new_sz);
+        if (table->config.read_mostly) {
+            /* Lookups may be walking the old chains, so we rehash copies of the
+             * entries into the new array rather than relinking the originals, and
+             * retire the originals and the old array.
+             */
+            for (i = 0; i < HASHTABLE_SIZE(old_bits); i++) {
+                hash_entry_t *e;
+                for (e = table->table[i]; e != NULL; e = e->next) {
+                    hash_entry_t *copy = (hash_entry_t *)hash_alloc(sizeof(*copy));
+                    uint hindex = hash_key_bits(table, e->key, old_bits + 1);
+                    copy->key = e->key;
+                    copy->payload = e->payload;
+                    copy->next = new_table[hindex];
+                    new_table[hindex] = copy;
+                    retire(table, e, 0, false /* key now owned by copy */);
+                }
+            }
+            retire(table, table->table, capacity * sizeof(hash_entry_t *), false);
+            /* Publish the new array and size as a pair: see
+             * hashtable_lookup_read_mostly().
+             */
+            dr_atomic_store32((volatile int *)&table->resize_seq,
+                              (int)(table->resize_seq + 1));
+            store_ptr((void *volatile *)&table->table, new_table);
+            dr_atomic_store32((volatile int *)&table->table_bits, (int)(old_bits + 1));
+            dr_atomic_store32((volatile int *)&table->resize_seq,
+                              (int)(table->resize_seq + 1));
+            return true;
+        }
+        table->table_bits++;
         /* rehash the old table into the new */
         for (i = 0; i < HASHTABLE_SIZE(old_bits); i++) {
             hash_entry_t *e = table->table[i];
@@ -350,7 +527,10 @@ hashtable_add(hashtable_t *table, void *key, void *payload)
         e->key = key;
     e->payload = payload;
     e->next = table->table[hindex];
-    table->table[hindex] = e;
+    if (table->config.read_mostly)
+        store_ptr((void *volatile *)&table->table[hindex], e);
+    else
+        table->table[hindex] = e;
     table->entries++;
     hashtable_check_for_resize(table);
     if (table->synch)
@@ -379,24 +559,20 @@ hashtable_add_replace(hashtable_t *table, void *key, void *payload)
     new_e->payload = payload;
     for (e = table->table[hindex], prev_e = NULL; e != NULL; prev_e = e, e = e->next) {
         if (keys_equal(table, e->key, key)) {
-            if (prev_e == NULL)
-                table->table[hindex] = new_e;
-            else
-                prev_e->next = new_e;
             new_e->next = e->next;
-            if (table->str_dup)
-                hash_free(e->key, strlen((const char *)e->key) + 1);
-            else if (table->config.free_key_func != NULL)
-                (table->config.free_key_func)(e->key);
+            unlink_entry(table, hindex, prev_e, e, new_e);
             /* up to caller to free payload */
             old_payload = e->payload;
-            hash_free(e, sizeof(*e));
+            free_entry(table, e);
             break;
         }
     }
     if (old_payload == NULL) {
         new_e->next = table->table[hindex];
-        table->table[hindex] = new_e;
+        if (table->config.read_mostly)
+            store_ptr((void *volatile *)&table->table[hindex], new_e);
+        else
+            table->table[hindex] = new_e;
         table->entries++;
         hashtable_check_for_resize(table);
     }
@@ -416,17 +592,10 @@ hashtable_remove(hashtable_t *table, void *key)
     uint hindex = hash_key(table, key);
     for (e = table->table[hindex], prev_e = NULL; e != NULL; prev_e = e, e = e->next) {
         if (keys_equal(table, e->key, key)) {
-            if (prev_e == NULL)
-                table->table[hindex] = e->next;
-            else
-                prev_e->next = e->next;
-            if (table->str_dup)
-                hash_free(e->key, strlen((const char *)e->key) + 1);
-            else if (table->config.free_key_func != NULL)
-                (table->config.free_key_func)(e->key);
+            unlink_entry(table, hindex, prev_e, e, NULL);
             if (table->free_payload_func != NULL)
                 (table->free_payload_func)(e->payload);
-            hash_free(e, sizeof(*e));
+            free_entry(table, e);
             res = true;
             table->entries--;
             break;
@@ -449,17 +618,10 @@ hashtable_remove_range(hashtable_t *table, void *start, void *end)
         for (e = table->table[i], prev_e = NULL; e != NULL; e = next_e) {
             next_e = e->next;
             if (e->key >= start && e->key < end) {
-                if (prev_e == NULL)
-                    table->table[i] = e->next;
-                else
-                    prev_e->next = e->next;
-                if (table->str_dup)
-                    hash_free(e->key, strlen((const char *)e->key) + 1);
-                else if (table->config.free_key_func != NULL)
-                    (table->config.free_key_func)(e->key);
+                unlink_entry(table, i, prev_e, e, NULL);
                 if (table->free_payload_func != NULL)
                     (table->free_payload_func)(e->payload);
-                hash_free(e, sizeof(*e));
+                free_entry(table, e);
                 table->entries--;
                 res = true;
             } else
@@ -512,10 +674,7 @@ hashtable_clear_internal(hashtable_t *table)
         hash_entry_t *e = table->table[i];
         while (e != NULL) {
             hash_entry_t *nexte = e->next;
-            if (table->str_dup)
-                hash_free(e->key, strlen((const char *)e->key) + 1);
-            else if (table->config.free_key_func != NULL)
-                (table->config.free_key_func)(e->key);
+            hash_free_key(table, e->key);
             if (table->free_payload_func != NULL)
                 (table->free_payload_func)(e->payload);
             hash_free(e, sizeof(*e));
@@ -524,6 +683,7 @@ hashtable_clear_internal(hashtable_t *table)
         table->table[i] = NULL;
     }
     table->entries = 0;
+    free_retired_internal(table);
 }
 
 void
@@ -551,6 +711,16 @@ hashtable_delete(hashtable_t *table)
     dr_mutex_destroy(table->lock);
 }
 
+void
+hashtable_free_retired(hashtable_t *table)
+{
+    if (table->synch)
+        dr_mutex_lock(table->lock);
+    free_retired_internal(table);
+    if (table->synch)
+        dr_mutex_unlock(table->lock);
+}
+
 /***************************************************************************
  * PERSISTENCE
  */
@@ -85,6 +85,19 @@ typedef struct _hashtable_config_t {
      * to true in hashtable_init() or hashtable_init_ex(), this field is ignored.
      */
     void (*free_key_func)(void *);
+    /**
+     * Selects a read-mostly mode where hashtable_lookup() never acquires the table
+     * lock, for tables whose lookups vastly outnumber their updates.  Updates are
+     * still serialized by the lock (if the table is synchronized) and are published
+     * to concurrent lookups atomically.  Entries that are replaced or removed, and
+     * the old entries and bucket array from a resize, are not freed right away as
+     * a concurrent lookup may still be reading them: they are kept until
+     * hashtable_free_retired(), hashtable_clear(), or hashtable_delete() is called.
+     * Payloads are freed on removal as usual, so the caller must still ensure that
+     * a payload returned by a lookup is not in use when its entry is removed.
+     * This must be set before the table is shared with other threads.
+     */
+    bool read_mostly;
 } hashtable_config_t;
 
 typedef struct _hashtable_t {
@@ -100,6 +113,8 @@ typedef struct _hashtable_t {
     uint entries;
     hashtable_config_t config;
     uint persist_count;
+    volatile uint resize_seq; /* Odd while a read-mostly resize is publishing. */
+    void *retired;            /* Read-mostly memory awaiting reclamation. */
 } hashtable_t;
 
 /* should move back to utils.c once have iterator and alloc_exit
@@ -236,6 +251,17 @@ hashtable_clear(hashtable_t *table);
 void
 hashtable_delete(hashtable_t *table);
 
+/**
+ * For a table in hashtable_config_t.read_mostly mode, frees the entries and
+ * bucket arrays retired by prior updates.  The caller must guarantee that no
+ * hashtable_lookup() on \p table is in progress, e.g., by calling this while all
+ * other threads that access the table are suspended or otherwise known to be
+ * outside of it.  The same holds for hashtable_clear() and hashtable_delete() on
+ * a read-mostly table.
+ */
+void
+hashtable_free_retired(hashtable_t *table);
+
 /** Acquires the hashtable lock. */
 void
 hashtable_lock(hashtable_t *table);
@@ -73,6 +73,12 @@ static char logdir[MAXIMUM_PATH];
 
 typedef struct _per_thread_t {
     void *bb_table;
+    /* For DRCOVLIB_HIT_COUNTS: one uint64 counter per bb_table entry, at the
+     * same index.  The two tables are unsynchronized and guarded by lock (NULL
+     * for per-thread tables) so the indices stay in step.
+     */
+    void *count_table;
+    void *lock;
     file_t log;
     char logname[MAXIMUM_PATH];
 } per_thread_t;
@@ -83,6 +89,11 @@ static bool drcov_per_thread = false;
 static int sysnum_execve = IF_X64_ELSE(59, 11);
 #endif
 static volatile bool go_native;
+static bool hit_counts;
+/* The target of the counter update when translating, where we must emit the same
+ * instrumentation but have no table entry.
+ */
+static uint64 translate_count;
 static int tls_idx = -1;
 static int drcovlib_init_count;
 
@@ -131,6 +142,14 @@ bb_table_entry_print(ptr_uint_t idx, void *entry, void *iter_data)
     return true; /* continue iteration */
 }
 
+static bool
+bb_count_entry_print(ptr_uint_t idx, void *entry, void *iter_data)
+{
+    per_thread_t *data = iter_data;
+    dr_fprintf(data->log, "%llu\n", *(uint64 *)entry);
+    return true; /* continue iteration */
+}
+
 static void
 bb_table_print(void *drcontext, per_thread_t *data)
 {
@@ -145,15 +164,42 @@ bb_table_print(void *drcontext, per_thread_t *data)
         drtable_iterate(data->bb_table, data, bb_table_entry_print);
     } else
         drtable_dump_entries(data->bb_table, data->log);
+    if (data->count_table == NULL)
+        return;
+    if (data->lock != NULL)
+        dr_mutex_lock(data->lock);
+    ASSERT(drtable_num_entries(data->count_table) == drtable_num_entries(data->bb_table),
+           "count table out of sync");
+    dr_fprintf(data->log, "BB Hit Counts: %u bbs\n",
+               drtable_num_entries(data->count_table));
+    if (TEST(DRCOVLIB_DUMP_AS_TEXT, options.flags)) {
+        dr_fprintf(data->log, "count:\n");
+        drtable_iterate(data->count_table, data, bb_count_entry_print);
+    } else
+        drtable_dump_entries(data->count_table, data->log);
+    if (data->lock != NULL)
+        dr_mutex_unlock(data->lock);
 }
 
-static void
+/* Returns the bb's counter for DRCOVLIB_HIT_COUNTS, or NULL. */
+static uint64 *
 bb_table_entry_add(void *drcontext, per_thread_t *data, app_pc start, uint size)
 {
-    bb_entry_t *bb_entry = drtable_alloc(data->bb_table, 1, NULL);
+    bb_entry_t *bb_entry;
+    uint64 *count = NULL;
     uint mod_id;
     app_pc mod_start;
     drcovlib_status_t res = drmodtrack_lookup(drcontext, start, &mod_id, &mod_start);
+    if (data->lock != NULL)
+        dr_mutex_lock(data->lock);
+    bb_entry = drtable_alloc(data->bb_table, 1, NULL);
+    if (data->count_table != NULL) {
+        count = drtable_alloc(data->count_table, 1, NULL);
+        if (count != NULL)
+            *count = 0;
+    }
+    if (data->lock != NULL)
+        dr_mutex_unlock(data->lock);
     /* we do not de-duplicate repeated bbs */
     ASSERT(size < USHRT_MAX, "size overflow");
     bb_entry->size = (ushort)size;
@@ -171,6 +217,7 @@ bb_table_entry_add(void *drcontext, per_thread_t *data, app_pc start, uint size)
         bb_entry->mod_id = UNKNOWN_MODULE_ID;
         bb_entry->start = (uint)(ptr_uint_t)start;
     }
+    return count;
 }
 
 #define INIT_BB_TABLE_ENTRIES 4096
@@ -187,6 +234,16 @@ bb_table_destroy(void *table, void *data)
     drtable_destroy(table, data);
 }
 
+static void *
+count_table_create(void)
+{
+    /* The counters are the targets of absolute-address increments in the code
+     * cache and so must be reachable from it.
+     */
+    return drtable_create(INIT_BB_TABLE_ENTRIES, sizeof(uint64), DRTABLE_MEM_REACHABLE,
+                          false /* guarded by per_thread_t.lock */, NULL);
+}
+
 static void
 version_print(file_t log)
 {
@@ -247,7 +304,15 @@ thread_data_create(void *drcontext)
     /* XXX: can we assume bb create event is serialized,
      * if so, no lock is required for bb_table operation.
      */
-    data->bb_table = bb_table_create(drcontext == NULL ? true : false);
+    if (hit_counts) {
+        data->bb_table = bb_table_create(false);
+        data->count_table = count_table_create();
+        data->lock = drcontext == NULL ? dr_mutex_create() : NULL;
+    } else {
+        data->bb_table = bb_table_create(drcontext == NULL ? true : false);
+        data->count_table = NULL;
+        data->lock = NULL;
+    }
     log_file_create(drcontext, data);
     return data;
 }
@@ -257,6 +322,10 @@ thread_data_destroy(void *drcontext, per_thread_t *data)
 {
     /* destroy the bb table */
     bb_table_destroy(data->bb_table, data);
+    if (data->count_table != NULL)
+        drtable_destroy(data->count_table, data);
+    if (data->lock != NULL)
+        dr_mutex_destroy(data->lock);
     dr_close_file(data->log);
     /* free thread data */
     if (drcontext == NULL) {
@@ -330,8 +399,10 @@ event_basic_block_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for
     app_pc tag_pc, start_pc, end_pc;
 
     /* do nothing for translation */
-    if (translating)
+    if (translating) {
+        *user_data = &translate_count;
         return DR_EMIT_DEFAULT;
+    }
 
     data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
     /* Collect the number of instructions and the basic block size,
@@ -365,7 +436,7 @@ event_basic_block_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for
      * 4. The duplication can be easily handled in a post-processing step,
      *    which is required anyway.
      */
-    bb_table_entry_add(drcontext, data, tag_pc, (uint)(end_pc - start_pc));
+    *user_data = bb_table_entry_add(drcontext, data, tag_pc, (uint)(end_pc - start_pc));
 
     if (go_native)
         return DR_EMIT_GO_NATIVE;
@@ -373,6 +444,28 @@ event_basic_block_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for
         return DR_EMIT_DEFAULT;
 }
 
+/* For DRCOVLIB_HIT_COUNTS, increments the bb's counter on entry. */
+static dr_emit_flags_t
+event_basic_block_insert(void *drcontext, void *tag, instrlist_t *bb, instr_t *instr,
+                         bool for_trace, bool translating, void *user_data)
+{
+    uint64 *count = (uint64 *)user_data;
+    if (count == NULL || !drmgr_is_first_instr(drcontext, instr))
+        return DR_EMIT_DEFAULT;
+    /* XXX: 64-bit counters are not yet supported by drx on ARM, where we update the
+     * bottom half of the (little-endian) counter.
+     */
+    if (!drx_insert_counter_update(drcontext, bb, instr,
+                                   /* We're using drmgr, so these slots here won't be
+                                    * used: drreg's slots will be.
+                                    */
+                                   SPILL_SLOT_MAX + 1,
+                                   IF_AARCHXX_(SPILL_SLOT_MAX + 1) count, 1,
+                                   IF_AARCHXX_ELSE(0, DRX_COUNTER_64BIT)))
+        ASSERT(false, "failed to insert hit counter update");
+    return DR_EMIT_DEFAULT;
+}
+
 static void
 event_thread_exit(void *drcontext)
 {
@@ -543,7 +636,9 @@ drcovlib_init(drcovlib_options_t *ops)
 
     if (ops->struct_size != sizeof(options))
         return DRCOVLIB_ERROR_INVALID_PARAMETER;
-    if ((ops->flags & (~(DRCOVLIB_DUMP_AS_TEXT | DRCOVLIB_THREAD_PRIVATE))) != 0)
+    if ((ops->flags &
+         (~(DRCOVLIB_DUMP_AS_TEXT | DRCOVLIB_THREAD_PRIVATE | DRCOVLIB_HIT_COUNTS))) !=
+        0)
         return DRCOVLIB_ERROR_INVALID_PARAMETER;
     if (TEST(DRCOVLIB_THREAD_PRIVATE, ops->flags)) {
         if (!dr_using_all_private_caches())
@@ -561,6 +656,7 @@ drcovlib_init(drcovlib_options_t *ops)
         options.logprefix = "drcov";
     if (options.native_until_thread > 0)
         go_native = true;
+    hit_counts = TEST(DRCOVLIB_HIT_COUNTS, options.flags);
 
     drmgr_init();
     drx_init();
@@ -575,7 +671,8 @@ drcovlib_init(drcovlib_options_t *ops)
 
     drmgr_register_thread_init_event(event_thread_init);
     drmgr_register_thread_exit_event(event_thread_exit);
-    drmgr_register_bb_instrumentation_event(event_basic_block_analysis, NULL, NULL);
+    drmgr_register_bb_instrumentation_event(
+        event_basic_block_analysis, hit_counts ? event_basic_block_insert : NULL, NULL);
     dr_register_filter_syscall_event(event_filter_syscall);
     drmgr_register_pre_syscall_event(event_pre_syscall);
 #ifdef UNIX
@@ -78,6 +78,19 @@ typedef enum {
      * drcovlib's own thread exit events rather than in drcovlib_exit().
      */
     DRCOVLIB_THREAD_PRIVATE = 0x0002,
+    /**
+     * Requests that an execution count be kept for each recorded basic block,
+     * in addition to the default record of which blocks were executed.  An
+     * inline counter increment is inserted at the top of each block, which
+     * adds runtime overhead over the default instrumentation-free mode.  The
+     * counts are written to a separate section following the basic block table
+     * in the log file and are used by \ref sec_drcov2lcov for its per-line
+     * execution counts.  In the default process-wide mode, the increments are
+     * not atomic, so counts for blocks executed concurrently by several
+     * threads may be slightly low.  Counters are 64-bit on x86; on ARM only
+     * the bottom 32 bits are updated.
+     */
+    DRCOVLIB_HIT_COUNTS = 0x0004,
 } drcovlib_flags_t;
 
 /** Specifies the options when initializing drcovlib. */
@@ -142,6 +155,12 @@ typedef struct _bb_entry_t {
     ushort mod_id;
 } bb_entry_t;
 
+/* With #DRCOVLIB_HIT_COUNTS, the basic block table is followed by a
+ * "BB Hit Counts: %u bbs" line and then one uint64 per basic block table
+ * entry, in the same order as the table.  Readers that do not know about
+ * this section simply ignore it, so the file format version is unchanged.
+ */
+
 /***************************************************************************
  * Coverage interface
  */
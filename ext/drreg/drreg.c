@@ -43,6 +43,7 @@
 #include "dr_api.h"
 #include "drmgr.h"
 #include "drvector.h"
+#include "hashtable.h"
 #include "drreg.h"
 #include "../ext_utils.h"
 #include <string.h>
@@ -70,22 +71,47 @@
 
 #define AFLAGS_SLOT 0 /* always */
 
-/* We support using GPR registers only: [DR_REG_START_GPR..DR_REG_STOP_GPR] */
+#define GPR_IDX(reg) ((reg)-DR_REG_START_GPR)
+
+/* We support GPR registers [DR_REG_START_GPR..DR_REG_STOP_GPR] plus, through
+ * drreg_reserve_register_ex(), SIMD registers.  SIMD registers are tracked by
+ * index (see simd_index()) and their app values are kept in a separate
+ * dr_raw_tls_calloc() area of SIMD_SLOT_SIZE-byte slots.
+ */
+#ifdef X86
+#    define NUM_SIMD_REGS IF_X64_ELSE(16, 8)
+#    define SIMD_SLOT_SIZE 32 /* a ymm register */
+#else
+/* Only AArch64 supports reservation: 32-bit ARM fails it for now. */
+#    define NUM_SIMD_REGS IF_X64_ELSE(32, 16)
+#    define SIMD_SLOT_SIZE 16 /* a q register */
+#endif
+/* The raw TLS area can't hold more than this */
+#define MAX_SIMD_SPILLS 32
+/* We align the SIMD area by hand: dr_raw_tls_calloc()'s alignment applies to every
+ * slot of the allocation, which never holds for more than one pointer-sized slot.
+ */
+#define SIMD_SLOT_ALIGN 16
+
+/* A set of GPRs, with bit GPR_IDX(reg) standing for reg (DR_NUM_GPR_REGS <= 64). */
+typedef uint64 reg_mask_t;
+
+#define REG_MASK(reg) (((reg_mask_t)1) << GPR_IDX(reg))
+#define REG_MASK_ALL ((reg_mask_t)-1)
 
-#define REG_DEAD ((void *)(ptr_uint_t)0)
-#define REG_LIVE ((void *)(ptr_uint_t)1)
-#define REG_UNKNOWN ((void *)(ptr_uint_t)2) /* only used outside drmgr insert phase */
+/* Liveness at one instr in the bb.  The whole bb is computed in a single backward
+ * pass into a per-thread array of these, one entry per instr (app or meta).
+ */
+typedef struct _live_info_t {
+    reg_mask_t regs; /* bit set if the GPR is live */
+    uint aflags;     /* the EFLAGS_READ_ARITH bits of the live arithmetic flags */
+    uint simd;       /* bit i set if any part of SIMD register i is live */
+} live_info_t;
+
+/* Initial capacity of the per-thread live_info_t array: it grows as needed. */
+#define LIVE_INFO_INIT_CAPACITY 64
 
 typedef struct _reg_info_t {
-    /* XXX: better to flip around and store bitvector of registers per instr
-     * in a single drvector_t?
-     */
-    /* The live vector holds one entry per app instr in the bb.
-     * For registers, each vector entry holds REG_{LIVE,DEAD}.
-     * For aflags, each vector entry holds a ptr_uint_t with the EFLAGS_READ_ARITH bits
-     * telling which arithmetic flags are live at that point.
-     */
-    drvector_t live;
     bool in_use;
     uint app_uses; /* # of uses in this bb by app */
     /* With lazy restore, and b/c we must set native to false, we need to record
@@ -98,20 +124,27 @@ typedef struct _reg_info_t {
     bool native;   /* app value is in original app reg */
     reg_id_t xchg; /* if !native && != REG_NULL, value was exchanged w/ this dead reg */
     int slot;      /* if !native && xchg==REG_NULL, value is in this TLS slot # */
+    /* For SIMD registers only: the register handed out, whose width determines how
+     * much is spilled and restored.
+     */
+    reg_id_t simd_reg;
 } reg_info_t;
 
 /* We use this in per_thread_t.slot_use[] and other places */
 #define DR_REG_EFLAGS DR_REG_INVALID
 
-#define GPR_IDX(reg) ((reg)-DR_REG_START_GPR)
-
 typedef struct _per_thread_t {
     instr_t *cur_instr;
     int live_idx;
+    live_info_t *live; /* indexed by live_idx */
+    uint live_capacity;
     reg_info_t reg[DR_NUM_GPR_REGS];
     reg_info_t aflags;
     reg_id_t slot_use[MAX_SPILLS]; /* holds the reg_id_t of which reg is inside */
     int pending_unreserved;        /* count of to-be-lazily-restored unreserved regs */
+    reg_info_t simd[NUM_SIMD_REGS];
+    reg_id_t simd_slot_use[MAX_SIMD_SPILLS]; /* which SIMD reg is in each SIMD slot */
+    int simd_pending_unreserved;
     /* We store the linear address of our TLS for access from another thread: */
     byte *tls_seg_base;
     /* bb-local values */
@@ -124,6 +157,12 @@ static drreg_options_t ops;
 static int tls_idx = -1;
 static uint tls_slot_offs;
 static reg_id_t tls_seg;
+static uint tls_simd_offs; /* the SIMD spill area, in the same segment */
+static uint tls_simd_raw_offs;
+static uint tls_simd_raw_slots;
+/* For drreg_options_t.cross_block_liveness: see drreg_exit_liveness_hint(). */
+static hashtable_t hint_table;
+static void *hint_lock;
 
 #ifdef DEBUG
 static uint stats_max_slot;
@@ -136,6 +175,10 @@ static drreg_status_t
 drreg_restore_reg_now(void *drcontext, instrlist_t *ilist, instr_t *inst,
                       per_thread_t *pt, reg_id_t reg);
 
+static void
+drreg_restore_simd_now(void *drcontext, instrlist_t *ilist, instr_t *inst,
+                       per_thread_t *pt, int idx);
+
 static void
 drreg_move_aflags_from_reg(void *drcontext, instrlist_t *ilist, instr_t *where,
                            per_thread_t *pt, bool stateful);
@@ -249,6 +292,95 @@ get_spilled_value(void *drcontext, uint slot)
     }
 }
 
+/* Returns the index of the reservable SIMD register that reg is all or part of,
+ * or -1 if there is none.
+ */
+static inline int
+simd_index(reg_id_t reg)
+{
+#ifdef X86
+    if (reg >= DR_REG_START_XMM && reg < DR_REG_START_XMM + NUM_SIMD_REGS)
+        return reg - DR_REG_START_XMM;
+    if (reg >= DR_REG_START_YMM && reg < DR_REG_START_YMM + NUM_SIMD_REGS)
+        return reg - DR_REG_START_YMM;
+    if (reg >= DR_REG_START_ZMM && reg < DR_REG_START_ZMM + NUM_SIMD_REGS)
+        return reg - DR_REG_START_ZMM;
+#elif defined(AARCH64)
+    /* The q, d, s, h, and b views of each v register are laid out in that order. */
+    if (reg >= DR_REG_Q0 && reg <= DR_REG_B31)
+        return (reg - DR_REG_Q0) % NUM_SIMD_REGS;
+    if (reg >= DR_REG_Z0 && reg <= DR_REG_Z31)
+        return reg - DR_REG_Z0;
+#endif
+    return -1;
+}
+
+static uint
+find_free_simd_slot(per_thread_t *pt)
+{
+    uint i;
+    for (i = 0; i < ops.num_spill_simd_slots; i++) {
+        if (pt->simd_slot_use[i] == DR_REG_NULL)
+            return i;
+    }
+    return MAX_SIMD_SPILLS;
+}
+
+static opnd_t
+simd_slot_opnd(void *drcontext, uint slot, reg_id_t reg)
+{
+    opnd_t opnd =
+        dr_raw_tls_opnd(drcontext, tls_seg, tls_simd_offs + slot * SIMD_SLOT_SIZE);
+    opnd_set_size(&opnd, reg_get_size(reg));
+    return opnd;
+}
+
+/* The SIMD analogue of spill_reg(): spills the full width of reg. */
+static void
+spill_simd_reg(void *drcontext, per_thread_t *pt, reg_id_t reg, uint slot,
+               instrlist_t *ilist, instr_t *where)
+{
+    opnd_t mem = simd_slot_opnd(drcontext, slot, reg);
+    LOG(drcontext, DR_LOG_ALL, 3, "%s @%d." PFX " %s %d\n", __FUNCTION__, pt->live_idx,
+        get_where_app_pc(where), get_register_name(reg), slot);
+    ASSERT(pt->simd_slot_use[slot] == DR_REG_NULL || pt->simd_slot_use[slot] == reg,
+           "internal tracking error");
+    pt->simd_slot_use[slot] = reg;
+#ifdef X86
+    /* A VEX-encoded xmm store would be fine, but a VEX xmm load zeroes the top
+     * of the ymm register, so we use legacy encodings for xmm throughout.
+     */
+    if (reg_is_strictly_ymm(reg))
+        PRE(ilist, where, INSTR_CREATE_vmovdqu(drcontext, mem, opnd_create_reg(reg)));
+    else
+        PRE(ilist, where, INSTR_CREATE_movdqu(drcontext, mem, opnd_create_reg(reg)));
+#else
+    PRE(ilist, where, INSTR_CREATE_str(drcontext, mem, opnd_create_reg(reg)));
+#endif
+}
+
+/* The SIMD analogue of restore_reg(). */
+static void
+restore_simd_reg(void *drcontext, per_thread_t *pt, reg_id_t reg, uint slot,
+                 instrlist_t *ilist, instr_t *where, bool release)
+{
+    opnd_t mem = simd_slot_opnd(drcontext, slot, reg);
+    LOG(drcontext, DR_LOG_ALL, 3, "%s @%d." PFX " %s slot=%d release=%d\n",
+        __FUNCTION__, pt->live_idx, get_where_app_pc(where), get_register_name(reg),
+        slot, release);
+    ASSERT(pt->simd_slot_use[slot] == reg, "internal tracking error");
+    if (release)
+        pt->simd_slot_use[slot] = DR_REG_NULL;
+#ifdef X86
+    if (reg_is_strictly_ymm(reg))
+        PRE(ilist, where, INSTR_CREATE_vmovdqu(drcontext, opnd_create_reg(reg), mem));
+    else
+        PRE(ilist, where, INSTR_CREATE_movdqu(drcontext, opnd_create_reg(reg), mem));
+#else
+    PRE(ilist, where, INSTR_CREATE_ldr(drcontext, opnd_create_reg(reg), mem));
+#endif
+}
+
 drreg_status_t
 drreg_max_slots_used(OUT uint *max)
 {
@@ -266,6 +398,287 @@ drreg_max_slots_used(OUT uint *max)
  * ANALYSIS AND CROSS-APP-INSTR
  */
 
+static inline bool
+drreg_reg_is_live(per_thread_t *pt, reg_id_t reg, int idx)
+{
+    return TEST(REG_MASK(reg), pt->live[idx].regs);
+}
+
+static inline bool
+drreg_simd_is_live(per_thread_t *pt, int simd_idx, int idx)
+{
+    return TEST(1U << simd_idx, pt->live[idx].simd);
+}
+
+/* Makes room for live_info_t entries [0..count), preserving existing entries. */
+static void
+drreg_live_info_reserve(per_thread_t *pt, uint count)
+{
+    live_info_t *grown;
+    uint capacity = pt->live_capacity;
+    if (count <= capacity)
+        return;
+    while (capacity < count)
+        capacity *= 2;
+    grown = (live_info_t *)dr_global_alloc(capacity * sizeof(*grown));
+    memcpy(grown, pt->live, pt->live_capacity * sizeof(*grown));
+    dr_global_free(pt->live, pt->live_capacity * sizeof(*pt->live));
+    pt->live = grown;
+    pt->live_capacity = capacity;
+}
+
+static inline reg_mask_t
+gpr_mask_of(reg_id_t reg)
+{
+    reg = reg_to_pointer_sized(reg);
+    if (reg < DR_REG_START_GPR || reg > DR_REG_STOP_GPR)
+        return 0;
+    return REG_MASK(reg);
+}
+
+/* Computes, for all GPRs at once, the same answers as instr_reads_from_reg() and
+ * instr_writes_to_exact_reg() with DR_QUERY_INCLUDE_COND_SRCS: a GPR is read if
+ * any part of it is read, including as an address register of a destination
+ * (DRi#1849), and written only if the whole register is written (or, for amd64,
+ * its bottom 32 bits, which zeroes the top).
+ */
+static void
+drreg_instr_reg_masks(instr_t *inst, OUT reg_mask_t *read, OUT reg_mask_t *written)
+{
+    int i, j;
+    reg_mask_t r = 0, w = 0;
+#ifdef X86
+    /* instr_reads_from_reg() ignores the sources of this one */
+    bool srcs_read = instr_get_opcode(inst) != OP_nop_modrm;
+#else
+    bool srcs_read = true;
+#endif
+    bool dsts_written = !instr_is_predicated(inst);
+    for (i = 0; srcs_read && i < instr_num_srcs(inst); i++) {
+        opnd_t opnd = instr_get_src(inst, i);
+        for (j = 0; j < opnd_num_regs_used(opnd); j++)
+            r |= gpr_mask_of(opnd_get_reg_used(opnd, j));
+    }
+    for (i = 0; i < instr_num_dsts(inst); i++) {
+        opnd_t opnd = instr_get_dst(inst, i);
+        if (opnd_is_reg(opnd)) {
+            reg_id_t reg = opnd_get_reg(opnd);
+            if (dsts_written && opnd_get_size(opnd) == reg_get_size(reg) &&
+                (reg_to_pointer_sized(reg) == reg IF_X86_64(|| reg_is_32bit(reg))))
+                w |= gpr_mask_of(reg);
+        } else {
+            for (j = 0; j < opnd_num_regs_used(opnd); j++)
+                r |= gpr_mask_of(opnd_get_reg_used(opnd, j));
+        }
+    }
+    *read = r;
+    *written = w;
+}
+
+#define SIMD_MASK_ALL ((uint)-1)
+
+static inline uint
+simd_mask_of(reg_id_t reg)
+{
+    int idx = simd_index(reg);
+    return idx < 0 ? 0 : 1U << idx;
+}
+
+/* The SIMD counterpart of drreg_instr_reg_masks().  A SIMD register is read if any
+ * part of it is read (including as a gather/scatter index), touched if any part of
+ * it is written, and killed only if all of it is unconditionally overwritten.  We do
+ * not try to track the instrs that implicitly read or write every SIMD register:
+ * we simply treat them as partial writes that also read.
+ */
+static void
+drreg_instr_simd_masks(instr_t *inst, OUT uint *read, OUT uint *touched,
+                       OUT uint *killed)
+{
+    int i, j;
+    uint r = 0, t = 0, k = 0;
+    bool dsts_written = !instr_is_predicated(inst);
+#ifdef X86
+    int opc = instr_get_opcode(inst);
+    bool zeroes_ymmh;
+    if (opc == OP_vzeroupper || opc == OP_vzeroall || opc == OP_fxsave32 ||
+        opc == OP_fxsave64 || opc == OP_fxrstor32 || opc == OP_fxrstor64 ||
+        opc == OP_xrstor32 || opc == OP_xrstor64 || instr_is_xsave(inst)) {
+        *read = SIMD_MASK_ALL;
+        *touched = SIMD_MASK_ALL;
+        *killed = 0;
+        return;
+    }
+    zeroes_ymmh = instr_zeroes_ymmh(inst);
+#endif
+    for (i = 0; i < instr_num_srcs(inst); i++) {
+        opnd_t opnd = instr_get_src(inst, i);
+        for (j = 0; j < opnd_num_regs_used(opnd); j++) {
+            reg_id_t reg = opnd_get_reg_used(opnd, j);
+#ifdef X86
+            /* A merge-masked write preserves the unselected elements. */
+            if (reg_is_opmask(reg))
+                dsts_written = false;
+#endif
+            r |= simd_mask_of(reg);
+        }
+    }
+    for (i = 0; i < instr_num_dsts(inst); i++) {
+        opnd_t opnd = instr_get_dst(inst, i);
+        if (opnd_is_reg(opnd)) {
+            reg_id_t reg = opnd_get_reg(opnd);
+            t |= simd_mask_of(reg);
+            if (opnd_get_size(opnd) != reg_get_size(reg))
+                continue;
+#ifdef X86
+            if (reg_is_strictly_ymm(reg) || reg_is_strictly_zmm(reg) ||
+                (reg_is_strictly_xmm(reg) && zeroes_ymmh))
+                k |= simd_mask_of(reg);
+#elif defined(AARCH64)
+            if ((reg >= DR_REG_Q0 && reg <= DR_REG_Q31) ||
+                (reg >= DR_REG_Z0 && reg <= DR_REG_Z31))
+                k |= simd_mask_of(reg);
+#endif
+        } else {
+            for (j = 0; j < opnd_num_regs_used(opnd); j++)
+                r |= simd_mask_of(opnd_get_reg_used(opnd, j));
+        }
+    }
+    *read = r;
+    *touched = t;
+    *killed = dsts_written ? k : 0;
+}
+
+/***************************************************************************
+ * CROSS-BLOCK LIVENESS HINTS
+ */
+
+/* With drreg_options_t.cross_block_liveness, we remember the liveness at the entry
+ * of each block, keyed by tag, and when all of a new block's successors are known
+ * we use the union of their entries in place of "everything is live" at its exit.
+ * An entry is a property of the app code alone, so a rebuilt block may replace it
+ * with a different (but equally correct) one.  We only use entries within the
+ * block's own module: DR deletes all of a module's fragments when its code is
+ * unmapped or changed, so we need never flush the blocks that used an entry, and
+ * we drop a module's entries when it is unloaded.  (Flushing individual users
+ * is not an option, as DR's flush granularity is an entire code region.)
+ * Blocks that use hints store their translations, as re-instrumenting them for
+ * state translation could see different entries.
+ */
+#define HINT_TABLE_BITS 12
+
+static void
+bb_hint_free(void *p)
+{
+    dr_global_free(p, sizeof(live_info_t));
+}
+
+/* Fills in succ with the tags the block can exit to and returns how many there
+ * are, or returns 0 if any exit is not a direct transfer within mod.
+ */
+static int
+bb_successors(void *drcontext, instrlist_t *bb, module_data_t *mod, OUT app_pc succ[2])
+{
+#ifdef ARM
+    /* XXX: handle Thumb-mode tags. */
+    return 0;
+#else
+    instr_t *inst, *last = instrlist_last_app(bb);
+    int i, num = 0;
+    if (last == NULL || instr_get_app_pc(last) == NULL)
+        return 0;
+    for (inst = instrlist_first(bb); inst != NULL; inst = instr_get_next(inst)) {
+        if (inst != last &&
+            (instr_is_syscall(inst) || instr_is_interrupt(inst) ||
+             (instr_is_cti(inst) && !opnd_is_instr(instr_get_target(inst)))))
+            return 0;
+    }
+    if (instr_is_syscall(last) || instr_is_interrupt(last))
+        return 0;
+    if (instr_is_cti(last)) {
+        if ((!instr_is_ubr(last) && !instr_is_cbr(last) &&
+             !instr_is_call_direct(last)) ||
+            !opnd_is_pc(instr_get_target(last)))
+            return 0;
+        succ[num++] = opnd_get_pc(instr_get_target(last));
+    }
+    if (num == 0 || instr_is_cbr(last)) {
+        succ[num] = decode_next_pc(drcontext, instr_get_app_pc(last));
+        if (succ[num] == NULL)
+            return 0;
+        num++;
+    }
+    for (i = 0; i < num; i++) {
+        if (!dr_module_contains_addr(mod, succ[i]))
+            return 0;
+    }
+    return num;
+#endif
+}
+
+/* Returns whether the liveness at the exit of bb is known from its successors'
+ * entries, in which case it is written to exit_live.
+ */
+static bool
+drreg_exit_liveness_hint(void *drcontext, void *tag, instrlist_t *bb,
+                         module_data_t *mod, OUT live_info_t *exit_live)
+{
+    app_pc succ[2];
+    int i, num = bb_successors(drcontext, bb, mod, succ);
+    if (num == 0)
+        return false;
+    exit_live->regs = 0;
+    exit_live->aflags = 0;
+    exit_live->simd = SIMD_MASK_ALL;
+    dr_mutex_lock(hint_lock);
+    for (i = 0; i < num; i++) {
+        live_info_t *hint = (live_info_t *)hashtable_lookup(&hint_table, succ[i]);
+        if (hint == NULL) {
+            dr_mutex_unlock(hint_lock);
+            return false;
+        }
+        exit_live->regs |= hint->regs;
+        exit_live->aflags |= hint->aflags;
+    }
+    dr_mutex_unlock(hint_lock);
+    LOG(drcontext, DR_LOG_ALL, 2, "%s: " PFX " exits to " PFX " live regs=" PFX "\n",
+        __FUNCTION__, tag, succ[0], (ptr_uint_t)exit_live->regs);
+    return true;
+}
+
+static void
+drreg_record_liveness_hint(void *tag, live_info_t *live_in)
+{
+    live_info_t *hint;
+    dr_mutex_lock(hint_lock);
+    hint = (live_info_t *)hashtable_lookup(&hint_table, tag);
+    if (hint == NULL) {
+        hint = (live_info_t *)dr_global_alloc(sizeof(*hint));
+        hashtable_add(&hint_table, tag, hint);
+    }
+    *hint = *live_in;
+    dr_mutex_unlock(hint_lock);
+}
+
+static void
+drreg_event_module_unload(void *drcontext, const module_data_t *info)
+{
+    dr_mutex_lock(hint_lock);
+#ifdef WINDOWS
+    hashtable_remove_range(&hint_table, (void *)info->start, (void *)info->end);
+#else
+    if (info->contiguous)
+        hashtable_remove_range(&hint_table, (void *)info->start, (void *)info->end);
+    else {
+        uint i;
+        for (i = 0; i < info->num_segments; i++) {
+            hashtable_remove_range(&hint_table, (void *)info->segments[i].start,
+                                   (void *)info->segments[i].end);
+        }
+    }
+#endif
+    dr_mutex_unlock(hint_lock);
+}
+
 static void
 count_app_uses(per_thread_t *pt, opnd_t opnd)
 {
@@ -298,14 +711,28 @@ drreg_event_bb_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for_tr
     per_thread_t *pt = get_tls_data(drcontext);
     instr_t *inst;
     ptr_uint_t aflags_new, aflags_cur = 0;
+    reg_mask_t live, read, written;
     uint index = 0;
     reg_id_t reg;
+    live_info_t exit_live = { 0 };
+    bool exit_hint = false;
+    module_data_t *mod = NULL;
+    dr_emit_flags_t res = DR_EMIT_DEFAULT;
 
     for (reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++)
         pt->reg[GPR_IDX(reg)].app_uses = 0;
     /* pt->bb_props is set to 0 at thread init and after each bb */
     pt->bb_has_internal_flow = false;
 
+    /* Re-instrumenting for translation must not pick up newer hints. */
+    if (ops.cross_block_liveness && !translating)
+        mod = dr_lookup_module(dr_fragment_app_pc(tag));
+    if (mod != NULL) {
+        exit_hint = drreg_exit_liveness_hint(drcontext, tag, bb, mod, &exit_live);
+        if (exit_hint)
+            res = DR_EMIT_STORE_TRANSLATIONS;
+    }
+
     /* Reverse scan is more efficient.  This means our indices are also reversed. */
     for (inst = instrlist_last(bb); inst != NULL; inst = instr_get_prev(inst)) {
         /* We consider both meta and app instrs, to handle rare cases of meta instrs
@@ -325,42 +752,50 @@ drreg_event_bb_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for_tr
                 __FUNCTION__, index, get_where_app_pc(inst));
         }
 
-        /* GPR liveness */
+        drreg_live_info_reserve(pt, index + 1);
+
+        /* GPR liveness: a read wins over a write by the same instr */
+        drreg_instr_reg_masks(inst, &read, &written);
+        if (index == 0 && exit_hint)
+            live = exit_live.regs;
+        else if (xfer || index == 0)
+            live = REG_MASK_ALL;
+        else
+            live = pt->live[index - 1].regs;
+        live = (live & ~written) | read;
+        pt->live[index].regs = live;
         LOG(drcontext, DR_LOG_ALL, 3, "%s @%d." PFX ":", __FUNCTION__, index,
             get_where_app_pc(inst));
         for (reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++) {
-            void *value = REG_LIVE;
-            /* DRi#1849: COND_SRCS here includes addressing regs in dsts */
-            if (instr_reads_from_reg(inst, reg, DR_QUERY_INCLUDE_COND_SRCS))
-                value = REG_LIVE;
-            /* make sure we don't consider writes to sub-regs */
-            else if (instr_writes_to_exact_reg(inst, reg, DR_QUERY_INCLUDE_COND_SRCS)
-                     /* a write to a 32-bit reg for amd64 zeroes the top 32 bits */
-                     IF_X86_64(||
-                               instr_writes_to_exact_reg(inst, reg_64_to_32(reg),
-                                                         DR_QUERY_INCLUDE_COND_SRCS)))
-                value = REG_DEAD;
-            else if (xfer)
-                value = REG_LIVE;
-            else if (index > 0)
-                value = drvector_get_entry(&pt->reg[GPR_IDX(reg)].live, index - 1);
             LOG(drcontext, DR_LOG_ALL, 3, " %s=%d", get_register_name(reg),
-                (int)(ptr_uint_t)value);
-            drvector_set_entry(&pt->reg[GPR_IDX(reg)].live, index, value);
+                TEST(REG_MASK(reg), live) ? 1 : 0);
         }
 
+        /* SIMD liveness, only needed if SIMD registers can be reserved */
+        if (ops.num_spill_simd_slots > 0) {
+            uint simd_read, simd_touched, simd_killed, simd_live;
+            drreg_instr_simd_masks(inst, &simd_read, &simd_touched, &simd_killed);
+            if (xfer || index == 0)
+                simd_live = SIMD_MASK_ALL;
+            else
+                simd_live = pt->live[index - 1].simd;
+            pt->live[index].simd = (simd_live & ~simd_killed) | simd_read;
+            LOG(drcontext, DR_LOG_ALL, 3, " simd=0x%x", pt->live[index].simd);
+        } else
+            pt->live[index].simd = SIMD_MASK_ALL;
+
         /* aflags liveness */
         aflags_new = instr_get_arith_flags(inst, DR_QUERY_INCLUDE_COND_SRCS);
-        if (xfer)
+        if (xfer && !(index == 0 && exit_hint))
             aflags_cur = EFLAGS_READ_ARITH; /* assume flags are read before written */
         else {
             uint aflags_read, aflags_w2r;
-            if (index == 0)
+            if (index == 0 && exit_hint)
+                aflags_cur = exit_live.aflags;
+            else if (index == 0)
                 aflags_cur = EFLAGS_READ_ARITH; /* assume flags are read before written */
-            else {
-                aflags_cur =
-                    (uint)(ptr_uint_t)drvector_get_entry(&pt->aflags.live, index - 1);
-            }
+            else
+                aflags_cur = pt->live[index - 1].aflags;
             aflags_read = (aflags_new & EFLAGS_READ_ARITH);
             /* if a flag is read by inst, set the read bit */
             aflags_cur |= (aflags_new & EFLAGS_READ_ARITH);
@@ -369,7 +804,7 @@ drreg_event_bb_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for_tr
             aflags_cur &= ~(aflags_w2r & ~aflags_read);
         }
         LOG(drcontext, DR_LOG_ALL, 3, " flags=%d\n", aflags_cur);
-        drvector_set_entry(&pt->aflags.live, index, (void *)(ptr_uint_t)aflags_cur);
+        pt->live[index].aflags = (uint)aflags_cur;
 
         if (instr_is_app(inst)) {
             int i;
@@ -383,8 +818,13 @@ drreg_event_bb_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for_tr
     }
 
     pt->live_idx = index;
+    if (mod != NULL) {
+        if (index > 0)
+            drreg_record_liveness_hint(tag, &pt->live[index - 1]);
+        dr_free_module_data(mod);
+    }
 
-    return DR_EMIT_DEFAULT;
+    return res;
 }
 
 static dr_emit_flags_t
@@ -399,7 +839,8 @@ drreg_event_bb_insert_early(void *drcontext, void *tag, instrlist_t *bb, instr_t
 
 static drreg_status_t
 drreg_insert_restore_all(void *drcontext, instrlist_t *bb, instr_t *inst,
-                         bool force_restore, OUT bool *regs_restored)
+                         bool force_restore, OUT bool *regs_restored,
+                         OUT uint *simd_restored)
 {
     per_thread_t *pt = get_tls_data(drcontext);
     reg_id_t reg;
@@ -407,7 +848,7 @@ drreg_insert_restore_all(void *drcontext, instrlist_t *bb, instr_t *inst,
     drreg_status_t res;
 
     /* Before each app read, or at end of bb, restore aflags to app value */
-    uint aflags = (uint)(ptr_uint_t)drvector_get_entry(&pt->aflags.live, pt->live_idx);
+    uint aflags = pt->live[pt->live_idx].aflags;
     if (!pt->aflags.native &&
         (force_restore ||
          TESTANY(EFLAGS_READ_ARITH, instr_get_eflags(inst, DR_QUERY_DEFAULT)) ||
@@ -509,6 +950,57 @@ drreg_insert_restore_all(void *drcontext, instrlist_t *bb, instr_t *inst,
         }
     }
 
+    /* The same for SIMD registers, whose app values are always in our own slots. */
+    if (simd_restored != NULL)
+        *simd_restored = 0;
+    if (ops.num_spill_simd_slots > 0) {
+        uint read, touched, killed;
+        int i;
+        drreg_instr_simd_masks(inst, &read, &touched, &killed);
+        for (i = 0; i < NUM_SIMD_REGS; i++) {
+            reg_info_t *info = &pt->simd[i];
+            uint bit = 1U << i;
+            uint tmp_slot;
+            if (info->native)
+                continue;
+            if (!force_restore && !TEST(bit, read) &&
+                /* Treat a partial or conditional write as a read */
+                !(TEST(bit, touched) && !TEST(bit, killed)) &&
+                (info->in_use ||
+                 !((pt->bb_has_internal_flow &&
+                    !TEST(DRREG_IGNORE_CONTROL_FLOW, pt->bb_props)) ||
+                   TEST(DRREG_CONTAINS_SPANNING_CONTROL_FLOW, pt->bb_props))))
+                continue;
+            if (!info->in_use) {
+                LOG(drcontext, DR_LOG_ALL, 3, "%s @%d." PFX ": lazily restoring %s\n",
+                    __FUNCTION__, pt->live_idx, get_where_app_pc(inst),
+                    get_register_name(info->simd_reg));
+                drreg_restore_simd_now(drcontext, bb, inst, pt, i);
+                ASSERT(pt->simd_pending_unreserved > 0, "should not go negative");
+                pt->simd_pending_unreserved--;
+                continue;
+            }
+            /* As for GPRs, we move the tool's value to a tmp slot around the
+             * app instr.  XXX: if we change this, we need to update
+             * drreg_event_restore_state().
+             */
+            tmp_slot = find_free_simd_slot(pt);
+            if (tmp_slot == MAX_SIMD_SPILLS) {
+                drreg_report_error(DRREG_ERROR_OUT_OF_SLOTS,
+                                   "failed to preserve tool SIMD val around app read");
+            }
+            LOG(drcontext, DR_LOG_ALL, 3, "%s @%d." PFX ": restoring %s for app read\n",
+                __FUNCTION__, pt->live_idx, get_where_app_pc(inst),
+                get_register_name(info->simd_reg));
+            spill_simd_reg(drcontext, pt, info->simd_reg, tmp_slot, bb, inst);
+            restore_simd_reg(drcontext, pt, info->simd_reg, info->slot, bb, inst,
+                             false /*keep slot*/);
+            restore_simd_reg(drcontext, pt, info->simd_reg, tmp_slot, bb, next, true);
+            if (simd_restored != NULL)
+                *simd_restored |= bit;
+        }
+    }
+
     return DRREG_SUCCESS;
 }
 
@@ -520,6 +1012,7 @@ drreg_event_bb_insert_late(void *drcontext, void *tag, instrlist_t *bb, instr_t
     reg_id_t reg;
     instr_t *next = instr_get_next(inst);
     bool restored_for_read[DR_NUM_GPR_REGS];
+    uint simd_restored_for_read;
     drreg_status_t res;
     dr_pred_type_t pred = instrlist_get_auto_predicate(bb);
 
@@ -533,7 +1026,29 @@ drreg_event_bb_insert_late(void *drcontext, void *tag, instrlist_t *bb, instr_t
      */
     bool do_last_spill = drmgr_is_last_instr(drcontext, inst) &&
         !TEST(DRREG_USER_RESTORES_AT_BB_END, pt->bb_props);
-    res = drreg_insert_restore_all(drcontext, bb, inst, do_last_spill, restored_for_read);
+    /* At the block end, an unreserved reg that is dead (which with cross-block
+     * liveness includes dead in all successors) need not be restored: we just
+     * release its slot.  The spill is still there for a fault on this instr.
+     */
+    if (do_last_spill && !ops.conservative && pt->pending_unreserved > 0) {
+        for (reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++) {
+            reg_info_t *info = &pt->reg[GPR_IDX(reg)];
+            if (info->in_use || info->native || info->xchg != DR_REG_NULL ||
+                pt->aflags.xchg == reg || drreg_reg_is_live(pt, reg, pt->live_idx))
+                continue;
+            LOG(drcontext, DR_LOG_ALL, 3,
+                "%s @%d." PFX ": dropping slot for %s dead at block end\n",
+                __FUNCTION__, pt->live_idx, get_where_app_pc(inst),
+                get_register_name(reg));
+            info->ever_spilled = false; /* no need to restore */
+            res = drreg_restore_reg_now(drcontext, bb, inst, pt, reg);
+            if (res != DRREG_SUCCESS)
+                drreg_report_error(res, "slot release at block end failed");
+            pt->pending_unreserved--;
+        }
+    }
+    res = drreg_insert_restore_all(drcontext, bb, inst, do_last_spill, restored_for_read,
+                                   &simd_restored_for_read);
     if (res != DRREG_SUCCESS)
         drreg_report_error(res, "failed to restore for reads");
 
@@ -541,7 +1056,7 @@ drreg_event_bb_insert_late(void *drcontext, void *tag, instrlist_t *bb, instr_t
     if (TESTANY(EFLAGS_WRITE_ARITH, instr_get_eflags(inst, DR_QUERY_INCLUDE_ALL)) &&
         /* Is everything written later? */
         (pt->live_idx == 0 ||
-         (ptr_uint_t)drvector_get_entry(&pt->aflags.live, pt->live_idx - 1) != 0)) {
+         pt->live[pt->live_idx - 1].aflags != 0)) {
         if (pt->aflags.in_use) {
             LOG(drcontext, DR_LOG_ALL, 3,
                 "%s @%d." PFX ": re-spilling aflags after app write\n", __FUNCTION__,
@@ -577,8 +1092,7 @@ drreg_event_bb_insert_late(void *drcontext, void *tag, instrlist_t *bb, instr_t
             if (instr_writes_to_reg(inst, reg, DR_QUERY_INCLUDE_ALL) &&
                 /* Don't bother if reg is dead beyond this write */
                 (ops.conservative || pt->live_idx == 0 ||
-                 drvector_get_entry(&pt->reg[GPR_IDX(reg)].live, pt->live_idx - 1) ==
-                     REG_LIVE ||
+                 drreg_reg_is_live(pt, reg, pt->live_idx - 1) ||
                  pt->aflags.xchg == reg)) {
                 uint tmp_slot = MAX_SPILLS;
                 if (pt->aflags.xchg == reg) {
@@ -637,6 +1151,57 @@ drreg_event_bb_insert_late(void *drcontext, void *tag, instrlist_t *bb, instr_t
         }
     }
 
+    /* After each app write, update spilled SIMD app values, as for GPRs above. */
+    if (ops.num_spill_simd_slots > 0) {
+        uint read, touched, killed;
+        int i;
+        drreg_instr_simd_masks(inst, &read, &touched, &killed);
+        for (i = 0; i < NUM_SIMD_REGS; i++) {
+            reg_info_t *info = &pt->simd[i];
+            if (!TEST(1U << i, touched) || info->native)
+                continue;
+            if (info->in_use) {
+                uint tmp_slot = MAX_SIMD_SPILLS;
+                /* Don't bother if reg is dead beyond this write */
+                if (!ops.conservative && pt->live_idx != 0 &&
+                    !drreg_simd_is_live(pt, i, pt->live_idx - 1))
+                    continue;
+                LOG(drcontext, DR_LOG_ALL, 3,
+                    "%s @%d." PFX ": re-spilling %s after app write\n", __FUNCTION__,
+                    pt->live_idx, get_where_app_pc(inst),
+                    get_register_name(info->simd_reg));
+                if (!TEST(1U << i, simd_restored_for_read)) {
+                    tmp_slot = find_free_simd_slot(pt);
+                    if (tmp_slot == MAX_SIMD_SPILLS) {
+                        drreg_report_error(
+                            DRREG_ERROR_OUT_OF_SLOTS,
+                            "failed to preserve tool SIMD val wrt app write");
+                    }
+                    spill_simd_reg(drcontext, pt, info->simd_reg, tmp_slot, bb, inst);
+                }
+                /* If reads and writes, keep tool-restore after app-spill. */
+                spill_simd_reg(drcontext, pt, info->simd_reg, info->slot, bb,
+                               TEST(1U << i, simd_restored_for_read)
+                                   ? instr_get_prev(next)
+                                   : next /*after*/);
+                info->ever_spilled = true;
+                if (!TEST(1U << i, simd_restored_for_read)) {
+                    restore_simd_reg(drcontext, pt, info->simd_reg, tmp_slot, bb,
+                                     next /*after*/, true);
+                }
+            } else {
+                /* Only a full write gets here: drop the slot. */
+                LOG(drcontext, DR_LOG_ALL, 3,
+                    "%s @%d." PFX ": dropping slot for unreserved %s after app write\n",
+                    __FUNCTION__, pt->live_idx, get_where_app_pc(inst),
+                    get_register_name(info->simd_reg));
+                info->ever_spilled = false; /* no need to restore */
+                drreg_restore_simd_now(drcontext, bb, inst, pt, i);
+                pt->simd_pending_unreserved--;
+            }
+        }
+    }
+
     if (drmgr_is_last_instr(drcontext, inst))
         pt->bb_props = 0;
 
@@ -655,6 +1220,12 @@ drreg_event_bb_insert_late(void *drcontext, void *tag, instrlist_t *bb, instr_t
                        "user failed to unreserve a register");
             }
         }
+        for (i = 0; i < NUM_SIMD_REGS; i++) {
+            ASSERT(!pt->simd[i].in_use, "user failed to unreserve a SIMD register");
+            ASSERT(pt->simd[i].native, "user failed to unreserve a SIMD register");
+        }
+        for (i = 0; i < MAX_SIMD_SPILLS; i++)
+            ASSERT(pt->simd_slot_use[i] == DR_REG_NULL, "SIMD slot leaked");
     }
 #endif
     instrlist_set_auto_predicate(bb, pred);
@@ -665,7 +1236,8 @@ drreg_status_t
 drreg_restore_all(void *drcontext, instrlist_t *bb, instr_t *where)
 {
     return drreg_insert_restore_all(drcontext, bb, where, true,
-                                    NULL /* do not need to track reg restores */);
+                                    NULL /* do not need to track reg restores */,
+                                    NULL);
 }
 
 /***************************************************************************
@@ -686,13 +1258,13 @@ drreg_forward_analysis(void *drcontext, instr_t *start)
     per_thread_t *pt = get_tls_data(drcontext);
     instr_t *inst;
     ptr_uint_t aflags_new, aflags_cur = 0;
+    /* GPRs neither read nor written yet: they end up live */
+    reg_mask_t unknown = REG_MASK_ALL, live = 0, read, written;
+    uint simd_unknown = SIMD_MASK_ALL, simd_live = 0;
     reg_id_t reg;
 
-    /* We just use index 0 of the live vectors */
-    for (reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++) {
+    for (reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++)
         pt->reg[GPR_IDX(reg)].app_uses = 0;
-        drvector_set_entry(&pt->reg[GPR_IDX(reg)].live, 0, REG_UNKNOWN);
-    }
 
     /* We have to consider meta instrs as well */
     for (inst = start; inst != NULL; inst = instr_get_next(inst)) {
@@ -700,22 +1272,16 @@ drreg_forward_analysis(void *drcontext, instr_t *start)
             break;
 
         /* GPR liveness */
-        for (reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++) {
-            void *value = REG_UNKNOWN;
-            if (drvector_get_entry(&pt->reg[GPR_IDX(reg)].live, 0) != REG_UNKNOWN)
-                continue;
-            /* DRi#1849: COND_SRCS here includes addressing regs in dsts */
-            if (instr_reads_from_reg(inst, reg, DR_QUERY_INCLUDE_COND_SRCS))
-                value = REG_LIVE;
-            /* make sure we don't consider writes to sub-regs */
-            else if (instr_writes_to_exact_reg(inst, reg, DR_QUERY_INCLUDE_COND_SRCS)
-                     /* a write to a 32-bit reg for amd64 zeroes the top 32 bits */
-                     IF_X86_64(||
-                               instr_writes_to_exact_reg(inst, reg_64_to_32(reg),
-                                                         DR_QUERY_INCLUDE_COND_SRCS)))
-                value = REG_DEAD;
-            if (value != REG_UNKNOWN)
-                drvector_set_entry(&pt->reg[GPR_IDX(reg)].live, 0, value);
+        if (unknown != 0) {
+            drreg_instr_reg_masks(inst, &read, &written);
+            live |= unknown & read;
+            unknown &= ~(read | written);
+        }
+        if (simd_unknown != 0 && ops.num_spill_simd_slots > 0) {
+            uint simd_read, simd_touched, simd_killed;
+            drreg_instr_simd_masks(inst, &simd_read, &simd_touched, &simd_killed);
+            simd_live |= simd_unknown & simd_read;
+            simd_unknown &= ~(simd_read | simd_killed);
         }
 
         /* aflags liveness */
@@ -735,16 +1301,12 @@ drreg_forward_analysis(void *drcontext, instr_t *start)
         }
     }
 
+    /* We just use index 0 of the live array */
     pt->live_idx = 0;
-
-    for (reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++) {
-        if (drvector_get_entry(&pt->reg[GPR_IDX(reg)].live, 0) == REG_UNKNOWN)
-            drvector_set_entry(&pt->reg[GPR_IDX(reg)].live, 0, REG_LIVE);
-    }
-    drvector_set_entry(&pt->aflags.live, 0,
-                       (void *)(ptr_uint_t)
-                       /* set read bit if not written */
-                       (EFLAGS_READ_ARITH & (~(EFLAGS_WRITE_TO_READ(aflags_cur)))));
+    pt->live[0].regs = live | unknown;
+    pt->live[0].simd = simd_live | simd_unknown;
+    /* set read bit if not written */
+    pt->live[0].aflags = (uint)(EFLAGS_READ_ARITH & (~(EFLAGS_WRITE_TO_READ(aflags_cur))));
     return DRREG_SUCCESS;
 }
 
@@ -764,10 +1326,34 @@ drreg_init_and_fill_vector(drvector_t *vec, bool allowed)
     return DRREG_SUCCESS;
 }
 
+drreg_status_t
+drreg_init_and_fill_vector_ex(drvector_t *vec, drreg_spill_class_t spill_class,
+                              bool allowed)
+{
+    uint i;
+    if (spill_class == DRREG_GPR_SPILL_CLASS)
+        return drreg_init_and_fill_vector(vec, allowed);
+    if (vec == NULL ||
+        (spill_class != DRREG_SIMD_XMM_SPILL_CLASS &&
+         spill_class != DRREG_SIMD_YMM_SPILL_CLASS))
+        return DRREG_ERROR_INVALID_PARAMETER;
+    drvector_init(vec, NUM_SIMD_REGS, false /*!synch*/, NULL);
+    for (i = 0; i < NUM_SIMD_REGS; i++)
+        drvector_set_entry(vec, i, allowed ? (void *)(ptr_uint_t)1 : NULL);
+    return DRREG_SUCCESS;
+}
+
 drreg_status_t
 drreg_set_vector_entry(drvector_t *vec, reg_id_t reg, bool allowed)
 {
-    if (vec == NULL || reg < DR_REG_START_GPR || reg > DR_REG_STOP_GPR)
+    int simd_idx = simd_index(reg);
+    if (vec == NULL)
+        return DRREG_ERROR_INVALID_PARAMETER;
+    if (simd_idx >= 0) {
+        drvector_set_entry(vec, simd_idx, allowed ? (void *)(ptr_uint_t)1 : NULL);
+        return DRREG_SUCCESS;
+    }
+    if (reg < DR_REG_START_GPR || reg > DR_REG_STOP_GPR)
         return DRREG_ERROR_INVALID_PARAMETER;
     drvector_set_entry(vec, reg - DR_REG_START_GPR,
                        allowed ? (void *)(ptr_uint_t)1 : NULL);
@@ -806,7 +1392,7 @@ drreg_reserve_reg_internal(void *drcontext, instrlist_t *ilist, instr_t *where,
             if (!pt->reg[idx].native && !pt->reg[idx].in_use &&
                 (reg_allowed == NULL || drvector_get_entry(reg_allowed, idx) != NULL) &&
                 (!only_if_no_spill || pt->reg[idx].ever_spilled ||
-                 drvector_get_entry(&pt->reg[idx].live, pt->live_idx) == REG_DEAD)) {
+                 !drreg_reg_is_live(pt, reg, pt->live_idx))) {
                 slot = pt->reg[idx].slot;
                 pt->pending_unreserved--;
                 already_spilled = pt->reg[idx].ever_spilled;
@@ -836,7 +1422,7 @@ drreg_reserve_reg_internal(void *drcontext, instrlist_t *ilist, instr_t *where,
             /* If we had a hint as to local vs whole-bb we could downgrade being
              * dead right now as a priority
              */
-            if (drvector_get_entry(&pt->reg[idx].live, pt->live_idx) == REG_DEAD)
+            if (!drreg_reg_is_live(pt, reg, pt->live_idx))
                 break;
             if (only_if_no_spill)
                 continue;
@@ -879,7 +1465,7 @@ drreg_reserve_reg_internal(void *drcontext, instrlist_t *ilist, instr_t *where,
     if (!already_spilled) {
         /* Even if dead now, we need to own a slot in case reserved past dead point */
         if (ops.conservative ||
-            drvector_get_entry(&pt->reg[GPR_IDX(reg)].live, pt->live_idx) == REG_LIVE) {
+            drreg_reg_is_live(pt, reg, pt->live_idx)) {
             LOG(drcontext, DR_LOG_ALL, 3, "%s @%d." PFX ": spilling %s to slot %d\n",
                 __FUNCTION__, pt->live_idx, get_where_app_pc(where),
                 get_register_name(reg), slot);
@@ -904,9 +1490,121 @@ drreg_reserve_reg_internal(void *drcontext, instrlist_t *ilist, instr_t *where,
     return DRREG_SUCCESS;
 }
 
-drreg_status_t
-drreg_reserve_register(void *drcontext, instrlist_t *ilist, instr_t *where,
-                       drvector_t *reg_allowed, OUT reg_id_t *reg_out)
+/* The SIMD counterpart of drreg_reserve_reg_internal(). */
+static drreg_status_t
+drreg_reserve_simd_reg_internal(void *drcontext, drreg_spill_class_t spill_class,
+                                instrlist_t *ilist, instr_t *where,
+                                drvector_t *reg_allowed, bool only_if_no_spill,
+                                OUT reg_id_t *reg_out)
+{
+    per_thread_t *pt = get_tls_data(drcontext);
+    uint slot = MAX_SIMD_SPILLS;
+    int idx, best_idx = -1;
+    reg_id_t start, reg;
+    bool already_spilled = false;
+    if (reg_out == NULL)
+        return DRREG_ERROR_INVALID_PARAMETER;
+#ifdef X86
+    if (spill_class == DRREG_SIMD_XMM_SPILL_CLASS)
+        start = DR_REG_START_XMM;
+    else if (spill_class == DRREG_SIMD_YMM_SPILL_CLASS) {
+        if (!proc_has_feature(FEATURE_AVX))
+            return DRREG_ERROR_FEATURE_NOT_AVAILABLE;
+        start = DR_REG_START_YMM;
+    } else
+        return DRREG_ERROR_INVALID_PARAMETER;
+#elif defined(AARCH64)
+    if (spill_class == DRREG_SIMD_XMM_SPILL_CLASS)
+        start = DR_REG_Q0;
+    else if (spill_class == DRREG_SIMD_YMM_SPILL_CLASS)
+        return DRREG_ERROR_FEATURE_NOT_AVAILABLE;
+    else
+        return DRREG_ERROR_INVALID_PARAMETER;
+#else
+    /* XXX: add 32-bit ARM support. */
+    return DRREG_ERROR_FEATURE_NOT_AVAILABLE;
+#endif
+    if (ops.num_spill_simd_slots == 0)
+        return DRREG_ERROR_OUT_OF_SLOTS;
+
+    /* First, try to use a previously unreserved but not yet lazily restored reg of
+     * the same width, for the same reason as drreg_reserve_reg_internal().
+     */
+    if (pt->simd_pending_unreserved > 0) {
+        for (idx = 0; idx < NUM_SIMD_REGS; idx++) {
+            reg_info_t *info = &pt->simd[idx];
+            if (!info->native && !info->in_use && info->simd_reg == start + idx &&
+                (reg_allowed == NULL || drvector_get_entry(reg_allowed, idx) != NULL) &&
+                (!only_if_no_spill || info->ever_spilled ||
+                 !drreg_simd_is_live(pt, idx, pt->live_idx))) {
+                slot = info->slot;
+                pt->simd_pending_unreserved--;
+                already_spilled = info->ever_spilled;
+                LOG(drcontext, DR_LOG_ALL, 3,
+                    "%s @%d." PFX ": using un-restored %s slot %d\n", __FUNCTION__,
+                    pt->live_idx, get_where_app_pc(where),
+                    get_register_name(info->simd_reg), slot);
+                break;
+            }
+        }
+    }
+
+    if (slot == MAX_SIMD_SPILLS) {
+        /* Look for a dead register, or else the highest-numbered one, which is
+         * the least likely to be used by the app.
+         */
+        for (idx = NUM_SIMD_REGS - 1; idx >= 0; idx--) {
+            if (pt->simd[idx].in_use || !pt->simd[idx].native)
+                continue;
+            if (reg_allowed != NULL && drvector_get_entry(reg_allowed, idx) == NULL)
+                continue;
+            if (!drreg_simd_is_live(pt, idx, pt->live_idx))
+                break;
+            if (!only_if_no_spill && best_idx < 0)
+                best_idx = idx;
+        }
+        if (idx < 0) {
+            if (best_idx < 0)
+                return DRREG_ERROR_REG_CONFLICT;
+            idx = best_idx;
+        }
+        slot = find_free_simd_slot(pt);
+        if (slot == MAX_SIMD_SPILLS)
+            return DRREG_ERROR_OUT_OF_SLOTS;
+    }
+
+    reg = start + idx;
+    ASSERT(!pt->simd[idx].in_use, "overlapping uses");
+    pt->simd[idx].in_use = true;
+    if (!already_spilled) {
+        /* Even if dead now, we need to own a slot in case reserved past dead point */
+        if (ops.conservative || drreg_simd_is_live(pt, idx, pt->live_idx)) {
+            LOG(drcontext, DR_LOG_ALL, 3, "%s @%d." PFX ": spilling %s to slot %d\n",
+                __FUNCTION__, pt->live_idx, get_where_app_pc(where),
+                get_register_name(reg), slot);
+            spill_simd_reg(drcontext, pt, reg, slot, ilist, where);
+            pt->simd[idx].ever_spilled = true;
+        } else {
+            LOG(drcontext, DR_LOG_ALL, 3,
+                "%s @%d." PFX ": no need to spill %s to slot %d\n", __FUNCTION__,
+                pt->live_idx, get_where_app_pc(where), get_register_name(reg), slot);
+            pt->simd_slot_use[slot] = reg;
+            pt->simd[idx].ever_spilled = false;
+        }
+    }
+    pt->simd[idx].native = false;
+    pt->simd[idx].xchg = DR_REG_NULL;
+    pt->simd[idx].slot = slot;
+    pt->simd[idx].simd_reg = reg;
+    *reg_out = reg;
+    return DRREG_SUCCESS;
+}
+
+static drreg_status_t
+drreg_reserve_register_common(void *drcontext, drreg_spill_class_t spill_class,
+                              instrlist_t *ilist, instr_t *where,
+                              drvector_t *reg_allowed, bool only_if_no_spill,
+                              OUT reg_id_t *reg_out)
 {
     dr_pred_type_t pred = instrlist_get_auto_predicate(ilist);
     drreg_status_t res;
@@ -915,31 +1613,80 @@ drreg_reserve_register(void *drcontext, instrlist_t *ilist, instr_t *where,
         if (res != DRREG_SUCCESS)
             return res;
     }
-    /* FIXME i#3827: ever_spilled is not being reset. */
     /* XXX i#2585: drreg should predicate spills and restores as appropriate */
     instrlist_set_auto_predicate(ilist, DR_PRED_NONE);
-    res =
-        drreg_reserve_reg_internal(drcontext, ilist, where, reg_allowed, false, reg_out);
+    if (spill_class == DRREG_GPR_SPILL_CLASS) {
+        res = drreg_reserve_reg_internal(drcontext, ilist, where, reg_allowed,
+                                         only_if_no_spill, reg_out);
+    } else {
+        res = drreg_reserve_simd_reg_internal(drcontext, spill_class, ilist, where,
+                                              reg_allowed, only_if_no_spill, reg_out);
+    }
     instrlist_set_auto_predicate(ilist, pred);
     return res;
 }
 
+drreg_status_t
+drreg_reserve_register(void *drcontext, instrlist_t *ilist, instr_t *where,
+                       drvector_t *reg_allowed, OUT reg_id_t *reg_out)
+{
+    /* FIXME i#3827: ever_spilled is not being reset. */
+    return drreg_reserve_register_common(drcontext, DRREG_GPR_SPILL_CLASS, ilist, where,
+                                         reg_allowed, false, reg_out);
+}
+
 drreg_status_t
 drreg_reserve_dead_register(void *drcontext, instrlist_t *ilist, instr_t *where,
                             drvector_t *reg_allowed, OUT reg_id_t *reg_out)
 {
-    dr_pred_type_t pred = instrlist_get_auto_predicate(ilist);
-    drreg_status_t res;
-    if (drmgr_current_bb_phase(drcontext) != DRMGR_PHASE_INSERTION) {
-        res = drreg_forward_analysis(drcontext, where);
-        if (res != DRREG_SUCCESS)
-            return res;
-    }
-    /* XXX i#2585: drreg should predicate spills and restores as appropriate */
+    return drreg_reserve_register_common(drcontext, DRREG_GPR_SPILL_CLASS, ilist, where,
+                                         reg_allowed, true, reg_out);
+}
+
+drreg_status_t
+drreg_reserve_register_ex(void *drcontext, drreg_spill_class_t spill_class,
+                          instrlist_t *ilist, instr_t *where, drvector_t *reg_allowed,
+                          OUT reg_id_t *reg_out)
+{
+    return drreg_reserve_register_common(drcontext, spill_class, ilist, where,
+                                         reg_allowed, false, reg_out);
+}
+
+drreg_status_t
+drreg_reserve_dead_register_ex(void *drcontext, drreg_spill_class_t spill_class,
+                               instrlist_t *ilist, instr_t *where,
+                               drvector_t *reg_allowed, OUT reg_id_t *reg_out)
+{
+    return drreg_reserve_register_common(drcontext, spill_class, ilist, where,
+                                         reg_allowed, true, reg_out);
+}
+
+/* The SIMD part of drreg_restore_app_value(): only dst_reg == app_reg is supported. */
+static drreg_status_t
+drreg_restore_simd_app_value(void *drcontext, instrlist_t *ilist, instr_t *where,
+                             reg_id_t app_reg, bool stateful)
+{
+    per_thread_t *pt = get_tls_data(drcontext);
+    int idx = simd_index(app_reg);
+    reg_info_t *info = &pt->simd[idx];
+    dr_pred_type_t pred;
+    if (info->native)
+        return DRREG_SUCCESS;
+    if (!info->ever_spilled)
+        return DRREG_ERROR_NO_APP_VALUE;
+    LOG(drcontext, DR_LOG_ALL, 3, "%s @%d." PFX ": getting app value for %s\n",
+        __FUNCTION__, pt->live_idx, get_where_app_pc(where),
+        get_register_name(info->simd_reg));
+    pred = instrlist_get_auto_predicate(ilist);
     instrlist_set_auto_predicate(ilist, DR_PRED_NONE);
-    res = drreg_reserve_reg_internal(drcontext, ilist, where, reg_allowed, true, reg_out);
+    restore_simd_reg(drcontext, pt, info->simd_reg, info->slot, ilist, where,
+                     stateful && !info->in_use);
     instrlist_set_auto_predicate(ilist, pred);
-    return res;
+    if (stateful && !info->in_use) {
+        info->native = true;
+        pt->simd_pending_unreserved--;
+    }
+    return DRREG_SUCCESS;
 }
 
 drreg_status_t
@@ -949,6 +1696,11 @@ drreg_restore_app_value(void *drcontext, instrlist_t *ilist, instr_t *where,
     per_thread_t *pt = get_tls_data(drcontext);
     dr_pred_type_t pred = instrlist_get_auto_predicate(ilist);
 
+    if (simd_index(app_reg) >= 0) {
+        if (dst_reg != app_reg)
+            return DRREG_ERROR_INVALID_PARAMETER;
+        return drreg_restore_simd_app_value(drcontext, ilist, where, app_reg, stateful);
+    }
     if (!reg_is_pointer_sized(app_reg) || !reg_is_pointer_sized(dst_reg))
         return DRREG_ERROR_INVALID_PARAMETER;
 
@@ -1134,12 +1886,46 @@ drreg_restore_reg_now(void *drcontext, instrlist_t *ilist, instr_t *inst,
     return DRREG_SUCCESS;
 }
 
+static void
+drreg_restore_simd_now(void *drcontext, instrlist_t *ilist, instr_t *inst,
+                       per_thread_t *pt, int idx)
+{
+    reg_info_t *info = &pt->simd[idx];
+    if (info->ever_spilled) {
+        LOG(drcontext, DR_LOG_ALL, 3, "%s @%d." PFX ": restoring %s\n", __FUNCTION__,
+            pt->live_idx, get_where_app_pc(inst), get_register_name(info->simd_reg));
+        restore_simd_reg(drcontext, pt, info->simd_reg, info->slot, ilist, inst, true);
+    } else {
+        /* still need to release slot */
+        LOG(drcontext, DR_LOG_ALL, 3, "%s @%d." PFX ": %s never spilled\n", __FUNCTION__,
+            pt->live_idx, get_where_app_pc(inst), get_register_name(info->simd_reg));
+        pt->simd_slot_use[info->slot] = DR_REG_NULL;
+    }
+    info->native = true;
+}
+
 drreg_status_t
 drreg_unreserve_register(void *drcontext, instrlist_t *ilist, instr_t *where,
                          reg_id_t reg)
 {
     per_thread_t *pt = get_tls_data(drcontext);
-    if (!pt->reg[GPR_IDX(reg)].in_use)
+    int simd_idx = simd_index(reg);
+    if (simd_idx >= 0) {
+        if (!pt->simd[simd_idx].in_use)
+            return DRREG_ERROR_INVALID_PARAMETER;
+        LOG(drcontext, DR_LOG_ALL, 3, "%s @%d." PFX " %s\n", __FUNCTION__, pt->live_idx,
+            get_where_app_pc(where), get_register_name(reg));
+        if (drmgr_current_bb_phase(drcontext) != DRMGR_PHASE_INSERTION) {
+            dr_pred_type_t pred = instrlist_get_auto_predicate(ilist);
+            instrlist_set_auto_predicate(ilist, DR_PRED_NONE);
+            drreg_restore_simd_now(drcontext, ilist, where, pt, simd_idx);
+            instrlist_set_auto_predicate(ilist, pred);
+        } else
+            pt->simd_pending_unreserved++;
+        pt->simd[simd_idx].in_use = false;
+        return DRREG_SUCCESS;
+    }
+    if (reg < DR_REG_START_GPR || reg > DR_REG_STOP_GPR || !pt->reg[GPR_IDX(reg)].in_use)
         return DRREG_ERROR_INVALID_PARAMETER;
     LOG(drcontext, DR_LOG_ALL, 3, "%s @%d." PFX " %s\n", __FUNCTION__, pt->live_idx,
         get_where_app_pc(where), get_register_name(reg));
@@ -1197,6 +1983,21 @@ drreg_reservation_info_ex(void *drcontext, reg_id_t reg, drreg_reserve_info_t *i
     if (info == NULL || info->size != sizeof(drreg_reserve_info_t))
         return DRREG_ERROR_INVALID_PARAMETER;
     pt = get_tls_data(drcontext);
+    if (simd_index(reg) >= 0) {
+        reg_info = &pt->simd[simd_index(reg)];
+        info->reserved = reg_info->in_use;
+        info->holds_app_value = reg_info->native;
+        info->app_value_retained = !reg_info->native && reg_info->ever_spilled;
+        info->is_dr_slot = false;
+        if (!reg_info->native && pt->simd_slot_use[reg_info->slot] != DR_REG_NULL) {
+            info->opnd = simd_slot_opnd(drcontext, reg_info->slot, reg_info->simd_reg);
+            info->tls_offs = tls_simd_offs + reg_info->slot * SIMD_SLOT_SIZE;
+        } else {
+            info->opnd = opnd_create_null();
+            info->tls_offs = -1;
+        }
+        return DRREG_SUCCESS;
+    }
     if (reg == DR_REG_NULL)
         reg_info = &pt->aflags;
     else {
@@ -1258,7 +2059,10 @@ drreg_is_register_dead(void *drcontext, reg_id_t reg, instr_t *inst, bool *dead)
             return res;
         ASSERT(pt->live_idx == 0, "non-drmgr-insert always uses 0 index");
     }
-    *dead = drvector_get_entry(&pt->reg[GPR_IDX(reg)].live, pt->live_idx) == REG_DEAD;
+    if (simd_index(reg) >= 0)
+        *dead = !drreg_simd_is_live(pt, simd_index(reg), pt->live_idx);
+    else
+        *dead = !drreg_reg_is_live(pt, reg, pt->live_idx);
     return DRREG_SUCCESS;
 }
 
@@ -1310,8 +2114,7 @@ drreg_move_aflags_from_reg(void *drcontext, instrlist_t *ilist, instr_t *where,
         pt->live_idx, get_where_app_pc(where),
         pt->reg[DR_REG_XAX - DR_REG_START_GPR].slot);
     if (ops.conservative ||
-        drvector_get_entry(&pt->reg[DR_REG_XAX - DR_REG_START_GPR].live, pt->live_idx) ==
-            REG_LIVE) {
+        drreg_reg_is_live(pt, DR_REG_XAX, pt->live_idx)) {
         restore_reg(drcontext, pt, DR_REG_XAX,
                     pt->reg[DR_REG_XAX - DR_REG_START_GPR].slot, ilist, where, stateful);
     } else if (stateful)
@@ -1330,7 +2133,7 @@ static drreg_status_t
 drreg_spill_aflags(void *drcontext, instrlist_t *ilist, instr_t *where, per_thread_t *pt)
 {
 #ifdef X86
-    uint aflags = (uint)(ptr_uint_t)drvector_get_entry(&pt->aflags.live, pt->live_idx);
+    uint aflags = pt->live[pt->live_idx].aflags;
     reg_id_t xax_swap = DR_REG_NULL;
     drreg_status_t res;
     LOG(drcontext, DR_LOG_ALL, 3, "%s @%d." PFX "\n", __FUNCTION__, pt->live_idx,
@@ -1362,8 +2165,7 @@ drreg_spill_aflags(void *drcontext, instrlist_t *ilist, instr_t *where, per_thre
         if (xax_slot == MAX_SPILLS)
             return DRREG_ERROR_OUT_OF_SLOTS;
         if (ops.conservative ||
-            drvector_get_entry(&pt->reg[DR_REG_XAX - DR_REG_START_GPR].live,
-                               pt->live_idx) == REG_LIVE)
+            drreg_reg_is_live(pt, DR_REG_XAX, pt->live_idx))
             spill_reg(drcontext, pt, DR_REG_XAX, xax_slot, ilist, where);
         else
             pt->slot_use[xax_slot] = DR_REG_XAX;
@@ -1413,7 +2215,7 @@ drreg_restore_aflags(void *drcontext, instrlist_t *ilist, instr_t *where,
                      per_thread_t *pt, bool release)
 {
 #ifdef X86
-    uint aflags = (uint)(ptr_uint_t)drvector_get_entry(&pt->aflags.live, pt->live_idx);
+    uint aflags = pt->live[pt->live_idx].aflags;
     uint temp_slot = 0;
     reg_id_t xax_swap = DR_REG_NULL;
     drreg_status_t res;
@@ -1442,8 +2244,7 @@ drreg_restore_aflags(void *drcontext, instrlist_t *ilist, instr_t *where,
                 INSTR_CREATE_xchg(drcontext, opnd_create_reg(DR_REG_XAX),
                                   opnd_create_reg(xax_swap)));
         } else if (ops.conservative ||
-                   drvector_get_entry(&pt->reg[DR_REG_XAX - DR_REG_START_GPR].live,
-                                      pt->live_idx) == REG_LIVE)
+                   drreg_reg_is_live(pt, DR_REG_XAX, pt->live_idx))
             spill_reg(drcontext, pt, DR_REG_XAX, temp_slot, ilist, where);
         restore_reg(drcontext, pt, DR_REG_XAX, AFLAGS_SLOT, ilist, where, release);
     }
@@ -1471,8 +2272,7 @@ drreg_restore_aflags(void *drcontext, instrlist_t *ilist, instr_t *where,
         }
     } else {
         if (ops.conservative ||
-            drvector_get_entry(&pt->reg[DR_REG_XAX - DR_REG_START_GPR].live,
-                               pt->live_idx) == REG_LIVE)
+            drreg_reg_is_live(pt, DR_REG_XAX, pt->live_idx))
             restore_reg(drcontext, pt, DR_REG_XAX, temp_slot, ilist, where, true);
     }
 #elif defined(AARCHXX)
@@ -1503,7 +2303,7 @@ drreg_reserve_aflags(void *drcontext, instrlist_t *ilist, instr_t *where)
             return res;
         ASSERT(pt->live_idx == 0, "non-drmgr-insert always uses 0 index");
     }
-    aflags = (uint)(ptr_uint_t)drvector_get_entry(&pt->aflags.live, pt->live_idx);
+    aflags = pt->live[pt->live_idx].aflags;
     /* Just like scratch regs, flags are exclusively owned */
     if (pt->aflags.in_use)
         return DRREG_ERROR_IN_USE;
@@ -1591,7 +2391,7 @@ drreg_aflags_liveness(void *drcontext, instr_t *inst, OUT uint *value)
             return res;
         ASSERT(pt->live_idx == 0, "non-drmgr-insert always uses 0 index");
     }
-    *value = (uint)(ptr_uint_t)drvector_get_entry(&pt->aflags.live, pt->live_idx);
+    *value = pt->live[pt->live_idx].aflags;
     return DRREG_SUCCESS;
 }
 
@@ -1706,6 +2506,52 @@ is_our_spill_or_restore(void *drcontext, instr_t *instr, bool *spill OUT,
     return true;
 }
 
+/* Recognizes the instrs emitted by spill_simd_reg() and restore_simd_reg(). */
+static bool
+is_our_simd_spill_or_restore(instr_t *instr, bool *spill OUT, reg_id_t *reg_spilled OUT,
+                             uint *slot_out OUT)
+{
+    int opc = instr_get_opcode(instr);
+    bool is_spill;
+    opnd_t regop, memop;
+    int disp;
+#ifdef X86
+    if (opc != OP_movdqu && opc != OP_vmovdqu)
+        return false;
+#elif defined(AARCH64)
+    if (opc != OP_str && opc != OP_ldr)
+        return false;
+#else
+    return false;
+#endif
+    if (ops.num_spill_simd_slots == 0 || instr_num_srcs(instr) < 1 ||
+        instr_num_dsts(instr) < 1)
+        return false;
+    is_spill = opnd_is_memory_reference(instr_get_dst(instr, 0));
+    regop = is_spill ? instr_get_src(instr, 0) : instr_get_dst(instr, 0);
+    memop = is_spill ? instr_get_dst(instr, 0) : instr_get_src(instr, 0);
+    if (!opnd_is_reg(regop) || simd_index(opnd_get_reg(regop)) < 0)
+        return false;
+#ifdef X86
+    if (!opnd_is_far_base_disp(memop) || opnd_get_segment(memop) != tls_seg ||
+        opnd_get_base(memop) != DR_REG_NULL)
+        return false;
+#else
+    if (!opnd_is_base_disp(memop) || opnd_get_base(memop) != tls_seg)
+        return false;
+#endif
+    if (opnd_get_index(memop) != DR_REG_NULL)
+        return false;
+    disp = opnd_get_disp(memop);
+    if (disp < (int)tls_simd_offs ||
+        disp >= (int)(tls_simd_offs + ops.num_spill_simd_slots * SIMD_SLOT_SIZE))
+        return false;
+    *spill = is_spill;
+    *reg_spilled = opnd_get_reg(regop);
+    *slot_out = (disp - tls_simd_offs) / SIMD_SLOT_SIZE;
+    return true;
+}
+
 drreg_status_t
 drreg_is_instr_spill_or_restore(void *drcontext, instr_t *instr, bool *spill OUT,
                                 bool *restore OUT, reg_id_t *reg_spilled OUT)
@@ -1737,8 +2583,12 @@ drreg_event_restore_state(void *drcontext, bool restore_memory,
      * spill to a temp slot (from drreg_event_bb_insert_late()) by watching for
      * a spill of an already-spilled reg to a different slot.
      */
+    per_thread_t *pt = get_tls_data(drcontext);
     uint spilled_to[DR_NUM_GPR_REGS];
     uint spilled_to_aflags = MAX_SPILLS;
+    uint simd_spilled_to[NUM_SIMD_REGS];
+    reg_id_t simd_spilled_reg[NUM_SIMD_REGS];
+    int i;
     reg_id_t reg;
     instr_t inst;
     byte *prev_pc, *pc = info->fragment_info.cache_start_pc;
@@ -1753,6 +2603,8 @@ drreg_event_restore_state(void *drcontext, bool restore_memory,
         return true; /* fault not in cache */
     for (reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++)
         spilled_to[GPR_IDX(reg)] = MAX_SPILLS;
+    for (i = 0; i < NUM_SIMD_REGS; i++)
+        simd_spilled_to[i] = MAX_SIMD_SPILLS;
     LOG(drcontext, DR_LOG_ALL, 3,
         "%s: processing fault @" PFX ": decoding from " PFX "\n", __FUNCTION__,
         info->raw_mcontext->pc, pc);
@@ -1798,6 +2650,20 @@ drreg_event_restore_state(void *drcontext, bool restore_memory,
             }
 #endif
         }
+        else if (is_our_simd_spill_or_restore(&inst, &spill, &reg, &slot)) {
+            /* The same tool-value heuristic as for GPRs */
+            i = simd_index(reg);
+            LOG(drcontext, DR_LOG_ALL, 3, "%s @" PFX " found %s to %s => SIMD slot %d\n",
+                __FUNCTION__, prev_pc, spill ? "spill" : "restore",
+                get_register_name(reg), slot);
+            if (spill) {
+                if (simd_spilled_to[i] == MAX_SIMD_SPILLS || simd_spilled_to[i] == slot) {
+                    simd_spilled_to[i] = slot;
+                    simd_spilled_reg[i] = reg;
+                }
+            } else if (simd_spilled_to[i] == slot)
+                simd_spilled_to[i] = MAX_SIMD_SPILLS;
+        }
 #ifdef X86
         else if (prev_xax_spill && instr_get_opcode(&inst) == OP_lahf && spill)
             aflags_in_xax = true;
@@ -1832,6 +2698,18 @@ drreg_event_restore_state(void *drcontext, bool restore_memory,
             reg_set_value(reg, info->mcontext, val);
         }
     }
+    for (i = 0; i < NUM_SIMD_REGS; i++) {
+        if (simd_spilled_to[i] < MAX_SIMD_SPILLS &&
+            TEST(DR_MC_MULTIMEDIA, info->mcontext->flags)) {
+            byte *src = pt->tls_seg_base + tls_simd_offs +
+                simd_spilled_to[i] * SIMD_SLOT_SIZE;
+            LOG(drcontext, DR_LOG_ALL, 3, "%s: restoring %s from SIMD slot %d\n",
+                __FUNCTION__, get_register_name(simd_spilled_reg[i]),
+                simd_spilled_to[i]);
+            memcpy(&info->mcontext->simd[i], src,
+                   opnd_size_in_bytes(reg_get_size(simd_spilled_reg[i])));
+        }
+    }
 
     return true;
 }
@@ -1858,23 +2736,21 @@ static void
 tls_data_init(per_thread_t *pt)
 {
     reg_id_t reg;
+    int i;
     memset(pt, 0, sizeof(*pt));
-    for (reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++) {
-        drvector_init(&pt->reg[GPR_IDX(reg)].live, 20, false /*!synch*/, NULL);
+    for (reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++)
         pt->reg[GPR_IDX(reg)].native = true;
-    }
     pt->aflags.native = true;
-    drvector_init(&pt->aflags.live, 20, false /*!synch*/, NULL);
+    for (i = 0; i < NUM_SIMD_REGS; i++)
+        pt->simd[i].native = true;
+    pt->live_capacity = LIVE_INFO_INIT_CAPACITY;
+    pt->live = (live_info_t *)dr_global_alloc(pt->live_capacity * sizeof(*pt->live));
 }
 
 static void
 tls_data_free(per_thread_t *pt)
 {
-    reg_id_t reg;
-    for (reg = DR_REG_START_GPR; reg <= DR_REG_STOP_GPR; reg++) {
-        drvector_delete(&pt->reg[GPR_IDX(reg)].live);
-    }
-    drvector_delete(&pt->aflags.live);
+    dr_global_free(pt->live, pt->live_capacity * sizeof(*pt->live));
 }
 
 static void
@@ -1898,6 +2774,7 @@ drreg_status_t
 drreg_init(drreg_options_t *ops_in)
 {
     uint prior_slots = ops.num_spill_slots;
+    uint prior_simd_slots = ops.num_spill_simd_slots;
     drmgr_priority_t high_priority = { sizeof(high_priority),
                                        DRMGR_PRIORITY_NAME_DRREG_HIGH, NULL, NULL,
                                        DRMGR_PRIORITY_INSERT_DRREG_HIGH };
@@ -1964,9 +2841,31 @@ drreg_init(drreg_options_t *ops_in)
         ops.do_not_sum_slots = false;
     }
 
+    /* SIMD slots are combined the same way. */
+    if (ops_in->struct_size > offsetof(drreg_options_t, num_spill_simd_slots)) {
+        if (ops.do_not_sum_slots) {
+            if (ops_in->num_spill_simd_slots > ops.num_spill_simd_slots)
+                ops.num_spill_simd_slots = ops_in->num_spill_simd_slots;
+        } else
+            ops.num_spill_simd_slots += ops_in->num_spill_simd_slots;
+        if (ops.num_spill_simd_slots > MAX_SIMD_SPILLS)
+            return DRREG_ERROR_OUT_OF_SLOTS;
+    }
+
     /* If anyone wants to be conservative, then be conservative. */
     ops.conservative = ops.conservative || ops_in->conservative;
 
+    /* Anyone can turn on cross-block liveness, but conservative wins. */
+    if (ops_in->struct_size > offsetof(drreg_options_t, cross_block_liveness) &&
+        ops_in->cross_block_liveness && hint_lock == NULL) {
+        hint_lock = dr_mutex_create();
+        hashtable_init_ex(&hint_table, HINT_TABLE_BITS, HASH_INTPTR, false /*!strdup*/,
+                          false /*!synch: hint_lock*/, bb_hint_free, NULL, NULL);
+        if (!drmgr_register_module_unload_event(drreg_event_module_unload))
+            return DRREG_ERROR;
+    }
+    ops.cross_block_liveness = hint_lock != NULL && !ops.conservative;
+
     /* The first callback wins. */
     if (ops_in->struct_size > offsetof(drreg_options_t, error_callback) &&
         ops.error_callback == NULL)
@@ -1980,6 +2879,25 @@ drreg_init(drreg_options_t *ops_in)
     if (!dr_raw_tls_calloc(&tls_seg, &tls_slot_offs, ops.num_spill_slots, 0))
         return DRREG_ERROR_OUT_OF_SLOTS;
 
+    if (ops.num_spill_simd_slots != prior_simd_slots) {
+        if (tls_simd_raw_slots > 0) {
+            if (!dr_raw_tls_cfree(tls_simd_raw_offs, tls_simd_raw_slots))
+                return DRREG_ERROR;
+            tls_simd_raw_slots = 0;
+        }
+        if (ops.num_spill_simd_slots > 0) {
+            tls_simd_raw_slots =
+                ops.num_spill_simd_slots * SIMD_SLOT_SIZE / sizeof(reg_t) +
+                SIMD_SLOT_ALIGN / sizeof(reg_t) - 1;
+            if (!dr_raw_tls_calloc(&tls_seg, &tls_simd_raw_offs, tls_simd_raw_slots,
+                                   0)) {
+                tls_simd_raw_slots = 0;
+                return DRREG_ERROR_OUT_OF_SLOTS;
+            }
+            tls_simd_offs = (uint)ALIGN_FORWARD(tls_simd_raw_offs, SIMD_SLOT_ALIGN);
+        }
+    }
+
     return DRREG_SUCCESS;
 }
 
@@ -2008,6 +2926,18 @@ drreg_exit(void)
         if (!dr_raw_tls_cfree(tls_slot_offs, ops.num_spill_slots))
             return DRREG_ERROR;
     }
+    if (tls_simd_raw_slots > 0) {
+        if (!dr_raw_tls_cfree(tls_simd_raw_offs, tls_simd_raw_slots))
+            return DRREG_ERROR;
+        tls_simd_raw_slots = 0;
+    }
+    if (hint_lock != NULL) {
+        if (!drmgr_unregister_module_unload_event(drreg_event_module_unload))
+            return DRREG_ERROR;
+        hashtable_delete(&hint_table);
+        dr_mutex_destroy(hint_lock);
+        hint_lock = NULL;
+    }
 
     /* Support re-attach */
     memset(&ops, 0, sizeof(ops));
@@ -167,6 +167,38 @@ typedef struct _drreg_options_t {
      * needed.
      */
     bool do_not_sum_slots;
+    /**
+     * The number of SIMD spill slots to use for registers reserved with
+     * drreg_reserve_register_ex() and a SIMD #drreg_spill_class_t.  Each slot
+     * holds one full register of the largest supported class and comes out of
+     * the same dr_raw_tls_calloc() budget as \p num_spill_slots.  As with
+     * general-purpose registers, each SIMD value held across application
+     * instructions needs one extra slot.  SIMD registers cannot be reserved if
+     * this is 0, in which case drreg also skips SIMD liveness analysis.
+     *
+     * When drreg_init() is called multiple times, this is combined just like
+     * \p num_spill_slots.
+     */
+    uint num_spill_simd_slots;
+    /**
+     * Normally drreg treats every register and the arithmetic flags as live at
+     * the end of a block.  If this is set, drreg instead remembers what is live
+     * at the start of each block, and uses that for a new block whose direct
+     * successors in the same module have all been seen.  Registers dead in all
+     * successors are then neither spilled nor restored at the block end.  Blocks
+     * that relied on another block's liveness store their translations (see
+     * #DR_EMIT_STORE_TRANSLATIONS).
+     *
+     * As with dead registers within a block, the application state presented at
+     * a fault, signal, or block boundary may then contain tool values in
+     * registers that are dead.  This is ignored if \p conservative is set, and
+     * it must not be used by tools that insert exits from blocks to other
+     * application code, nor for applications that modify their own module code.
+     *
+     * If multiple drreg_init() calls are made, this field is combined by
+     * logical OR.
+     */
+    bool cross_block_liveness;
 } drreg_options_t;
 
 DR_EXPORT
@@ -283,6 +315,25 @@ drreg_restore_app_aflags(void *drcontext, instrlist_t *ilist, instr_t *where);
  * SCRATCH REGISTERS
  */
 
+/** The class of register requested from drreg_reserve_register_ex(). */
+typedef enum {
+    /** A general-purpose register, as returned by drreg_reserve_register(). */
+    DRREG_GPR_SPILL_CLASS,
+    /**
+     * A 128-bit SIMD register: an xmm register on x86 or a q register on
+     * AArch64.  Only the low 128 bits of the application value are preserved,
+     * so on x86 the tool must use only legacy SSE encodings on the register, as
+     * VEX-encoded writes zero its upper bits.
+     */
+    DRREG_SIMD_XMM_SPILL_CLASS,
+    /**
+     * A 256-bit ymm register on x86.  Requires AVX support in the processor.
+     * The upper bits of a zmm register are not preserved, so the tool must not
+     * use EVEX encodings on the register.  Not supported on ARM.
+     */
+    DRREG_SIMD_YMM_SPILL_CLASS,
+} drreg_spill_class_t;
+
 /** Flags passed to drreg_set_bb_properties(). */
 typedef enum {
     /**
@@ -363,6 +414,40 @@ drreg_status_t
 drreg_reserve_dead_register(void *drcontext, instrlist_t *ilist, instr_t *where,
                             drvector_t *reg_allowed, OUT reg_id_t *reg);
 
+DR_EXPORT
+/**
+ * Identical to drreg_reserve_register() except the class of register is
+ * specified by \p spill_class.  For a SIMD class, \p reg_allowed must be
+ * set up with drreg_init_and_fill_vector_ex() for that class, and \p
+ * drreg_options_t.num_spill_simd_slots must be non-zero.  SIMD registers
+ * have the same lazy restore and liveness behavior as general-purpose
+ * registers, are released with drreg_unreserve_register(), and can be
+ * passed to drreg_get_app_value() (with the same register as source and
+ * destination), drreg_is_register_dead(), and drreg_reservation_info_ex().
+ *
+ * Returns #DRREG_ERROR_FEATURE_NOT_AVAILABLE if the processor does not
+ * support \p spill_class, which is always the case for SIMD classes on
+ * 32-bit ARM.
+ *
+ * @return whether successful or an error code on failure.
+ */
+drreg_status_t
+drreg_reserve_register_ex(void *drcontext, drreg_spill_class_t spill_class,
+                          instrlist_t *ilist, instr_t *where, drvector_t *reg_allowed,
+                          OUT reg_id_t *reg);
+
+DR_EXPORT
+/**
+ * Identical to drreg_reserve_register_ex() except returns failure if no
+ * register is available that does not require a spill.
+ *
+ * @return whether successful or an error code on failure.
+ */
+drreg_status_t
+drreg_reserve_dead_register_ex(void *drcontext, drreg_spill_class_t spill_class,
+                               instrlist_t *ilist, instr_t *where,
+                               drvector_t *reg_allowed, OUT reg_id_t *reg);
+
 DR_EXPORT
 /**
  * Initializes \p vec to hold #DR_NUM_GPR_REGS entries, each either
@@ -376,12 +461,27 @@ DR_EXPORT
 drreg_status_t
 drreg_init_and_fill_vector(drvector_t *vec, bool allowed);
 
+DR_EXPORT
+/**
+ * Identical to drreg_init_and_fill_vector() except the vector is sized for
+ * the registers of \p spill_class, for use with drreg_reserve_register_ex().
+ * A SIMD vector holds one entry per SIMD register number, which all of that
+ * register's views (e.g., xmm1 and ymm1) share.
+ *
+ * @return whether successful or an error code on failure.
+ */
+drreg_status_t
+drreg_init_and_fill_vector_ex(drvector_t *vec, drreg_spill_class_t spill_class,
+                              bool allowed);
+
 DR_EXPORT
 /**
  * Sets the entry in \p vec at index \p reg minus #DR_REG_START_GPR to
  * NULL if \p allowed is false or a non-NULL value if \p allowed is
  * true.  This is intendend as a convenience routine for setting up
- * the \p reg_allowed parameter to drreg_reserve_register().
+ * the \p reg_allowed parameter to drreg_reserve_register().  If \p reg
+ * is a SIMD register, the entry for its register number is set instead,
+ * for a vector set up by drreg_init_and_fill_vector_ex().
  *
  * @return whether successful or an error code on failure.
  */
@@ -196,6 +196,44 @@ wrap_entry_free(void *v)
     }
 }
 
+/* A drwrap_wrap_lite() request.  Instrumentation refers to these directly, so
+ * they are only freed at exit: unwrapping just disables them.
+ */
+typedef struct _lite_entry_t {
+    app_pc func;
+    drwrap_lite_pre_cb_t pre_cb;
+    drwrap_lite_post_cb_t post_cb;
+    void *user_data;
+    uint num_args;
+    drwrap_callconv_t callconv;
+    bool enabled;
+} lite_entry_t;
+
+#define LITE_TABLE_HASH_BITS 6
+/* Protected by wrap_lock. */
+static hashtable_t lite_table;
+/* Set once any lite wrap is requested: from then on each new block's returns
+ * are checked.  Protected by wrap_lock.
+ */
+static bool lite_check_rets;
+
+static void
+lite_entry_free(void *v)
+{
+    dr_global_free(v, sizeof(lite_entry_t));
+}
+
+#ifdef X86
+/* Raw TLS for the inline return check: the negated stack pointer at the entry
+ * of the innermost lite-wrapped call (0 if none), and a spill slot.
+ */
+#    define LITE_TLS_NEG_XSP 0
+#    define LITE_TLS_SPILL 1
+#    define LITE_TLS_SLOTS 2
+static reg_id_t lite_tls_seg;
+static uint lite_tls_offs;
+#endif
+
 /* TLS.  OK to be callback-shared: just more nesting. */
 static int tls_idx;
 
@@ -210,6 +248,14 @@ static int tls_idx;
 /* Lazy removal and flushing.  Protected by wrap_lock. */
 static uint disabled_count;
 
+/* Flushes requested by wrap and replace updates while a drwrap_begin_batch() is
+ * open, deferred to the outermost drwrap_end_batch().  Protected by wrap_lock.
+ */
+static int batch_depth;
+static drvector_t batch_unlink_pcs; /* for dr_unlink_flush_region() */
+static drvector_t batch_delay_pcs;  /* for dr_delay_flush_region() */
+#define BATCH_INITIAL_CAPACITY 64
+
 /* i#1713: per-thread state, similar to where_am_i_t */
 typedef enum _drwrap_where_t {
     DRWRAP_WHERE_OUTSIDE_CALLBACK,
@@ -238,6 +284,16 @@ typedef struct _per_thread_t {
     bool hit_exception;
 #endif
     app_pc retaddr[MAX_WRAP_NESTING];
+    /* drwrap_wrap_lite() calls in progress, innermost at lite_level. */
+    int lite_level;
+    struct {
+        reg_t xsp; /* at the entry, so the retaddr slot */
+        app_pc retaddr;
+        drwrap_lite_post_cb_t post_cb;
+        void *user_data;
+        void *call_data;
+    } lite[MAX_WRAP_NESTING];
+    reg_t *lite_tls; /* this thread's LITE_TLS_* slots */
 } per_thread_t;
 
 /***************************************************************************
@@ -901,6 +957,9 @@ drwrap_event_exception(void *drcontext, dr_exception_t *excpt);
 static void
 drwrap_replace_init(void);
 
+static bool
+drwrap_batch_defer_flush(app_pc pc, bool delay);
+
 /***************************************************************************
  * INIT
  */
@@ -954,6 +1013,14 @@ drwrap_init(void)
     hashtable_init_ex(&post_call_table, POST_CALL_TABLE_HASH_BITS, HASH_INTPTR,
                       false /*!str_dup*/, false /*!synch*/, post_call_entry_free, NULL,
                       NULL);
+    hashtable_init_ex(&lite_table, LITE_TABLE_HASH_BITS, HASH_INTPTR, false /*!str_dup*/,
+                      false /*!synch*/, lite_entry_free, NULL, NULL);
+#ifdef X86
+    if (!dr_raw_tls_calloc(&lite_tls_seg, &lite_tls_offs, LITE_TLS_SLOTS, 0))
+        return false;
+#endif
+    drvector_init(&batch_unlink_pcs, BATCH_INITIAL_CAPACITY, false /*!synch*/, NULL);
+    drvector_init(&batch_delay_pcs, BATCH_INITIAL_CAPACITY, false /*!synch*/, NULL);
     post_call_rwlock = dr_rwlock_create();
     wrap_lock = dr_recurlock_create();
     drmgr_register_module_unload_event(drwrap_event_module_unload);
@@ -1013,6 +1080,15 @@ drwrap_exit(void)
     hashtable_delete(&replace_native_table);
     hashtable_delete(&wrap_table);
     hashtable_delete(&post_call_table);
+    hashtable_delete(&lite_table);
+    lite_check_rets = false;
+    drvector_delete(&batch_unlink_pcs);
+    drvector_delete(&batch_delay_pcs);
+    batch_depth = 0;
+#ifdef X86
+    if (!dr_raw_tls_cfree(lite_tls_offs, LITE_TLS_SLOTS))
+        ASSERT(false, "failed to free lite TLS");
+#endif
     dr_rwlock_destroy(post_call_rwlock);
     dr_recurlock_destroy(wrap_lock);
     drmgr_exit();
@@ -1030,6 +1106,10 @@ drwrap_thread_init(void *drcontext)
     per_thread_t *pt = (per_thread_t *)dr_thread_alloc(drcontext, sizeof(*pt));
     memset(pt, 0, sizeof(*pt));
     pt->wrap_level = -1;
+    pt->lite_level = -1;
+#ifdef X86
+    pt->lite_tls = (reg_t *)(dr_get_dr_segment_base(lite_tls_seg) + lite_tls_offs);
+#endif
     drmgr_set_tls_field(drcontext, tls_idx, (void *)pt);
 }
 
@@ -1205,7 +1285,8 @@ drwrap_replace_common(hashtable_t *table, app_pc original, void *payload, bool o
     /* XXX: we're assuming void* tag == pc
      * XXX: we're assuming the replace target is not in the middle of a trace
      */
-    if (flush || dr_fragment_exists_at(dr_get_current_drcontext(), original)) {
+    if ((flush || dr_fragment_exists_at(dr_get_current_drcontext(), original)) &&
+        !drwrap_batch_defer_flush(original, true /*delay*/)) {
         /* we do not guarantee faster than a lazy flush.
          * we can't use dr_unlink_flush_region() unless we require that
          * caller hold no locks and be in clean call or syscall event.
@@ -1676,6 +1757,119 @@ drwrap_flush_func(app_pc func)
         ASSERT(false, "wrap update flush failed");
 }
 
+/* Sorts pcs in place and flushes them, combining those less than a page apart
+ * into one region.  Uses dr_delay_flush_region() if delay is set and
+ * dr_unlink_flush_region() otherwise.  If only_existing is set, a region is
+ * skipped when none of its pcs is still in the cache, as DR flushes at a
+ * coarser granularity and an earlier region may have covered it.
+ */
+static void
+drwrap_flush_pcs(app_pc *pcs, uint num, bool delay, bool only_existing)
+{
+    void *drcontext = dr_get_current_drcontext();
+    size_t max_gap = dr_page_size();
+    uint i, j, gap;
+    ASSERT(!dr_recurlock_self_owns(wrap_lock), "cannot hold lock while flushing");
+    /* shell sort: no libc, and this is not worth a heap */
+    for (gap = num / 2; gap > 0; gap /= 2) {
+        for (i = gap; i < num; i++) {
+            app_pc pc = pcs[i];
+            for (j = i; j >= gap && pcs[j - gap] > pc; j -= gap)
+                pcs[j] = pcs[j - gap];
+            pcs[j] = pc;
+        }
+    }
+    for (i = 0; i < num;) {
+        app_pc start = pcs[i], end = pcs[i] + 1;
+        /* XXX: we're assuming void* tag == pc */
+        bool exists = !only_existing || dr_fragment_exists_at(drcontext, pcs[i]);
+        for (i++; i < num && (ptr_int_t)(pcs[i] - end) < (ptr_int_t)max_gap; i++) {
+            end = pcs[i] + 1;
+            if (!exists)
+                exists = dr_fragment_exists_at(drcontext, pcs[i]);
+        }
+        if (!exists)
+            continue;
+        dr_atomic_add_stat_return_sum(&drwrap_stats.flush_count, 1);
+        if (delay) {
+            if (!dr_delay_flush_region(start, end - start, 0, NULL))
+                ASSERT(false, "batch replace flush failed");
+        } else {
+            if (!dr_unlink_flush_region(start, end - start))
+                ASSERT(false, "batch wrap flush failed");
+        }
+    }
+}
+
+/* If a batch is open, records pc for flushing at its end and returns true. */
+static bool
+drwrap_batch_defer_flush(app_pc pc, bool delay)
+{
+    bool deferred = false;
+    dr_recurlock_lock(wrap_lock);
+    if (batch_depth > 0) {
+        drvector_append(delay ? &batch_delay_pcs : &batch_unlink_pcs, (void *)pc);
+        deferred = true;
+    }
+    dr_recurlock_unlock(wrap_lock);
+    return deferred;
+}
+
+/* Moves the pcs out of vec into a new array so they can be flushed unlocked. */
+static app_pc *
+drwrap_batch_take_pcs(drvector_t *vec, OUT uint *num)
+{
+    app_pc *pcs = NULL;
+    *num = vec->entries;
+    if (*num > 0) {
+        pcs = dr_global_alloc(*num * sizeof(*pcs));
+        memcpy(pcs, vec->array, *num * sizeof(*pcs));
+        vec->entries = 0;
+    }
+    return pcs;
+}
+
+DR_EXPORT
+void
+drwrap_begin_batch(void)
+{
+    dr_recurlock_lock(wrap_lock);
+    batch_depth++;
+    dr_recurlock_unlock(wrap_lock);
+}
+
+DR_EXPORT
+bool
+drwrap_end_batch(void)
+{
+    app_pc *unlink_pcs, *delay_pcs;
+    uint num_unlink, num_delay;
+    dr_recurlock_lock(wrap_lock);
+    if (batch_depth == 0) {
+        dr_recurlock_unlock(wrap_lock);
+        return false;
+    }
+    if (--batch_depth > 0) {
+        dr_recurlock_unlock(wrap_lock);
+        return true;
+    }
+    unlink_pcs = drwrap_batch_take_pcs(&batch_unlink_pcs, &num_unlink);
+    delay_pcs = drwrap_batch_take_pcs(&batch_delay_pcs, &num_delay);
+    dr_recurlock_unlock(wrap_lock);
+    NOTIFY(1, "%s: flushing %u wrap and %u replace updates\n", __FUNCTION__,
+           num_unlink, num_delay);
+    if (unlink_pcs != NULL) {
+        drwrap_flush_pcs(unlink_pcs, num_unlink, false /*unlink*/,
+                         true /*only_existing*/);
+        dr_global_free(unlink_pcs, num_unlink * sizeof(*unlink_pcs));
+    }
+    if (delay_pcs != NULL) {
+        drwrap_flush_pcs(delay_pcs, num_delay, true /*delay*/, false /*all*/);
+        dr_global_free(delay_pcs, num_delay * sizeof(*delay_pcs));
+    }
+    return true;
+}
+
 static app_pc
 get_retaddr_from_stack(reg_t xsp)
 {
@@ -2166,12 +2360,11 @@ drwrap_after_callee_func(void *drcontext, per_thread_t *pt, dr_mcontext_t *mc, i
         dr_set_mcontext(drcontext, wrapcxt.mc);
 
     if (do_flush) {
-        /* handle delayed flushes while holding no lock
-         * XXX: optimization: combine nearby addresses to reduce # flushes
+        /* handle delayed flushes while holding no lock, combining nearby
+         * addresses to reduce # flushes
          */
-        uint i;
-        for (i = 0; i < toflush.entries; i++)
-            drwrap_flush_func((app_pc)toflush.array[i]);
+        drwrap_flush_pcs((app_pc *)toflush.array, toflush.entries, false /*unlink*/,
+                         false /*all*/);
         drvector_delete(&toflush);
     }
 
@@ -2264,6 +2457,205 @@ drwrap_insert_post_call(void *drcontext, instrlist_t *bb, instr_t *where,
                             opnd_create_reg(DR_REG_XSP));
 }
 
+/***************************************************************************
+ * LIGHTWEIGHT WRAPPING
+ */
+
+#ifdef X86
+/* A lite-wrapped call's return is the return instruction executed with the
+ * stack pointer it had at the entry (for a tail call, that of the outermost
+ * caller's frame, which serves the whole chain).  Rather than instrumenting
+ * post-call sites, we keep the innermost such stack pointer negated in TLS and
+ * check it inline before every return, which needs neither a table lookup nor
+ * a flush for a newly seen caller.
+ */
+
+static void
+drwrap_lite_set_top(per_thread_t *pt)
+{
+    if (pt->lite_level >= 0)
+        pt->lite_tls[LITE_TLS_NEG_XSP] = (reg_t)(-(ptr_int_t)pt->lite[pt->lite_level].xsp);
+    else
+        pt->lite_tls[LITE_TLS_NEG_XSP] = 0;
+}
+
+/* called via clean call at the top of callee */
+static void
+drwrap_lite_in_callee(lite_entry_t *lite, reg_t xsp, reg_t arg0, reg_t arg1, reg_t arg2,
+                      reg_t arg3)
+{
+    void *drcontext = dr_get_current_drcontext();
+    per_thread_t *pt = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+    void *call_data = NULL;
+    app_pc retaddr = get_retaddr_from_stack(xsp);
+
+    /* Drop calls that were left without reaching their return (longjmp, an
+     * exception).  The same stack pointer and retaddr is a tail call, which
+     * shares the frame's return, so it is kept.
+     */
+    while (pt->lite_level >= 0 &&
+           (pt->lite[pt->lite_level].xsp < xsp ||
+            (pt->lite[pt->lite_level].xsp == xsp &&
+             pt->lite[pt->lite_level].retaddr != retaddr)))
+        pt->lite_level--;
+    if (lite->enabled) {
+        NOTIFY(2, "%s: level %d function " PFX "\n", __FUNCTION__, pt->lite_level + 1,
+               lite->func);
+        if (lite->pre_cb != NULL)
+            call_data = (*lite->pre_cb)(lite->user_data, arg0, arg1, arg2, arg3);
+        if (lite->post_cb != NULL) {
+            ASSERT(pt->lite_level + 1 < MAX_WRAP_NESTING, "max wrapped nesting reached");
+            if (pt->lite_level + 1 < MAX_WRAP_NESTING) {
+                pt->lite_level++;
+                pt->lite[pt->lite_level].xsp = xsp;
+                pt->lite[pt->lite_level].retaddr = retaddr;
+                pt->lite[pt->lite_level].post_cb = lite->post_cb;
+                pt->lite[pt->lite_level].user_data = lite->user_data;
+                pt->lite[pt->lite_level].call_data = call_data;
+            }
+        }
+    }
+    drwrap_lite_set_top(pt);
+}
+
+/* called via clean call at a return whose stack pointer matched */
+static void
+drwrap_lite_after_callee(reg_t retval, reg_t xsp)
+{
+    void *drcontext = dr_get_current_drcontext();
+    per_thread_t *pt = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+    app_pc retaddr = get_retaddr_from_stack(xsp);
+    /* A frame whose stack pointer matches but whose return address does not was
+     * abandoned and its slot reused by a sibling call: drop it silently.
+     */
+    while (pt->lite_level >= 0 && pt->lite[pt->lite_level].xsp <= xsp) {
+        int level = pt->lite_level--;
+        if (pt->lite[level].xsp == xsp && pt->lite[level].retaddr == retaddr) {
+            (*pt->lite[level].post_cb)(pt->lite[level].user_data,
+                                       pt->lite[level].call_data, retval);
+        }
+    }
+    drwrap_lite_set_top(pt);
+}
+
+static bool
+drwrap_lite_callconv_supported(drwrap_callconv_t callconv)
+{
+    switch (callconv) {
+#    ifdef X64
+    case DRWRAP_CALLCONV_AMD64:
+    case DRWRAP_CALLCONV_MICROSOFT_X64: return true;
+#    else
+    case DRWRAP_CALLCONV_CDECL:
+    case DRWRAP_CALLCONV_FASTCALL:
+    case DRWRAP_CALLCONV_THISCALL: return true;
+#    endif
+    default: return false;
+    }
+}
+
+/* Returns the operand holding the arg-th argument at the callee entry. */
+static opnd_t
+drwrap_lite_arg_opnd(drwrap_callconv_t callconv, uint arg)
+{
+    uint stack_arg = arg;
+    switch (callconv) {
+#    ifdef X64
+    case DRWRAP_CALLCONV_AMD64: {
+        static const reg_id_t regs[] = { DR_REG_RDI, DR_REG_RSI, DR_REG_RDX,
+                                         DR_REG_RCX };
+        ASSERT(arg < sizeof(regs) / sizeof(regs[0]), "too many args");
+        return opnd_create_reg(regs[arg]);
+    }
+    case DRWRAP_CALLCONV_MICROSOFT_X64: {
+        static const reg_id_t regs[] = { DR_REG_RCX, DR_REG_RDX, DR_REG_R8, DR_REG_R9 };
+        ASSERT(arg < sizeof(regs) / sizeof(regs[0]), "too many args");
+        return opnd_create_reg(regs[arg]);
+    }
+#    else
+    case DRWRAP_CALLCONV_FASTCALL:
+        if (arg < 2)
+            return opnd_create_reg(arg == 0 ? DR_REG_ECX : DR_REG_EDX);
+        stack_arg = arg - 2;
+        break;
+    case DRWRAP_CALLCONV_THISCALL:
+        if (arg == 0)
+            return opnd_create_reg(DR_REG_ECX);
+        stack_arg = arg - 1;
+        break;
+#    endif
+    default: break;
+    }
+    /* Skip the retaddr. */
+    return OPND_CREATE_MEMPTR(DR_REG_XSP, (stack_arg + 1) * sizeof(reg_t));
+}
+
+static void
+drwrap_lite_insert_pre(void *drcontext, instrlist_t *bb, instr_t *where,
+                       lite_entry_t *lite)
+{
+    opnd_t args[DRWRAP_LITE_MAX_ARGS];
+    uint i;
+    for (i = 0; i < DRWRAP_LITE_MAX_ARGS; i++) {
+        args[i] = i < lite->num_args ? drwrap_lite_arg_opnd(lite->callconv, i)
+                                     : OPND_CREATE_INTPTR(0);
+    }
+    /* As with DRWRAP_FAST_CLEANCALLS, we rely on the ABI at the entry. */
+    dr_insert_clean_call_ex(drcontext, bb, where, (void *)drwrap_lite_in_callee,
+                            DR_CLEANCALL_NOSAVE_FLAGS | DR_CLEANCALL_NOSAVE_XMM_NONPARAM,
+                            6, OPND_CREATE_INTPTR((ptr_int_t)lite),
+                            opnd_create_reg(DR_REG_XSP), args[0], args[1], args[2],
+                            args[3]);
+}
+
+static void
+drwrap_lite_insert_ret_check(void *drcontext, instrlist_t *bb, instr_t *where)
+{
+    /* We use jecxz on the sum of xsp and the negated entry xsp so that neither
+     * the arithmetic flags nor a second register are needed:
+     *     mov  [spill], xcx
+     *     mov  xcx, [neg_xsp]
+     *     lea  xcx, [xsp + xcx]
+     *     jecxz match
+     *     jmp  done
+     *   match:
+     *     <clean call>
+     *   done:
+     *     mov  xcx, [spill]
+     * XXX: we do not restore xcx if DR translates from the middle of this,
+     * which only happens for a synchronous suspension as nothing here faults.
+     */
+    instr_t *match = INSTR_CREATE_label(drcontext);
+    instr_t *done = INSTR_CREATE_label(drcontext);
+    opnd_t neg_xsp = opnd_create_far_base_disp(
+        lite_tls_seg, DR_REG_NULL, DR_REG_NULL, 0,
+        lite_tls_offs + LITE_TLS_NEG_XSP * sizeof(reg_t), OPSZ_PTR);
+    opnd_t spill =
+        opnd_create_far_base_disp(lite_tls_seg, DR_REG_NULL, DR_REG_NULL, 0,
+                                  lite_tls_offs + LITE_TLS_SPILL * sizeof(reg_t), OPSZ_PTR);
+    instrlist_meta_preinsert(
+        bb, where, INSTR_CREATE_mov_st(drcontext, spill, opnd_create_reg(DR_REG_XCX)));
+    instrlist_meta_preinsert(
+        bb, where, INSTR_CREATE_mov_ld(drcontext, opnd_create_reg(DR_REG_XCX), neg_xsp));
+    instrlist_meta_preinsert(
+        bb, where,
+        INSTR_CREATE_lea(drcontext, opnd_create_reg(DR_REG_XCX),
+                         opnd_create_base_disp(DR_REG_XSP, DR_REG_XCX, 1, 0, OPSZ_lea)));
+    instrlist_meta_preinsert(bb, where,
+                             INSTR_CREATE_jecxz(drcontext, opnd_create_instr(match)));
+    instrlist_meta_preinsert(bb, where,
+                             INSTR_CREATE_jmp(drcontext, opnd_create_instr(done)));
+    instrlist_meta_preinsert(bb, where, match);
+    /* Flags and non-return xmm registers are scratch at a return. */
+    dr_insert_clean_call_ex(drcontext, bb, where, (void *)drwrap_lite_after_callee,
+                            DR_CLEANCALL_NOSAVE_FLAGS | DR_CLEANCALL_NOSAVE_XMM_NONRET, 2,
+                            opnd_create_reg(DR_REG_XAX), opnd_create_reg(DR_REG_XSP));
+    instrlist_meta_preinsert(bb, where, done);
+    instrlist_meta_preinsert(
+        bb, where, INSTR_CREATE_mov_ld(drcontext, opnd_create_reg(DR_REG_XCX), spill));
+}
+#endif /* X86 */
+
 static dr_emit_flags_t
 drwrap_event_bb_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for_trace,
                          bool translating, OUT void **user_data)
@@ -2313,6 +2705,15 @@ drwrap_event_bb_insert(void *drcontext, void *tag, instrlist_t *bb, instr_t *ins
                                 opnd_create_reg(DR_REG_XSP)
                                     _IF_NOT_X86(opnd_create_reg(DR_REG_LR)));
     }
+#ifdef X86
+    if (lite_check_rets) {
+        lite_entry_t *lite = hashtable_lookup(&lite_table, (void *)pc);
+        if (lite != NULL)
+            drwrap_lite_insert_pre(drcontext, bb, inst, lite);
+        if (instr_is_return(inst) && instr_is_app(inst))
+            drwrap_lite_insert_ret_check(drcontext, bb, inst);
+    }
+#endif
     dr_recurlock_unlock(wrap_lock);
 
     if (post_call_lookup_for_instru(instr_get_app_pc(inst) /*normalized*/)) {
@@ -2511,7 +2912,8 @@ drwrap_wrap_ex(app_pc func, void (*pre_func_cb)(void *wrapcxt, INOUT void **user
         wrap_new->next = NULL;
         hashtable_add(&wrap_table, (void *)func, (void *)wrap_new);
         /* XXX: we're assuming void* tag == pc */
-        if (dr_fragment_exists_at(dr_get_current_drcontext(), func)) {
+        if (dr_fragment_exists_at(dr_get_current_drcontext(), func) &&
+            !drwrap_batch_defer_flush(func, false /*unlink*/)) {
             dr_atomic_add_stat_return_sum(&drwrap_stats.flush_count, 1);
             /* we do not guarantee faster than a lazy flush */
             if (!dr_unlink_flush_region(func, 1))
@@ -2558,6 +2960,77 @@ drwrap_unwrap(app_pc func, void (*pre_func_cb)(void *wrapcxt, OUT void **user_da
     return res;
 }
 
+DR_EXPORT
+bool
+drwrap_wrap_lite(app_pc func, drwrap_lite_pre_cb_t pre_func_cb,
+                 drwrap_lite_post_cb_t post_func_cb, void *user_data, uint num_args,
+                 uint flags)
+{
+#ifdef X86
+    lite_entry_t *lite;
+    drwrap_callconv_t callconv = EXTRACT_CALLCONV(flags);
+    if (callconv == 0)
+        callconv = DRWRAP_CALLCONV_DEFAULT;
+    if (func == NULL || (pre_func_cb == NULL && post_func_cb == NULL) ||
+        num_args > DRWRAP_LITE_MAX_ARGS || EXCLUDE_CALLCONV(flags) != 0 ||
+        !drwrap_lite_callconv_supported(callconv))
+        return false;
+
+    dr_recurlock_lock(wrap_lock);
+    lite = hashtable_lookup(&lite_table, (void *)func);
+    if (lite == NULL) {
+        lite = dr_global_alloc(sizeof(*lite));
+        lite->func = func;
+        hashtable_add(&lite_table, (void *)func, (void *)lite);
+    } else if (lite->enabled &&
+               (lite->pre_cb != pre_func_cb || lite->post_cb != post_func_cb)) {
+        /* Only one lite wrap per function. */
+        dr_recurlock_unlock(wrap_lock);
+        return false;
+    }
+    /* A disabled entry is re-used, as existing instrumentation may refer to it. */
+    lite->pre_cb = pre_func_cb;
+    lite->post_cb = post_func_cb;
+    lite->user_data = user_data;
+    lite->num_args = num_args;
+    lite->callconv = callconv;
+    lite->enabled = true;
+    lite_check_rets = true;
+    dr_recurlock_unlock(wrap_lock);
+
+    /* XXX: we're assuming void* tag == pc */
+    if (dr_fragment_exists_at(dr_get_current_drcontext(), func) &&
+        !drwrap_batch_defer_flush(func, false /*unlink*/))
+        drwrap_flush_func(func);
+    return true;
+#else
+    /* XXX: the inline return check is x86-only for now. */
+    return false;
+#endif
+}
+
+DR_EXPORT
+bool
+drwrap_unwrap_lite(app_pc func, drwrap_lite_pre_cb_t pre_func_cb,
+                   drwrap_lite_post_cb_t post_func_cb)
+{
+    lite_entry_t *lite;
+    bool res = false;
+    if (func == NULL)
+        return false;
+    dr_recurlock_lock(wrap_lock);
+    lite = hashtable_lookup(&lite_table, (void *)func);
+    if (lite != NULL && lite->enabled && lite->pre_cb == pre_func_cb &&
+        lite->post_cb == post_func_cb) {
+        lite->enabled = false;
+        res = true;
+    }
+    dr_recurlock_unlock(wrap_lock);
+    if (res && !drwrap_batch_defer_flush(func, false /*unlink*/))
+        drwrap_flush_func(func);
+    return res;
+}
+
 DR_EXPORT
 bool
 drwrap_is_wrapped(app_pc func, void (*pre_func_cb)(void *wrapcxt, OUT void **user_data),
@@ -451,6 +451,102 @@ bool
 drwrap_unwrap(app_pc func, void (*pre_func_cb)(void *wrapcxt, OUT void **user_data),
               void (*post_func_cb)(void *wrapcxt, void *user_data));
 
+/** The maximum number of arguments passed to a drwrap_wrap_lite() pre callback. */
+#define DRWRAP_LITE_MAX_ARGS 4
+
+/**
+ * A pre-function callback for drwrap_wrap_lite().  It is passed the \p user_data
+ * given to drwrap_wrap_lite() and the first \p num_args arguments of the call,
+ * with the rest set to 0.  Its return value is passed to the post-function
+ * callback for the same call.
+ */
+typedef void *(*drwrap_lite_pre_cb_t)(void *user_data, reg_t arg0, reg_t arg1,
+                                      reg_t arg2, reg_t arg3);
+
+/**
+ * A post-function callback for drwrap_wrap_lite().  It is passed the \p user_data
+ * given to drwrap_wrap_lite(), the value returned by the pre-function callback
+ * for this call (or NULL if there is none), and the pointer-sized return value.
+ */
+typedef void (*drwrap_lite_post_cb_t)(void *user_data, void *call_data, reg_t retval);
+
+DR_EXPORT
+/**
+ * Requests a lightweight wrap of the function \p func, for callbacks that only
+ * need to read arguments and the return value, such as allocator tracking.
+ * Rather than a full context switch, a table lookup, and a wrapping context,
+ * \p pre_func_cb is called at the function entry through a clean call that
+ * passes the first \p num_args arguments (at most #DRWRAP_LITE_MAX_ARGS)
+ * directly.  The return is detected by an inline check of the stack pointer at
+ * each return instruction against the one recorded at the entry, rather than
+ * by post-call tables, so no flushes are needed for new call sites and tail
+ * calls are handled.  Either callback may be NULL, but not both.
+ *
+ * This comes with these restrictions:
+ * - The callbacks cannot use the drwrap_get_arg() family of routines or modify
+ *   the application state.
+ * - Like #DRWRAP_FAST_CLEANCALLS, the function must follow the standard ABI
+ *   calling convention given in \p flags (only a #drwrap_callconv_t value is
+ *   accepted), as registers that are scratch at the entry and return are not
+ *   preserved across the callbacks.
+ * - Only one lightweight wrap per function is allowed.
+ * - As with drwrap_wrap(), the request should be made before \p func is first
+ *   executed, typically from a module load event: otherwise the caller must
+ *   flush \p func.
+ * - If the function is exited abnormally, such as by longjmp or an exception,
+ *   the post-function callback is not called, unless the next lite-wrapped call
+ *   is made from the same call site at the same stack depth, as that looks like
+ *   a tail call.
+ * - This is only supported on x86.
+ *
+ * \return whether successful.
+ */
+bool
+drwrap_wrap_lite(app_pc func, drwrap_lite_pre_cb_t pre_func_cb,
+                 drwrap_lite_post_cb_t post_func_cb, void *user_data, uint num_args,
+                 uint flags);
+
+DR_EXPORT
+/**
+ * Removes a wrap requested by drwrap_wrap_lite() for \p func with the callback
+ * pair \p pre_func_cb and \p post_func_cb.  Calls already in progress still have
+ * their post-function callback called.  This routine cannot be called from
+ * either callback.
+ *
+ * \return whether successful.
+ */
+bool
+drwrap_unwrap_lite(app_pc func, drwrap_lite_pre_cb_t pre_func_cb,
+                   drwrap_lite_post_cb_t post_func_cb);
+
+DR_EXPORT
+/**
+ * Opens a batch of wrap and replace updates.  Until the matching
+ * drwrap_end_batch(), the code cache flushes that drwrap_wrap(),
+ * drwrap_wrap_ex(), drwrap_wrap_lite(), drwrap_unwrap_lite(), drwrap_replace(),
+ * and drwrap_replace_native() would perform for code that has already executed
+ * are instead recorded.  The outermost drwrap_end_batch() then sorts them and
+ * issues one flush per cluster of nearby addresses.  This greatly reduces the
+ * cost of wrapping many functions after they may have run, such as after a
+ * symbol lookup.  Until the batch ends, an update may not take effect for code
+ * already in the cache.  Batches nest, and the batch is process-wide: updates
+ * from any thread are deferred while it is open.
+ */
+void
+drwrap_begin_batch(void);
+
+DR_EXPORT
+/**
+ * Closes a batch opened by drwrap_begin_batch().  If this is the outermost
+ * batch, performs the flushes that were deferred.  Like drwrap_wrap() for a
+ * function that has already executed, this must then be called from a context
+ * where dr_unlink_flush_region() is permitted, with no locks held.
+ *
+ * \return false if there is no open batch.
+ */
+bool
+drwrap_end_batch(void);
+
 DR_EXPORT
 /**
  * Returns the DynamoRIO context.  This routine can be faster than
@@ -112,6 +112,12 @@ drx_buf_init_library(void);
 void
 drx_buf_exit_library(void);
 
+/* defined in drx_counter.c */
+bool
+drx_counter_init_library(void);
+void
+drx_counter_exit_library(void);
+
 #ifdef PLATFORM_SUPPORTS_SCATTER_GATHER
 static bool
 drx_event_restore_state(void *drcontext, bool restore_memory,
@@ -160,6 +166,9 @@ drx_init(void)
         return false;
 #endif
 
+    if (!drx_counter_init_library())
+        return false;
+
     return drx_buf_init_library();
 }
 
@@ -175,6 +184,7 @@ drx_exit()
         soft_kills_exit();
 
     drx_buf_exit_library();
+    drx_counter_exit_library();
     drreg_exit();
     if (expand_scatter_gather_drreg_initialized)
         drreg_exit();
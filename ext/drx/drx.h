@@ -174,6 +174,69 @@ drx_insert_counter_update(void *drcontext, instrlist_t *ilist, instr_t *where,
                           IF_NOT_X86_(dr_spill_slot_t slot2) void *addr, int value,
                           uint flags);
 
+struct _drx_sharded_counter_t;
+
+/**
+ * Opaque handle to a counter with a separate slot per thread, for use with
+ * drx_insert_sharded_counter_update().
+ */
+typedef struct _drx_sharded_counter_t drx_sharded_counter_t;
+
+DR_EXPORT
+/**
+ * Creates a sharded counter.  Each thread gets its own slot for the counter in
+ * a per-thread array allocated by drx, so updates need neither a lock nor
+ * cross-thread cache line transfers, unlike a #DRX_COUNTER_LOCK update of a
+ * shared counter.  The slots are summed by drx_sharded_counter_get_total(), and
+ * a thread's slots are folded into the total when it exits.
+ *
+ * The first sharded counter must be created before any thread is initialized,
+ * typically from dr_client_main(), as threads initialized earlier have no slots.
+ * Later counters may be created at any time.  The number of live counters is
+ * limited (currently to 512).
+ *
+ * \return the new counter, or NULL on failure.
+ *
+ * \note Not yet supported on 32-bit ARM.
+ */
+drx_sharded_counter_t *
+drx_sharded_counter_create(void);
+
+DR_EXPORT
+/**
+ * Frees a counter created by drx_sharded_counter_create().  The caller must
+ * ensure that no instrumentation updating \p counter will execute afterward.
+ *
+ * \return whether successful.
+ */
+bool
+drx_sharded_counter_free(drx_sharded_counter_t *counter);
+
+DR_EXPORT
+/**
+ * Inserts into \p ilist prior to \p where meta-instruction(s) to add the
+ * constant \p value to the current thread's slot for \p counter.  The 64-bit
+ * slot is located via raw TLS and updated without a lock.  This routine must
+ * be called from drmgr's insertion phase, and uses drreg to obtain a scratch
+ * register (two on AArch64) and, on x86, to spill the arithmetic flags.
+ * On AArch64 \p value must lie in (-4096, 4096).
+ *
+ * \return whether successful.
+ */
+bool
+drx_insert_sharded_counter_update(void *drcontext, instrlist_t *ilist, instr_t *where,
+                                  drx_sharded_counter_t *counter, int value);
+
+DR_EXPORT
+/**
+ * Returns the sum of all threads' slots for \p counter, including those of
+ * threads that have exited.  The slots of running threads are read without
+ * synchronizing with their updates, so the result may omit updates that are
+ * in progress.
+ */
+uint64
+drx_sharded_counter_get_total(drx_sharded_counter_t *counter);
+
 /***************************************************************************
  * SOFT KILLS
  */
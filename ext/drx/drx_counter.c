@@ -0,0 +1,304 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* DynamoRio eXtension sharded counters: each thread updates its own slot
+ * without a lock, and the slots are summed when the total is requested.
+ */
+
+#include "dr_api.h"
+#include "drx.h"
+#include "drmgr.h"
+#include "drreg.h"
+#include "../ext_utils.h"
+#include <limits.h> /* for SCHAR_MAX */
+#include <string.h> /* for memset */
+
+#define MINSERT instrlist_meta_preinsert
+
+/* The maximum number of live counters, which bounds each thread's shard. */
+#define MAX_SHARDED_COUNTERS 512
+
+/* A thread's slots, pointed at by raw TLS.  The slots come first so that the
+ * instrumentation's displacement is just the counter index.
+ */
+typedef struct _shard_t {
+    uint64 value[MAX_SHARDED_COUNTERS];
+    struct _shard_t *next, *prev;
+} shard_t;
+
+struct _drx_sharded_counter_t {
+    uint idx;
+    /* the sum of the slots of threads that have exited */
+    uint64 retired;
+};
+
+/* Protects counters, shards, and the retired totals. */
+static void *counter_lock;
+static drx_sharded_counter_t *counters[MAX_SHARDED_COUNTERS];
+/* The live threads' shards. */
+static shard_t *shards;
+/* Shards are only allocated for threads initialized after the first counter is
+ * created, which sets this along with the raw TLS slot.
+ */
+static bool any_counters_created;
+static bool any_threads_initialized;
+static reg_id_t tls_seg;
+static uint tls_offs;
+
+#define SHARD_PTR(seg_base) (*(shard_t **)((byte *)(seg_base) + tls_offs))
+
+/* called by drx_init() */
+bool
+drx_counter_init_library(void);
+void
+drx_counter_exit_library(void);
+
+static void
+event_thread_init(void *drcontext);
+static void
+event_thread_exit(void *drcontext);
+
+bool
+drx_counter_init_library(void)
+{
+    if (!drmgr_register_thread_init_event(event_thread_init) ||
+        !drmgr_register_thread_exit_event(event_thread_exit))
+        return false;
+    counter_lock = dr_mutex_create();
+    return counter_lock != NULL;
+}
+
+void
+drx_counter_exit_library(void)
+{
+    uint i;
+    drmgr_unregister_thread_init_event(event_thread_init);
+    drmgr_unregister_thread_exit_event(event_thread_exit);
+    /* Threads skipped at process exit still have their shards. */
+    while (shards != NULL) {
+        shard_t *next = shards->next;
+        dr_global_free(shards, sizeof(*shards));
+        shards = next;
+    }
+    for (i = 0; i < MAX_SHARDED_COUNTERS; i++) {
+        if (counters[i] != NULL) {
+            dr_global_free(counters[i], sizeof(*counters[i]));
+            counters[i] = NULL;
+        }
+    }
+    if (any_counters_created && !dr_raw_tls_cfree(tls_offs, 1))
+        DR_ASSERT_MSG(false, "failed to free sharded counter TLS");
+    any_counters_created = false;
+    any_threads_initialized = false;
+    dr_mutex_destroy(counter_lock);
+}
+
+static void
+event_thread_init(void *drcontext)
+{
+    shard_t *shard;
+    dr_mutex_lock(counter_lock);
+    any_threads_initialized = true;
+    if (!any_counters_created) {
+        dr_mutex_unlock(counter_lock);
+        return;
+    }
+    shard = dr_global_alloc(sizeof(*shard));
+    memset(shard->value, 0, sizeof(shard->value));
+    shard->prev = NULL;
+    shard->next = shards;
+    if (shards != NULL)
+        shards->prev = shard;
+    shards = shard;
+    dr_mutex_unlock(counter_lock);
+    SHARD_PTR(dr_get_dr_segment_base(tls_seg)) = shard;
+}
+
+static void
+event_thread_exit(void *drcontext)
+{
+    shard_t *shard;
+    uint i;
+    if (!any_counters_created)
+        return;
+    shard = SHARD_PTR(dr_get_dr_segment_base(tls_seg));
+    if (shard == NULL)
+        return;
+    dr_mutex_lock(counter_lock);
+    for (i = 0; i < MAX_SHARDED_COUNTERS; i++) {
+        if (counters[i] != NULL)
+            counters[i]->retired += shard->value[i];
+    }
+    if (shard->prev != NULL)
+        shard->prev->next = shard->next;
+    else
+        shards = shard->next;
+    if (shard->next != NULL)
+        shard->next->prev = shard->prev;
+    dr_mutex_unlock(counter_lock);
+    SHARD_PTR(dr_get_dr_segment_base(tls_seg)) = NULL;
+    dr_global_free(shard, sizeof(*shard));
+}
+
+DR_EXPORT
+drx_sharded_counter_t *
+drx_sharded_counter_create(void)
+{
+    drx_sharded_counter_t *counter = NULL;
+    shard_t *shard;
+    uint i;
+#ifdef ARM
+    /* FIXME i#1551: the 64-bit slot update is NYI on 32-bit ARM */
+    return NULL;
+#endif
+    dr_mutex_lock(counter_lock);
+    if (!any_counters_created) {
+        /* Existing threads would have no shard to update. */
+        if (any_threads_initialized || !dr_raw_tls_calloc(&tls_seg, &tls_offs, 1, 0)) {
+            dr_mutex_unlock(counter_lock);
+            return NULL;
+        }
+        any_counters_created = true;
+    }
+    for (i = 0; i < MAX_SHARDED_COUNTERS; i++) {
+        if (counters[i] == NULL)
+            break;
+    }
+    if (i < MAX_SHARDED_COUNTERS) {
+        counter = dr_global_alloc(sizeof(*counter));
+        counter->idx = i;
+        counter->retired = 0;
+        /* clear what a freed counter may have left in this index */
+        for (shard = shards; shard != NULL; shard = shard->next)
+            shard->value[i] = 0;
+        counters[i] = counter;
+    }
+    dr_mutex_unlock(counter_lock);
+    return counter;
+}
+
+DR_EXPORT
+bool
+drx_sharded_counter_free(drx_sharded_counter_t *counter)
+{
+    dr_mutex_lock(counter_lock);
+    if (counter == NULL || counter->idx >= MAX_SHARDED_COUNTERS ||
+        counters[counter->idx] != counter) {
+        dr_mutex_unlock(counter_lock);
+        return false;
+    }
+    counters[counter->idx] = NULL;
+    dr_mutex_unlock(counter_lock);
+    dr_global_free(counter, sizeof(*counter));
+    return true;
+}
+
+DR_EXPORT
+uint64
+drx_sharded_counter_get_total(drx_sharded_counter_t *counter)
+{
+    uint64 total;
+    shard_t *shard;
+    dr_mutex_lock(counter_lock);
+    total = counter->retired;
+    /* The other threads' slots are read racily: an update in flight may be missed. */
+    for (shard = shards; shard != NULL; shard = shard->next)
+        total += shard->value[counter->idx];
+    dr_mutex_unlock(counter_lock);
+    return total;
+}
+
+DR_EXPORT
+bool
+drx_insert_sharded_counter_update(void *drcontext, instrlist_t *ilist, instr_t *where,
+                                  drx_sharded_counter_t *counter, int value)
+{
+    int disp;
+    reg_id_t reg;
+#ifdef AARCH64
+    reg_id_t reg2;
+#endif
+    if (counter == NULL || drmgr_current_bb_phase(drcontext) != DRMGR_PHASE_INSERTION)
+        return false;
+    disp = (int)(counter->idx * sizeof(uint64));
+#ifdef X86
+    if (drreg_reserve_aflags(drcontext, ilist, where) != DRREG_SUCCESS ||
+        drreg_reserve_register(drcontext, ilist, where, NULL, &reg) != DRREG_SUCCESS)
+        return false;
+    dr_insert_read_raw_tls(drcontext, ilist, where, tls_seg, tls_offs, reg);
+    /* No lock prefix: the slot is only written by this thread. */
+    MINSERT(ilist, where,
+            INSTR_CREATE_add(drcontext,
+                             opnd_create_base_disp(reg, DR_REG_NULL, 0, disp,
+                                                   IF_X64_ELSE(OPSZ_8, OPSZ_4)),
+                             OPND_CREATE_INT_32OR8(value)));
+#    ifndef X64
+    MINSERT(ilist, where,
+            INSTR_CREATE_adc(drcontext, OPND_CREATE_MEM32(reg, disp + 4),
+                             OPND_CREATE_INT32(value < 0 ? -1 : 0)));
+#    endif
+    if (drreg_unreserve_register(drcontext, ilist, where, reg) != DRREG_SUCCESS ||
+        drreg_unreserve_aflags(drcontext, ilist, where) != DRREG_SUCCESS)
+        return false;
+    return true;
+#elif defined(AARCH64)
+    /* add and sub take a 12-bit unsigned immediate */
+    if (value <= -4096 || value >= 4096)
+        return false;
+    if (drreg_reserve_register(drcontext, ilist, where, NULL, &reg) != DRREG_SUCCESS ||
+        drreg_reserve_register(drcontext, ilist, where, NULL, &reg2) != DRREG_SUCCESS)
+        return false;
+    dr_insert_read_raw_tls(drcontext, ilist, where, tls_seg, tls_offs, reg);
+    MINSERT(ilist, where,
+            XINST_CREATE_load(drcontext, opnd_create_reg(reg2),
+                              OPND_CREATE_MEM64(reg, disp)));
+    if (value >= 0) {
+        MINSERT(ilist, where,
+                XINST_CREATE_add(drcontext, opnd_create_reg(reg2), OPND_CREATE_INT(value)));
+    } else {
+        MINSERT(ilist, where,
+                XINST_CREATE_sub(drcontext, opnd_create_reg(reg2),
+                                 OPND_CREATE_INT(-value)));
+    }
+    MINSERT(ilist, where,
+            XINST_CREATE_store(drcontext, OPND_CREATE_MEM64(reg, disp),
+                               opnd_create_reg(reg2)));
+    if (drreg_unreserve_register(drcontext, ilist, where, reg2) != DRREG_SUCCESS ||
+        drreg_unreserve_register(drcontext, ilist, where, reg) != DRREG_SUCCESS)
+        return false;
+    return true;
+#else
+    /* FIXME i#1551: NYI on 32-bit ARM */
+    return false;
+#endif
+}
@@ -0,0 +1,216 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Tests and benchmarks concurrent lookups in a read-mostly drcontainers
+ * hashtable (hashtable_config_t.read_mostly) while another thread adds,
+ * replaces, and removes entries and forces resizes.
+ * Pass "-bench" to print lookup times for the read-mostly mode and for a regular
+ * lock-protected table.
+ */
+
+#include "configure.h"
+#include "dr_api.h"
+#include "hashtable.h"
+#include "tools.h"
+#include "thread.h"
+#include "condvar.h"
+#include <string.h>
+
+#define NUM_READERS 4
+#define NUM_STABLE_KEYS 512
+#define NUM_CHURN_KEYS 4096
+#define READER_ITERS 200
+#define PAYLOAD_MAGIC 0x5a5a0000
+#define REPLACED_MAGIC 0x3c3c0000
+/* Start small so the writer resizes the table under the readers. */
+#define INITIAL_BITS 4
+
+static hashtable_t table;
+static void *start_readers;
+static volatile int writer_done;
+static volatile int reader_errors;
+
+static void *
+stable_key(uint i)
+{
+    return (void *)(ptr_uint_t)(i * 8 + 8);
+}
+
+static void *
+churn_key(uint i)
+{
+    return (void *)(ptr_uint_t)(0x100000 + i * 8);
+}
+
+static void *
+payload_for(void *key, uint magic)
+{
+    return (void *)((ptr_uint_t)key ^ magic);
+}
+
+static bool
+churn_payload_ok(void *key, void *payload)
+{
+    return payload == NULL || payload == payload_for(key, PAYLOAD_MAGIC) ||
+        payload == payload_for(key, REPLACED_MAGIC);
+}
+
+THREAD_FUNC_RETURN_TYPE
+reader(void *arg)
+{
+    uint iter, i;
+    wait_cond_var(start_readers);
+    for (iter = 0; iter < READER_ITERS || dr_atomic_load32(&writer_done) == 0; iter++) {
+        for (i = 0; i < NUM_STABLE_KEYS; i++) {
+            void *key = stable_key(i);
+            if (hashtable_lookup(&table, key) != payload_for(key, PAYLOAD_MAGIC))
+                dr_atomic_add32_return_sum(&reader_errors, 1);
+            key = churn_key((i * 7 + iter) % NUM_CHURN_KEYS);
+            if (!churn_payload_ok(key, hashtable_lookup(&table, key)))
+                dr_atomic_add32_return_sum(&reader_errors, 1);
+        }
+    }
+    return THREAD_FUNC_RETURN_ZERO;
+}
+
+static void
+writer(void)
+{
+    uint i;
+    for (i = 0; i < NUM_CHURN_KEYS; i++) {
+        void *key = churn_key(i);
+        if (!hashtable_add(&table, key, payload_for(key, PAYLOAD_MAGIC)))
+            print("add of new key failed\n");
+        if (i % 3 == 0) {
+            hashtable_add_replace(&table, key, payload_for(key, REPLACED_MAGIC));
+        }
+        if (i % 5 == 0 && i > 0) {
+            if (!hashtable_remove(&table, churn_key(i - 1)))
+                print("remove of existing key failed\n");
+        }
+    }
+    hashtable_remove_range(&table, churn_key(0), churn_key(NUM_CHURN_KEYS / 2));
+    dr_atomic_store32(&writer_done, 1);
+}
+
+static void
+run_threads(bool with_writer)
+{
+    thread_t threads[NUM_READERS];
+    uint i;
+    start_readers = create_cond_var();
+    writer_done = with_writer ? 0 : 1;
+    for (i = 0; i < NUM_READERS; i++)
+        threads[i] = create_thread(reader, NULL);
+    signal_cond_var(start_readers);
+    if (with_writer)
+        writer();
+    for (i = 0; i < NUM_READERS; i++)
+        join_thread(threads[i]);
+    destroy_cond_var(start_readers);
+}
+
+static void
+init_table(bool read_mostly)
+{
+    hashtable_config_t config = {
+        sizeof(config),
+    };
+    uint i;
+    hashtable_init_ex(&table, INITIAL_BITS, HASH_INTPTR, false /*!strdup*/,
+                      true /*synch*/, NULL, NULL, NULL);
+    config.resizable = true;
+    config.resize_threshold = 75;
+    config.read_mostly = read_mostly;
+    hashtable_configure(&table, &config);
+    for (i = 0; i < NUM_STABLE_KEYS; i++)
+        hashtable_add(&table, stable_key(i), payload_for(stable_key(i), PAYLOAD_MAGIC));
+}
+
+static void
+check_final_table(void)
+{
+    uint i;
+    for (i = 0; i < NUM_CHURN_KEYS; i++) {
+        void *payload = hashtable_lookup(&table, churn_key(i));
+        /* The writer removes the lower half plus the key before each multiple of 5. */
+        bool expect_present =
+            i >= NUM_CHURN_KEYS / 2 && !(i % 5 == 4 && i + 1 < NUM_CHURN_KEYS);
+        if (!churn_payload_ok(churn_key(i), payload) ||
+            (payload != NULL) != expect_present)
+            print("bad payload for churn key %d\n", i);
+    }
+    for (i = 0; i < NUM_STABLE_KEYS; i++) {
+        if (hashtable_lookup(&table, stable_key(i)) !=
+            payload_for(stable_key(i), PAYLOAD_MAGIC))
+            print("stable key %d lost\n", i);
+    }
+}
+
+static uint64
+time_lookups(bool read_mostly)
+{
+    uint64 start;
+    init_table(read_mostly);
+    start = dr_get_milliseconds();
+    run_threads(false);
+    start = dr_get_milliseconds() - start;
+    hashtable_delete(&table);
+    return start;
+}
+
+int
+main(int argc, char **argv)
+{
+    dr_standalone_init();
+
+    init_table(true);
+    run_threads(true);
+    if (reader_errors != 0)
+        print("%d inconsistent lookups\n", reader_errors);
+    check_final_table();
+    hashtable_free_retired(&table);
+    check_final_table();
+    hashtable_delete(&table);
+    print("read-mostly lookups are consistent\n");
+
+    if (argc > 1 && strcmp(argv[1], "-bench") == 0) {
+        uint64 locked = time_lookups(false);
+        uint64 read_mostly = time_lookups(true);
+        print("%d readers x %d lookups: locked %d ms, read-mostly %d ms\n", NUM_READERS,
+              READER_ITERS * NUM_STABLE_KEYS * 2, (int)locked, (int)read_mostly);
+    }
+
+    dr_standalone_exit();
+    print("all done\n");
+    return 0;
+}
@@ -2290,6 +2290,123 @@ test_noalloc(void *dcontext)
      */
 }
 
+/* A corpus resembling typical client instrumentation, including operands that
+ * select different templates for the same opcode.
+ */
+static int
+build_encode_corpus(void *dc, instr_t **corpus, int max)
+{
+    int n = 0;
+#define ADD_INSTR(in)       \
+        do {                    \
+            ASSERT(n < max);    \
+            corpus[n++] = (in); \
+        } while (0)
+    ADD_INSTR(INSTR_CREATE_mov_ld(dc, opnd_create_reg(DR_REG_XAX),
+                                  OPND_CREATE_MEMPTR(DR_REG_XCX, 0x10)));
+    ADD_INSTR(INSTR_CREATE_mov_st(dc, OPND_CREATE_MEMPTR(DR_REG_XSP, 0x100),
+                                  opnd_create_reg(DR_REG_XDX)));
+    ADD_INSTR(INSTR_CREATE_mov_imm(dc, opnd_create_reg(DR_REG_EAX),
+                                   OPND_CREATE_INT32(0x12345678)));
+    ADD_INSTR(INSTR_CREATE_mov_imm(dc, opnd_create_reg(DR_REG_CL), OPND_CREATE_INT8(1)));
+    ADD_INSTR(INSTR_CREATE_add(dc, opnd_create_reg(DR_REG_EAX), OPND_CREATE_INT8(1)));
+    ADD_INSTR(INSTR_CREATE_add(dc, opnd_create_reg(DR_REG_EAX), OPND_CREATE_INT32(1)));
+    ADD_INSTR(
+        INSTR_CREATE_add(dc, opnd_create_reg(DR_REG_EAX), OPND_CREATE_INT32(0x1000)));
+    ADD_INSTR(
+        INSTR_CREATE_add(dc, opnd_create_reg(DR_REG_EBX), OPND_CREATE_INT32(0x1000)));
+    ADD_INSTR(INSTR_CREATE_add(dc, OPND_CREATE_MEM32(DR_REG_XAX, 0x1000),
+                               OPND_CREATE_INT8(-1)));
+    ADD_INSTR(INSTR_CREATE_sub(dc, opnd_create_reg(DR_REG_XSP), OPND_CREATE_INT32(0x80)));
+    ADD_INSTR(INSTR_CREATE_lea(dc, opnd_create_reg(DR_REG_XSP),
+                               OPND_CREATE_MEM_lea(DR_REG_XSP, DR_REG_NULL, 0, -8)));
+    ADD_INSTR(INSTR_CREATE_lea(dc, opnd_create_reg(DR_REG_XAX),
+                               OPND_CREATE_MEM_lea(DR_REG_XBX, DR_REG_XSI, 4, 0x1234)));
+    ADD_INSTR(INSTR_CREATE_inc(dc, OPND_CREATE_MEM32(DR_REG_XAX, 0)));
+    ADD_INSTR(
+        INSTR_CREATE_cmp(dc, opnd_create_reg(DR_REG_ECX), opnd_create_reg(DR_REG_EDX)));
+    ADD_INSTR(
+        INSTR_CREATE_test(dc, opnd_create_reg(DR_REG_EAX), opnd_create_reg(DR_REG_EAX)));
+    ADD_INSTR(INSTR_CREATE_shl(dc, opnd_create_reg(DR_REG_EAX),
+                               opnd_create_immed_int(1, OPSZ_0)));
+    ADD_INSTR(INSTR_CREATE_shl(dc, opnd_create_reg(DR_REG_EAX), OPND_CREATE_INT8(1)));
+    ADD_INSTR(INSTR_CREATE_shl(dc, opnd_create_reg(DR_REG_EAX), OPND_CREATE_INT8(3)));
+    ADD_INSTR(INSTR_CREATE_push(dc, opnd_create_reg(DR_REG_XAX)));
+    ADD_INSTR(INSTR_CREATE_pop(dc, opnd_create_reg(DR_REG_XAX)));
+    ADD_INSTR(INSTR_CREATE_push_imm(dc, OPND_CREATE_INT8(4)));
+    ADD_INSTR(INSTR_CREATE_push_imm(dc, OPND_CREATE_INT32(0x400)));
+    ADD_INSTR(INSTR_CREATE_lahf(dc));
+    ADD_INSTR(INSTR_CREATE_sahf(dc));
+    ADD_INSTR(INSTR_CREATE_setcc(dc, OP_seto, opnd_create_reg(DR_REG_AL)));
+    ADD_INSTR(
+        INSTR_CREATE_xchg(dc, opnd_create_reg(DR_REG_EAX), opnd_create_reg(DR_REG_EBX)));
+    ADD_INSTR(
+        INSTR_CREATE_xchg(dc, opnd_create_reg(DR_REG_ECX), opnd_create_reg(DR_REG_EBX)));
+    ADD_INSTR(INSTR_CREATE_movdqu(
+        dc, opnd_create_reg(DR_REG_XMM1),
+        opnd_create_base_disp(DR_REG_XCX, DR_REG_NULL, 0, 0x20, OPSZ_16)));
+    ADD_INSTR(INSTR_CREATE_vmovdqu(
+        dc, opnd_create_reg(DR_REG_YMM1),
+        opnd_create_base_disp(DR_REG_XCX, DR_REG_NULL, 0, 0x20, OPSZ_32)));
+    ADD_INSTR(INSTR_CREATE_pxor(dc, opnd_create_reg(DR_REG_XMM2),
+                                opnd_create_reg(DR_REG_XMM3)));
+#ifdef X64
+    ADD_INSTR(INSTR_CREATE_mov_imm(dc, opnd_create_reg(DR_REG_R9),
+                                   OPND_CREATE_INT64(0x123456789abcdefLL)));
+    ADD_INSTR(INSTR_CREATE_mov_ld(dc, opnd_create_reg(DR_REG_R10),
+                                  OPND_CREATE_MEMPTR(DR_REG_R11, 0x10)));
+    ADD_INSTR(INSTR_CREATE_add(dc, opnd_create_reg(DR_REG_R8D), OPND_CREATE_INT8(1)));
+    ADD_INSTR(INSTR_CREATE_movdqu(
+        dc, opnd_create_reg(DR_REG_XMM9),
+        opnd_create_base_disp(DR_REG_R12, DR_REG_NULL, 0, 0, OPSZ_16)));
+#endif
+#undef ADD_INSTR
+    return n;
+}
+
+/* The template chosen on a cold encode must match the one chosen from the
+ * encoder's template cache.  Building with NIGHTLY_REGRESSION undefined also
+ * times repeated encoding of the corpus.
+ */
+static void
+test_encode_template_cache(void *dc)
+{
+    instr_t *corpus[64];
+    byte encoded[BUFFER_SIZE_ELEMENTS(corpus)][MAX_INSTR_LENGTH];
+    uint len[BUFFER_SIZE_ELEMENTS(corpus)];
+    byte ebuf[MAX_INSTR_LENGTH];
+    int i, n, pass;
+
+    n = build_encode_corpus(dc, corpus, BUFFER_SIZE_ELEMENTS(corpus));
+    for (i = 0; i < n; i++) {
+        byte *end = instr_encode(dc, corpus[i], encoded[i]);
+        ASSERT(end != NULL);
+        len[i] = (uint)(end - encoded[i]);
+    }
+    /* Walk in reverse so entries are consumed in a different order than filled */
+    for (pass = 0; pass < 2; pass++) {
+        for (i = n - 1; i >= 0; i--) {
+            byte *end = instr_encode(dc, corpus[i], ebuf);
+            ASSERT(end != NULL && (uint)(end - ebuf) == len[i]);
+            ASSERT(memcmp(ebuf, encoded[i], len[i]) == 0);
+        }
+    }
+#if !defined(NIGHTLY_REGRESSION) && !defined(STANDALONE_DECODER)
+    {
+        /* Compare against a run with -no_encode_template_cache. */
+        uint64 start = dr_get_milliseconds();
+        for (pass = 0; pass < 100000; pass++) {
+            for (i = 0; i < n; i++)
+                instr_encode(dc, corpus[i], ebuf);
+        }
+        dr_fprintf(STDERR, "encoded %d instrs in " UINT64_FORMAT_STRING " ms\n",
+                   100000 * n, dr_get_milliseconds() - start);
+    }
+#endif
+    for (i = 0; i < n; i++)
+        instr_destroy(dc, corpus[i]);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -2363,6 +2480,8 @@ main(int argc, char *argv[])
 
     test_noalloc(dcontext);
 
+    test_encode_template_cache(dcontext);
+
 #ifndef STANDALONE_DECODER /* speed up compilation */
     test_all_opcodes_2_avx512_vex(dcontext);
     test_all_opcodes_3_avx512_vex(dcontext);
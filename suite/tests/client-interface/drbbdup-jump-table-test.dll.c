@@ -0,0 +1,155 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Tests drbbdup's jump table dispatch, used for dense case encodings, and the
+ * summing of its per-thread statistics.
+ */
+
+#include "dr_api.h"
+#include "drmgr.h"
+#include "drbbdup.h"
+
+#define CHECK(x, msg)                                                                \
+    do {                                                                             \
+        if (!(x)) {                                                                  \
+            dr_fprintf(STDERR, "CHECK failed %s:%d: %s\n", __FILE__, __LINE__, msg); \
+            dr_abort();                                                              \
+        }                                                                            \
+    } while (0);
+
+/* Encodings 1-5 minus 4 are registered: dense enough for a table with a hole. */
+#define NUM_ENCODINGS 7
+#define IS_CASE(encoding) ((encoding) >= 1 && (encoding) <= 5 && (encoding) != 4)
+
+/* Assume single threaded. */
+static uintptr_t encode_val;
+static uint case_hits[NUM_ENCODINGS];
+static unsigned long no_dynamic_handling_count;
+
+static uintptr_t
+set_up_bb_dups(void *drbbdup_ctx, void *drcontext, void *tag, instrlist_t *bb,
+               bool *enable_dups, bool *enable_dynamic_handling, void *user_data)
+{
+    uintptr_t encoding;
+    for (encoding = 1; encoding < NUM_ENCODINGS; encoding++) {
+        if (IS_CASE(encoding)) {
+            drbbdup_status_t res = drbbdup_register_case_encoding(drbbdup_ctx, encoding);
+            CHECK(res == DRBBDUP_SUCCESS, "failed to register case");
+        }
+    }
+    no_dynamic_handling_count++;
+    *enable_dups = true;
+    *enable_dynamic_handling = false;
+    return 0; /* return default case */
+}
+
+static void
+update_encoding()
+{
+    encode_val = (encode_val + 1) % NUM_ENCODINGS;
+}
+
+static void
+insert_encode(void *drcontext, void *tag, instrlist_t *bb, instr_t *where,
+              void *user_data, void *orig_analysis_data)
+{
+    dr_insert_clean_call(drcontext, bb, where, update_encoding, false, 0);
+}
+
+static void
+check_case(uintptr_t encoding)
+{
+    if (IS_CASE(encode_val)) {
+        CHECK(encoding == encode_val, "dispatched to the wrong case");
+    } else {
+        CHECK(encoding == 0, "unhandled encoding not sent to the default case");
+    }
+    case_hits[encoding]++;
+}
+
+static void
+instrument_instr(void *drcontext, void *tag, instrlist_t *bb, instr_t *instr,
+                 instr_t *where, uintptr_t encoding, void *user_data,
+                 void *orig_analysis_data, void *analysis_data)
+{
+    bool is_first;
+    drbbdup_status_t res = drbbdup_is_first_instr(drcontext, instr, &is_first);
+    CHECK(res == DRBBDUP_SUCCESS, "failed to check whether instr is start");
+    if (is_first) {
+        dr_insert_clean_call(drcontext, bb, where, check_case, false, 1,
+                             OPND_CREATE_INTPTR(encoding));
+    }
+}
+
+static void
+event_exit(void)
+{
+    drbbdup_status_t res;
+    uintptr_t encoding;
+
+    drbbdup_stats_t stats = { sizeof(drbbdup_stats_t) };
+    res = drbbdup_get_stats(&stats);
+    CHECK(res == DRBBDUP_SUCCESS, "drbbdup statistics gathering failed");
+    CHECK(stats.no_dup_count == 0, "all bbs should be duplicated");
+    CHECK(stats.no_dynamic_handling_count == no_dynamic_handling_count,
+          "no dynamic handling count should match");
+    CHECK(stats.bail_count == 0, "should be 0 since dynamic case gen is turned off");
+    CHECK(stats.gen_count == 0, "should be 0 since dynamic case gen is turned off");
+
+    for (encoding = 0; encoding < NUM_ENCODINGS; encoding++) {
+        if (encoding == 0 || IS_CASE(encoding))
+            CHECK(case_hits[encoding] > 0, "case was never dispatched to");
+    }
+
+    res = drbbdup_exit();
+    CHECK(res == DRBBDUP_SUCCESS, "drbbdup exit failed");
+    drmgr_exit();
+}
+
+DR_EXPORT void
+dr_init(client_id_t id)
+{
+    drmgr_init();
+
+    drbbdup_options_t opts = { 0 };
+    opts.struct_size = sizeof(drbbdup_options_t);
+    opts.set_up_bb_dups = set_up_bb_dups;
+    opts.insert_encode = insert_encode;
+    opts.instrument_instr = instrument_instr;
+    opts.runtime_case_opnd = opnd_create_abs_addr(&encode_val, OPSZ_PTR);
+    opts.non_default_case_limit = 4;
+    opts.is_stat_enabled = true;
+
+    drbbdup_status_t res = drbbdup_init(&opts);
+    CHECK(res == DRBBDUP_SUCCESS, "drbbdup init failed");
+    dr_register_exit_event(event_exit);
+}
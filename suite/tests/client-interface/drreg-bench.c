@@ -0,0 +1,89 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* An app with a lot of long straight-line code, for timing drreg's analysis and
+ * insertion over large blocks: see drreg-bench.dll.c.
+ */
+
+#include "tools.h"
+
+#define REPEAT4(x) x x x x
+#define REPEAT16(x) REPEAT4(REPEAT4(x))
+#define REPEAT256(x) REPEAT16(REPEAT16(x))
+
+#define NUM_FUNCS 16
+
+/* Volatile so each statement keeps its own loads and stores. */
+static volatile ptr_int_t a, b, c;
+
+/* Each function is a few thousand instrs of arithmetic with memory operands and
+ * both flag-reading and flag-writing instrs, with no branches.
+ */
+#define FUNCTION(n)                                           \
+    static NOINLINE ptr_int_t func##n(ptr_int_t seed)         \
+    {                                                         \
+        a = seed;                                             \
+        REPEAT256(a = a * 3 + b; b ^= (a >> 2); c += a < b;) \
+        return a + b + c;                                     \
+    }
+
+FUNCTION(0)
+FUNCTION(1)
+FUNCTION(2)
+FUNCTION(3)
+FUNCTION(4)
+FUNCTION(5)
+FUNCTION(6)
+FUNCTION(7)
+FUNCTION(8)
+FUNCTION(9)
+FUNCTION(10)
+FUNCTION(11)
+FUNCTION(12)
+FUNCTION(13)
+FUNCTION(14)
+FUNCTION(15)
+
+int
+main(int argc, char **argv)
+{
+    ptr_int_t (*funcs[NUM_FUNCS])(ptr_int_t) = {
+        func0, func1, func2,  func3,  func4,  func5,  func6,  func7,
+        func8, func9, func10, func11, func12, func13, func14, func15,
+    };
+    int i;
+    for (i = 0; i < NUM_FUNCS; i++)
+        c += funcs[i](i);
+    print("app done\n");
+    return 0;
+}
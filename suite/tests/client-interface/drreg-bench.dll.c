@@ -0,0 +1,185 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Times drreg's liveness analysis and register reservation over every block.
+ * Each app instr gets the aflags and one register reserved around some meta
+ * code, so the cost is dominated by drreg rather than by the instrumentation.
+ * The time is only printed with "-time", so this can be pointed at any large
+ * app:
+ *   drrun -c libclient.drreg-bench.dll.so -time -- <app>
+ * Passing "-cross" turns on drreg's cross-block liveness hints.
+ */
+
+#include "dr_api.h"
+#include "drmgr.h"
+#include "drreg.h"
+#include "drutil.h"
+#include <string.h>
+
+#define CHECK(x, msg)                        \
+    do {                                     \
+        if (!(x)) {                          \
+            dr_fprintf(STDERR, "%s\n", msg); \
+            dr_abort();                      \
+        }                                    \
+    } while (0);
+
+typedef struct _bb_time_t {
+    uint64 start;
+} bb_time_t;
+
+static bool print_time;
+static void *stats_mutex;
+static uint64 total_usec;
+static uint64 num_blocks;
+static uint64 num_instrs;
+
+static dr_emit_flags_t
+event_bb_app2app(void *drcontext, void *tag, instrlist_t *bb, bool for_trace,
+                 bool translating, OUT void **user_data)
+{
+    bb_time_t *bb_time = (bb_time_t *)dr_thread_alloc(drcontext, sizeof(*bb_time));
+    bool expanded;
+    CHECK(drutil_expand_rep_string_ex(drcontext, bb, &expanded, NULL),
+          "drutil rep expansion failed");
+    if (expanded) {
+        drreg_status_t res =
+            drreg_set_bb_properties(drcontext, DRREG_CONTAINS_SPANNING_CONTROL_FLOW);
+        CHECK(res == DRREG_SUCCESS, "failed to set properties");
+    }
+    /* Everything from here through the end of the insertion phase is timed. */
+    bb_time->start = dr_get_microseconds();
+    *user_data = bb_time;
+    return DR_EMIT_DEFAULT;
+}
+
+static dr_emit_flags_t
+event_bb_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for_trace,
+                  bool translating, void *user_data)
+{
+    return DR_EMIT_DEFAULT;
+}
+
+static dr_emit_flags_t
+event_bb_insert(void *drcontext, void *tag, instrlist_t *bb, instr_t *instr,
+                bool for_trace, bool translating, void *user_data)
+{
+    reg_id_t reg;
+    drreg_status_t res;
+    if (!instr_is_app(instr))
+        return DR_EMIT_DEFAULT;
+    res = drreg_reserve_aflags(drcontext, bb, instr);
+    CHECK(res == DRREG_SUCCESS, "failed to reserve aflags");
+    res = drreg_reserve_register(drcontext, bb, instr, NULL, &reg);
+    CHECK(res == DRREG_SUCCESS, "failed to reserve");
+    instrlist_meta_preinsert(bb, instr,
+                             XINST_CREATE_load_int(drcontext, opnd_create_reg(reg),
+                                                   OPND_CREATE_INT32(1)));
+    instrlist_meta_preinsert(bb, instr,
+                             XINST_CREATE_add(drcontext, opnd_create_reg(reg),
+                                              OPND_CREATE_INT32(1)));
+    res = drreg_unreserve_register(drcontext, bb, instr, reg);
+    CHECK(res == DRREG_SUCCESS, "failed to unreserve");
+    res = drreg_unreserve_aflags(drcontext, bb, instr);
+    CHECK(res == DRREG_SUCCESS, "failed to unreserve aflags");
+    return DR_EMIT_DEFAULT;
+}
+
+static dr_emit_flags_t
+event_bb_instru2instru(void *drcontext, void *tag, instrlist_t *bb, bool for_trace,
+                       bool translating, void *user_data)
+{
+    bb_time_t *bb_time = (bb_time_t *)user_data;
+    uint64 elapsed = dr_get_microseconds() - bb_time->start;
+    uint count = 0;
+    instr_t *instr;
+    for (instr = instrlist_first_app(bb); instr != NULL;
+         instr = instr_get_next_app(instr))
+        count++;
+    dr_mutex_lock(stats_mutex);
+    total_usec += elapsed;
+    num_blocks++;
+    num_instrs += count;
+    dr_mutex_unlock(stats_mutex);
+    dr_thread_free(drcontext, bb_time, sizeof(*bb_time));
+    return DR_EMIT_DEFAULT;
+}
+
+static void
+event_exit(void)
+{
+    bool ok = drmgr_unregister_bb_instrumentation_ex_event(
+        event_bb_app2app, event_bb_analysis, event_bb_insert, event_bb_instru2instru);
+    CHECK(ok, "drmgr unregister bb failed");
+    if (print_time) {
+        dr_fprintf(STDERR,
+                   "instrumented " UINT64_FORMAT_STRING " blocks (" UINT64_FORMAT_STRING
+                   " app instrs) in " UINT64_FORMAT_STRING " usec\n",
+                   num_blocks, num_instrs, total_usec);
+    }
+    CHECK(num_blocks > 0 && num_instrs > num_blocks, "no blocks seen");
+    dr_mutex_destroy(stats_mutex);
+    drutil_exit();
+    drreg_exit();
+    drmgr_exit();
+    dr_fprintf(STDERR, "all done\n");
+}
+
+DR_EXPORT void
+dr_client_main(client_id_t id, int argc, const char *argv[])
+{
+    drreg_options_t ops = { sizeof(ops), 2 /*max slots needed*/, false };
+    drmgr_priority_t priority = { sizeof(priority), "drreg-bench", NULL, NULL, 0 };
+    bool ok;
+    drreg_status_t res;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-time") == 0)
+            print_time = true;
+        else if (strcmp(argv[i], "-cross") == 0)
+            ops.cross_block_liveness = true;
+    }
+
+    drmgr_init();
+    res = drreg_init(&ops);
+    CHECK(res == DRREG_SUCCESS, "drreg init failed");
+    CHECK(drutil_init(), "drutil init failed");
+    stats_mutex = dr_mutex_create();
+    dr_register_exit_event(event_exit);
+
+    ok = drmgr_register_bb_instrumentation_ex_event(event_bb_app2app, event_bb_analysis,
+                                                    event_bb_insert,
+                                                    event_bb_instru2instru, &priority);
+    CHECK(ok, "drmgr register bb failed");
+}
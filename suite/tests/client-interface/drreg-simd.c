@@ -0,0 +1,143 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Checks that app values of SIMD registers survive drreg SIMD reservations that
+ * drreg-simd.dll.c clobbers, including across a fault: see drreg-simd.dll.c for
+ * the markers.
+ */
+
+#include "tools.h"
+#include "../../../core/unix/include/sigcontext.h"
+#include <setjmp.h>
+#include <signal.h>
+#include <ucontext.h>
+
+/* These must match drreg-simd.dll.c. */
+#define MARKER_XMM 0xd1d1
+#define MARKER_YMM 0xd2d2
+#define MARKER_FAULT 0xd3d3
+
+static const uint pattern[8] = { 0x01234567, 0x89abcdef, 0xdeadbeef, 0x0badf00d,
+                                 0x10203040, 0x50607080, 0x11223344, 0x55667788 };
+static SIGJMP_BUF mark;
+
+static void
+check_sum(const uint *out, int num, const char *name)
+{
+    int i;
+    for (i = 0; i < num; i++) {
+        if (out[i] != pattern[i] * 2) {
+            print("ERROR: %s element %d is 0x%x\n", name, i, out[i]);
+            return;
+        }
+    }
+    print("%s ok\n", name);
+}
+
+static void
+test_xmm(void)
+{
+    uint out[4];
+    __asm__ __volatile__("movdqu %1, %%xmm1\n\t"
+                         "mov %2, %%eax\n\t"
+                         "paddd %%xmm1, %%xmm1\n\t"
+                         "movdqu %%xmm1, %0\n\t"
+                         : "=m"(out)
+                         : "m"(pattern), "i"(MARKER_XMM)
+                         : "xmm1", "eax");
+    check_sum(out, 4, "xmm");
+}
+
+static void
+test_ymm(void)
+{
+    uint out[8];
+    if (!__builtin_cpu_supports("avx")) {
+        /* Keep the output the same. */
+        print("ymm ok\n");
+        return;
+    }
+    __asm__ __volatile__("vmovdqu %1, %%ymm1\n\t"
+                         "mov %2, %%eax\n\t"
+                         "vpaddd %%ymm1, %%ymm1, %%ymm1\n\t"
+                         "vmovdqu %%ymm1, %0\n\t"
+                         "vzeroupper\n\t"
+                         : "=m"(out)
+                         : "m"(pattern), "i"(MARKER_YMM)
+                         : "xmm1", "eax");
+    check_sum(out, 8, "ymm");
+}
+
+static void
+handle_signal(int signal, siginfo_t *siginfo, ucontext_t *ucxt)
+{
+    kernel_fpstate_t *fp = (kernel_fpstate_t *)ucxt->uc_mcontext.fpregs;
+    int i;
+    for (i = 0; i < 4; i++) {
+#ifdef X64
+        uint val = fp->xmm_space[4 + i];
+#else
+        uint val = fp->_xmm[1].element[i];
+#endif
+        if (val != pattern[i]) {
+            print("ERROR: xmm1 element %d is 0x%x at fault\n", i, val);
+            SIGLONGJMP(mark, 1);
+        }
+    }
+    print("fault ok\n");
+    SIGLONGJMP(mark, 1);
+}
+
+static void
+test_fault(void)
+{
+    intercept_signal(SIGSEGV, (handler_3_t)&handle_signal, false);
+    if (SIGSETJMP(mark) == 0) {
+        __asm__ __volatile__("movdqu %0, %%xmm1\n\t"
+                             "mov %1, %%eax\n\t"
+                             "mov (%2), %%eax\n\t"
+                             :
+                             : "m"(pattern), "i"(MARKER_FAULT), "r"(NULL)
+                             : "xmm1", "eax", "memory");
+    }
+}
+
+int
+main(int argc, const char *argv[])
+{
+    test_xmm();
+    test_ymm();
+    test_fault();
+    print("app done\n");
+    return 0;
+}
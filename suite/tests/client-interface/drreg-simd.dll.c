@@ -0,0 +1,158 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Tests drreg's SIMD register reservations.  Blocks containing one of the markers
+ * from drreg-simd.c reserve xmm1 or ymm1 before each app instr and clobber it, so
+ * the app only sees the right values if drreg restores them for app reads, re-spills
+ * them after app writes, and restores them on a fault.  All other blocks reserve
+ * whatever xmm register drreg picks and clobber that.
+ */
+
+#include "dr_api.h"
+#include "drmgr.h"
+#include "drreg.h"
+#include <string.h>
+
+#define CHECK(x, msg)                        \
+    do {                                     \
+        if (!(x)) {                          \
+            dr_fprintf(STDERR, "%s\n", msg); \
+            dr_abort();                      \
+        }                                    \
+    } while (0);
+
+/* These must match drreg-simd.c. */
+#define MARKER_XMM 0xd1d1
+#define MARKER_YMM 0xd2d2
+#define MARKER_FAULT 0xd3d3
+
+static drvector_t only_reg1;
+
+static dr_emit_flags_t
+event_bb_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for_trace,
+                  bool translating, OUT void **user_data)
+{
+    instr_t *instr;
+    ptr_int_t marker = 0;
+    for (instr = instrlist_first_app(bb); instr != NULL;
+         instr = instr_get_next_app(instr)) {
+        ptr_int_t val;
+        if (instr_is_mov_constant(instr, &val) &&
+            opnd_is_reg(instr_get_dst(instr, 0)) &&
+            opnd_get_reg(instr_get_dst(instr, 0)) == DR_REG_EAX &&
+            (val == MARKER_XMM || val == MARKER_YMM || val == MARKER_FAULT))
+            marker = val;
+    }
+    *user_data = (void *)marker;
+    return DR_EMIT_DEFAULT;
+}
+
+static dr_emit_flags_t
+event_bb_insert(void *drcontext, void *tag, instrlist_t *bb, instr_t *instr,
+                bool for_trace, bool translating, void *user_data)
+{
+    ptr_int_t marker = (ptr_int_t)user_data;
+    drreg_reserve_info_t info = {
+        sizeof(info),
+    };
+    reg_id_t reg;
+    drreg_status_t res;
+    if (!instr_is_app(instr))
+        return DR_EMIT_DEFAULT;
+    if (marker == MARKER_YMM) {
+        res = drreg_reserve_register_ex(drcontext, DRREG_SIMD_YMM_SPILL_CLASS, bb, instr,
+                                        &only_reg1, &reg);
+        if (res == DRREG_ERROR_FEATURE_NOT_AVAILABLE)
+            return DR_EMIT_DEFAULT; /* the app skips its ymm test too */
+        CHECK(res == DRREG_SUCCESS && reg == DR_REG_YMM1, "failed to reserve ymm1");
+        instrlist_meta_preinsert(bb, instr,
+                                 INSTR_CREATE_vpcmpeqd(drcontext, opnd_create_reg(reg),
+                                                       opnd_create_reg(reg),
+                                                       opnd_create_reg(reg)));
+    } else if (marker != 0) {
+        res = drreg_reserve_register_ex(drcontext, DRREG_SIMD_XMM_SPILL_CLASS, bb, instr,
+                                        &only_reg1, &reg);
+        CHECK(res == DRREG_SUCCESS && reg == DR_REG_XMM1, "failed to reserve xmm1");
+        instrlist_meta_preinsert(
+            bb, instr,
+            INSTR_CREATE_pcmpeqd(drcontext, opnd_create_reg(reg), opnd_create_reg(reg)));
+    } else {
+        res = drreg_reserve_register_ex(drcontext, DRREG_SIMD_XMM_SPILL_CLASS, bb, instr,
+                                        NULL, &reg);
+        CHECK(res == DRREG_SUCCESS && reg_is_strictly_xmm(reg), "failed to reserve");
+        instrlist_meta_preinsert(
+            bb, instr,
+            INSTR_CREATE_pxor(drcontext, opnd_create_reg(reg), opnd_create_reg(reg)));
+    }
+    res = drreg_reservation_info_ex(drcontext, reg, &info);
+    CHECK(res == DRREG_SUCCESS && info.reserved && !info.holds_app_value &&
+              !info.is_dr_slot,
+          "unexpected reservation info");
+    res = drreg_unreserve_register(drcontext, bb, instr, reg);
+    CHECK(res == DRREG_SUCCESS, "failed to unreserve");
+    return DR_EMIT_DEFAULT;
+}
+
+static void
+event_exit(void)
+{
+    bool ok = drmgr_unregister_bb_instrumentation_event(event_bb_analysis);
+    CHECK(ok, "drmgr unregister bb failed");
+    drvector_delete(&only_reg1);
+    drreg_exit();
+    drmgr_exit();
+    dr_fprintf(STDERR, "all done\n");
+}
+
+DR_EXPORT void
+dr_client_main(client_id_t id, int argc, const char *argv[])
+{
+    drreg_options_t ops = { sizeof(ops), 1 /*max slots needed*/, false };
+    bool ok;
+    drreg_status_t res;
+
+    /* One slot for the reservation and one for the tool value across app reads. */
+    ops.num_spill_simd_slots = 2;
+    drmgr_init();
+    res = drreg_init(&ops);
+    CHECK(res == DRREG_SUCCESS, "drreg init failed");
+    res = drreg_init_and_fill_vector_ex(&only_reg1, DRREG_SIMD_XMM_SPILL_CLASS, false);
+    CHECK(res == DRREG_SUCCESS, "vector init failed");
+    res = drreg_set_vector_entry(&only_reg1, DR_REG_XMM1, true);
+    CHECK(res == DRREG_SUCCESS, "vector set failed");
+    dr_register_exit_event(event_exit);
+
+    ok = drmgr_register_bb_instrumentation_event(event_bb_analysis, event_bb_insert,
+                                                 NULL);
+    CHECK(ok, "drmgr register bb failed");
+}
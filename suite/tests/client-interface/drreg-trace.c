@@ -0,0 +1,117 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Runs a loop that becomes a trace whose first two blocks are joined by a call,
+ * with edx and the carry flag live across it, so -opt_trace_spills removes the
+ * restores and saves of edx and the arithmetic flags that drreg-trace.dll.c causes
+ * at that seam.  The app values must survive that, including across a fault in the
+ * callee.
+ */
+
+#include "tools.h"
+#include <setjmp.h>
+#include <signal.h>
+#include <ucontext.h>
+
+#define EDX_VAL 0x1234
+#define ITERS 1000
+#define CARRY_FLAG 0x1
+
+static SIGJMP_BUF mark;
+
+#ifdef X64
+/* The call below must not clobber the red zone. */
+#    define SKIP_RED_ZONE "lea -128(%%rsp), %%rsp\n\t"
+#    define RESTORE_RED_ZONE "lea 128(%%rsp), %%rsp\n\t"
+#else
+#    define SKIP_RED_ZONE ""
+#    define RESTORE_RED_ZONE ""
+#endif
+
+/* Each iteration adds *ptr plus the carry flag plus edx to eax. */
+static int
+seam_loop(int iters, int *ptr)
+{
+    int sum;
+    __asm__ __volatile__(SKIP_RED_ZONE "mov %[edx_val], %%edx\n\t"
+                                       "xor %%eax, %%eax\n\t"
+                                       "stc\n\t"
+                                       "1:\n\t"
+                                       "call 2f\n\t"
+                                       "dec %[iters]\n\t"
+                                       "stc\n\t"
+                                       "jnz 1b\n\t"
+                                       "jmp 3f\n\t"
+                                       "2:\n\t"
+                                       "mov (%[ptr]), %%ecx\n\t"
+                                       "adc %%ecx, %%eax\n\t"
+                                       "add %%edx, %%eax\n\t"
+                                       "ret\n\t"
+                                       "3:\n\t" RESTORE_RED_ZONE
+                         : "=&a"(sum), [iters] "+r"(iters)
+                         : [ptr] "r"(ptr), [edx_val] "i"(EDX_VAL)
+                         : "ecx", "edx", "cc", "memory");
+    return sum;
+}
+
+static void
+handle_signal(int signal, siginfo_t *siginfo, ucontext_t *ucxt)
+{
+    sigcontext_t *sc = SIGCXT_FROM_UCXT(ucxt);
+    if ((uint)sc->SC_XDX != EDX_VAL)
+        print("ERROR: edx is 0x%x at fault\n", (uint)sc->SC_XDX);
+    else if ((sc->SC_XFLAGS & CARRY_FLAG) == 0)
+        print("ERROR: CF is clear at fault\n");
+    else if ((uint)sc->SC_XAX != 0)
+        print("ERROR: eax is 0x%x at fault\n", (uint)sc->SC_XAX);
+    else
+        print("fault ok\n");
+    SIGLONGJMP(mark, 1);
+}
+
+int
+main(int argc, const char *argv[])
+{
+    int val = 1;
+    int sum = seam_loop(ITERS, &val);
+    if (sum != ITERS * (val + 1 + EDX_VAL))
+        print("ERROR: sum is 0x%x\n", sum);
+    else
+        print("sum ok\n");
+    intercept_signal(SIGSEGV, (handler_3_t)&handle_signal, false);
+    /* The loop is a trace by now: fault in its second block. */
+    if (SIGSETJMP(mark) == 0)
+        seam_loop(ITERS, NULL);
+    print("app done\n");
+    return 0;
+}
@@ -0,0 +1,108 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Reserves edx and the arithmetic flags at the top of every block and clobbers
+ * both, so every block restores and saves them and drreg-trace.c's trace has a
+ * restore/save pair at each seam for -opt_trace_spills to remove.
+ */
+
+#include "dr_api.h"
+#include "drmgr.h"
+#include "drreg.h"
+
+#define CHECK(x, msg)                        \
+    do {                                     \
+        if (!(x)) {                          \
+            dr_fprintf(STDERR, "%s\n", msg); \
+            dr_abort();                      \
+        }                                    \
+    } while (0);
+
+static drvector_t only_edx;
+static uint num_blocks;
+
+static dr_emit_flags_t
+event_bb_insert(void *drcontext, void *tag, instrlist_t *bb, instr_t *instr,
+                bool for_trace, bool translating, void *user_data)
+{
+    reg_id_t reg;
+    drreg_status_t res;
+    if (!drmgr_is_first_instr(drcontext, instr))
+        return DR_EMIT_DEFAULT;
+    res = drreg_reserve_register(drcontext, bb, instr, &only_edx, &reg);
+    CHECK(res == DRREG_SUCCESS && reg == DR_REG_XDX, "failed to reserve edx");
+    res = drreg_reserve_aflags(drcontext, bb, instr);
+    CHECK(res == DRREG_SUCCESS, "failed to reserve aflags");
+    instrlist_insert_mov_immed_ptrsz(drcontext, (ptr_int_t)&num_blocks,
+                                     opnd_create_reg(reg), bb, instr, NULL, NULL);
+    instrlist_meta_preinsert(bb, instr,
+                             INSTR_CREATE_add(drcontext, OPND_CREATE_MEM32(reg, 0),
+                                              OPND_CREATE_INT8(1)));
+    res = drreg_unreserve_aflags(drcontext, bb, instr);
+    CHECK(res == DRREG_SUCCESS, "failed to unreserve aflags");
+    res = drreg_unreserve_register(drcontext, bb, instr, reg);
+    CHECK(res == DRREG_SUCCESS, "failed to unreserve");
+    return DR_EMIT_DEFAULT;
+}
+
+static void
+event_exit(void)
+{
+    bool ok = drmgr_unregister_bb_insertion_event(event_bb_insert);
+    CHECK(ok, "drmgr unregister bb failed");
+    CHECK(num_blocks > 0, "no blocks counted");
+    drvector_delete(&only_edx);
+    drreg_exit();
+    drmgr_exit();
+    dr_fprintf(STDERR, "all done\n");
+}
+
+DR_EXPORT void
+dr_client_main(client_id_t id, int argc, const char *argv[])
+{
+    drreg_options_t ops = { sizeof(ops), 2 /*max slots needed*/, false };
+    bool ok;
+    drreg_status_t res;
+
+    drmgr_init();
+    res = drreg_init(&ops);
+    CHECK(res == DRREG_SUCCESS, "drreg init failed");
+    res = drreg_init_and_fill_vector(&only_edx, false);
+    CHECK(res == DRREG_SUCCESS, "vector init failed");
+    res = drreg_set_vector_entry(&only_edx, DR_REG_XDX, true);
+    CHECK(res == DRREG_SUCCESS, "vector set failed");
+    dr_register_exit_event(event_exit);
+
+    ok = drmgr_register_bb_instrumentation_event(NULL, event_bb_insert, NULL);
+    CHECK(ok, "drmgr register bb failed");
+}
@@ -0,0 +1,86 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Exercises drwrap_begin_batch(): see drwrap-batch.dll.c. */
+
+#include "tools.h"
+
+/* Keeps the compiler from eliding the calls below. */
+static volatile int sink;
+
+#define BATCH_FUNC(n)   \
+    EXPORT NOINLINE int \
+    batch_##n(int x)    \
+    {                   \
+        return x + n;   \
+    }
+
+BATCH_FUNC(0)
+BATCH_FUNC(1)
+BATCH_FUNC(2)
+BATCH_FUNC(3)
+BATCH_FUNC(4)
+BATCH_FUNC(5)
+BATCH_FUNC(6)
+BATCH_FUNC(7)
+
+/* The client wraps the batch_ functions when this is called. */
+EXPORT NOINLINE void
+batch_marker(void)
+{
+    sink++;
+}
+
+static void
+call_all(void)
+{
+    sink += batch_0(sink);
+    sink += batch_1(sink);
+    sink += batch_2(sink);
+    sink += batch_3(sink);
+    sink += batch_4(sink);
+    sink += batch_5(sink);
+    sink += batch_6(sink);
+    sink += batch_7(sink);
+}
+
+int
+main(int argc, char **argv)
+{
+    /* Get the functions into the code cache before they are wrapped. */
+    call_all();
+    batch_marker();
+    call_all();
+    print("app done\n");
+    return 0;
+}
@@ -0,0 +1,138 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Tests drwrap_begin_batch() and drwrap_end_batch(): wrapping functions that
+ * have already executed inside a batch should take a single flush.
+ */
+
+#include "dr_api.h"
+#include "drmgr.h"
+#include "drwrap.h"
+
+#define CHECK(x, msg)                        \
+    do {                                     \
+        if (!(x)) {                          \
+            dr_fprintf(STDERR, "%s\n", msg); \
+            dr_abort();                      \
+        }                                    \
+    } while (0)
+
+#define NUM_FUNCS 8
+
+static const char *const names[NUM_FUNCS] = { "batch_0", "batch_1", "batch_2",
+                                               "batch_3", "batch_4", "batch_5",
+                                               "batch_6", "batch_7" };
+static app_pc funcs[NUM_FUNCS];
+static app_pc marker;
+static int pre_count[NUM_FUNCS];
+
+static int
+get_flush_count(void)
+{
+    drwrap_stats_t stats = {
+        sizeof(stats),
+    };
+    CHECK(drwrap_get_stats(&stats), "get_stats failed");
+    return stats.flush_count;
+}
+
+static void
+batch_pre(void *wrapcxt, OUT void **user_data)
+{
+    app_pc func = drwrap_get_func(wrapcxt);
+    int i;
+    for (i = 0; i < NUM_FUNCS; i++) {
+        if (funcs[i] == func)
+            pre_count[i]++;
+    }
+}
+
+/* Called from a clean call, as flushing is not allowed from wrap callbacks. */
+static void
+at_marker(void)
+{
+    int flushes = get_flush_count();
+    int i;
+    drwrap_begin_batch();
+    drwrap_begin_batch();
+    for (i = 0; i < NUM_FUNCS; i++)
+        CHECK(drwrap_wrap(funcs[i], batch_pre, NULL), "wrap failed");
+    CHECK(drwrap_end_batch(), "inner end_batch failed");
+    CHECK(get_flush_count() == flushes, "inner end_batch should not flush");
+    CHECK(drwrap_end_batch(), "outer end_batch failed");
+    dr_fprintf(STDERR, "wrapped %d functions with %d flush(es)\n", NUM_FUNCS,
+               get_flush_count() - flushes);
+    CHECK(!drwrap_end_batch(), "unbalanced end_batch should fail");
+}
+
+static dr_emit_flags_t
+event_bb_insert(void *drcontext, void *tag, instrlist_t *bb, instr_t *inst,
+                bool for_trace, bool translating, void *user_data)
+{
+    if (dr_fragment_app_pc(tag) == marker && drmgr_is_first_instr(drcontext, inst))
+        dr_insert_clean_call(drcontext, bb, inst, (void *)at_marker, false, 0);
+    return DR_EMIT_DEFAULT;
+}
+
+static void
+event_exit(void)
+{
+    int i;
+    for (i = 0; i < NUM_FUNCS; i++)
+        CHECK(pre_count[i] == 1, "wrapped function not called once");
+    drmgr_unregister_bb_insertion_event(event_bb_insert);
+    drwrap_exit();
+    drmgr_exit();
+    dr_fprintf(STDERR, "all done\n");
+}
+
+DR_EXPORT void
+dr_init(client_id_t id)
+{
+    module_data_t *module = dr_get_main_module();
+    int i;
+
+    drmgr_init();
+    CHECK(drwrap_init(), "drwrap_init failed");
+    dr_register_exit_event(event_exit);
+
+    for (i = 0; i < NUM_FUNCS; i++) {
+        funcs[i] = (app_pc)dr_get_proc_address(module->handle, names[i]);
+        CHECK(funcs[i] != NULL, "failed to find function");
+    }
+    marker = (app_pc)dr_get_proc_address(module->handle, "batch_marker");
+    CHECK(marker != NULL, "failed to find marker");
+    CHECK(drmgr_register_bb_instrumentation_event(NULL, event_bb_insert, NULL),
+          "failed to register bb event");
+    dr_free_module_data(module);
+}
@@ -0,0 +1,96 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Exercises drwrap_wrap_lite(): see drwrap-lite.dll.c. */
+
+#include "tools.h"
+#include <setjmp.h>
+
+static jmp_buf env;
+/* Keeps the compiler from eliding or flattening the calls below. */
+static volatile int sink;
+
+EXPORT NOINLINE int
+lite_sum(int a, int b, int c, int d)
+{
+    return a + b + c + d;
+}
+
+EXPORT NOINLINE int
+lite_fact(int n)
+{
+    int res;
+    if (n <= 1)
+        return 1;
+    res = n * lite_fact(n - 1);
+    sink = res;
+    return res;
+}
+
+#if defined(UNIX) && defined(X64)
+/* A tail call, which shares lite_sum's return. */
+int
+lite_tail(int a, int b, int c, int d);
+asm(".text\n"
+    ".global lite_tail\n"
+    ".type lite_tail, @function\n"
+    "lite_tail:\n"
+    "    jmp lite_sum\n");
+#else
+EXPORT NOINLINE int
+lite_tail(int a, int b, int c, int d)
+{
+    return lite_sum(a, b, c, d);
+}
+#endif
+
+EXPORT NOINLINE int
+lite_jump(int x)
+{
+    longjmp(env, x);
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int i;
+    print("sum %d\n", lite_sum(1, 2, 3, 4));
+    print("fact %d\n", lite_fact(5));
+    print("tail %d\n", lite_tail(2, 3, 4, 5));
+    if (setjmp(env) == 0)
+        lite_jump(7);
+    for (i = 0; i < 10; i++)
+        sink += lite_sum(i, i, i, i);
+    print("app done\n");
+    return 0;
+}
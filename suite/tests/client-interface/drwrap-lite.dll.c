@@ -0,0 +1,156 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Tests drwrap_wrap_lite(): argument and return values, nesting, tail calls, and
+ * leaving a wrapped function by longjmp.
+ */
+
+#include "dr_api.h"
+#include "drmgr.h"
+#include "drwrap.h"
+
+#define CHECK(x, msg)                        \
+    do {                                     \
+        if (!(x)) {                          \
+            dr_fprintf(STDERR, "%s\n", msg); \
+            dr_abort();                      \
+        }                                    \
+    } while (0)
+
+typedef struct _func_t {
+    const char *name;
+    uint num_args;
+    int pre_count;
+    int post_count;
+} func_t;
+
+enum { FUNC_SUM, FUNC_FACT, FUNC_TAIL, FUNC_JUMP, NUM_FUNCS };
+
+static func_t funcs[NUM_FUNCS] = {
+    { "lite_sum", 4 },
+    { "lite_fact", 1 },
+    { "lite_tail", 4 },
+    { "lite_jump", 1 },
+};
+
+static int
+fact(int n)
+{
+    return n <= 1 ? 1 : n * fact(n - 1);
+}
+
+static void *
+pre_sum(void *user_data, reg_t arg0, reg_t arg1, reg_t arg2, reg_t arg3)
+{
+    func_t *func = (func_t *)user_data;
+    func->pre_count++;
+    return (void *)(ptr_int_t)((int)arg0 + (int)arg1 + (int)arg2 + (int)arg3);
+}
+
+static void *
+pre_one(void *user_data, reg_t arg0, reg_t arg1, reg_t arg2, reg_t arg3)
+{
+    func_t *func = (func_t *)user_data;
+    CHECK(arg1 == 0 && arg2 == 0 && arg3 == 0, "unrequested args should be 0");
+    func->pre_count++;
+    return (void *)(ptr_int_t)(int)arg0;
+}
+
+static void
+post_sum(void *user_data, void *call_data, reg_t retval)
+{
+    func_t *func = (func_t *)user_data;
+    func->post_count++;
+    CHECK((int)retval == (int)(ptr_int_t)call_data, "wrong sum");
+}
+
+static void
+post_fact(void *user_data, void *call_data, reg_t retval)
+{
+    func_t *func = (func_t *)user_data;
+    func->post_count++;
+    CHECK((int)retval == fact((int)(ptr_int_t)call_data), "wrong factorial");
+}
+
+static void
+post_jump(void *user_data, void *call_data, reg_t retval)
+{
+    func_t *func = (func_t *)user_data;
+    func->post_count++;
+}
+
+static void
+event_exit(void)
+{
+    int i;
+    for (i = 0; i < NUM_FUNCS; i++) {
+        dr_fprintf(STDERR, "%s: %d pre, %d post\n", funcs[i].name, funcs[i].pre_count,
+                   funcs[i].post_count);
+    }
+    drwrap_exit();
+    drmgr_exit();
+    dr_fprintf(STDERR, "all done\n");
+}
+
+DR_EXPORT void
+dr_init(client_id_t id)
+{
+    module_data_t *module = dr_get_main_module();
+    drwrap_lite_pre_cb_t pre[NUM_FUNCS] = { pre_sum, pre_one, pre_sum, pre_one };
+    drwrap_lite_post_cb_t post[NUM_FUNCS] = { post_sum, post_fact, post_sum,
+                                              post_jump };
+    int i;
+
+    drmgr_init();
+    CHECK(drwrap_init(), "drwrap_init failed");
+    dr_register_exit_event(event_exit);
+
+    for (i = 0; i < NUM_FUNCS; i++) {
+        app_pc pc = (app_pc)dr_get_proc_address(module->handle, funcs[i].name);
+        CHECK(pc != NULL, "failed to find function");
+        CHECK(drwrap_wrap_lite(pc, pre[i], post[i], &funcs[i], funcs[i].num_args,
+                               DRWRAP_CALLCONV_DEFAULT),
+              "wrap failed");
+    }
+
+    /* Only one lite wrap per function, but an unwrapped one can be re-wrapped. */
+    {
+        app_pc pc = (app_pc)dr_get_proc_address(module->handle, "lite_sum");
+        CHECK(!drwrap_wrap_lite(pc, pre_one, post_sum, NULL, 1, 0),
+              "second wrap should fail");
+        CHECK(drwrap_unwrap_lite(pc, pre_sum, post_sum), "unwrap failed");
+        CHECK(!drwrap_unwrap_lite(pc, pre_sum, post_sum), "second unwrap should fail");
+        CHECK(drwrap_wrap_lite(pc, pre_sum, post_sum, &funcs[FUNC_SUM], 4, 0),
+              "re-wrap failed");
+    }
+    dr_free_module_data(module);
+}
@@ -0,0 +1,70 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Exercises drx sharded counters from several threads: see drx-sharded.dll.c. */
+
+#include "tools.h"
+#include "thread.h"
+
+#define NUM_THREADS 4
+#define NUM_ITERS 1000
+
+static volatile int sink;
+
+EXPORT NOINLINE void
+sharded_work(void)
+{
+    sink++;
+}
+
+static THREAD_FUNC_RETURN_TYPE
+thread_func(void *arg)
+{
+    int i;
+    for (i = 0; i < NUM_ITERS; i++)
+        sharded_work();
+    return THREAD_FUNC_RETURN_ZERO;
+}
+
+int
+main(int argc, char **argv)
+{
+    thread_t threads[NUM_THREADS];
+    int i;
+    for (i = 0; i < NUM_THREADS; i++)
+        threads[i] = create_thread(thread_func, NULL);
+    for (i = 0; i < NUM_THREADS; i++)
+        join_thread(threads[i]);
+    print("all threads done\n");
+    return 0;
+}
@@ -0,0 +1,113 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Tests drx_insert_sharded_counter_update(): per-thread slots must add up to
+ * the same totals as a locked shared counter.
+ */
+
+#include "dr_api.h"
+#include "drmgr.h"
+#include "drreg.h"
+#include "drx.h"
+
+#define CHECK(x, msg)                                                                \
+    do {                                                                             \
+        if (!(x)) {                                                                  \
+            dr_fprintf(STDERR, "CHECK failed %s:%d: %s\n", __FILE__, __LINE__, msg); \
+            dr_abort();                                                              \
+        }                                                                            \
+    } while (0);
+
+/* Must match drx-sharded.c. */
+#define EXPECTED_WORK_CALLS (4 * 1000)
+
+static app_pc work_pc;
+static drx_sharded_counter_t *work_count;
+static drx_sharded_counter_t *bb_count;
+static uint64 bb_count_locked;
+
+static void
+event_exit(void)
+{
+    CHECK(drx_sharded_counter_get_total(work_count) == EXPECTED_WORK_CALLS,
+          "wrong sharded work count");
+    CHECK(drx_sharded_counter_get_total(bb_count) == bb_count_locked,
+          "sharded and locked block counts differ");
+    dr_fprintf(STDERR, "sharded counts match\n");
+    CHECK(drx_sharded_counter_free(work_count), "free failed");
+    CHECK(drx_sharded_counter_free(bb_count), "free failed");
+    drx_exit();
+    drreg_exit();
+    drmgr_exit();
+}
+
+static dr_emit_flags_t
+event_app_instruction(void *drcontext, void *tag, instrlist_t *bb, instr_t *inst,
+                      bool for_trace, bool translating, void *user_data)
+{
+    if (!drmgr_is_first_instr(drcontext, inst))
+        return DR_EMIT_DEFAULT;
+    if (dr_fragment_app_pc(tag) == work_pc) {
+        CHECK(drx_insert_sharded_counter_update(drcontext, bb, inst, work_count, 1),
+              "work update failed");
+    }
+    CHECK(drx_insert_sharded_counter_update(drcontext, bb, inst, bb_count, 1),
+          "bb update failed");
+    CHECK(drx_insert_counter_update(drcontext, bb, inst, SPILL_SLOT_MAX + 1,
+                                    IF_NOT_X86_(SPILL_SLOT_MAX + 1) & bb_count_locked, 1,
+                                    DRX_COUNTER_64BIT | DRX_COUNTER_LOCK),
+          "locked update failed");
+    return DR_EMIT_DEFAULT;
+}
+
+DR_EXPORT void
+dr_init(client_id_t id)
+{
+    drreg_options_t ops = { sizeof(ops), 3 /*max slots needed*/, false };
+    module_data_t *module;
+    CHECK(drmgr_init(), "drmgr_init failed");
+    CHECK(drx_init(), "drx_init failed");
+    CHECK(drreg_init(&ops) == DRREG_SUCCESS, "drreg_init failed");
+    dr_register_exit_event(event_exit);
+    if (!drmgr_register_bb_instrumentation_event(NULL, event_app_instruction, NULL))
+        DR_ASSERT(false);
+
+    module = dr_get_main_module();
+    work_pc = (app_pc)dr_get_proc_address(module->handle, "sharded_work");
+    CHECK(work_pc != NULL, "failed to find sharded_work");
+    dr_free_module_data(module);
+
+    work_count = drx_sharded_counter_create();
+    bb_count = drx_sharded_counter_create();
+    CHECK(work_count != NULL && bb_count != NULL, "create failed");
+}
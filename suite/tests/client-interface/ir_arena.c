@@ -0,0 +1,81 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Each thread runs a loop until it has started building a trace, at which point
+ * the main thread exits, so the threads are torn down at process exit while
+ * their traces are still being built.  See ir_arena.dll.c.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define NUM_THREADS 8
+/* Past the trace threshold, so the loop is a trace head being built. */
+#define HOT_ITERS 100
+
+static volatile int num_hot;
+static volatile unsigned int sum;
+
+static void *
+thread_func(void *arg)
+{
+    unsigned int i;
+    for (i = 0;; i++) {
+        if (i % 3 == 0)
+            sum += i;
+        else
+            sum ^= i;
+        if (i == HOT_ITERS)
+            __sync_fetch_and_add(&num_hot, 1);
+    }
+    return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+    pthread_t thread;
+    int i;
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        if (pthread_create(&thread, NULL, thread_func, NULL) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+    while (num_hot < NUM_THREADS)
+        sched_yield();
+    fprintf(stderr, "all threads hot\n");
+    return 0;
+}
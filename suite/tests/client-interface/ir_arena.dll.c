@@ -0,0 +1,93 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Builds every block and trace out of the IR arena, and asks for traces that
+ * keep growing, so that threads exit with a trace still being built.  That
+ * trace's instrs are freed during thread exit and must still be valid then.
+ */
+
+#include "dr_api.h"
+
+static int num_traces;
+
+static void
+add_meta_nops(void *drcontext, instrlist_t *ilist)
+{
+    /* Instrs we create come from the arena. */
+    instr_t *where = instrlist_first(ilist);
+    int i;
+    for (i = 0; i < 4; i++)
+        instrlist_meta_preinsert(ilist, where, INSTR_CREATE_nop(drcontext));
+}
+
+static dr_emit_flags_t
+event_bb(void *drcontext, void *tag, instrlist_t *bb, bool for_trace, bool translating)
+{
+    add_meta_nops(drcontext, bb);
+    return DR_EMIT_DEFAULT;
+}
+
+static dr_emit_flags_t
+event_trace(void *drcontext, void *tag, instrlist_t *trace, bool translating)
+{
+    if (!translating)
+        dr_atomic_add32_return_sum(&num_traces, 1);
+    add_meta_nops(drcontext, trace);
+    return DR_EMIT_DEFAULT;
+}
+
+static dr_custom_trace_action_t
+event_end_trace(void *drcontext, void *trace_tag, void *next_tag)
+{
+    /* Never stop at a trace head, so traces are built for as long as possible. */
+    return CUSTOM_TRACE_CONTINUE;
+}
+
+static void
+event_exit(void)
+{
+    if (num_traces == 0)
+        dr_fprintf(STDERR, "no traces were built\n");
+    dr_fprintf(STDERR, "done\n");
+}
+
+DR_EXPORT void
+dr_client_main(client_id_t id, int argc, const char *argv[])
+{
+    if (!dr_set_ir_allocation_mode(DR_IR_ALLOC_ARENA))
+        dr_fprintf(STDERR, "failed to enable the IR arena\n");
+    dr_register_bb_event(event_bb);
+    dr_register_trace_event(event_trace);
+    dr_register_end_trace_event(event_end_trace);
+    dr_register_exit_event(event_exit);
+}
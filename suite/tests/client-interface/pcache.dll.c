@@ -232,6 +232,8 @@ dr_init(client_id_t id)
         dr_fprintf(STDERR, "failed to register ro");
     if (!dr_register_persist_patch(event_persist_patch))
         dr_fprintf(STDERR, "failed to register patch");
+    if (!dr_set_persist_version(0x1234abcd))
+        dr_fprintf(STDERR, "failed to set persist version");
 
     hashtable_init(&sample_inlined_table, 4, HASH_INTPTR, false /*!strdup*/);
     hashtable_init_ex(&sample_pointer_table, 4, HASH_INTPTR, false /*!strdup*/,
@@ -0,0 +1,92 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Tests dr_set_perf_sampler(): samples every thread on its task clock and checks
+ * that samples of the code cache are translated back into the executable.
+ */
+
+#include "dr_api.h"
+
+/* 1ms of thread CPU time. */
+#define PERIOD_NS 1000000
+
+static app_pc exe_start;
+static app_pc exe_end;
+static bool unsupported;
+/* Only updated from the sampled thread's signal handler, so approximate. */
+static int num_app_samples;
+static int num_exe_samples;
+static int num_dr_samples;
+
+static void
+event_sample(void *drcontext, dr_perf_sample_t *sample)
+{
+    DR_ASSERT(sample->size == sizeof(*sample));
+    DR_ASSERT(sample->event == DR_PERF_SAMPLE_TASK_CLOCK);
+    DR_ASSERT(sample->raw_pc != NULL);
+    if (sample->where == DR_WHERE_FCACHE || sample->where == DR_WHERE_APP) {
+        num_app_samples++;
+        if (sample->pc >= exe_start && sample->pc < exe_end)
+            num_exe_samples++;
+    } else {
+        /* Time in DR or the client is never attributed to the app. */
+        DR_ASSERT(sample->pc == NULL);
+        num_dr_samples++;
+    }
+}
+
+static void
+event_thread_init(void *drcontext)
+{
+    if (!dr_set_perf_sampler(DR_PERF_SAMPLE_TASK_CLOCK, PERIOD_NS, event_sample))
+        unsupported = true;
+}
+
+static void
+event_exit(void)
+{
+    /* The kernel may not support perf events at all, as in some containers. */
+    DR_ASSERT(unsupported || (num_app_samples > 0 && num_exe_samples > 0));
+    dr_fprintf(STDERR, "perf sampling done\n");
+}
+
+DR_EXPORT void
+dr_client_main(client_id_t id, int argc, const char *argv[])
+{
+    module_data_t *exe = dr_get_main_module();
+    DR_ASSERT(exe != NULL);
+    exe_start = exe->start;
+    exe_end = exe->end;
+    dr_free_module_data(exe);
+    dr_register_thread_init_event(event_thread_init);
+    dr_register_exit_event(event_exit);
+}
@@ -0,0 +1,109 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Runs many threads, half spinning in the code cache and half blocked in a
+ * system call, while the client performs a synchall flush at each getppid().
+ * The thread count can be passed as the first argument.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_THREADS 16
+#define NUM_FLUSHES 10
+
+static volatile int done;
+static volatile int started;
+static int pipefd[2];
+
+static void *
+spinner(void *arg)
+{
+    volatile unsigned int x = (unsigned int)(ptrdiff_t)arg;
+    __sync_fetch_and_add(&started, 1);
+    while (!done)
+        x = x * 1103515245 + 12345;
+    return NULL;
+}
+
+static void *
+blocker(void *arg)
+{
+    char c;
+    __sync_fetch_and_add(&started, 1);
+    if (read(pipefd[0], &c, 1) != 1)
+        perror("read");
+    return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+    int num_threads = argc > 1 ? atoi(argv[1]) : DEFAULT_THREADS;
+    struct timespec pause = { 0, 1000 * 1000 };
+    pthread_t *threads;
+    int i;
+
+    threads = malloc(num_threads * sizeof(*threads));
+    if (threads == NULL || pipe(pipefd) != 0) {
+        perror("setup");
+        return 1;
+    }
+    for (i = 0; i < num_threads; i++) {
+        if (pthread_create(&threads[i], NULL, i % 2 == 0 ? spinner : blocker,
+                           (void *)(ptrdiff_t)i) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+    while (started < num_threads)
+        nanosleep(&pause, NULL);
+    for (i = 0; i < NUM_FLUSHES; i++) {
+        getppid(); /* the client flushes here */
+        nanosleep(&pause, NULL);
+    }
+    done = 1;
+    for (i = 0; i < num_threads / 2; i++) {
+        if (write(pipefd[1], "x", 1) != 1)
+            perror("write");
+    }
+    for (i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    fprintf(stderr, "all threads joined\n");
+    return 0;
+}
@@ -0,0 +1,126 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Performs a synchall flush of the app's executable at each getppid() and
+ * measures how long each one pauses the app.  Pass "-bench" to print the pause
+ * distribution along with the thread count.
+ */
+
+#include "dr_api.h"
+#include <string.h>
+#include <sys/syscall.h>
+
+#define MAX_FLUSHES 64
+
+static app_pc exe_start;
+static size_t exe_size;
+static int num_flushes;
+static uint64 pause_us[MAX_FLUSHES];
+static int num_threads;
+static bool bench;
+
+static bool
+event_filter_syscall(void *drcontext, int sysnum)
+{
+    return sysnum == SYS_getppid;
+}
+
+static bool
+event_pre_syscall(void *drcontext, int sysnum)
+{
+    uint64 start;
+    if (sysnum != SYS_getppid || num_flushes >= MAX_FLUSHES)
+        return true;
+    start = dr_get_microseconds();
+    if (!dr_flush_region(exe_start, exe_size))
+        dr_fprintf(STDERR, "flush failed\n");
+    pause_us[num_flushes++] = dr_get_microseconds() - start;
+    return true;
+}
+
+static void
+event_thread_init(void *drcontext)
+{
+    dr_atomic_add32_return_sum(&num_threads, 1);
+}
+
+static void
+sort_pauses(void)
+{
+    int i, j;
+    for (i = 1; i < num_flushes; i++) {
+        uint64 val = pause_us[i];
+        for (j = i; j > 0 && pause_us[j - 1] > val; j--)
+            pause_us[j] = pause_us[j - 1];
+        pause_us[j] = val;
+    }
+}
+
+static void
+event_exit(void)
+{
+    if (bench && num_flushes > 0) {
+        /* Bucket i counts pauses under 10^(i+2) us, with the last open-ended. */
+        int buckets[4] = { 0 };
+        int i, j;
+        uint64 bound;
+        sort_pauses();
+        for (i = 0; i < num_flushes; i++) {
+            for (j = 0, bound = 100; j < 3 && pause_us[i] >= bound; j++, bound *= 10)
+                ;
+            buckets[j]++;
+        }
+        dr_fprintf(STDERR,
+                   "%d threads: pause (us) median " UINT64_FORMAT_STRING
+                   ", max " UINT64_FORMAT_STRING "\n",
+                   num_threads, pause_us[num_flushes / 2], pause_us[num_flushes - 1]);
+        dr_fprintf(STDERR, "  <100us: %d, <1ms: %d, <10ms: %d, >=10ms: %d\n",
+                   buckets[0], buckets[1], buckets[2], buckets[3]);
+    }
+    dr_fprintf(STDERR, "performed %d synchall flushes\n", num_flushes);
+}
+
+DR_EXPORT void
+dr_client_main(client_id_t id, int argc, const char *argv[])
+{
+    module_data_t *exe = dr_get_main_module();
+    DR_ASSERT(exe != NULL);
+    exe_start = exe->start;
+    exe_size = exe->end - exe->start;
+    dr_free_module_data(exe);
+    bench = argc > 1 && strcmp(argv[1], "-bench") == 0;
+    dr_register_filter_syscall_event(event_filter_syscall);
+    dr_register_pre_syscall_event(event_pre_syscall);
+    dr_register_thread_init_event(event_thread_init);
+    dr_register_exit_event(event_exit);
+}
@@ -0,0 +1,97 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Measures how long a fault in the code cache takes to reach the app's
+ * handler, as with runtimes that use guard pages or null checks for control
+ * flow.  Pass "-bench" to print the latency distribution.
+ */
+
+#include "tools.h"
+#include <setjmp.h>
+#include <signal.h>
+
+#define NUM_FAULTS 10000
+
+static sigjmp_buf env;
+static volatile long long fault_ns;
+static long long latency_ns[NUM_FAULTS];
+static int handled;
+static char *guard;
+
+static void
+handler(int sig, siginfo_t *info, void *ucxt)
+{
+    long long now = bench_now_ns();
+    if (info->si_addr != guard + handled % 64) {
+        fprintf(stderr, "wrong fault address %p\n", info->si_addr);
+        abort();
+    }
+    latency_ns[handled] = now - fault_ns;
+    siglongjmp(env, 1);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct sigaction act;
+    volatile int sum = 0;
+
+    memset(&act, 0, sizeof(act));
+    act.sa_sigaction = handler;
+    act.sa_flags = SA_SIGINFO;
+    sigemptyset(&act.sa_mask);
+    if (sigaction(SIGSEGV, &act, NULL) != 0) {
+        perror("sigaction");
+        return 1;
+    }
+    guard = mmap(NULL, 4096, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (guard == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    for (handled = 0; handled < NUM_FAULTS; handled++) {
+        if (sigsetjmp(env, 1) == 0) {
+            fault_ns = bench_now_ns();
+            sum += *(volatile char *)(guard + handled % 64);
+            fprintf(stderr, "no fault\n");
+            return 1;
+        }
+    }
+
+    if (argc > 1 && strcmp(argv[1], "-bench") == 0) {
+        bench_print_latency(latency_ns, NUM_FAULTS);
+    }
+    fprintf(stderr, "handled %d faults\n", handled);
+    munmap(guard, 4096);
+    return 0;
+}
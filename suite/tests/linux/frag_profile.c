@@ -0,0 +1,195 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Runs a hot loop in a child under -profile_frags and checks the child's
+ * hotness report, which is written when the child exits.  Takes the
+ * -profile_frags_dir directory as its argument.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define NUM_ITERS 100000
+
+/* These match dr_frag_profile_header_t, dr_frag_profile_module_t, and
+ * dr_frag_profile_entry_t.
+ */
+#define FRAG_PROFILE_MAGIC 0x464f525047415246ULL
+#define FRAG_PROFILE_VERSION 1
+
+typedef struct {
+    uint64_t magic;
+    uint64_t version;
+    uint64_t num_modules;
+    uint64_t num_entries;
+} header_t;
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint64_t path_len;
+} module_t;
+
+typedef struct {
+    uint64_t module;
+    uint64_t offset;
+    uint64_t bb_count;
+    uint64_t trace_count;
+} entry_t;
+
+static volatile int sink;
+
+static void
+hot_loop(void)
+{
+    int i;
+    for (i = 0; i < NUM_ITERS; i++)
+        sink += i;
+}
+
+static const char *
+basename_of(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    return slash == NULL ? path : slash + 1;
+}
+
+static int
+check_report(const char *path, const char *app)
+{
+    header_t header;
+    module_t module;
+    entry_t entry;
+    char **paths;
+    uint64_t i, prev_total = ~0ULL;
+    int res = 1;
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        printf("no report %s\n", path);
+        return 1;
+    }
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        header.magic != FRAG_PROFILE_MAGIC || header.version != FRAG_PROFILE_VERSION ||
+        header.num_entries == 0) {
+        printf("bad header\n");
+        fclose(f);
+        return 1;
+    }
+    paths = calloc(header.num_modules + 1, sizeof(*paths));
+    for (i = 0; i < header.num_modules; i++) {
+        if (fread(&module, sizeof(module), 1, f) != 1 || module.path_len == 0 ||
+            module.start >= module.end) {
+            printf("bad module %d\n", (int)i);
+            goto check_report_done;
+        }
+        paths[i] = malloc(module.path_len);
+        if (fread(paths[i], module.path_len, 1, f) != 1 ||
+            paths[i][module.path_len - 1] != '\0') {
+            printf("bad module path %d\n", (int)i);
+            goto check_report_done;
+        }
+    }
+    for (i = 0; i < header.num_entries; i++) {
+        uint64_t total;
+        if (fread(&entry, sizeof(entry), 1, f) != 1) {
+            printf("truncated entries\n");
+            goto check_report_done;
+        }
+        total = entry.bb_count + entry.trace_count;
+        if (total > prev_total) {
+            printf("entries not sorted\n");
+            goto check_report_done;
+        }
+        if (i == 0) {
+            /* The loop body is the hottest code in the child. */
+            if (entry.module >= header.num_modules ||
+                strcmp(basename_of(paths[entry.module]), basename_of(app)) != 0) {
+                printf("hottest fragment is not in the app\n");
+                goto check_report_done;
+            }
+            if (total < NUM_ITERS / 2) {
+                printf("hottest fragment only counted %d times\n", (int)total);
+                goto check_report_done;
+            }
+        }
+        prev_total = total;
+    }
+    if (fread(&entry, 1, 1, f) != 0) {
+        printf("trailing data\n");
+        goto check_report_done;
+    }
+    res = 0;
+check_report_done:
+    for (i = 0; i < header.num_modules; i++)
+        free(paths[i]);
+    free(paths);
+    fclose(f);
+    return res;
+}
+
+int
+main(int argc, char **argv)
+{
+    char path[1024];
+    pid_t child;
+    int status;
+    if (argc != 2) {
+        printf("usage: %s <report dir>\n", argv[0]);
+        return 1;
+    }
+    mkdir(argv[1], 0755);
+    child = fork();
+    if (child < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (child == 0) {
+        hot_loop();
+        return 0;
+    }
+    if (waitpid(child, &status, 0) != child || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+        printf("child failed\n");
+        return 1;
+    }
+    snprintf(path, sizeof(path), "%s/fragprof.%d.0.dat", argv[1], (int)child);
+    if (check_report(path, argv[0]) == 0)
+        printf("report ok\n");
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,156 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Stresses flushing the way a JIT does: each thread repeatedly rewrites and
+ * calls a function in its own code buffer, so every iteration flushes while the
+ * other threads are running.  Pass "-funcs N" to rewrite N functions per
+ * iteration instead of one, which fills the code cache with blocks that are all
+ * deleted together.  Pass "-bench" to print the elapsed time.
+ */
+
+#include "tools.h"
+#include <stddef.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define NUM_THREADS 8
+#define NUM_ITERS 500
+#define MAX_FUNCS 1024
+/* Distance between functions in a code buffer. */
+#define FUNC_SPACING 64
+
+static volatile int go;
+static int num_funcs = 1;
+static size_t code_size;
+
+/* Emits "return val" into buf. */
+static void
+emit_return(unsigned char *buf, int val)
+{
+#if defined(X86)
+    buf[0] = 0xb8; /* mov eax, imm32 */
+    memcpy(buf + 1, &val, sizeof(val));
+    buf[5] = 0xc3; /* ret */
+#elif defined(AARCH64)
+    unsigned int instrs[2];
+    instrs[0] = 0x52800000 | ((val & 0xffff) << 5); /* movz w0, #val */
+    instrs[1] = 0xd65f03c0;                          /* ret */
+    memcpy(buf, instrs, sizeof(instrs));
+    __builtin___clear_cache((char *)buf, (char *)buf + sizeof(instrs));
+#elif defined(ARM)
+    unsigned int instrs[2];
+    instrs[0] = 0xe3000000 | ((val & 0xf000) << 4) | (val & 0xfff); /* movw r0, #val */
+    instrs[1] = 0xe12fff1e;                                            /* bx lr */
+    memcpy(buf, instrs, sizeof(instrs));
+    __builtin___clear_cache((char *)buf, (char *)buf + sizeof(instrs));
+#else
+#    error NYI
+#endif
+}
+
+static void *
+thread_func(void *arg)
+{
+    unsigned char *buf = (unsigned char *)arg;
+    int i, j;
+    while (!go)
+        sched_yield();
+    for (i = 0; i < NUM_ITERS; i++) {
+        int expect = (int)(((ptrdiff_t)buf >> 12) + i) & 0xffff;
+        /* Each rewrite of code we have already run forces a flush. */
+        for (j = 0; j < num_funcs; j++)
+            emit_return(buf + j * FUNC_SPACING, (expect + j) & 0xffff);
+        for (j = 0; j < num_funcs; j++) {
+            int (*func)(void) = (int (*)(void))(buf + j * FUNC_SPACING);
+            if (func() != ((expect + j) & 0xffff)) {
+                fprintf(stderr, "iter %d func %d: stale code\n", i, j);
+                exit(1);
+            }
+        }
+    }
+    return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+    pthread_t threads[NUM_THREADS];
+    unsigned char *code[NUM_THREADS];
+    long long start;
+    bool bench = false;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-bench") == 0)
+            bench = true;
+        else if (strcmp(argv[i], "-funcs") == 0 && i + 1 < argc)
+            num_funcs = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [-funcs N] [-bench]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (num_funcs < 1 || num_funcs > MAX_FUNCS) {
+        fprintf(stderr, "-funcs must be 1..%d\n", MAX_FUNCS);
+        return 1;
+    }
+    code_size = (num_funcs * FUNC_SPACING + 4095) & ~(size_t)4095;
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        /* A separate mapping per thread, so each thread's rewrites flush only its
+         * own code.
+         */
+        code[i] = mmap(NULL, code_size, PROT_READ | PROT_WRITE | PROT_EXEC,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (code[i] == MAP_FAILED) {
+            perror("mmap");
+            return 1;
+        }
+        if (pthread_create(&threads[i], NULL, thread_func, code[i]) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+    start = bench_now_ns();
+    go = 1;
+    for (i = 0; i < NUM_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    if (bench) {
+        fprintf(stderr, "%d threads x %d iters x %d funcs: %.1f ms\n", NUM_THREADS,
+                NUM_ITERS, num_funcs, (bench_now_ns() - start) / 1000000.);
+    }
+    fprintf(stderr, "all threads done\n");
+    for (i = 0; i < NUM_THREADS; i++)
+        munmap(code[i], code_size);
+    return 0;
+}
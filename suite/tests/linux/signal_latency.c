@@ -0,0 +1,117 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Measures how long an asynchronous signal sent from another thread takes to
+ * reach a handler while its target thread spins in the code cache.
+ * Pass "-bench" to print the latency distribution.
+ */
+
+#include "tools.h"
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#define NUM_SIGNALS 1000
+/* A real-time signal, as timer-driven runtimes use. */
+#define LATENCY_SIGNAL (SIGRTMIN + 1)
+
+static pid_t target_tid;
+static volatile int target_ready;
+static volatile int received;
+static volatile long long sent_ns;
+static long long latency_ns[NUM_SIGNALS];
+static volatile unsigned int spin_result;
+
+static void
+handler(int sig, siginfo_t *info, void *ucxt)
+{
+    if (received < NUM_SIGNALS)
+        latency_ns[received] = bench_now_ns() - sent_ns;
+    __sync_fetch_and_add(&received, 1);
+}
+
+static void *
+sender(void *arg)
+{
+    struct timespec pause = { 0, 50 * 1000 };
+    int i;
+    while (!target_ready)
+        sched_yield();
+    for (i = 0; i < NUM_SIGNALS; i++) {
+        sent_ns = bench_now_ns();
+        syscall(SYS_tgkill, getpid(), target_tid, LATENCY_SIGNAL);
+        /* Wait for delivery before sending the next one, so each sample is
+         * independent.
+         */
+        while (received <= i)
+            nanosleep(&pause, NULL);
+    }
+    return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct sigaction act;
+    pthread_t thread;
+    unsigned int spin = 1;
+
+    memset(&act, 0, sizeof(act));
+    act.sa_sigaction = handler;
+    act.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&act.sa_mask);
+    if (sigaction(LATENCY_SIGNAL, &act, NULL) != 0) {
+        perror("sigaction");
+        return 1;
+    }
+    target_tid = syscall(SYS_gettid);
+    if (pthread_create(&thread, NULL, sender, NULL) != 0) {
+        perror("pthread_create");
+        return 1;
+    }
+    target_ready = 1;
+    /* Spin without any system calls or exits from a single loop, so that
+     * delivery at a fragment exit depends on how soon the loop is left.
+     */
+    while (received < NUM_SIGNALS)
+        spin = spin * 1103515245 + 12345;
+    spin_result = spin;
+    pthread_join(thread, NULL);
+
+    if (argc > 1 && strcmp(argv[1], "-bench") == 0) {
+        bench_print_latency(latency_ns, NUM_SIGNALS);
+    }
+    fprintf(stderr, "received %d signals\n", received);
+    return 0;
+}
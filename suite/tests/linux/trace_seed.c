@@ -0,0 +1,191 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Tests -trace_seed_file.  A child runs a hot loop under -profile_frags and its
+ * report becomes the seed file.  We then re-exec, which reloads the seeds, and
+ * check that the loop's trace is now built on its first entry: the loop head's
+ * bb is never executed on its own.  Takes the report directory as its argument.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define NUM_ITERS 100000
+/* Well below the default -trace_threshold. */
+#define MAX_SEEDED_HEAD_BB_COUNT 5
+
+/* These match dr_frag_profile_header_t and dr_frag_profile_entry_t. */
+#define FRAG_PROFILE_MAGIC 0x464f525047415246ULL
+
+typedef struct {
+    uint64_t magic;
+    uint64_t version;
+    uint64_t num_modules;
+    uint64_t num_entries;
+} header_t;
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint64_t path_len;
+} module_t;
+
+typedef struct {
+    uint64_t module;
+    uint64_t offset;
+    uint64_t bb_count;
+    uint64_t trace_count;
+} entry_t;
+
+static volatile int sink;
+
+static void
+hot_loop(void)
+{
+    int i;
+    for (i = 0; i < NUM_ITERS; i++)
+        sink += i;
+}
+
+/* Runs hot_loop() in a child and returns its pid, or -1 on failure. */
+static pid_t
+run_child(void)
+{
+    int status;
+    pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (child == 0) {
+        hot_loop();
+        exit(0);
+    }
+    if (waitpid(child, &status, 0) != child || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+        printf("child failed\n");
+        return -1;
+    }
+    return child;
+}
+
+/* Reads the hottest entry from the report at path. */
+static int
+read_hottest(const char *path, entry_t *entry)
+{
+    header_t header;
+    module_t module;
+    uint64_t i;
+    int res = 1;
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        printf("no report %s\n", path);
+        return 1;
+    }
+    if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != FRAG_PROFILE_MAGIC ||
+        header.num_entries == 0) {
+        printf("bad header\n");
+        goto read_hottest_done;
+    }
+    for (i = 0; i < header.num_modules; i++) {
+        if (fread(&module, sizeof(module), 1, f) != 1 ||
+            fseek(f, (long)module.path_len, SEEK_CUR) != 0) {
+            printf("bad module\n");
+            goto read_hottest_done;
+        }
+    }
+    if (fread(entry, sizeof(*entry), 1, f) != 1) {
+        printf("bad entry\n");
+        goto read_hottest_done;
+    }
+    res = 0;
+read_hottest_done:
+    fclose(f);
+    return res;
+}
+
+int
+main(int argc, char **argv)
+{
+    char path[1024], seed[1024];
+    entry_t entry;
+    pid_t child;
+    if (argc < 2) {
+        printf("usage: %s <report dir>\n", argv[0]);
+        return 1;
+    }
+    snprintf(seed, sizeof(seed), "%s/seed.dat", argv[1]);
+    if (argc == 2) {
+        /* The first run: no seeds yet. */
+        mkdir(argv[1], 0755);
+        unlink(seed);
+        child = run_child();
+        if (child < 0)
+            return 1;
+        snprintf(path, sizeof(path), "%s/fragprof.%d.0.dat", argv[1], (int)child);
+        if (rename(path, seed) != 0) {
+            perror("rename");
+            return 1;
+        }
+        if (read_hottest(seed, &entry) != 0)
+            return 1;
+        if (entry.trace_count < NUM_ITERS / 2)
+            printf("loop was not in a trace\n");
+        else
+            printf("unseeded profile written\n");
+        fflush(stdout);
+        execl(argv[0], argv[0], argv[1], "seeded", NULL);
+        perror("execl");
+        return 1;
+    }
+    child = run_child();
+    if (child < 0)
+        return 1;
+    snprintf(path, sizeof(path), "%s/fragprof.%d.0.dat", argv[1], (int)child);
+    if (read_hottest(path, &entry) != 0)
+        return 1;
+    if (entry.trace_count < NUM_ITERS / 2)
+        printf("loop was not in a trace\n");
+    else if (entry.bb_count > MAX_SEEDED_HEAD_BB_COUNT)
+        printf("seeded loop head ran %d times as a bb\n", (int)entry.bb_count);
+    else
+        printf("seeded trace built on first entry\n");
+    unlink(path);
+    unlink(seed);
+    return 0;
+}
@@ -0,0 +1,99 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Creates and joins many short-lived threads, as a thread-per-request server
+ * does, to exercise and measure thread creation and exit.
+ * Pass "-bench" to print the thread creation rate.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#define NUM_BATCHES 100
+#define THREADS_PER_BATCH 8
+
+static volatile int work_done;
+static pthread_mutex_t work_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *
+request(void *arg)
+{
+    pthread_mutex_lock(&work_lock);
+    work_done += (int)(long)arg;
+    pthread_mutex_unlock(&work_lock);
+    return NULL;
+}
+
+static double
+now_seconds(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.;
+}
+
+int
+main(int argc, char **argv)
+{
+    pthread_t threads[THREADS_PER_BATCH];
+    int i, j, expected = 0;
+    double start = now_seconds(), elapsed;
+
+    for (i = 0; i < NUM_BATCHES; i++) {
+        for (j = 0; j < THREADS_PER_BATCH; j++) {
+            if (pthread_create(&threads[j], NULL, request, (void *)(long)(j + 1)) != 0) {
+                fprintf(stderr, "pthread_create failed\n");
+                return 1;
+            }
+            expected += j + 1;
+        }
+        for (j = 0; j < THREADS_PER_BATCH; j++) {
+            if (pthread_join(threads[j], NULL) != 0) {
+                fprintf(stderr, "pthread_join failed\n");
+                return 1;
+            }
+        }
+    }
+    elapsed = now_seconds() - start;
+
+    if (work_done != expected)
+        fprintf(stderr, "work mismatch: %d vs %d\n", work_done, expected);
+    if (argc > 1 && strcmp(argv[1], "-bench") == 0) {
+        fprintf(stderr, "%d threads in %.3f s: %.0f creates per second\n",
+                NUM_BATCHES * THREADS_PER_BATCH, elapsed,
+                NUM_BATCHES * THREADS_PER_BATCH / elapsed);
+    }
+    fprintf(stderr, "created and joined %d threads\n", NUM_BATCHES * THREADS_PER_BATCH);
+    return 0;
+}
@@ -37,6 +37,7 @@
 #    ifdef UNIX
 #        include <unistd.h>
 #        include <sys/syscall.h> /* for SYS_* numbers */
+#        include <time.h>        /* for clock_gettime */
 #    endif
 #    ifdef MACOS
 #        include <mach/mach.h>
@@ -480,6 +481,34 @@ intercept_signal(int sig, handler_3_t handler, bool sigstack)
     ASSERT_NOERR(rc);
 }
 
+/******************************************************************************
+ * Timing for tests with a -bench mode
+ */
+
+long long
+bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int
+bench_compare(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+void
+bench_print_latency(long long *samples_ns, int num)
+{
+    qsort(samples_ns, num, sizeof(samples_ns[0]), bench_compare);
+    fprintf(stderr, "latency (us): median %.1f, 90%% %.1f, 99%% %.1f, max %.1f\n",
+            samples_ns[num / 2] / 1000., samples_ns[num * 9 / 10] / 1000.,
+            samples_ns[num * 99 / 100] / 1000., samples_ns[num - 1] / 1000.);
+}
+
 #    endif /* UNIX */
 
 #else /* asm code *************************************************************/
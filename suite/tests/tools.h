@@ -88,10 +88,15 @@
 #undef PFX
 #define PFX "0x" PFMT
 
-#if defined(AARCH64) && SIGSTKSZ < 16384
+/* SIGSTKSZ is not a constant expression in newer glibc, so only evaluate it
+ * where it is needed.
+ */
+#ifdef AARCH64
+#    if SIGSTKSZ < 16384
 /* SIGSTKSZ was incorrectly defined in Linux releases before 4.3. */
-#    undef SIGSTKSZ
-#    define SIGSTKSZ 16384
+#        undef SIGSTKSZ
+#        define SIGSTKSZ 16384
+#    endif
 #endif
 
 #ifdef __cplusplus
@@ -297,6 +302,16 @@ typedef void (*handler_3_t)(int, siginfo_t *, ucontext_t *);
 /* set up signal_handler as the handler for signal "sig" */
 void
 intercept_signal(int sig, handler_3_t handler, bool sigstack);
+
+/* Returns CLOCK_MONOTONIC time in nanoseconds. */
+long long
+bench_now_ns(void);
+
+/* Sorts the num samples and prints their median, 90th and 99th percentiles, and
+ * maximum to stderr.
+ */
+void
+bench_print_latency(long long *samples_ns, int num);
 #endif
 
 /* for cross-plaform siglongjmp */